@@ -33,6 +33,7 @@
 #include <boost/asio.hpp>
 #include <string>
 #include <vector>
+#include <deque>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
 #include <atomic>
@@ -50,7 +51,10 @@
 #undef LOG_DEFAULT_CHANNEL 
 #define LOG_DEFAULT_CHANNEL "net_server"
 
-#define ABSTRACT_SERVER_SEND_QUE_MAX_COUNT 1000
+#define ABSTRACT_SERVER_SEND_QUE_MAX_BYTES          (128 * 1024 * 1024)   //connection is closed when more than this waits to be sent
+#define ABSTRACT_SERVER_SEND_MAX_BUFFERS_PER_WRITE  64                    //queued buffers are written with one gather write, up to this many
+#define ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE        8192
+#define ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE        (256 * 1024)          //read buffer grows up to this while reads keep filling it
 
 namespace epee
 {
@@ -95,6 +99,7 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(const void* ptr, size_t cb);
+    virtual bool do_send_shared(const shared_buffer& buff);
     virtual bool close();
     virtual bool call_run_once_service_io();
     virtual bool request_callback();
@@ -111,20 +116,25 @@ namespace net_utils
     /// Handle completion of a write operation.
     void handle_write(const boost::system::error_code& e, size_t cb);
 
+    /// Start writing the queued buffers, m_send_que_lock is to be held.
+    void start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self);
+
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
 
     /// Socket for the connection.
     boost::asio::ip::tcp::socket socket_;
 
-    /// Buffer for incoming data.
-    boost::array<char, 8192> buffer_;
+    /// Buffer for incoming data, sized by how much the socket gives at once.
+    std::vector<char> buffer_;
 
     t_connection_context context;
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::list<std::string> m_send_que;
+    std::deque<shared_buffer> m_send_que;      // the first m_send_que_writing ones are being written
+    size_t m_send_que_writing;
+    size_t m_send_que_bytes;
     volatile uint32_t& m_ref_sockets_count;
     i_connection_filter* &m_pfilter;
     volatile bool m_is_multithreaded;
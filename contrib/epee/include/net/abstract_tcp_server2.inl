@@ -52,9 +52,12 @@ DISABLE_VS_WARNINGS(4355)
     typename t_protocol_handler::config_type& config, volatile uint32_t& sock_count, i_connection_filter* &pfilter)
                           : strand_(io_service),
                             socket_(io_service),
+                            buffer_(ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE),
                             m_protocol_handler(this, config, context), 
                             m_want_close_connection(0), 
                             m_was_shutdown(0), 
+                            m_send_que_writing(0), 
+                            m_send_que_bytes(0), 
                             m_ref_sockets_count(sock_count), 
                             m_pfilter(pfilter)
   {
@@ -244,6 +247,12 @@ DISABLE_VS_WARNINGS(4355)
           shutdown();
       }else
       {
+        // bulk transfers fill the buffer, so it doubles; it gets back to the small size once reads get short
+        if(bytes_transferred == buffer_.size() && buffer_.size() < ABSTRACT_SERVER_RECV_BUFFER_MAX_SIZE)
+          std::vector<char>(buffer_.size() * 2).swap(buffer_);
+        else if(bytes_transferred < ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE && buffer_.size() > ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE)
+          std::vector<char>(ABSTRACT_SERVER_RECV_BUFFER_MIN_SIZE).swap(buffer_);
+
         socket_.async_read_some(boost::asio::buffer(buffer_),
           strand_.wrap(
             boost::bind(&connection<t_protocol_handler>::handle_read, connection<t_protocol_handler>::shared_from_this(),
@@ -295,6 +304,14 @@ DISABLE_VS_WARNINGS(4355)
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(const void* ptr, size_t cb)
+  {
+    TRY_ENTRY();
+    return do_send_shared(make_shared_buffer(ptr, cb));
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send_shared(const shared_buffer& buff)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -304,48 +321,58 @@ DISABLE_VS_WARNINGS(4355)
     if(m_was_shutdown)
       return false;
 
-    LOG_PRINT("[sock " << socket_.native_handle() << "] SEND " << cb, LOG_LEVEL_4);
+    LOG_PRINT("[sock " << socket_.native_handle() << "] SEND " << buff->size(), LOG_LEVEL_4);
     context.m_last_send = time(NULL);
-    context.m_send_cnt += cb;
+    context.m_send_cnt += buff->size();
     //some data should be wrote to stream
     //request complete
     
     CRITICAL_REGION_LOCAL_VAR(m_send_que_lock, send_guard);
-    if(m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    if(m_send_que_bytes + buff->size() > ABSTRACT_SERVER_SEND_QUE_MAX_BYTES)
     {
       send_guard.unlock();//manual unlock
-      LOG_ERROR("send to [" << print_connection_context_short(context) << ", (" << (void*)this << ")] que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_COUNT(" << ABSTRACT_SERVER_SEND_QUE_MAX_COUNT << "), shutting down connection");
+      LOG_ERROR("send to [" << print_connection_context_short(context) << ", (" << (void*)this << ")] que size is more than ABSTRACT_SERVER_SEND_QUE_MAX_BYTES(" << ABSTRACT_SERVER_SEND_QUE_MAX_BYTES << "), shutting down connection");
       close();
       return false;
     }
 
-    m_send_que.resize(m_send_que.size()+1);
-    m_send_que.back().assign((const char*)ptr, cb);
+    m_send_que.push_back(buff);
+    m_send_que_bytes += buff->size();
     
-    if(m_send_que.size() > 1)
+    if(m_send_que_writing)
     {
       //active operation should be in progress, nothing to do, just wait last operation callback
     }else
     {
       //no active operation
-      if(m_send_que.size()!=1)
-      {
-        LOG_ERROR("Looks like no active operations, but send que size != 1!!");
-        return false;
-      }
+      start_write(self);
+    }
 
-      boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), m_send_que.front().size()),
-        //strand_.wrap(
-        boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
-        //)
-        );
+    return true;
 
-      LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Assync send requested " << m_send_que.front().size());
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_shared", false);
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void connection<t_protocol_handler>::start_write(const boost::shared_ptr<connection<t_protocol_handler> >& self)
+  {
+    //everything queued meanwhile goes in one gather write
+    std::vector<boost::asio::const_buffer> buffers;
+    size_t bytes = 0;
+    for(size_t i = 0; i != m_send_que.size() && i != ABSTRACT_SERVER_SEND_MAX_BUFFERS_PER_WRITE; i++)
+    {
+      buffers.push_back(boost::asio::buffer(*m_send_que[i]));
+      bytes += m_send_que[i]->size();
     }
+    m_send_que_writing = buffers.size();
 
-    return true;
+    boost::asio::async_write(socket_, buffers,
+      //strand_.wrap(
+      boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
+      //)
+      );
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
+    LOG_PRINT_L4("[sock " << socket_.native_handle() << "] Assync send requested " << bytes << " in " << buffers.size() << " buffers");
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
@@ -405,7 +432,12 @@ DISABLE_VS_WARNINGS(4355)
       return;
     }
 
-    m_send_que.pop_front();
+    for(; m_send_que_writing && m_send_que.size(); m_send_que_writing--)
+    {
+      m_send_que_bytes -= m_send_que.front()->size();
+      m_send_que.pop_front();
+    }
+    m_send_que_writing = 0;
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -415,10 +447,7 @@ DISABLE_VS_WARNINGS(4355)
     }else
     {
       //have more data to send
-      boost::asio::async_write(socket_, boost::asio::buffer(m_send_que.front().data(), m_send_que.front().size()),
-        //strand_.wrap(
-          boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2));
-        //);
+      start_write(connection<t_protocol_handler>::shared_from_this());
     }
     CRITICAL_REGION_END();
 
@@ -69,6 +69,7 @@ namespace levin
 
 #define LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED 0
 #define LEVIN_DEFAULT_MAX_PACKET_SIZE 100000000      //100MB by default
+#define LEVIN_BODY_PREALLOCATE_MAX_SIZE (1024 * 1024)  //body buffer reserved up front, the rest grows as it arrives
 
 #define LEVIN_PACKET_REQUEST			0x00000001
 #define LEVIN_PACKET_RESPONSE		0x00000002
@@ -76,6 +76,7 @@ public:
   int invoke_async(int command, const std::string& in_buff, boost::uuids::uuid connection_id, callback_t cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const std::string& in_buff, boost::uuids::uuid connection_id);
+  int notify(int command, const net_utils::shared_buffer& in_buff, boost::uuids::uuid connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
   bool request_callback(boost::uuids::uuid connection_id);
@@ -346,14 +347,22 @@ public:
       return false;
     }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
-
+    // received bytes are taken straight into the head or into the body buffer reserved for it, nothing is kept past the packet end
+    const char* pdata = (const char*)ptr;
     bool is_continue = true;
     while(is_continue)
     {
       switch(m_state)
       {
       case stream_state_body:
+        {
+          size_t chunk = std::min<size_t>(cb, m_current_head.m_cb - m_cache_in_buffer.size());
+          if(m_cache_in_buffer.size() + chunk > m_cache_in_buffer.capacity())
+            m_cache_in_buffer.reserve(std::min<size_t>(m_current_head.m_cb, std::max(m_cache_in_buffer.size() + chunk, m_cache_in_buffer.capacity() * 2)));
+          m_cache_in_buffer.append(pdata, chunk);
+          pdata += chunk;
+          cb -= chunk;
+        }
         if(m_cache_in_buffer.size() < m_current_head.m_cb)
         {
           is_continue = false;
@@ -361,13 +370,7 @@ public:
         }
         {
           std::string buff_to_invoke;
-          if(m_cache_in_buffer.size()  == m_current_head.m_cb)
-            buff_to_invoke.swap(m_cache_in_buffer);
-          else
-          {
-            buff_to_invoke.assign(m_cache_in_buffer, 0, (std::string::size_type)m_current_head.m_cb);
-            m_cache_in_buffer.erase(0, (std::string::size_type)m_current_head.m_cb);
-          }
+          buff_to_invoke.swap(m_cache_in_buffer);
 
           bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
 
@@ -465,6 +468,10 @@ public:
         break;
       case stream_state_head:
         {
+          size_t chunk = std::min<size_t>(cb, sizeof(bucket_head2) - m_cache_in_buffer.size());
+          m_cache_in_buffer.append(pdata, chunk);
+          pdata += chunk;
+          cb -= chunk;
           if(m_cache_in_buffer.size() < sizeof(bucket_head2))
           {
             if(m_cache_in_buffer.size() >= sizeof(uint64_t) && *((uint64_t*)m_cache_in_buffer.data()) != LEVIN_SIGNATURE)
@@ -484,7 +491,7 @@ public:
           }
           m_current_head = *phead;
 
-          m_cache_in_buffer.erase(0, sizeof(bucket_head2));
+          m_cache_in_buffer.clear();
           m_state = stream_state_body;
           m_oponent_protocol_ver = m_current_head.m_protocol_version;
           if(m_current_head.m_cb > m_config.m_max_packet_size)
@@ -494,6 +501,8 @@ public:
               << ", connection will be closed.");
             return false;
           }
+          // only what was actually received is held for a huge packet announced by the head
+          m_cache_in_buffer.reserve(std::min<size_t>(m_current_head.m_cb, LEVIN_BODY_PREALLOCATE_MAX_SIZE));
         }
         break;
       default:
@@ -661,6 +670,11 @@ public:
   }
 
   int notify(int command, const std::string& in_buff)
+  {
+    return notify(command, net_utils::make_shared_buffer(in_buff.data(), in_buff.size()));
+  }
+
+  int notify(int command, const net_utils::shared_buffer& in_buff)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -676,7 +690,7 @@ public:
     bucket_head2 head = {0};
     head.m_signature = LEVIN_SIGNATURE;
     head.m_have_to_return_data = false;
-    head.m_cb = in_buff.size();
+    head.m_cb = in_buff->size();
 
     head.m_command = command;
     head.m_protocol_version = LEVIN_PROTOCOL_VER_1;
@@ -688,7 +702,7 @@ public:
       return -1;
     }
 
-    if(!m_pservice_endpoint->do_send(in_buff.data(), (int)in_buff.size()))
+    if(!m_pservice_endpoint->do_send_shared(in_buff))
     {
       LOG_PRINT_CC_RED(m_connection_context, "Failed to do_send()", LOG_LEVEL_2);
       return -1;
@@ -822,6 +836,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(int command, const net_utils::shared_buffer& in_buff, boost::uuids::uuid connection_id)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(command, in_buff) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 bool async_protocol_handler_config<t_connection_context>::close(boost::uuids::uuid connection_id)
 {
   CRITICAL_REGION_LOCAL(m_connects_lock);
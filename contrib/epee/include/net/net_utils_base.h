@@ -30,6 +30,7 @@
 #define _NET_UTILS_BASE_H_
 
 #include <boost/uuid/uuid.hpp>
+#include <boost/shared_ptr.hpp>
 #include "string_tools.h"
 
 #ifndef MAKE_IP
@@ -99,9 +100,19 @@ namespace net_utils
 	/************************************************************************/
 	/*                                                                      */
 	/************************************************************************/
+  //data to be sent, immutable once made, so one copy is shared by all the connections it goes to
+  typedef boost::shared_ptr<const std::string> shared_buffer;
+
+  inline shared_buffer make_shared_buffer(const void* ptr, size_t cb)
+  {
+    return shared_buffer(new std::string(reinterpret_cast<const char*>(ptr), cb));
+  }
+
 	struct i_service_endpoint
 	{
 		virtual bool do_send(const void* ptr, size_t cb)=0;
+    //sends the buffer without copying it where the endpoint supports that
+    virtual bool do_send_shared(const shared_buffer& buff){return do_send(buff->data(), buff->size());}
     virtual bool close()=0;
     virtual bool call_run_once_service_io()=0;
     virtual bool request_callback()=0;
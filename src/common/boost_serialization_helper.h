@@ -7,6 +7,7 @@
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 #include <boost/filesystem/fstream.hpp>
+#include <sstream>
 
 #define CHECK_PROJECT_NAME()    std::string project_name = CURRENCY_NAME; ar & project_name;  if(project_name != CURRENCY_NAME) {throw std::runtime_error(std::string("wrong storage file: project name in file: ") + project_name + ", expected: " + CURRENCY_NAME );}
 
@@ -44,4 +45,29 @@ namespace tools
     return !data_file.fail();
     CATCH_ENTRY_L0("unserialize_obj_from_file", false);
   }
+
+  template<class t_object>
+  bool serialize_obj_to_buff(t_object& obj, std::string& buff)
+  {
+    TRY_ENTRY();
+    std::ostringstream ss;
+    {
+      boost::archive::binary_oarchive a(ss);
+      a << obj;
+    }
+    buff = ss.str();
+    return !ss.fail();
+    CATCH_ENTRY_L0("serialize_obj_to_buff", false);
+  }
+
+  template<class t_object>
+  bool unserialize_obj_from_buff(t_object& obj, const std::string& buff)
+  {
+    TRY_ENTRY();
+    std::istringstream ss(buff);
+    boost::archive::binary_iarchive a(ss);
+    a >> obj;
+    return !ss.fail();
+    CATCH_ENTRY_L0("unserialize_obj_from_buff", false);
+  }
 }
@@ -0,0 +1,278 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <string>
+#include <vector>
+#include <cstring>
+#ifdef WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include "include_base_utils.h"
+#include "misc_language.h"
+#include "string_tools.h"
+#include "crypto/hash.h"
+
+namespace tools
+{
+  /* Append-only file of variable-size records, written on top of some snapshot.
+   * Layout: header { magic, snapshot_id }, then records { size, checksum, data }.
+   * Records with bad size or checksum (i.e. torn by a crash while appending) are cut off on open.
+   * Appended records reach the OS on return, sync() makes them survive a power loss too.
+   */
+  class journal_file
+  {
+  public:
+    journal_file() : m_snapshot_id(0), m_records_count(0)
+    {}
+
+    ~journal_file()
+    {
+      close();
+    }
+
+    // opens (creates if needed) the journal and reads all valid records
+    bool open(const std::wstring& filename, std::vector<std::string>& records, bool* p_corrupted = nullptr, std::string* p_reason = nullptr)
+    {
+      close();
+      records.clear();
+      m_filename = filename;
+      m_snapshot_id = 0;
+      m_records_count = 0;
+      if (p_corrupted)
+        *p_corrupted = false;
+
+      if (!boost::filesystem::exists(filename))
+        return reset(0);
+
+      std::string buff;
+      {
+        boost::filesystem::ifstream in(filename, std::ios::binary);
+        if (in.fail())
+        {
+          if (p_reason)
+            *p_reason = "file could not be opened";
+          return false;
+        }
+        buff.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+      }
+
+      header h = AUTO_VAL_INIT(h);
+      if (buff.size() < sizeof h || (memcpy(&h, buff.data(), sizeof h), h.magic != JOURNAL_FILE_MAGIC))
+      {
+        if (p_corrupted)
+          *p_corrupted = true;
+        if (p_reason)
+          *p_reason = "bad header, journal reset";
+        return reset(0);
+      }
+      m_snapshot_id = h.snapshot_id;
+
+      size_t offset = sizeof h;
+      while (offset + sizeof(record_header) <= buff.size())
+      {
+        record_header rh = AUTO_VAL_INIT(rh);
+        memcpy(&rh, buff.data() + offset, sizeof rh);
+        if (rh.size > buff.size() - offset - sizeof rh || rh.checksum != get_checksum(buff.data() + offset + sizeof rh, rh.size))
+          break;
+        records.push_back(buff.substr(offset + sizeof rh, rh.size));
+        offset += sizeof rh + rh.size;
+      }
+
+      if (offset != buff.size())
+      {
+        if (p_corrupted)
+          *p_corrupted = true;
+        if (p_reason)
+          *p_reason = std::string("journal tail is corrupted, truncated: ") + epee::string_tools::num_to_string_fast(buff.size()) + " -> " + epee::string_tools::num_to_string_fast(offset);
+        boost::filesystem::resize_file(filename, offset);
+      }
+
+      m_records_count = records.size();
+      m_stream.open(filename, std::ios::binary | std::ios::app | std::ios::out);
+      return !m_stream.fail();
+    }
+
+    // creates empty journal, overwriting existing one
+    bool create(const std::wstring& filename, uint64_t snapshot_id)
+    {
+      close();
+      m_filename = filename;
+      return reset(snapshot_id);
+    }
+
+    // drops all records and binds the journal to a new snapshot
+    bool reset(uint64_t snapshot_id)
+    {
+      close();
+      m_stream.open(m_filename, std::ios::binary | std::ios::trunc | std::ios::out);
+      if (m_stream.fail())
+        return false;
+
+      header h = AUTO_VAL_INIT(h);
+      h.magic = JOURNAL_FILE_MAGIC;
+      h.snapshot_id = snapshot_id;
+      m_stream.write(reinterpret_cast<const char*>(&h), sizeof h);
+      m_stream.flush();
+      m_snapshot_id = snapshot_id;
+      m_records_count = 0;
+      return !m_stream.fail();
+    }
+
+    bool append(const std::string& record)
+    {
+      if (!m_stream.is_open() || m_stream.fail() || record.size() > UINT32_MAX)
+        return false;
+
+      write_record(m_stream, record);
+      m_stream.flush();
+      if (m_stream.fail())
+        return false;
+
+      ++m_records_count;
+      return true;
+    }
+
+    // replaces the journal with the given records at once: they go to a temporary file, which is synced and renamed
+    // over the journal, so a crash leaves either the old journal or the new one
+    bool rewrite(uint64_t snapshot_id, const std::vector<std::string>& records)
+    {
+      close();
+      std::wstring tmp_filename = m_filename + L".tmp";
+      {
+        boost::filesystem::ofstream out(tmp_filename, std::ios::binary | std::ios::trunc | std::ios::out);
+        header h = AUTO_VAL_INIT(h);
+        h.magic = JOURNAL_FILE_MAGIC;
+        h.snapshot_id = snapshot_id;
+        out.write(reinterpret_cast<const char*>(&h), sizeof h);
+        for (const auto& record : records)
+        {
+          if (record.size() > UINT32_MAX)
+            out.setstate(std::ios::failbit);
+          else
+            write_record(out, record);
+        }
+        out.flush();
+        if (out.fail())
+          return reopen_for_append();
+      }
+
+      boost::system::error_code ec;
+      if (!sync_file(tmp_filename) || (boost::filesystem::rename(tmp_filename, m_filename, ec), ec))
+        return reopen_for_append();
+      sync_file(boost::filesystem::path(m_filename).parent_path().wstring(), true);
+
+      m_snapshot_id = snapshot_id;
+      m_records_count = records.size();
+      m_stream.open(m_filename, std::ios::binary | std::ios::app | std::ios::out);
+      return !m_stream.fail();
+    }
+
+    // flushes the appended records to the disk
+    bool sync()
+    {
+      if (!m_stream.is_open())
+        return false;
+      m_stream.flush();
+      return !m_stream.fail() && sync_file(m_filename);
+    }
+
+    void close()
+    {
+      if (m_stream.is_open())
+        m_stream.close();
+      m_stream.clear();
+    }
+
+    bool is_open() const { return m_stream.is_open(); }
+    uint64_t get_snapshot_id() const { return m_snapshot_id; }
+    size_t records_count() const { return m_records_count; }
+
+    uint64_t size_bytes() const
+    {
+      boost::system::error_code ec;
+      uint64_t sz = boost::filesystem::file_size(m_filename, ec);
+      return ec ? 0 : sz;
+    }
+
+    // flushes a file to the disk, or a directory to make a rename in it survive a power loss
+    static bool sync_file(const std::wstring& filename, bool is_directory = false)
+    {
+#ifdef WIN32
+      // directory entries are written through on windows
+      if (is_directory)
+        return true;
+      int fd = _wopen(filename.c_str(), _O_RDWR | _O_BINARY);
+      if (fd < 0)
+        return false;
+      bool r = _commit(fd) == 0;
+      _close(fd);
+#else
+      // a file name without a directory is in the current one
+      std::string path = filename.empty() && is_directory ? std::string(".") : boost::filesystem::path(filename).string();
+      int fd = ::open(path.c_str(), is_directory ? O_RDONLY : O_RDWR);
+      if (fd < 0)
+        return false;
+      bool r = ::fsync(fd) == 0;
+      ::close(fd);
+#endif
+      return r;
+    }
+
+  private:
+    static const uint64_t JOURNAL_FILE_MAGIC = 0x314c4e524a544c57; // "WLTJRNL1"
+
+#pragma pack(push, 1)
+    struct header
+    {
+      uint64_t magic;
+      uint64_t snapshot_id;
+    };
+
+    struct record_header
+    {
+      uint32_t size;
+      uint32_t checksum;
+    };
+#pragma pack(pop)
+
+    static void write_record(std::ostream& out, const std::string& record)
+    {
+      record_header rh = AUTO_VAL_INIT(rh);
+      rh.size = static_cast<uint32_t>(record.size());
+      rh.checksum = get_checksum(record.data(), record.size());
+      out.write(reinterpret_cast<const char*>(&rh), sizeof rh);
+      out.write(record.data(), record.size());
+    }
+
+    // a failed rewrite leaves the old journal, which is appended to further
+    bool reopen_for_append()
+    {
+      m_stream.clear();
+      m_stream.open(m_filename, std::ios::binary | std::ios::app | std::ios::out);
+      return false;
+    }
+
+    static uint32_t get_checksum(const char* data, size_t size)
+    {
+      crypto::hash h = crypto::cn_fast_hash(data, size);
+      uint32_t res = 0;
+      memcpy(&res, &h, sizeof res);
+      return res;
+    }
+
+    std::wstring m_filename;
+    boost::filesystem::ofstream m_stream;
+    uint64_t m_snapshot_id;
+    size_t m_records_count;
+  };
+
+} // namespace tools
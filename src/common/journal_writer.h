@@ -0,0 +1,264 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "include_base_utils.h"
+#include "misc_os_dependent.h"
+#include "common/boost_serialization_helper.h"
+#include "common/journal_file.h"
+
+namespace tools
+{
+  /* journal_file written from its own thread: callers only queue records, so they can do it under their locks.
+   * Records are serialized and appended in the order they were queued, the journal is synced at least once per
+   * sync_interval_ms while records come, and on rewrite and close.
+   */
+  template<class t_record>
+  class journal_writer
+  {
+  public:
+    explicit journal_writer(uint64_t sync_interval_ms) : m_sync_interval_ms(sync_interval_ms), m_open(false), m_stop(false), m_sync_requested(false),
+      m_queued_count(0), m_synced_count(0), m_records_count(0), m_complete(true)
+    {}
+
+    ~journal_writer()
+    {
+      close();
+    }
+
+    // opens the journal like journal_file::open and starts writing to it
+    bool open(const std::wstring& filename, std::vector<std::string>& records, bool* p_corrupted = nullptr, std::string* p_reason = nullptr)
+    {
+      close();
+      if (!m_journal.open(filename, records, p_corrupted, p_reason))
+        return false;
+
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_open = true;
+      m_stop = false;
+      m_sync_requested = false;
+      m_queued_count = m_synced_count = 0;
+      m_records_count = m_journal.records_count();
+      m_complete = true;
+      m_thread = boost::thread([this](){ worker(); });
+      return true;
+    }
+
+    void append(const t_record& rec)
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if (!m_open)
+          return;
+        m_queue.push_back(item());
+        m_queue.back().rec = rec;
+        ++m_queued_count;
+        ++m_records_count;
+      }
+      m_cv.notify_one();
+    }
+
+    // the journal is replaced with records, the ones queued before are not written then
+    void rewrite(std::list<t_record>& records)
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if (!m_open)
+          return;
+        m_queue.clear();
+        m_queue.push_back(item());
+        m_queue.back().is_rewrite = true;
+        m_queue.back().records.swap(records);
+        ++m_queued_count;
+        m_records_count = m_queue.back().records.size();
+      }
+      m_cv.notify_one();
+    }
+
+    // waits until everything queued so far is written and synced, returns false if some of it failed to be written
+    bool flush()
+    {
+      std::unique_lock<std::mutex> lk(m_lock);
+      if (!m_open)
+        return false;
+      uint64_t target = m_queued_count;
+      m_sync_requested = true;
+      m_cv.notify_one();
+      m_synced_cv.wait(lk, [&](){ return m_synced_count >= target || !m_open; });
+      return m_synced_count >= target && m_complete;
+    }
+
+    // writes and syncs the queued records, then closes the journal
+    void close()
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if (!m_open)
+          return;
+        m_open = false;
+        m_stop = true;
+      }
+      m_cv.notify_one();
+      m_synced_cv.notify_all();
+      m_thread.join();
+      m_journal.close();
+    }
+
+    bool is_open()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_open;
+    }
+
+    // records in the journal once the queued ones are written
+    size_t records_count()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_records_count;
+    }
+
+  private:
+    struct item
+    {
+      item() : is_rewrite(false), rec(boost::value_initialized<t_record>())
+      {}
+
+      bool is_rewrite;
+      t_record rec;                   // to append
+      std::list<t_record> records;    // to rewrite the journal with
+    };
+
+    void worker()
+    {
+      bool dirty = false;
+      bool complete = true;       // no record is missing since the last rewrite
+      uint64_t last_sync_time = epee::misc_utils::get_tick_count();
+      while (true)
+      {
+        std::deque<item> items;
+        uint64_t queued_count = 0;
+        bool stop = false, sync_requested = false;
+        {
+          std::unique_lock<std::mutex> lk(m_lock);
+          auto has_work = [this](){ return m_stop || m_sync_requested || m_queue.size(); };
+          if (dirty)
+            m_cv.wait_for(lk, std::chrono::milliseconds(m_sync_interval_ms), has_work);
+          else
+            m_cv.wait(lk, has_work);
+          items.swap(m_queue);
+          queued_count = m_queued_count;
+          stop = m_stop;
+          sync_requested = m_sync_requested;
+          m_sync_requested = false;
+        }
+
+        for (auto& it : items)
+        {
+          if (it.is_rewrite)
+          {
+            if (write_all(it.records))
+            {
+              dirty = false;
+              complete = true;
+              continue;
+            }
+            // the old journal is kept, the records still go to it, so that nothing is lost on replay
+            for (auto& rec : it.records)
+              append_record(rec, dirty, complete);
+          }
+          else
+            append_record(it.rec, dirty, complete);
+        }
+
+        uint64_t now = epee::misc_utils::get_tick_count();
+        if (dirty && (stop || sync_requested || now - last_sync_time >= m_sync_interval_ms))
+        {
+          if (!m_journal.sync())
+          {
+            LOG_ERROR("Failed to sync journal");
+            complete = false;
+          }
+          dirty = false;
+          last_sync_time = now;
+        }
+
+        {
+          std::lock_guard<std::mutex> lk(m_lock);
+          if (!dirty)
+            m_synced_count = queued_count;
+          m_complete = complete;
+        }
+        m_synced_cv.notify_all();
+        if (stop)
+          return;
+      }
+    }
+
+    void append_record(t_record& rec, bool& dirty, bool& complete)
+    {
+      if (write(rec))
+        dirty = true;
+      else
+        complete = false;
+    }
+
+    // returns true if the record was appended
+    bool write(t_record& rec)
+    {
+      std::string buff;
+      if (!tools::serialize_obj_to_buff(rec, buff) || !m_journal.append(buff))
+      {
+        LOG_ERROR("Failed to append journal record");
+        return false;
+      }
+      return true;
+    }
+
+    // returns true if the journal was rewritten, it's synced then
+    bool write_all(std::list<t_record>& records)
+    {
+      std::vector<std::string> buffs;
+      buffs.reserve(records.size());
+      for (auto& rec : records)
+      {
+        buffs.push_back(std::string());
+        if (!tools::serialize_obj_to_buff(rec, buffs.back()))
+        {
+          LOG_ERROR("Failed to serialize journal record, journal is not rewritten");
+          return false;
+        }
+      }
+      if (!m_journal.rewrite(m_journal.get_snapshot_id(), buffs))
+      {
+        LOG_ERROR("Failed to rewrite journal");
+        return false;
+      }
+      return true;
+    }
+
+    journal_file m_journal;                 // used by the writer thread only, while it runs
+    uint64_t m_sync_interval_ms;
+    boost::thread m_thread;
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    std::condition_variable m_synced_cv;
+    std::deque<item> m_queue;
+    bool m_open;
+    bool m_stop;
+    bool m_sync_requested;
+    uint64_t m_queued_count;                // items queued since open
+    uint64_t m_synced_count;                // items written and synced
+    size_t m_records_count;
+    bool m_complete;                        // false if some record failed to be written or synced since the last rewrite
+  };
+}
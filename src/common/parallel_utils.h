@@ -0,0 +1,248 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <boost/thread.hpp>
+
+#include "include_base_utils.h"
+
+namespace tools
+{
+  /* Calls cb(i) for every i in [0, count) using up to threads_count threads, the calling thread included.
+   * Indices are handed out one by one, so items of uneven cost are balanced between threads.
+   * After all threads are joined, the first exception thrown by cb (if any) is rethrown in the calling thread.
+   */
+  inline void parallel_for(size_t count, size_t threads_count, const std::function<void(size_t)>& cb)
+  {
+    if (threads_count > count)
+      threads_count = count;
+
+    if (threads_count <= 1)
+    {
+      for (size_t i = 0; i < count; ++i)
+        cb(i);
+      return;
+    }
+
+    std::atomic<size_t> next_index(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr first_exception;
+    std::mutex exception_lock;
+
+    auto worker = [&]()
+    {
+      for (size_t i = next_index++; i < count && !failed; i = next_index++)
+      {
+        try
+        {
+          cb(i);
+        }
+        catch (...)
+        {
+          std::lock_guard<std::mutex> lk(exception_lock);
+          if (!first_exception)
+            first_exception = std::current_exception();
+          failed = true;
+        }
+      }
+    };
+
+    std::vector<boost::thread> threads;
+    threads.reserve(threads_count - 1);
+    try
+    {
+      for (size_t t = 1; t < threads_count; ++t)
+        threads.push_back(boost::thread(worker));
+    }
+    catch (const std::exception& e)
+    {
+      // not fatal: the items are still processed by already started threads and by the calling thread
+      LOG_PRINT_RED_L0("parallel_for: failed to start worker thread #" << threads.size() + 1 << ": " << e.what());
+    }
+
+    worker();
+
+    for (auto& th : threads)
+      th.join();
+
+    if (first_exception)
+      std::rethrow_exception(first_exception);
+  }
+
+  /* Threads started once and fed from a bounded queue. A task that doesn't fit in the queue is run by the posting
+   * thread itself, so a busy pool slows its callers down instead of piling their work up.
+   */
+  class worker_pool
+  {
+  public:
+    explicit worker_pool(size_t max_queue_size) : m_max_queue_size(max_queue_size), m_stop(false)
+    {}
+
+    ~worker_pool()
+    {
+      stop();
+    }
+
+    void start(size_t threads_count)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_stop = false;
+      for (size_t i = m_threads.size(); i < threads_count; ++i)
+        m_threads.push_back(boost::thread([this](){ worker(); }));
+    }
+
+    // tasks queued already are run before the threads exit, the ones posted after that are run by the posting thread
+    void stop()
+    {
+      std::vector<boost::thread> threads;
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        m_stop = true;
+        threads.swap(m_threads);
+      }
+      m_cv.notify_all();
+      for (auto& th : threads)
+        th.join();
+    }
+
+    size_t get_threads_count()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_threads.size();
+    }
+
+    size_t get_queue_size()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_queue.size();
+    }
+
+    /* Same as parallel_for, but the calling thread is helped by up to threads_count - 1 pool threads instead of new ones.
+     * Helpers that don't fit in the queue are not posted, the items are handled by the others then.
+     */
+    void run(size_t count, size_t threads_count, const std::function<void(size_t)>& cb)
+    {
+      if (threads_count > count)
+        threads_count = count;
+
+      std::shared_ptr<batch> b = std::make_shared<batch>(count, cb);
+      for (size_t t = 1; t < threads_count; ++t)
+      {
+        {
+          std::lock_guard<std::mutex> lk(b->lock);
+          ++b->helpers_count;
+        }
+        if (!try_post([b](){ b->work(); b->leave(); }))
+        {
+          std::lock_guard<std::mutex> lk(b->lock);
+          --b->helpers_count;
+          break;
+        }
+      }
+
+      b->work();
+      {
+        std::unique_lock<std::mutex> lk(b->lock);
+        b->cv.wait(lk, [&](){ return b->helpers_count == 0; });
+      }
+
+      if (b->first_exception)
+        std::rethrow_exception(b->first_exception);
+    }
+
+  private:
+    struct batch
+    {
+      batch(size_t count_, const std::function<void(size_t)>& cb_) : count(count_), cb(cb_), next_index(0), failed(false), helpers_count(0)
+      {}
+
+      void work()
+      {
+        for (size_t i = next_index++; i < count && !failed; i = next_index++)
+        {
+          try
+          {
+            cb(i);
+          }
+          catch (...)
+          {
+            std::lock_guard<std::mutex> lk(lock);
+            if (!first_exception)
+              first_exception = std::current_exception();
+            failed = true;
+          }
+        }
+      }
+
+      void leave()
+      {
+        {
+          std::lock_guard<std::mutex> lk(lock);
+          --helpers_count;
+        }
+        cv.notify_all();
+      }
+
+      size_t count;
+      const std::function<void(size_t)>& cb;  //the caller waits for all helpers, so it outlives them
+      std::atomic<size_t> next_index;
+      std::atomic<bool> failed;
+      std::exception_ptr first_exception;
+      std::mutex lock;
+      std::condition_variable cv;
+      size_t helpers_count;
+    };
+
+    bool try_post(std::function<void()>&& task)
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        if (m_stop || m_threads.empty() || m_queue.size() >= m_max_queue_size)
+          return false;
+        m_queue.push_back(std::move(task));
+      }
+      m_cv.notify_one();
+      return true;
+    }
+
+    void worker()
+    {
+      while (true)
+      {
+        std::function<void()> task;
+        {
+          std::unique_lock<std::mutex> lk(m_lock);
+          m_cv.wait(lk, [this](){ return m_stop || m_queue.size(); });
+          if (m_queue.empty())
+            return;
+          task = std::move(m_queue.front());
+          m_queue.pop_front();
+        }
+        task();
+      }
+    }
+
+    size_t m_max_queue_size;
+    std::mutex m_lock;
+    std::condition_variable m_cv;
+    std::deque<std::function<void()> > m_queue;
+    std::vector<boost::thread> m_threads;
+    bool m_stop;
+  };
+
+  inline size_t get_default_worker_threads_count()
+  {
+    unsigned int n = boost::thread::hardware_concurrency();
+    return n != 0 ? n : 1;
+  }
+}
@@ -246,6 +246,8 @@ bool handle_get_daemon_info(po::variables_map& vm)
   << "difficulty: " << res.difficulty << ENDL
   << "tx_count: " << res.tx_count << ENDL
   << "tx_pool_size: " << res.tx_pool_size << ENDL
+  << "tx_pool_memory_usage: " << res.tx_pool_memory_usage << " of " << res.tx_pool_max_memory_usage << ENDL
+  << "tx_pool_evicted_count: " << res.tx_pool_evicted_count << " (last minute: " << res.tx_pool_evicted_last_minute << ")" << ENDL
   << "alt_blocks_count: " << res.alt_blocks_count << ENDL
   << "outgoing_connections_count: " << res.outgoing_connections_count << ENDL
   << "incoming_connections_count: " << res.incoming_connections_count << ENDL
@@ -255,6 +257,9 @@ bool handle_get_daemon_info(po::variables_map& vm)
   << "current_network_hashrate_350: " << res.current_network_hashrate_350 << ENDL
   << "scratchpad_size: " << res.scratchpad_size << ENDL
   << "alias_count: " << res.alias_count << ENDL
+  << "sync_ranges: " << res.sync_ranges_pending << " pending, " << res.sync_ranges_downloading << " downloading, " << res.sync_ranges_ready << " ready" << ENDL
+  << "sync_prevalidation: " << res.sync_prevalidation_queue_size << " queued, " << res.sync_prevalidation_busy_workers << " of " << res.sync_prevalidation_workers << " workers busy" << ENDL
+  << "sync_applier_busy: " << res.sync_applier_busy << ENDL
   << "transactions_cnt_per_day: " << res.transactions_cnt_per_day << ENDL
   << "transactions_volume_per_day: " << res.transactions_volume_per_day << ENDL;
   return true;
@@ -202,6 +202,29 @@ namespace crypto {
     return true;
   }
 
+  bool crypto_ops::precompute_public_key(const public_key &base, precomputed_public_key &precomp) {
+    static_assert(sizeof(ge_cached) == sizeof(precomputed_public_key), "precomputed_public_key size mismatch");
+    ge_p3 point;
+    if (ge_frombytes_vartime(&point, &base) != 0) {
+      return false;
+    }
+    ge_p3_to_cached(reinterpret_cast<ge_cached *>(&precomp), &point);
+    return true;
+  }
+
+  void crypto_ops::derive_public_key(const key_derivation &derivation, size_t output_index,
+    const precomputed_public_key &base, public_key &derived_key) {
+    ec_scalar scalar;
+    ge_p3 point1;
+    ge_p1p1 point2;
+    ge_p2 point3;
+    derivation_to_scalar(derivation, output_index, scalar);
+    ge_scalarmult_base(&point1, &scalar);
+    ge_add(&point2, &point1, reinterpret_cast<const ge_cached *>(&base));
+    ge_p1p1_to_p2(&point3, &point2);
+    ge_tobytes(&derived_key, &point3);
+  }
+
   void crypto_ops::derive_secret_key(const key_derivation &derivation, size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     ec_scalar scalar;
@@ -298,7 +321,6 @@ POP_WARNINGS
     const public_key *const *pubs, size_t pubs_count,
     const secret_key &sec, size_t sec_index,
     signature *sig) {
-    lock_guard<mutex> lock(random_lock);
     size_t i;
     ge_p3 image_unp;
     ge_dsmp image_pre;
@@ -325,21 +347,31 @@ POP_WARNINGS
       abort();
     }
     ge_dsm_precomp(image_pre, &image_unp);
+    {
+      // only the random numbers are drawn under the lock (in the same order as before), so signatures for
+      // different inputs can be generated in parallel
+      lock_guard<mutex> lock(random_lock);
+      for (i = 0; i < pubs_count; i++) {
+        if (i == sec_index) {
+          random_scalar(k);
+        } else {
+          random_scalar(sig[i].c);
+          random_scalar(sig[i].r);
+        }
+      }
+    }
     sc_0(&sum);
     buf->h = prefix_hash;
     for (i = 0; i < pubs_count; i++) {
       ge_p2 tmp2;
       ge_p3 tmp3;
       if (i == sec_index) {
-        random_scalar(k);
         ge_scalarmult_base(&tmp3, &k);
         ge_p3_tobytes(&buf->ab[i].a, &tmp3);
         hash_to_ec(*pubs[i], tmp3);
         ge_scalarmult(&tmp2, &k, &tmp3);
         ge_tobytes(&buf->ab[i].b, &tmp2);
       } else {
-        random_scalar(sig[i].c);
-        random_scalar(sig[i].r);
         if (ge_frombytes_vartime(&tmp3, &*pubs[i]) != 0) {
           abort();
         }
@@ -54,12 +54,20 @@ namespace crypto {
     ec_scalar c, r;
     friend class crypto_ops;
   };
+
+  /* Public key unpacked into the form used for point addition (ge_cached),
+   * so that repeated derivations against the same base skip decompression.
+   */
+  POD_CLASS precomputed_public_key {
+    char data[160];
+    friend class crypto_ops;
+  };
 #pragma pack(pop)
 
   static_assert(sizeof(ec_point) == 32 && sizeof(ec_scalar) == 32 &&
     sizeof(public_key) == 32 && sizeof(secret_key) == 32 &&
     sizeof(key_derivation) == 32 && sizeof(key_image) == 32 &&
-    sizeof(signature) == 64, "Invalid structure size");
+    sizeof(signature) == 64 && sizeof(precomputed_public_key) == 160, "Invalid structure size");
 
   class crypto_ops {
     crypto_ops();
@@ -81,6 +89,10 @@ namespace crypto {
     friend bool generate_key_derivation(const public_key &, const secret_key &, key_derivation &);
     static bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
     friend bool derive_public_key(const key_derivation &, std::size_t, const public_key &, public_key &);
+    static bool precompute_public_key(const public_key &, precomputed_public_key &);
+    friend bool precompute_public_key(const public_key &, precomputed_public_key &);
+    static void derive_public_key(const key_derivation &, std::size_t, const precomputed_public_key &, public_key &);
+    friend void derive_public_key(const key_derivation &, std::size_t, const precomputed_public_key &, public_key &);
     static void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     friend void derive_secret_key(const key_derivation &, std::size_t, const secret_key &, secret_key &);
     static void generate_signature(const hash &, const public_key &, const secret_key &, signature &);
@@ -161,6 +173,15 @@ namespace crypto {
     const public_key &base, public_key &derived_key) {
     return crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
   }
+  /* Fast path for deriving many keys from the same base (e.g. account spend key while scanning outputs).
+   */
+  inline bool precompute_public_key(const public_key &base, precomputed_public_key &precomp) {
+    return crypto_ops::precompute_public_key(base, precomp);
+  }
+  inline void derive_public_key(const key_derivation &derivation, std::size_t output_index,
+    const precomputed_public_key &base, public_key &derived_key) {
+    crypto_ops::derive_public_key(derivation, output_index, base, derived_key);
+  }
   inline void derive_secret_key(const key_derivation &derivation, std::size_t output_index,
     const secret_key &base, secret_key &derived_key) {
     crypto_ops::derive_secret_key(derivation, output_index, base, derived_key);
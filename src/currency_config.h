@@ -62,14 +62,30 @@
 
 
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          2000  //by default, blocks ids count in synchronizing
+#define BLOCKS_IDS_SYNCHRONIZING_BULK_COUNT             10000 //blocks ids count in synchronizing for peers with CURRENCY_PROTOCOL_FEATURE_BULK_BLOCK_IDS
+#define CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE            500   //block ids hashed together in the embedded block ids hashes list
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              200    //by default, blocks count in blocks downloading
 #define CURRENCY_PROTOCOL_MAX_BLOCKS_REQUEST_COUNT      500        
 #define CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT         500        
+#define CURRENCY_PROTOCOL_SYNC_RANGE_TIMEOUT_MS         60000  //peer that doesn't deliver a requested blocks range in time is dropped
+#define CURRENCY_PROTOCOL_SYNC_SLOW_PEER_RATIO          4      //peer this times slower than the fastest one doesn't hold back the next blocks to be applied
+#define CURRENCY_PROTOCOL_SYNC_MAX_BLOCKS_AHEAD         2000   //blocks beyond the next one to be applied aren't requested, so downloaded blocks waiting to be applied stay bounded
+#define CURRENCY_PROTOCOL_SYNC_APPLY_RETRY_MS           100    //downloaded blocks applier waits this long when another batch operation holds the blockchain
+#define CURRENCY_PROTOCOL_TX_ANNOUNCE_INTERVAL_MS       2000   //mean delay of batched tx hash announcements to a peer, randomized by +-50%
+#define CURRENCY_PROTOCOL_TX_REQUEST_TIMEOUT_MS         10000  //announced tx requested from a peer may be requested from another one after this
+#define CURRENCY_PROTOCOL_MAX_KNOWN_TXS_PER_PEER        20000  //tx hashes remembered as known by a peer, to not announce them back
+#define CURRENCY_PROTOCOL_BLOCK_TXS_REQUEST_TIMEOUT_MS  10000  //missing txs of a compact block are asked from the next peer that announced it after this
 
 
 #define CURRENCY_ALT_BLOCK_LIVETIME_COUNT               (720*7)//one week
 #define CURRENCY_MEMPOOL_TX_LIVETIME                    86400 //seconds, one day
 #define CURRENCY_MEMPOOL_TX_FROM_ALT_BLOCK_LIVETIME     (CURRENCY_ALT_BLOCK_LIVETIME_COUNT*DIFFICULTY_TARGET) //seconds, one week
+#define CURRENCY_MEMPOOL_MAX_CONCURRENT_ADMISSIONS      16     //txs being verified at once, the others wait for a slot
+#define CURRENCY_MEMPOOL_ADMISSION_WAIT_MS              5000   //relayed tx is dropped (not failed) if it didn't get a slot in time
+#define CURRENCY_MEMPOOL_DEFAULT_MAX_SIZE_MB            256    //memory budget of the pool, lowest fee rate txs are evicted above it
+#define CURRENCY_MEMPOOL_REVALIDATION_BATCH_SIZE        200    //txs loaded from the pool journal re-added per idle call
+#define CURRENCY_MEMPOOL_JOURNAL_COMPACTION_MIN_RECORDS 10000  //pool journal is rewritten when it has more records than this and twice the pool size
+#define CURRENCY_MEMPOOL_JOURNAL_SYNC_INTERVAL_MS       1000   //pool journal is fsynced at least this often while pool changes
 
 #ifndef TESTNET
 #define P2P_DEFAULT_PORT                                10101
@@ -80,6 +96,7 @@
 #endif
 
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT           1000
+#define COMMAND_RPC_GET_BLOCKS_IDS_FAST_MAX_COUNT       20000
 
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
@@ -133,6 +150,7 @@
 #endif
 
 #define CURRENCY_POOLDATA_FILENAME                      "poolstate.bin"
+#define CURRENCY_POOLDATA_JOURNAL_FILENAME              "poolstate.journal"
 //#define CURRENCY_BLOCKCHAINDATA_FILENAME                "blockchain.bin"
 //#define CURRENCY_BLOCKCHAINDATA_TEMP_FILENAME           "blockchain.bin.tmp"
 #define CURRENCY_BLOCKCHAINDATA_FOLDERNAME_OLD          "blockchain"
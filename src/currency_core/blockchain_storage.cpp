@@ -48,6 +48,7 @@ using namespace currency;
 #define BLOCKCHAIN_OPTIONS_ID_CURRENT_PRUNED_RS_HEIGHT              1
 #define BLOCKCHAIN_OPTIONS_ID_LAST_WORKED_VERSION                   2
 #define BLOCKCHAIN_OPTIONS_ID_STORAGE_MAJOR_COMPABILITY_VERSION     3 //mismatch here means full resync
+#define BLOCKCHAIN_OPTIONS_ID_FAST_SYNC_UNVERIFIED_HEIGHT           4
 
 #define BLOCKCHAIN_STORAGE_MAJOR_COMPABILITY_VERSION                1
 
@@ -57,6 +58,7 @@ DISABLE_VS_WARNINGS(4267)
   namespace
   {
     const command_line::arg_descriptor<std::string>   arg_macos_debuger_dummy_option =     {"-NSDocumentRevisionsDebugMode", "XCode weird paramter", "", true};
+    const command_line::arg_descriptor<bool>          arg_no_fast_sync =                   {"no-fast-sync", "Check proof of work of blocks below the top checkpoint too", false, true};
   }
   
 
@@ -77,8 +79,10 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) :m_db(std::share
                                                                  m_db_current_pruned_rs_height(BLOCKCHAIN_OPTIONS_ID_CURRENT_PRUNED_RS_HEIGHT, m_db_solo_options),
                                                                  m_db_last_worked_version(BLOCKCHAIN_OPTIONS_ID_LAST_WORKED_VERSION, m_db_solo_options),
                                                                  m_db_storage_major_compability_version(BLOCKCHAIN_OPTIONS_ID_STORAGE_MAJOR_COMPABILITY_VERSION, m_db_solo_options),                                                               
+                                                                 m_db_fast_sync_unverified_height(BLOCKCHAIN_OPTIONS_ID_FAST_SYNC_UNVERIFIED_HEIGHT, m_db_solo_options),
                                                                  m_tx_pool(tx_pool),
                                                                  m_is_in_checkpoint_zone(false), 
+                                                                 m_fast_sync(true),
                                                                  m_donations_account(AUTO_VAL_INIT(m_donations_account)), 
                                                                  m_royalty_account(AUTO_VAL_INIT(m_royalty_account)),
                                                                  m_locker_file(0), 
@@ -93,6 +97,7 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) :m_db(std::share
 void blockchain_storage::init_options(boost::program_options::options_description& desc)
 {
   command_line::add_arg(desc, arg_macos_debuger_dummy_option); 
+  command_line::add_arg(desc, arg_no_fast_sync);
   //db::lmdb_adapter::init_options(desc);
 }
 //------------------------------------------------------
@@ -104,6 +109,7 @@ bool blockchain_storage::init(const boost::program_options::variables_map& vm, c
   //CHECK_AND_ASSERT_MES(res, false, "Unable to init lmdb adapter");
 
   m_config_folder = config_folder;
+  m_fast_sync = !command_line::has_arg(vm, arg_no_fast_sync);
 
   // remove old incompatible DB
   const std::string old_db_folder_path = m_config_folder + "/" CURRENCY_BLOCKCHAINDATA_FOLDERNAME_OLD;
@@ -190,15 +196,23 @@ bool blockchain_storage::start_batch_exclusive_operation()
   CRITICAL_REGION_END();
 
   CRITICAL_SECTION_LOCK(m_blockchain_lock);
-  //m_db.begin_batch_exclusive_operation();
+  //every block is added in a nested transaction, the batch is written to the db once
+  m_db.begin_transaction();
   LOG_PRINT_MAGENTA("[START_BATCH_EXCLUSIVE_OPERATION]", LOG_LEVEL_0);
   return true;
 }
 //------------------------------------------------------
 bool blockchain_storage::finish_batch_exclusive_operation(bool success)
 {
-
-  //m_db.finish_batch_exclusive_operation(success);
+  //blocks that failed were purged by themselves already, the ones added before them are kept whatever success is
+  try
+  {
+    m_db.commit_transaction();
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_ERROR("EXCEPTION WHILE COMMITTING BATCH EXCLUSIVE OPERATION: " << ex.what());
+  }
   CRITICAL_SECTION_UNLOCK(m_blockchain_lock);
 
   CRITICAL_REGION_BEGIN(m_exclusive_batch_lock);
@@ -692,7 +706,8 @@ bool blockchain_storage::get_short_chain_history(std::list<crypto::hash>& ids)
   return true;
 }
 //------------------------------------------------------
-bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count)
+bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count,
+  std::list<std::vector<std::vector<uint64_t> > >* p_global_outs_indexes /* = nullptr */)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   PROF_L2_START(find_blockchain_supplement_time);
@@ -708,9 +723,29 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
   {
     blocks.resize(blocks.size() + 1);
     blocks.back().first = m_db_blocks[i]->bl;
-    std::list<crypto::hash> mis;
-    get_transactions(m_db_blocks[i]->bl.tx_hashes, blocks.back().second, mis);
-    CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
+    const block& bl = blocks.back().first;
+    if (!p_global_outs_indexes)
+    {
+      std::list<crypto::hash> mis;
+      get_transactions(bl.tx_hashes, blocks.back().second, mis);
+      CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
+    }
+    else
+    {
+      // take transactions and their global outputs indexes from the same chain entry
+      p_global_outs_indexes->resize(p_global_outs_indexes->size() + 1);
+      std::vector<std::vector<uint64_t> >& block_indexes = p_global_outs_indexes->back();
+      block_indexes.resize(bl.tx_hashes.size() + 1);
+      CHECK_AND_ASSERT_MES(get_tx_outputs_gindexs(get_transaction_hash(bl.miner_tx), block_indexes[0]), false, "internal error, miner transaction from block " << i << " not found");
+      size_t j = 1;
+      for (const auto& tx_id : bl.tx_hashes)
+      {
+        auto tx_ptr = m_db_transactions.find(tx_id);
+        CHECK_AND_ASSERT_MES(tx_ptr, false, "internal error, transaction " << tx_id << " from block not found");
+        blocks.back().second.push_back(tx_ptr->tx);
+        block_indexes[j++] = tx_ptr->m_global_output_indexes;
+      }
+    }
     txs_count += blocks.back().second.size();
   }
   PROF_L2_FINISH(get_transactions_time);
@@ -718,6 +753,31 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::find_blockchain_ids_supplement(const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& ids, std::list<uint64_t>& timestamps, uint64_t& total_height, uint64_t& start_height, size_t max_count)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (!find_blockchain_supplement(qblock_ids, start_height))
+    return false;
+
+  total_height = get_current_blockchain_height();
+  size_t end_height = static_cast<size_t>(std::min<uint64_t>(total_height, start_height + max_count));
+  if (end_height <= start_height)
+    return true;
+  // every block keeps the id of the one before it, so only the top one (if it's in the range) is hashed
+  for (size_t i = start_height; i != end_height; i++)
+  {
+    auto bei_ptr = m_db_blocks[i];
+    if (i != start_height)
+      ids.push_back(bei_ptr->bl.prev_id);
+    timestamps.push_back(bei_ptr->bl.timestamp);
+  }
+  if (end_height < total_height)
+    ids.push_back(m_db_blocks[end_height]->bl.prev_id);
+  else
+    ids.push_back(get_block_hash(m_db_blocks[end_height - 1]->bl));
+  return true;
+}
+//------------------------------------------------------------------
 bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -765,7 +825,7 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
   return true;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp)
+bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp, size_t max_count)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   if (!find_blockchain_supplement(qblock_ids, resp.start_height))
@@ -773,7 +833,7 @@ bool blockchain_storage::find_blockchain_supplement(const std::list<crypto::hash
 
   resp.total_height = get_current_blockchain_height();
   size_t count = 0;
-  for (size_t i = resp.start_height; i != m_db_blocks.size() && count < BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT; i++, count++)
+  for (size_t i = resp.start_height; i != m_db_blocks.size() && count < max_count; i++, count++)
     resp.m_block_ids.push_back(get_block_hash(m_db_blocks[i]->bl));
   return true;
 }
@@ -942,7 +1002,7 @@ uint64_t blockchain_storage::get_scratchpad_size()
   return m_scratchpad_wr.get_scratchpad().size() * 32;
 }
 //------------------------------------------------------
-bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height)
+bool blockchain_storage::get_tx_input_keys(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
@@ -972,8 +1032,7 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     }
   };
 
-  //check ring signature
-  std::vector<crypto::public_key> output_keys;
+  output_keys.clear();
   outputs_visitor vi(output_keys, *this);
   if (!scan_outputkeys_for_indexes(txin, vi, pmax_related_block_height))
   {
@@ -986,9 +1045,11 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     LOG_PRINT_L0("Output keys for tx with amount = " << txin.amount << " and count indexes " << txin.key_offsets.size() << " returned wrong keys count " << output_keys.size());
     return false;
   }
-  if (m_is_in_checkpoint_zone)
-    return true;
-
+  return true;
+}
+//------------------------------------------------------
+bool blockchain_storage::check_tx_input_signature(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::public_key>& output_keys, const std::vector<crypto::signature>& sig)
+{
   bool r = crypto::validate_key_image(txin.k_image);
   CHECK_AND_ASSERT_MES(r, false, "key image for tx" << tx_prefix_hash << " is invalid: " << txin.k_image);
 
@@ -996,6 +1057,18 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
   return crypto::check_ring_signature(tx_prefix_hash, txin.k_image, output_keys, sig.data());
 }
 //------------------------------------------------------
+bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //check ring signature
+  std::vector<crypto::public_key> output_keys;
+  if (!get_tx_input_keys(txin, output_keys, pmax_related_block_height))
+    return false;
+  if (m_is_in_checkpoint_zone)
+    return true;
+  return check_tx_input_signature(txin, tx_prefix_hash, output_keys, sig);
+}
+//------------------------------------------------------
 bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height)
 {
   PROFILE_FUNC("blockchain_storage::check_tx_inputs(tx, prefix_id, max_h)");
@@ -1044,11 +1117,49 @@ bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::ha
 bool blockchain_storage::check_tx_inputs(const transaction& tx, uint64_t& max_used_block_height, crypto::hash& max_used_block_id)
 {
   PROFILE_FUNC("blockchain_storage::check_tx_inputs(tx, max_h, max_id)");
-  CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  bool res = check_tx_inputs(tx, &max_used_block_height);
-  if (!res) return false;
-  CHECK_AND_ASSERT_MES(max_used_block_height < m_db_blocks.size(), false, "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db_blocks.size());
-  get_block_hash(m_db_blocks[max_used_block_height]->bl, max_used_block_id);
+  // ring members are resolved under the lock, then signatures are checked against this snapshot without it,
+  // so txs from different peers are verified concurrently and block handling is not held by them
+  crypto::hash tx_prefix_hash = get_transaction_prefix_hash(tx);
+  std::vector<std::vector<crypto::public_key> > inputs_keys;
+  bool in_checkpoint_zone = false;
+  {
+    CRITICAL_REGION_LOCAL(m_blockchain_lock);
+    in_checkpoint_zone = m_is_in_checkpoint_zone;
+    max_used_block_height = 0;
+    inputs_keys.reserve(tx.vin.size());
+    BOOST_FOREACH(const auto& txin, tx.vin)
+    {
+      CHECK_AND_ASSERT_MES(txin.type() == typeid(txin_to_key), false, "wrong type id in tx input at blockchain_storage::check_tx_inputs");
+      const txin_to_key& in_to_key = boost::get<txin_to_key>(txin);
+      CHECK_AND_ASSERT_MES(in_to_key.key_offsets.size(), false, "empty in_to_key.key_offsets in transaction with id " << get_transaction_hash(tx));
+      if (have_tx_keyimg_as_spent(in_to_key.k_image))
+      {
+        LOG_PRINT_L0("Key image already spent in blockchain: " << string_tools::pod_to_hex(in_to_key.k_image));
+        return false;
+      }
+      inputs_keys.push_back(std::vector<crypto::public_key>());
+      if (!get_tx_input_keys(in_to_key, inputs_keys.back(), &max_used_block_height))
+      {
+        LOG_PRINT_L0("Failed to check input #" << inputs_keys.size() - 1 << " for tx " << get_transaction_hash(tx));
+        return false;
+      }
+    }
+    CHECK_AND_ASSERT_MES(max_used_block_height < m_db_blocks.size(), false, "internal error: max used block index=" << max_used_block_height << " is not less then blockchain size = " << m_db_blocks.size());
+    get_block_hash(m_db_blocks[max_used_block_height]->bl, max_used_block_id);
+  }
+  if (in_checkpoint_zone)
+    return true;
+
+  CHECK_AND_ASSERT_MES(tx.signatures.size() == tx.vin.size(), false, "tx signatures count differs from inputs");
+  for (size_t i = 0; i != tx.vin.size(); ++i)
+  {
+    const txin_to_key& in_to_key = boost::get<txin_to_key>(tx.vin[i]);
+    if (!check_tx_input_signature(in_to_key, tx_prefix_hash, inputs_keys[i], tx.signatures[i]))
+    {
+      LOG_PRINT_L0("Failed to check input #" << i << " for tx " << get_transaction_hash(tx));
+      return false;
+    }
+  }
   return true;
 }
 //------------------------------------------------------------------
@@ -1383,6 +1494,10 @@ bool blockchain_storage::check_tx_with_view_key(const crypto::hash& tx_hash, con
   r = crypto::generate_key_derivation(tx_pub_key, view_key, derivation);
   CHECK_AND_ASSERT_MES(r, false, "generate_key_derivation failed, tx " << tx_hash);
 
+  crypto::precomputed_public_key spend_public_key = AUTO_VAL_INIT(spend_public_key);
+  r = crypto::precompute_public_key(addr.m_spend_public_key, spend_public_key);
+  CHECK_AND_ASSERT_MES(r, false, "precompute_public_key failed, addr.m_spend_public_key: " << addr.m_spend_public_key);
+
   incoming_amount = 0;
   outs_indicies.clear();
 
@@ -1394,8 +1509,7 @@ bool blockchain_storage::check_tx_with_view_key(const crypto::hash& tx_hash, con
       const crypto::public_key& pk = boost::get<txout_to_key>(out.target).key;
 
       crypto::public_key derived_pk = AUTO_VAL_INIT(derived_pk);
-      r = crypto::derive_public_key(derivation, output_index, addr.m_spend_public_key, derived_pk);
-      CHECK_AND_ASSERT_MES(r, false, "derive_public_key failed, tx: " << tx_hash << ", output: " << output_index << ", addr.m_spend_public_key: " << addr.m_spend_public_key);
+      crypto::derive_public_key(derivation, output_index, spend_public_key, derived_pk);
 
       if (pk == derived_pk)
       {
@@ -1783,6 +1897,72 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
   return true;
 }
 //------------------------------------------------------
+bool blockchain_storage::is_pow_check_needed(uint64_t height)
+{
+  //genesis has no PoW, the top checkpoint block itself is checked by id only as well
+  return !m_fast_sync || !height || !m_checkpoints.is_in_checkpoint_zone(height);
+}
+//------------------------------------------------------
+uint64_t blockchain_storage::get_fast_sync_unverified_height()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_db_fast_sync_unverified_height;
+}
+//------------------------------------------------------
+bool blockchain_storage::check_block_ids_group(uint64_t height, const crypto::hash& id, bool& is_group_end)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  is_group_end = (height + 1) % CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE == 0 && height < m_checkpoints.get_block_ids_hashes_height();
+  if (!is_group_end)
+    return true;
+  CHECK_AND_ASSERT_MES(height == m_db_blocks.size(), false, "Block ids group is checked at wrong height " << height);
+
+  uint64_t group_start = height + 1 - CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE;
+  std::vector<crypto::hash> ids;
+  ids.reserve(CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE);
+  for (uint64_t h = group_start; h != height; h++)
+    ids.push_back(get_block_hash(m_db_blocks[h]->bl));
+  ids.push_back(id);
+  size_t checked_count = 0;
+  return m_checkpoints.check_block_ids(group_start, ids, checked_count) && checked_count == ids.size();
+}
+//------------------------------------------------------
+bool blockchain_storage::get_block_ids_hashes(uint64_t height, std::string& blob)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(height <= m_db_blocks.size(), false, "Block ids hashes height " << height << " is above blockchain height " << m_db_blocks.size());
+  blob.clear();
+  std::vector<crypto::hash> ids;
+  for (uint64_t h = 0; h + CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE <= height; h += CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE)
+  {
+    ids.clear();
+    for (uint64_t i = h; i != h + CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE; i++)
+      ids.push_back(get_block_hash(m_db_blocks[i]->bl));
+    crypto::hash group_hash = checkpoints::get_block_ids_group_hash(ids.data());
+    blob.append(reinterpret_cast<const char*>(&group_hash), sizeof(group_hash));
+  }
+  return true;
+}
+//------------------------------------------------------
+bool blockchain_storage::rollback_unverified_blocks()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  uint64_t unverified_height = m_db_fast_sync_unverified_height;
+  if (!unverified_height)
+    return true;
+  size_t popped = 0;
+  while (m_db_blocks.size() > unverified_height)
+  {
+    bool r = pop_block_from_blockchain();
+    CHECK_AND_ASSERT_MES(r, false, "Failed to pop block while rolling back unverified blocks");
+    ++popped;
+  }
+  m_db_fast_sync_unverified_height = 0;
+  if (popped)
+    LOG_PRINT_YELLOW(popped << " blocks added without PoW check were rolled back, blockchain height is " << m_db_blocks.size(), LOG_LEVEL_0);
+  return true;
+}
+//------------------------------------------------------
 bool blockchain_storage::pop_block_from_blockchain()
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -1904,6 +2084,40 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, block_verif
   return handle_block_to_main_chain(bl, id, bvc);
 }
 //------------------------------------------------------
+bool blockchain_storage::check_new_block_header(const block& bl, const crypto::hash& id)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (bl.prev_id != get_top_block_id())
+  {
+    LOG_PRINT_L2("Block " << id << " doesn't go on top, its header is not checked");
+    return false;
+  }
+
+  if (!check_block_timestamp_main(bl))
+  {
+    LOG_PRINT_L0("Block with id: " << id << ENDL << "have invalid timestamp: " << bl.timestamp);
+    return false;
+  }
+
+  if (!is_pow_check_needed(m_db_blocks.size()))
+    return true;
+
+  wide_difficulty_type current_diffic = get_difficulty_for_next_block();
+  CHECK_AND_ASSERT_MES(current_diffic, false, "!!!!!!!!! difficulty overhead !!!!!!!!!");
+  crypto::hash proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+  {
+    return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
+  });
+  if (!check_hash(proof_of_work, current_diffic))
+  {
+    LOG_PRINT_L0("Block with id: " << id << ENDL
+      << "have not enough proof of work: " << proof_of_work << ENDL
+      << "nexpected difficulty: " << current_diffic);
+    return false;
+  }
+  return true;
+}
+//------------------------------------------------------
 bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypto::hash& id, block_verification_context& bvc)
 {
   PROF_L1_START(block_processing_time);
@@ -1936,28 +2150,46 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   PROF_L1_START(longhash_calculating_time);
   crypto::hash proof_of_work = null_hash;
 
-  proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+  bool check_pow = is_pow_check_needed(m_db_blocks.size());
+  if (check_pow)
   {
-    return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
-  });
+    proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+    {
+      return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
+    });
 
-  if (!check_hash(proof_of_work, current_diffic))
-  {
-    LOG_PRINT_L0("Block with id: " << id << ENDL
-      << "have not enough proof of work: " << proof_of_work << ENDL
-      << "nexpected difficulty: " << current_diffic);
-    bvc.m_verifivation_failed = true;
-    return false;
+    if (!check_hash(proof_of_work, current_diffic))
+    {
+      LOG_PRINT_L0("Block with id: " << id << ENDL
+        << "have not enough proof of work: " << proof_of_work << ENDL
+        << "nexpected difficulty: " << current_diffic);
+      bvc.m_verifivation_failed = true;
+      return false;
+    }
   }
   if (m_checkpoints.is_in_checkpoint_zone(get_current_blockchain_height()))
   {
     m_is_in_checkpoint_zone = true;
-    if (!m_checkpoints.check_block(get_current_blockchain_height(), id))
+    bool is_a_checkpoint = false, is_group_end = false;
+    if (!m_checkpoints.check_block(get_current_blockchain_height(), id, is_a_checkpoint) || !check_block_ids_group(get_current_blockchain_height(), id, is_group_end))
     {
       LOG_ERROR("CHECKPOINT VALIDATION FAILED");
+      //the blocks added without PoW check since the previous checkpoint led to a wrong one
+      rollback_unverified_blocks();
       bvc.m_verifivation_failed = true;
       return false;
     }
+    //the last block of a group confirms the whole group the way a checkpoint does
+    is_a_checkpoint = is_a_checkpoint || is_group_end;
+    if (is_a_checkpoint && m_db_fast_sync_unverified_height)
+    {
+      LOG_PRINT_L1("Blocks from height " << static_cast<uint64_t>(m_db_fast_sync_unverified_height) << " added without PoW check are confirmed by checkpoint at height " << get_current_blockchain_height());
+      m_db_fast_sync_unverified_height = 0;
+    }
+    else if (!check_pow && !is_a_checkpoint && !m_db_fast_sync_unverified_height)
+    {
+      m_db_fast_sync_unverified_height = get_current_blockchain_height();
+    }
   }
   else
     m_is_in_checkpoint_zone = false;
@@ -2304,7 +2536,13 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
     CHECK_AND_ASSERT_MES(i_res.second, false, "insertion of new alternative block returned as it already exist");
     alt_chain.push_back(i_res.first);
     //check if difficulty bigger then in main chain
-    if (m_db_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty)
+    if (m_db_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty && m_db_fast_sync_unverified_height)
+    {
+      //the difficulty of blocks added without PoW check is not proven, only a checkpoint or a block ids group settles them
+      LOG_PRINT_L0("Alternative chain on height " << alt_chain.front()->second.height << " has more cum_difficulty than the main one with blocks added without PoW check from height "
+        << static_cast<uint64_t>(m_db_fast_sync_unverified_height) << ", kept as alternative");
+    }
+    else if (m_db_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty)
     {
       //do reorganize!
       LOG_PRINT_GREEN("###### REORGANIZE on height: " << alt_chain.front()->second.height << " of " << m_db_blocks.size() - 1 << " with cum_difficulty " << m_db_blocks.back()->cumulative_difficulty
@@ -58,6 +58,7 @@ namespace currency
     bool init(const boost::program_options::variables_map& vm, const std::string& config_folder);
     bool deinit();
 
+    //blocks added within a batch are written to the db in one transaction
     bool start_batch_exclusive_operation();
     bool finish_batch_exclusive_operation(bool success);
 
@@ -80,6 +81,8 @@ namespace currency
 
     bool set_checkpoints(checkpoints&& chk_pts);
     checkpoints& get_checkpoints() { return m_checkpoints; }
+    //first block added without PoW check and not confirmed by a checkpoint yet, 0 if none
+    uint64_t get_fast_sync_unverified_height();
 
     //bool push_new_block();
     bool get_blocks(uint64_t start_offset, size_t count, std::list<block>& blocks, std::list<transaction>& txs);
@@ -87,6 +90,8 @@ namespace currency
     bool get_alternative_blocks(std::list<block>& blocks);
     size_t get_alternative_blocks_count();
     crypto::hash get_block_id_by_height(uint64_t height);
+    //group hashes of the blocks below height, the way checkpoints::add_block_ids_hashes takes them
+    bool get_block_ids_hashes(uint64_t height, std::string& blob);
     bool get_block_by_hash(const crypto::hash &h, block &blk);
     bool get_block_by_height(uint64_t h, block &blk);
     bool get_block_swap_transactions(uint64_t height, const crypto::secret_key& sk, std::string& block_id, std::string& prev_block_id, uint64_t& timestamp, std::list<swap_transaction_info>& swap_txs_list);
@@ -109,15 +114,19 @@ namespace currency
     bool get_top_block(block& b);
     wide_difficulty_type get_difficulty_for_next_block();
     bool add_new_block(const block& bl_, block_verification_context& bvc);
+    //checks timestamp and PoW of a block that goes on top of the chain, without adding it
+    bool check_new_block_header(const block& bl, const crypto::hash& id);
     bool reset_and_set_genesis_block(const block& b);
     bool create_block_template(block& b, const account_public_address& miner_address, wide_difficulty_type& di, uint64_t& height, const blobdata& ex_nonce, bool vote_for_donation, const alias_info& ai);
     bool have_block(const crypto::hash& id);
     size_t get_total_transactions();
     bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
     bool get_short_chain_history(std::list<crypto::hash>& ids);
-    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp);
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp, size_t max_count = BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT);
     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, uint64_t& starter_offset);
-    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    bool find_blockchain_ids_supplement(const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& ids, std::list<uint64_t>& timestamps, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count,
+      std::list<std::vector<std::vector<uint64_t> > >* p_global_outs_indexes = nullptr);
     bool handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NOTIFY_RESPONSE_GET_OBJECTS::request& rsp);
     bool handle_get_objects(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
     bool get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
@@ -130,6 +139,8 @@ namespace currency
     uint64_t get_scratchpad_size();
     //bool store_blockchain();
     bool check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL);
+    bool get_tx_input_keys(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height = NULL);
+    static bool check_tx_input_signature(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::public_key>& output_keys, const std::vector<crypto::signature>& sig);
     bool check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL);
     bool check_tx_inputs(const transaction& tx, uint64_t* pmax_used_block_height = NULL);
     bool check_tx_inputs(const transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id);
@@ -246,6 +257,7 @@ namespace currency
     tools::db::solo_db_value<uint64_t, uint64_t, solo_options_container> m_db_current_pruned_rs_height;
     tools::db::solo_db_value<uint64_t, std::string, solo_options_container, true> m_db_last_worked_version;
     tools::db::solo_db_value<uint64_t, uint64_t, solo_options_container> m_db_storage_major_compability_version;
+    tools::db::solo_db_value<uint64_t, uint64_t, solo_options_container> m_db_fast_sync_unverified_height; //first block added without PoW check and not confirmed by a checkpoint yet, 0 if none
     outputs_container m_db_outputs;
     aliases_container m_db_aliases;
     address_to_aliases_container m_db_addr_to_alias;
@@ -261,6 +273,7 @@ namespace currency
     blocks_ext_by_hash m_alternative_chains; // crypto::hash -> block_extended_info
 
     std::atomic<bool> m_is_in_checkpoint_zone;
+    bool m_fast_sync;
 
     std::string m_config_folder;
     account_keys m_donations_account;
@@ -321,6 +334,10 @@ namespace currency
     //void fill_addr_to_alias_dict();
     //bool resync_spent_tx_flags();
     bool prune_ring_signatures_if_need();
+    //fast sync: blocks below the top checkpoint are added without PoW check, the chain of their ids is confirmed by the next checkpoint or the end of their block ids group
+    bool is_pow_check_needed(uint64_t height);
+    bool rollback_unverified_blocks();
+    bool check_block_ids_group(uint64_t height, const crypto::hash& id, bool& is_group_end);
     bool prune_ring_signatures(uint64_t height, uint64_t& transactions_pruned, uint64_t& signatures_pruned);
     bool check_instance(const std::string& data_dir);
   };
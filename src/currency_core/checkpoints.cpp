@@ -26,7 +26,7 @@ namespace currency
   //---------------------------------------------------------------------------
   bool checkpoints::is_in_checkpoint_zone(uint64_t height) const
   {
-    return !m_points.empty() && (height <= (--m_points.end())->first);
+    return (!m_points.empty() || !m_block_ids_hashes.empty()) && height <= get_top_checkpoint_height();
   }
   //---------------------------------------------------------------------------
   bool checkpoints::is_height_passed_zone(uint64_t height, uint64_t blockchain_last_block_height) const
@@ -34,6 +34,10 @@ namespace currency
     if(height > blockchain_last_block_height)
       return false;
 
+    //the whole group of the height is fixed by its hash
+    if (height < get_block_ids_hashes_height() && height - height % CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE + CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE - 1 <= blockchain_last_block_height)
+      return true;
+
     auto it = m_points.lower_bound(height);
     if(it == m_points.end())
       return false;
@@ -45,15 +49,23 @@ namespace currency
   //---------------------------------------------------------------------------
   uint64_t checkpoints::get_top_checkpoint_height() const 
   {
-    if (!m_points.size())
-      return 0;
-    return (--m_points.end())->first;
+    uint64_t top = m_points.size() ? (--m_points.end())->first : 0;
+    if (m_block_ids_hashes.size())
+      top = std::max(top, get_block_ids_hashes_height() - 1);
+    return top;
   }
   //---------------------------------------------------------------------------
   bool checkpoints::check_block(uint64_t height, const crypto::hash& h) const
+  {
+    bool is_a_checkpoint = false;
+    return check_block(height, h, is_a_checkpoint);
+  }
+  //---------------------------------------------------------------------------
+  bool checkpoints::check_block(uint64_t height, const crypto::hash& h, bool& is_a_checkpoint) const
   {
     auto it = m_points.find(height);
-    if(it == m_points.end())
+    is_a_checkpoint = it != m_points.end();
+    if(!is_a_checkpoint)
       return true;
 
     if(it->second == h)
@@ -66,4 +78,42 @@ namespace currency
       return false;
     }
   }
+  //---------------------------------------------------------------------------
+  bool checkpoints::add_block_ids_hashes(const std::string& blob)
+  {
+    CHECK_AND_ASSERT_MES(blob.size() % sizeof(crypto::hash) == 0, false, "WRONG BLOCK IDS HASHES SIZE: " << blob.size());
+    m_block_ids_hashes.resize(blob.size() / sizeof(crypto::hash));
+    if (blob.size())
+      memcpy(m_block_ids_hashes.data(), blob.data(), blob.size());
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  uint64_t checkpoints::get_block_ids_hashes_height() const
+  {
+    return m_block_ids_hashes.size() * CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE;
+  }
+  //---------------------------------------------------------------------------
+  bool checkpoints::check_block_ids(uint64_t start_height, const std::vector<crypto::hash>& ids, size_t& checked_count) const
+  {
+    checked_count = 0;
+    uint64_t group_size = CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE;
+    uint64_t group_start = (start_height + group_size - 1) / group_size * group_size;
+    for (; group_start + group_size <= start_height + ids.size() && group_start < get_block_ids_hashes_height(); group_start += group_size)
+    {
+      const crypto::hash& expected = m_block_ids_hashes[group_start / group_size];
+      crypto::hash h = get_block_ids_group_hash(&ids[group_start - start_height]);
+      if (h != expected)
+      {
+        LOG_ERROR("BLOCK IDS HASH FAILED FOR HEIGHTS " << group_start << "-" << group_start + group_size - 1 << ". EXPECTED HASH: " << expected << ", FETCHED HASH: " << h);
+        return false;
+      }
+      checked_count = static_cast<size_t>(group_start + group_size - start_height);
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  crypto::hash checkpoints::get_block_ids_group_hash(const crypto::hash* ids)
+  {
+    return crypto::cn_fast_hash(ids, CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE * sizeof(crypto::hash));
+  }
 }
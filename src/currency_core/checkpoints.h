@@ -4,6 +4,7 @@
 
 #pragma once
 #include <map>
+#include <vector>
 #include "currency_basic_impl.h"
 
 
@@ -17,8 +18,19 @@ namespace currency
     bool is_in_checkpoint_zone(uint64_t height) const;
     bool is_height_passed_zone(uint64_t height, uint64_t blockchain_last_block_height) const;
     bool check_block(uint64_t height, const crypto::hash& h) const;
+    bool check_block(uint64_t height, const crypto::hash& h, bool& is_a_checkpoint) const;
     uint64_t get_top_checkpoint_height() const;
+
+    // blob is the hashes of every CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE block ids in a row, from genesis on
+    bool add_block_ids_hashes(const std::string& blob);
+    // heights below it are covered by the block ids hashes
+    uint64_t get_block_ids_hashes_height() const;
+    // checks every whole group of ids below get_block_ids_hashes_height(), ids start at start_height;
+    // checked_count is the number of ids from the front up to the end of the last checked group
+    bool check_block_ids(uint64_t start_height, const std::vector<crypto::hash>& ids, size_t& checked_count) const;
+    static crypto::hash get_block_ids_group_hash(const crypto::hash* ids);
   private:
     std::map<uint64_t, crypto::hash> m_points;
+    std::vector<crypto::hash> m_block_ids_hashes;
   };
 }
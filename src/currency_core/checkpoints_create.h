@@ -6,6 +6,7 @@
 
 #include "checkpoints.h"
 #include "misc_log_ex.h"
+#include "block_ids_hashes.h"
 
 #define ADD_CHECKPOINT(h, hash)  CHECK_AND_ASSERT(checkpoints.add_checkpoint(h,  hash), false);
 
@@ -31,6 +32,7 @@ namespace currency {
     ADD_CHECKPOINT(500000,  "774f103be1dbe3e4531dabdeb611b3ba2810bef14f9de7392eaf182320ff6153");
     ADD_CHECKPOINT(550000,  "2582cc179b45a480ed229bd21ca0e8337b944d44401f2177971bf23e22b416b4");
     ADD_CHECKPOINT(773500,  "5741cb650d2000200ccd79d451d5cd63f3674a7fc230cc68b475f4b7493f5c4e");
+    CHECK_AND_ASSERT(checkpoints.add_block_ids_hashes(std::string(reinterpret_cast<const char*>(block_ids_hashes_data), sizeof(block_ids_hashes_data) - 1)), false);
 #endif
     return true;
   }
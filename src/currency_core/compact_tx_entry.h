@@ -0,0 +1,57 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "currency_basic.h"
+
+namespace currency
+{
+  /************************************************************************/
+  /* Transaction data a wallet needs to find its outputs and spendings,   */
+  /* sent instead of the full tx blob by getblocks.bin in compact mode    */
+  /************************************************************************/
+  struct compact_tx_out
+  {
+    enum { type_to_key = 0, type_other = 1 };
+
+    uint64_t amount;
+    uint8_t type;                  // type_to_key or type_other for any other target, which can't be a wallet's output
+    crypto::public_key key;        // txout_to_key only
+
+    BEGIN_SERIALIZE_OBJECT()
+      VARINT_FIELD(amount)
+      FIELD(type)
+      if (type == type_to_key)
+        FIELD(key)
+    END_SERIALIZE()
+  };
+
+  struct compact_tx_in
+  {
+    uint64_t amount;
+    crypto::key_image k_image;
+
+    BEGIN_SERIALIZE_OBJECT()
+      VARINT_FIELD(amount)
+      FIELD(k_image)
+    END_SERIALIZE()
+  };
+
+  struct compact_tx_entry
+  {
+    uint8_t extra_parsed;
+    crypto::public_key tx_pub_key;
+    std::vector<compact_tx_out> outs;   // all the outputs, in the tx order
+    std::vector<compact_tx_in> ins;     // txin_to_key inputs only, in the tx order
+    std::string payment_id;
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELD(extra_parsed)
+      FIELD(tx_pub_key)
+      FIELD(outs)
+      FIELD(ins)
+      FIELD(payment_id)
+    END_SERIALIZE()
+  };
+}
@@ -23,13 +23,13 @@ namespace currency
     };
 
     state m_state;
-    std::list<crypto::hash> m_needed_objects;
     std::unordered_set<crypto::hash> m_requested_objects;
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
     //size_t m_score;  TODO: add score calculations
     std::string m_remote_version;
+    uint64_t m_remote_features;       //CURRENCY_PROTOCOL_FEATURE_* flags from the peer's sync data
   };
 
   inline std::string get_protocol_state_string(currency_connection_context::state s)
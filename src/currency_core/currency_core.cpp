@@ -18,6 +18,7 @@ using namespace epee;
 #include "currency_format_utils.h"
 #include "misc_language.h"
 #include "profile_tools.h"
+#include "common/parallel_utils.h"
 
 DISABLE_VS_WARNINGS(4355)
 
@@ -30,6 +31,8 @@ namespace currency
               m_blockchain_storage(m_mempool),
               m_miner(this, m_blockchain_storage),
               m_miner_address(boost::value_initialized<account_public_address>()), 
+              m_tx_admissions_count(0),
+              m_tx_verification_pool(CURRENCY_MEMPOOL_MAX_CONCURRENT_ADMISSIONS),
               m_starter_message_showed(false)
   {
     set_currency_protocol(pprotocol);
@@ -50,6 +53,7 @@ namespace currency
   void core::init_options(boost::program_options::options_description& desc)
   {
     blockchain_storage::init_options(desc);
+    tx_memory_pool::init_options(desc);
   }
   //-----------------------------------------------------------------------------------------------
   std::string core::get_config_folder()
@@ -127,7 +131,7 @@ namespace currency
   {
     bool r = handle_command_line(vm);
 
-    r = m_mempool.init(m_config_folder);
+    r = m_mempool.init(m_config_folder, vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize memory pool");
 
     r = m_blockchain_storage.init(vm, m_config_folder);
@@ -136,6 +140,11 @@ namespace currency
     r = m_miner.init(vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
+    //the thread calling handle_incoming_txs verifies txs too, so the pool has one thread less
+    size_t verification_threads_count = std::min<size_t>(tools::get_default_worker_threads_count(), CURRENCY_MEMPOOL_MAX_CONCURRENT_ADMISSIONS);
+    m_tx_verification_pool.start(verification_threads_count - 1);
+    m_mempool.set_verification_pool(&m_tx_verification_pool);
+
     return load_state_data();
   }
   //-----------------------------------------------------------------------------------------------
@@ -154,6 +163,7 @@ namespace currency
   {
     m_miner.stop();
     m_miner.deinit();
+    m_tx_verification_pool.stop();
     m_mempool.deinit();
     m_blockchain_storage.deinit();
     return true;
@@ -165,9 +175,18 @@ namespace currency
    crypto::hash tx_hash = tx_hash_;
    if (tx_hash == null_hash)
      tx_hash = get_transaction_hash(tx);
-   CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
   tvc = boost::value_initialized<tx_verification_context>();
-  //want to process all transactions sequentially
+  tvc.m_tx_hash = tx_hash;
+  //transactions are verified concurrently, only the commit to the pool is serialized (in tx_memory_pool::add_tx)
+  if (!enter_tx_admission(keeped_by_block))
+  {
+    LOG_PRINT_L0("tx " << tx_hash << " dropped: no verification slot in " << CURRENCY_MEMPOOL_ADMISSION_WAIT_MS << " ms, "
+      << CURRENCY_MEMPOOL_MAX_CONCURRENT_ADMISSIONS << " txs are being verified already");
+    tvc.m_admission_timed_out = true;
+    return false;
+  }
+  ON_EXIT([this](){ leave_tx_admission(); });
+
   if (!check_tx_syntax(tx))
   {
     LOG_PRINT_L0("WRONG TRANSACTION BLOB, Failed to check tx " << tx_hash << " syntax, rejected");
@@ -201,8 +220,6 @@ namespace currency
 bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block)
   {
     tvc = boost::value_initialized<tx_verification_context>();
-    //want to process all transactions sequentially
-    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
 
     if(tx_blob.size() > get_max_tx_size())
     {
@@ -226,6 +243,45 @@ bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context&
     return handle_incoming_tx(tx, tvc, keeped_by_block, tx_hash);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_txs(const std::list<blobdata>& txs_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block)
+  {
+    PROFILE_FUNC("core::handle_incoming_txs");
+    std::vector<const blobdata*> blobs;
+    for (const auto& tx_blob : txs_blobs)
+      blobs.push_back(&tx_blob);
+    tvcs.assign(blobs.size(), tx_verification_context());
+
+    std::atomic<bool> r(true);
+    m_tx_verification_pool.run(blobs.size(), m_tx_verification_pool.get_threads_count() + 1, [&](size_t i)
+    {
+      if (!handle_incoming_tx(*blobs[i], tvcs[i], keeped_by_block))
+        r = false;
+    });
+    return r;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::enter_tx_admission(bool keeped_by_block)
+  {
+    std::unique_lock<std::mutex> lk(m_tx_admission_lock);
+    auto has_slot = [this](){ return m_tx_admissions_count < CURRENCY_MEMPOOL_MAX_CONCURRENT_ADMISSIONS; };
+    //txs from blocks always wait, relayed ones give up when verification can't keep up with them
+    if (keeped_by_block)
+      m_tx_admission_cv.wait(lk, has_slot);
+    else if (!m_tx_admission_cv.wait_for(lk, std::chrono::milliseconds(CURRENCY_MEMPOOL_ADMISSION_WAIT_MS), has_slot))
+      return false;
+    ++m_tx_admissions_count;
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  void core::leave_tx_admission()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_tx_admission_lock);
+      --m_tx_admissions_count;
+    }
+    m_tx_admission_cv.notify_one();
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_stat_info(core_stat_info& st_inf)
   {
     st_inf.mining_speed = m_miner.get_speed();
@@ -359,14 +415,20 @@ bool core::handle_incoming_tx(const blobdata& tx_blob, tx_verification_context&
     return m_blockchain_storage.create_block_template(b, adr, diffic, height, ex_nonce, vote_for_donation, ai);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp)
+  bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp, size_t max_count)
+  {
+    return m_blockchain_storage.find_blockchain_supplement(qblock_ids, resp, max_count);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::find_blockchain_ids_supplement(const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& ids, std::list<uint64_t>& timestamps, uint64_t& total_height, uint64_t& start_height, size_t max_count)
   {
-    return m_blockchain_storage.find_blockchain_supplement(qblock_ids, resp);
+    return m_blockchain_storage.find_blockchain_ids_supplement(qblock_ids, ids, timestamps, total_height, start_height, max_count);
   }
   //-----------------------------------------------------------------------------------------------
-  bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count)
+  bool core::find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count,
+    std::list<std::vector<std::vector<uint64_t> > >* p_global_outs_indexes /* = nullptr */)
   {
-    return m_blockchain_storage.find_blockchain_supplement(qblock_ids, blocks, total_height, start_height, max_count);
+    return m_blockchain_storage.find_blockchain_supplement(qblock_ids, blocks, total_height, start_height, max_count, p_global_outs_indexes);
   }
   //-----------------------------------------------------------------------------------------------
   void core::print_blockchain(uint64_t start_index, uint64_t end_index)
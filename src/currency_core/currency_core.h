@@ -5,6 +5,8 @@
 
 #pragma once
 
+#include <condition_variable>
+#include <mutex>
 #include <boost/program_options/options_description.hpp>
 #include <boost/program_options/variables_map.hpp>
 
@@ -18,6 +20,7 @@
 #include "currency_core/currency_stat_info.h"
 #include "warnings.h"
 #include "crypto/hash.h"
+#include "common/parallel_utils.h"
 
 PUSH_WARNINGS
 DISABLE_VS_WARNINGS(4355)
@@ -35,6 +38,8 @@ namespace currency
      bool on_idle();
      bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block);
      bool handle_incoming_tx(const transaction & tx, tx_verification_context& tvc, bool keeped_by_block, const crypto::hash& tx_hash = null_hash);
+     //verifies txs of the batch in parallel on the verification pool, tvcs are in the same order as the blobs
+     bool handle_incoming_txs(const std::list<blobdata>& txs_blobs, std::vector<tx_verification_context>& tvcs, bool keeped_by_block);
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
      bool handle_incoming_block(const block& b, block_verification_context& bvc, bool update_miner_blocktemplate = true);
      i_currency_protocol* get_protocol(){return m_pprotocol;}
@@ -79,8 +84,10 @@ namespace currency
      bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
      bool have_block(const crypto::hash& id);
      bool get_short_chain_history(std::list<crypto::hash>& ids);
-     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp);
-     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp, size_t max_count = BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT);
+     bool find_blockchain_ids_supplement(const std::list<crypto::hash>& qblock_ids, std::list<crypto::hash>& ids, std::list<uint64_t>& timestamps, uint64_t& total_height, uint64_t& start_height, size_t max_count);
+     bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, std::list<std::pair<block, std::list<transaction> > >& blocks, uint64_t& total_height, uint64_t& start_height, size_t max_count,
+       std::list<std::vector<std::vector<uint64_t> > >* p_global_outs_indexes = nullptr);
      bool get_stat_info(core_stat_info& st_inf);
      bool get_backward_blocks_sizes(uint64_t from_height, std::vector<size_t>& sizes, size_t count);
      bool get_tx_outputs_gindexs(const crypto::hash& tx_id, std::vector<uint64_t>& indexs);
@@ -117,12 +124,17 @@ namespace currency
      bool handle_command_line(const boost::program_options::variables_map& vm);
      bool on_update_blocktemplate_interval();
      bool check_tx_inputs_keyimages_diff(const transaction& tx);
+     bool enter_tx_admission(bool keeped_by_block);
+     void leave_tx_admission();
 
 
      tx_memory_pool m_mempool;
      blockchain_storage m_blockchain_storage;
      i_currency_protocol* m_pprotocol;
-     critical_section m_incoming_tx_lock;
+     std::mutex m_tx_admission_lock;
+     std::condition_variable m_tx_admission_cv;
+     size_t m_tx_admissions_count;
+     tools::worker_pool m_tx_verification_pool;
      //m_miner and m_miner_addres are probably temporary here
      miner m_miner;
      account_public_address m_miner_address;
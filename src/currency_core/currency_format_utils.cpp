@@ -15,6 +15,7 @@ using namespace epee;
 #include "profile_tools.h"
 #include "currency_core/swap_address.h"
 #include "common/base58.h"
+#include "common/parallel_utils.h"
 
 namespace currency
 {
@@ -554,7 +555,8 @@ namespace currency
                                                              transaction& tx,
                                                              keypair& txkey,
                                                              uint64_t unlock_time,
-                                                             uint8_t tx_outs_attr)
+                                                             uint8_t tx_outs_attr,
+                                                             size_t sign_threads_count)
   {
     tx.vin.clear();
     tx.vout.clear();
@@ -646,26 +648,33 @@ namespace currency
     crypto::hash tx_prefix_hash;
     get_transaction_prefix_hash(tx, tx_prefix_hash);
 
-    std::stringstream ss_ring_s;
-    size_t i = 0;
-    BOOST_FOREACH(const tx_source_entry& src_entr,  sources)
+    // every input is signed independently, so ring signatures are generated in parallel
+    TIME_MEASURE_START(sign_time);
+    tx.signatures.resize(sources.size());
+    tools::parallel_for(sources.size(), sign_threads_count ? sign_threads_count : tools::get_default_worker_threads_count(), [&](size_t i)
     {
-      ss_ring_s << "pub_keys:" << ENDL;
+      const tx_source_entry& src_entr = sources[i];
       std::vector<const crypto::public_key*> keys_ptrs;
       BOOST_FOREACH(const tx_source_entry::output_entry& o, src_entr.outputs)
-      {
         keys_ptrs.push_back(&o.second);
-        ss_ring_s << o.second << ENDL;
-      }
 
-      tx.signatures.push_back(std::vector<crypto::signature>());
-      std::vector<crypto::signature>& sigs = tx.signatures.back();
+      std::vector<crypto::signature>& sigs = tx.signatures[i];
       sigs.resize(src_entr.outputs.size());
       crypto::generate_ring_signature(tx_prefix_hash, boost::get<txin_to_key>(tx.vin[i]).k_image, keys_ptrs, in_contexts[i].in_ephemeral.sec, src_entr.real_output, sigs.data());
+    });
+    TIME_MEASURE_FINISH(sign_time);
+    LOG_PRINT_L3("construct_tx: " << sources.size() << " inputs signed in " << sign_time << " mcs");
+
+    std::stringstream ss_ring_s;
+    for (size_t i = 0; i != sources.size(); i++)
+    {
+      const tx_source_entry& src_entr = sources[i];
+      ss_ring_s << "pub_keys:" << ENDL;
+      BOOST_FOREACH(const tx_source_entry::output_entry& o, src_entr.outputs)
+        ss_ring_s << o.second << ENDL;
       ss_ring_s << "signatures:" << ENDL;
-      std::for_each(sigs.begin(), sigs.end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
+      std::for_each(tx.signatures[i].begin(), tx.signatures[i].end(), [&](const crypto::signature& s){ss_ring_s << s << ENDL;});
       ss_ring_s << "prefix_hash:" << tx_prefix_hash << ENDL << "in_ephemeral_key: " << in_contexts[i].in_ephemeral.sec << ENDL << "real_output: " << src_entr.real_output;
-      i++;
     }
 
     LOG_PRINT2("construct_tx.log", "transaction_created: " << get_transaction_hash(tx) << ENDL << obj_to_json_str(tx) << ENDL << ss_ring_s.str() , LOG_LEVEL_3);
@@ -775,6 +784,13 @@ namespace currency
     return pk == out_key.key;
   }
   //---------------------------------------------------------------
+  bool is_out_to_acc(const txout_to_key& out_key, const crypto::key_derivation& derivation, const crypto::precomputed_public_key& spend_public_key, size_t output_index)
+  {
+    crypto::public_key pk;
+    crypto::derive_public_key(derivation, output_index, spend_public_key, pk);
+    return pk == out_key.key;
+  }
+  //---------------------------------------------------------------
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     crypto::public_key tx_pub_key = get_tx_pub_key_from_extra(tx);
@@ -786,11 +802,22 @@ namespace currency
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     money_transfered = 0;
+    if (tx.vout.empty())
+      return true;
+
+    //the derivation depends only on tx and account, so do the scalar multiplication once per tx, not once per output
+    crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+    crypto::precomputed_public_key spend_public_key = AUTO_VAL_INIT(spend_public_key);
+    bool keys_ok = crypto::generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation) &&
+      crypto::precompute_public_key(acc.m_account_address.m_spend_public_key, spend_public_key);
+    if (!keys_ok)
+      LOG_PRINT_L2("lookup_acc_outs: unable to derive keys for tx pub key " << tx_pub_key << ", no outputs can belong to the account");
+
     size_t i = 0;
     BOOST_FOREACH(const tx_out& o,  tx.vout)
     {
       CHECK_AND_ASSERT_MES(o.target.type() ==  typeid(txout_to_key), false, "wrong type id in transaction out" );
-      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+      if(keys_ok && is_out_to_acc(boost::get<txout_to_key>(o.target), derivation, spend_public_key, i))
       {
         outs.push_back(i);
         money_transfered += o.amount;
@@ -933,6 +960,75 @@ namespace currency
     return true;
   }
   //---------------------------------------------------------------
+  void get_compact_tx_entry(const transaction& tx, compact_tx_entry& cte)
+  {
+    tx_extra_info tei = AUTO_VAL_INIT(tei);
+    cte.extra_parsed = parse_and_validate_tx_extra(tx, tei) ? 1 : 0;
+    cte.tx_pub_key = tei.m_tx_pub_key;
+    cte.payment_id.clear();
+    if (cte.extra_parsed && tei.m_user_data_blob.size())
+      get_payment_id_from_user_data(tei.m_user_data_blob, cte.payment_id);
+
+    cte.outs.resize(tx.vout.size());
+    for (size_t i = 0; i != tx.vout.size(); ++i)
+    {
+      compact_tx_out& cto = cte.outs[i];
+      cto.amount = tx.vout[i].amount;
+      if (tx.vout[i].target.type() == typeid(txout_to_key))
+      {
+        cto.type = compact_tx_out::type_to_key;
+        cto.key = boost::get<txout_to_key>(tx.vout[i].target).key;
+      }
+      else
+      {
+        cto.type = compact_tx_out::type_other;
+        cto.key = null_pkey;
+      }
+    }
+
+    cte.ins.clear();
+    for (const auto& in : tx.vin)
+    {
+      if (in.type() != typeid(txin_to_key))
+        continue;
+      const txin_to_key& intk = boost::get<txin_to_key>(in);
+      compact_tx_in cti = AUTO_VAL_INIT(cti);
+      cti.amount = intk.amount;
+      cti.k_image = intk.k_image;
+      cte.ins.push_back(cti);
+    }
+  }
+  //---------------------------------------------------------------
+  void get_tx_from_compact_entry(const compact_tx_entry& cte, transaction& tx)
+  {
+    tx.vout.resize(cte.outs.size());
+    for (size_t i = 0; i != cte.outs.size(); ++i)
+    {
+      tx.vout[i].amount = cte.outs[i].amount;
+      if (cte.outs[i].type == compact_tx_out::type_to_key)
+      {
+        txout_to_key otk = AUTO_VAL_INIT(otk);
+        otk.key = cte.outs[i].key;
+        tx.vout[i].target = otk;
+      }
+      else
+      {
+        // the target itself is not sent, the output is looked up the same way as in the full tx then
+        tx.vout[i].target = txout_to_script();
+      }
+    }
+
+    tx.vin.clear();
+    tx.vin.reserve(cte.ins.size());
+    for (const auto& cti : cte.ins)
+    {
+      txin_to_key intk = AUTO_VAL_INIT(intk);
+      intk.amount = cti.amount;
+      intk.k_image = cti.k_image;
+      tx.vin.push_back(intk);
+    }
+  }
+  //---------------------------------------------------------------
   bool get_swap_info_from_tx_extra(const transaction& tx, const crypto::secret_key& sk, account_public_address& addr)
   {
     tx_extra_info tei = AUTO_VAL_INIT(tei);
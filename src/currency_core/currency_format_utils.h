@@ -15,6 +15,7 @@
 #include "crypto/wild_keccak.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "blockchain_storage_basic.h"
+#include "compact_tx_entry.h"
 
 #define MAX_ALIAS_LEN         255
 #define VALID_ALIAS_CHARS     "0123456789abcdefghijklmnopqrstuvwxyz-."
@@ -166,7 +167,8 @@ namespace currency
   bool validate_alias_name(const std::string& al);
   bool construct_tx(const account_keys& keys, const create_tx_arg& arg, create_tx_res& rsp);
   bool construct_tx(const account_keys& sender_account_keys, const std::vector<tx_source_entry>& sources, const std::vector<tx_destination_entry>& destinations, transaction& tx, keypair& txkey, uint64_t unlock_time, uint8_t tx_outs_attr = CURRENCY_TO_KEY_OUT_RELAXED);
-  bool construct_tx(const account_keys& sender_account_keys, const std::vector<tx_source_entry>& sources, const std::vector<tx_destination_entry>& destinations, const std::vector<uint8_t>& extra, transaction& tx, keypair& txkey, uint64_t unlock_time, uint8_t tx_outs_attr = CURRENCY_TO_KEY_OUT_RELAXED);
+  bool construct_tx(const account_keys& sender_account_keys, const std::vector<tx_source_entry>& sources, const std::vector<tx_destination_entry>& destinations, const std::vector<uint8_t>& extra, transaction& tx, keypair& txkey, uint64_t unlock_time, uint8_t tx_outs_attr = CURRENCY_TO_KEY_OUT_RELAXED,
+    size_t sign_threads_count = 0); // 0 - default worker threads count
   bool sign_update_alias(alias_info& ai, const crypto::public_key& pkey, const crypto::secret_key& skey);
   bool make_tx_extra_alias_entry(std::string& buff, const alias_info& alinfo, bool make_buff_to_sign = false);
   bool add_tx_extra_alias(transaction& tx, const alias_info& alinfo);
@@ -176,6 +178,7 @@ namespace currency
   bool add_tx_pub_key_to_extra(transaction& tx, const crypto::public_key& tx_pub_key);
   bool add_tx_extra_nonce(transaction& tx, const blobdata& extra_nonce);
   bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::public_key& tx_pub_key, size_t output_index);
+  bool is_out_to_acc(const txout_to_key& out_key, const crypto::key_derivation& derivation, const crypto::precomputed_public_key& spend_public_key, size_t output_index);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool get_tx_fee(const transaction& tx, uint64_t & fee);
@@ -228,6 +231,9 @@ namespace currency
   bool set_payment_id_and_swap_addr_to_tx_extra(std::vector<uint8_t>& extra, const payment_id_t& payment_id, const account_public_address& acc = account_public_address());
   bool get_payment_id_from_user_data(const std::string& user_data, payment_id_t& payment_id);
   bool get_payment_id_from_tx_extra(const transaction& tx, payment_id_t& payment_id);
+  void get_compact_tx_entry(const transaction& tx, compact_tx_entry& cte);
+  // makes a tx that has only outputs and key images of inputs, enough for lookup_acc_outs and key images checks
+  void get_tx_from_compact_entry(const compact_tx_entry& cte, transaction& tx);
   bool get_swap_info_from_tx_extra(const transaction& tx, const crypto::secret_key& sk, account_public_address& addr);
   bool get_swap_info_from_tx(const transaction& tx, const crypto::secret_key& sk, swap_transaction_info& swap_info);
   bool encrypt_user_data_with_tx_secret_key(const crypto::secret_key& sk, std::vector<uint8_t>& extra);
@@ -13,8 +13,11 @@
 #include "currency_config.h"
 #include "blockchain_storage.h"
 #include "common/boost_serialization_helper.h"
+#include "common/command_line.h"
 #include "common/int-util.h"
+#include "common/parallel_utils.h"
 #include "misc_language.h"
+#include "string_coding.h"
 #include "warnings.h"
 #include "crypto/hash.h"
 #include "profile_tools.h"
@@ -23,10 +26,19 @@ DISABLE_VS_WARNINGS(4244 4345 4503) //'boost::foreach_detail_::or_' : decorated
 
 namespace currency
 {
-  //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs) : m_blockchain(bchs)
+  namespace
   {
+    const command_line::arg_descriptor<uint64_t> arg_pool_max_size_mb = {"pool-max-size-mb", "Memory budget of the transaction pool in MB, the lowest fee rate txs are evicted above it", CURRENCY_MEMPOOL_DEFAULT_MAX_SIZE_MB};
 
+    // rough per-node overhead of std containers: allocator header, links and cached hash or colour
+    const size_t container_node_overhead = 4 * sizeof(void*);
+  }
+  //---------------------------------------------------------------------------------
+  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs) : m_blockchain(bchs), m_pool_version(0), m_ready_cache_top_id(null_hash),
+    m_memory_usage(0), m_max_memory_usage(CURRENCY_MEMPOOL_DEFAULT_MAX_SIZE_MB * 1024 * 1024), m_evicted_count(0), m_evicted_count_minute_ago(0), m_evicted_last_minute(0),
+    m_journal(CURRENCY_MEMPOOL_JOURNAL_SYNC_INTERVAL_MS), m_verification_pool(nullptr)
+  {
+    m_template_cache.valid = false;
   }
   //---------------------------------------------------------------------------------
   bool tx_memory_pool::add_tx(const transaction &tx, const crypto::hash &id, tx_verification_context& tvc, bool kept_by_block)
@@ -70,6 +82,11 @@ namespace currency
       crypto::key_image ki = AUTO_VAL_INIT(ki);
       if (have_tx_keyimges_as_spent(tx, ki_tx, ki))
       {
+        if (ki_tx == id)
+        {
+          LOG_PRINT_L2("tx " << id << " was added to tx_pool by another thread");
+          return true;
+        }
         LOG_ERROR("Transaction " << id << " uses already spent key image " << ki << " seen in tx " << ki_tx);
         tvc.m_verifivation_failed = true;
         return false;
@@ -84,10 +101,31 @@ namespace currency
       }
     }
 
+    uint64_t memory_usage = get_tx_memory_usage(tx);
+    if (!kept_by_block && !is_fee_rate_admitted(id, inputs_amount - outputs_amount, blob_size, memory_usage))
+      return false;
+
     crypto::hash max_used_block_id = null_hash;
     uint64_t max_used_block_height = 0;
     bool ch_inp_res = m_blockchain.check_tx_inputs(tx, max_used_block_height, max_used_block_id);
     CRITICAL_REGION_LOCAL(m_transactions_lock);
+    // txs are verified concurrently, so the same tx or a conflicting one may have been committed meanwhile
+    if (m_transactions.count(id))
+    {
+      LOG_PRINT_L2("tx " << id << " was added to tx_pool by another thread");
+      return true;
+    }
+    if (!kept_by_block)
+    {
+      crypto::hash ki_tx = AUTO_VAL_INIT(ki_tx);
+      crypto::key_image ki = AUTO_VAL_INIT(ki);
+      if (have_tx_keyimges_as_spent(tx, ki_tx, ki))
+      {
+        LOG_ERROR("Transaction " << id << " uses already spent key image " << ki << " seen in tx " << ki_tx);
+        tvc.m_verifivation_failed = true;
+        return false;
+      }
+    }
     if (!ch_inp_res)
     {
       if (kept_by_block)
@@ -102,6 +140,7 @@ namespace currency
         txd_p.first->second.max_used_block_height = 0;
         txd_p.first->second.kept_by_block = kept_by_block;
         txd_p.first->second.receive_time = time(nullptr);
+        on_tx_added(id, txd_p.first->second);
         tvc.m_verifivation_impossible = true;
         tvc.m_added_to_pool = true;
       }
@@ -126,6 +165,7 @@ namespace currency
       txd_p.first->second.last_failed_height = 0;
       txd_p.first->second.last_failed_id = null_hash;
       txd_p.first->second.receive_time = time(nullptr);
+      on_tx_added(id, txd_p.first->second);
       tvc.m_added_to_pool = true;
 
       if (txd_p.first->second.fee > 0)
@@ -144,6 +184,14 @@ namespace currency
       auto ins_res = kei_image_set.insert(id);
       CHECK_AND_ASSERT_MES(ins_res.second, false, "internal error: try to insert duplicate iterator in key_image set");
     }
+    if (!evict_transactions(id))
+    {
+      // outranked by the txs it would push out, dropped like at admission
+      tvc.m_verifivation_failed = false;
+      tvc.m_added_to_pool = false;
+      tvc.m_should_be_relayed = false;
+      return false;
+    }
 
     tvc.m_verifivation_failed = false;
     //succeed
@@ -170,6 +218,7 @@ namespace currency
     blob_size = it->second.blob_size;
     fee = it->second.fee;
     remove_transaction_keyimages(it->second.tx);
+    on_tx_removed(it->first, it->second);
     m_transactions.erase(it);
     return true;
   }
@@ -220,7 +269,14 @@ namespace currency
   //------------------------------------------------------
   void tx_memory_pool::on_idle()
   {
+    revalidate_journal_transactions();
     m_remove_stuck_tx_interval.do_call([this]() {return remove_stuck_transactions(); });
+    m_eviction_rate_interval.do_call([this]() {return update_eviction_rate(); });
+
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    size_t txs_count = m_transactions.size() + m_pending_revalidation.size();
+    if (m_journal.records_count() > std::max<size_t>(CURRENCY_MEMPOOL_JOURNAL_COMPACTION_MIN_RECORDS, txs_count * 2))
+      compact_journal();
   }
   //------------------------------------------------------
   void tx_memory_pool::lock()
@@ -238,18 +294,38 @@ namespace currency
     CRITICAL_REGION_LOCAL(m_transactions_lock);
     m_transactions.clear();
     m_spent_key_images.clear();
+    m_pending_revalidation.clear();
+    rebuild_fee_rate_index();
+    compact_journal();
   }
   //------------------------------------------------------
-  bool tx_memory_pool::init(const std::string& config_folder)
+  void tx_memory_pool::init_options(boost::program_options::options_description& desc)
+  {
+    command_line::add_arg(desc, arg_pool_max_size_mb);
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::init(const std::string& config_folder, const boost::program_options::variables_map& vm)
   {
     m_config_folder = config_folder;
+    if (command_line::has_arg(vm, arg_pool_max_size_mb))
+      m_max_memory_usage = command_line::get_arg(vm, arg_pool_max_size_mb) * 1024 * 1024;
+    if (!tools::create_directories_if_necessary(m_config_folder))
+    {
+      LOG_PRINT_L0("Failed to create data directory: " << m_config_folder);
+      return false;
+    }
+
+    // pool snapshot could be left on exit by previous versions, the journal is used since then
     std::string state_file_path = config_folder + "/" + CURRENCY_POOLDATA_FILENAME;
     boost::system::error_code ec;
-    if (!boost::filesystem::exists(state_file_path, ec))
-      return true;
-    bool res = tools::unserialize_obj_from_file(*this, state_file_path);
-    if (res)
+    if (boost::filesystem::exists(state_file_path, ec))
     {
+      bool res = tools::unserialize_obj_from_file(*this, state_file_path);
+      if (!res)
+      {
+        LOG_ERROR("Failed to load memory pool from file " << state_file_path);
+        return false;
+      }
       if (epee::log_space::log_singletone::get_log_detalisation_level() >= LOG_LEVEL_2)
       {
         std::stringstream ss;
@@ -258,50 +334,172 @@ namespace currency
           ss << tx.first << " sz: " << std::setw(5) << tx.second.blob_size << " rcv: " << misc_utils::get_time_interval_string(time(nullptr) - tx.second.receive_time) << " ago" << ENDL;
         LOG_PRINT_L2(ss.str());
       }
+    }
+    rebuild_fee_rate_index();
+    if (!load_journal())
+      return false;
 
-      // mem pool has just been successfully loaded from file
-      // delete pool file to avoid loading outdated data on the next load (in case a crash happen for ex.)
-      if (!boost::filesystem::remove_all(state_file_path))
+    // the loaded transactions are in the compacted journal once it's on the disk, only then the old file can go
+    if (boost::filesystem::exists(state_file_path, ec))
+    {
+      if (!m_journal.flush())
+      {
+        LOG_ERROR("pool journal is not written, pool file " << state_file_path << " is kept");
+      }
+      else if (!boost::filesystem::remove_all(state_file_path, ec))
       {
         LOG_ERROR("failed to remove pool file " << state_file_path << " after a successful load");
       }
     }
-    else
-    {
-      LOG_ERROR("Failed to load memory pool from file " << state_file_path);
-    }
-    return res;
+    return true;
   }
   //------------------------------------------------------
   bool tx_memory_pool::deinit()
   {
-    if (!tools::create_directories_if_necessary(m_config_folder))
+    // everything is in the journal already, the queued records are written on close
+    m_journal.close();
+    return true;
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::load_journal()
+  {
+    std::string journal_path = m_config_folder + "/" + CURRENCY_POOLDATA_JOURNAL_FILENAME;
+    std::vector<std::string> records;
+    bool corrupted = false;
+    std::string reason;
+    if (!m_journal.open(epee::string_encoding::utf8_to_wstring(journal_path), records, &corrupted, &reason))
     {
-      LOG_PRINT_L0("Failed to create data directory: " << m_config_folder);
+      LOG_ERROR("Failed to open pool journal " << journal_path << ": " << reason);
       return false;
     }
+    if (corrupted)
+      LOG_PRINT_RED_L0("Pool journal " << journal_path << " is corrupted: " << reason);
+
+    // the last record for a tx wins, txs are re-added in the order they came
+    std::list<journal_record> pending;
+    std::unordered_map<crypto::hash, std::list<journal_record>::iterator> pending_by_id;
+    size_t applied = 0;
+    for (; applied != records.size(); ++applied)
+    {
+      journal_record rec = AUTO_VAL_INIT(rec);
+      if (!tools::unserialize_obj_from_buff(rec, records[applied]))
+      {
+        LOG_ERROR("Failed to parse pool journal record #" << applied << ", the rest of the journal is ignored");
+        break;
+      }
+      auto it = pending_by_id.find(rec.id);
+      if (it != pending_by_id.end())
+      {
+        pending.erase(it->second);
+        pending_by_id.erase(it);
+      }
+      if (rec.type == journal_record::add && !m_transactions.count(rec.id))
+        pending_by_id[rec.id] = pending.insert(pending.end(), rec);
+    }
 
-    std::string state_file_path = m_config_folder + "/" + CURRENCY_POOLDATA_FILENAME;
-    bool res = tools::serialize_obj_to_file(*this, state_file_path);
-    if (!res)
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_pending_revalidation.swap(pending);
+    LOG_PRINT_L0("Pool journal loaded from " << journal_path << ": " << applied << " of " << records.size() << " records, "
+      << m_pending_revalidation.size() << " transactions to be revalidated");
+    compact_journal();
+    return true;
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::compact_journal()
+  {
+    // the snapshot is taken under the lock, the writer replaces the journal with it
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (!m_journal.is_open())
+      return;
+    std::list<journal_record> records;
+    for (auto& t : m_transactions)
+    {
+      journal_record rec = AUTO_VAL_INIT(rec);
+      rec.type = journal_record::add;
+      rec.id = t.first;
+      rec.tx = t.second.tx;
+      rec.kept_by_block = t.second.kept_by_block;
+      rec.receive_time = t.second.receive_time;
+      records.push_back(rec);
+    }
+    records.insert(records.end(), m_pending_revalidation.begin(), m_pending_revalidation.end());
+    m_journal.rewrite(records);
+    LOG_PRINT_L1("Pool journal compaction queued, " << m_journal.records_count() << " records");
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::journal_append(journal_record& rec)
+  {
+    // only queued here, the record is serialized and written by the journal thread
+    m_journal.append(rec);
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::flush_journal()
+  {
+    m_journal.flush();
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::revalidate_journal_transactions()
+  {
+    std::vector<journal_record> batch;
     {
-      LOG_PRINT_L0("Failed to serialize memory pool to file " << state_file_path);
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      while (!m_pending_revalidation.empty() && batch.size() < CURRENCY_MEMPOOL_REVALIDATION_BATCH_SIZE)
+      {
+        batch.push_back(m_pending_revalidation.front());
+        m_pending_revalidation.pop_front();
+      }
+    }
+    if (batch.empty())
+      return true;
+
+    // the chain could move on while the node was down, so the txs are checked again like incoming ones
+    std::atomic<size_t> added_count(0);
+    std::function<void(size_t)> revalidate = [&](size_t i)
+    {
+      journal_record& rec = batch[i];
+      if (have_tx(rec.id) || m_blockchain.have_tx(rec.id))
+        return;
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!add_tx(rec.tx, rec.id, tvc, rec.kept_by_block) || !tvc.m_added_to_pool)
+      {
+        LOG_PRINT_L1("tx " << rec.id << " from pool journal didn't pass revalidation, dropped");
+        return;
+      }
+      CRITICAL_REGION_LOCAL(m_transactions_lock);
+      auto it = m_transactions.find(rec.id);
+      if (it != m_transactions.end())
+        it->second.receive_time = rec.receive_time;
+      ++added_count;
+    };
+    if (m_verification_pool)
+      m_verification_pool->run(batch.size(), m_verification_pool->get_threads_count() + 1, revalidate);
+    else
+      tools::parallel_for(batch.size(), 1, revalidate);
+
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    LOG_PRINT_L1("Pool journal: " << added_count << " of " << batch.size() << " txs revalidated, " << m_pending_revalidation.size() << " left");
+    if (m_pending_revalidation.empty())
+    {
+      LOG_PRINT_L0("Pool journal revalidation finished, " << m_transactions.size() << " transactions in pool");
+      compact_journal();
     }
     return true;
   }
   //------------------------------------------------------
   bool tx_memory_pool::fill_block_template(block &bl, size_t median_size, uint64_t already_generated_coins, uint64_t already_donated_coins, size_t &total_size, uint64_t &fee)
   {
-    typedef transactions_container::value_type txv;
     CRITICAL_REGION_LOCAL(m_transactions_lock);
 
-    std::vector<txv *> txs(m_transactions.size());
-    std::transform(m_transactions.begin(), m_transactions.end(), txs.begin(), [](txv &a) -> txv * { return &a; });
-    std::sort(txs.begin(), txs.end(), [](txv *a, txv *b) -> bool {
-      uint64_t a_hi, a_lo = mul128(a->second.fee, b->second.blob_size, &a_hi);
-      uint64_t b_hi, b_lo = mul128(b->second.fee, a->second.blob_size, &b_hi);
-      return a_hi > b_hi || (a_hi == b_hi && a_lo > b_lo);
-    });
+    // bl.prev_id is the chain tip the template is built on
+    block_template_cache& tc = m_template_cache;
+    if (tc.valid && tc.top_id == bl.prev_id && tc.pool_version == m_pool_version && tc.median_size == median_size &&
+      tc.already_generated_coins == already_generated_coins && tc.already_donated_coins == already_donated_coins)
+    {
+      bl.tx_hashes.insert(bl.tx_hashes.end(), tc.tx_hashes.begin(), tc.tx_hashes.end());
+      total_size = tc.total_size;
+      fee = tc.fee;
+      return true;
+    }
 
     size_t current_size = 0;
     uint64_t current_fee = 0;
@@ -314,25 +512,24 @@ namespace currency
     size_t best_position = 0;
     total_size = 0;
     fee = 0;
-    size_t tx_count = 0;
 
     std::unordered_set<crypto::key_image> k_images;
+    std::vector<crypto::hash> selected;
 
-    for (size_t i = 0; i < txs.size(); i++)
+    // transactions are taken in fee per byte order until the block is full, so only the top of the pool is visited
+    for (auto fit = m_fee_rate_index.begin(); fit != m_fee_rate_index.end() && selected.size() <= 124; ++fit)
     {
-      txv &tx(*txs[i]);
+      auto it = m_transactions.find(fit->id);
+      CHECK_AND_ASSERT_MES(it != m_transactions.end(), false, "internal error: tx " << fit->id << " from fee rate index not found in pool");
+      tx_details& txd = it->second;
 
-      if (tx_count > 124 || !is_transaction_ready_to_go(tx.second) || have_key_images(k_images, tx.second.tx))
-      {
-        txs[i] = NULL;
+      if (!is_transaction_ready_to_go(it->first, txd, bl.prev_id) || have_key_images(k_images, txd.tx))
         continue;
-      }
-      ++tx_count;
-      append_key_images(k_images, tx.second.tx);
-
+      selected.push_back(it->first);
+      append_key_images(k_images, txd.tx);
 
-      current_size += tx.second.blob_size;
-      current_fee += tx.second.fee;
+      current_size += txd.blob_size;
+      current_fee += txd.fee;
 
       uint64_t current_reward;
       if (!get_block_reward(median_size, current_size + CURRENCY_COINBASE_BLOB_RESERVED_SIZE, already_generated_coins, already_donated_coins, current_reward, max_donation))
@@ -343,20 +540,23 @@ namespace currency
       if (best_money < current_reward + current_fee)
       {
         best_money = current_reward + current_fee;
-        best_position = i + 1;
+        best_position = selected.size();
         total_size = current_size;
         fee = current_fee;
       }
     }
-
-    for (size_t i = 0; i < best_position; i++)
-    {
-      if (txs[i])
-      {
-        bl.tx_hashes.push_back(txs[i]->first);
-      }
-    }
-
+    selected.resize(best_position);
+    bl.tx_hashes.insert(bl.tx_hashes.end(), selected.begin(), selected.end());
+
+    tc.valid = true;
+    tc.top_id = bl.prev_id;
+    tc.pool_version = m_pool_version;
+    tc.median_size = median_size;
+    tc.already_generated_coins = already_generated_coins;
+    tc.already_donated_coins = already_donated_coins;
+    tc.tx_hashes.swap(selected);
+    tc.total_size = total_size;
+    tc.fee = fee;
     return true;
   }
   //------------------------------------------------------
@@ -551,6 +751,7 @@ namespace currency
       {
         LOG_PRINT_L0("Tx " << it->first << " removed from tx pool due to outdated, age: " << tx_age);
         remove_transaction_keyimages(it->second.tx);
+        on_tx_removed(it->first, it->second);
         m_transactions.erase(it++);
       }
       else
@@ -614,4 +815,206 @@ namespace currency
     //transaction is ok.
     return true;
   }
+  //------------------------------------------------------
+  bool tx_memory_pool::is_transaction_ready_to_go(const crypto::hash& id, tx_details& txd, const crypto::hash& top_id)
+  {
+    // results depend only on the chain, so they are kept until the tip changes
+    if (top_id != m_ready_cache_top_id)
+    {
+      m_ready_cache.clear();
+      m_ready_cache_top_id = top_id;
+    }
+    auto it = m_ready_cache.find(id);
+    if (it != m_ready_cache.end())
+      return it->second;
+    bool ready = is_transaction_ready_to_go(txd);
+    m_ready_cache[id] = ready;
+    return ready;
+  }
+  //------------------------------------------------------
+  int tx_memory_pool::compare_fee_rates(uint64_t a_fee, size_t a_blob_size, uint64_t b_fee, size_t b_blob_size)
+  {
+    // a_fee / a_blob_size vs b_fee / b_blob_size
+    uint64_t a_hi, a_lo = mul128(a_fee, b_blob_size, &a_hi);
+    uint64_t b_hi, b_lo = mul128(b_fee, a_blob_size, &b_hi);
+    if (a_hi != b_hi)
+      return a_hi > b_hi ? 1 : -1;
+    if (a_lo != b_lo)
+      return a_lo > b_lo ? 1 : -1;
+    return 0;
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::fee_rate_greater::operator()(const fee_rate_entry& a, const fee_rate_entry& b) const
+  {
+    int r = compare_fee_rates(a.fee, a.blob_size, b.fee, b.blob_size);
+    if (r)
+      return r > 0;
+    return memcmp(&a.id, &b.id, sizeof(a.id)) < 0;
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::on_tx_added(const crypto::hash& id, const tx_details& txd)
+  {
+    fee_rate_entry e = AUTO_VAL_INIT(e);
+    e.fee = txd.fee;
+    e.blob_size = txd.blob_size;
+    e.id = id;
+    m_fee_rate_index.insert(e);
+    m_memory_usage += get_tx_memory_usage(txd.tx);
+    ++m_pool_version;
+
+    journal_record rec = AUTO_VAL_INIT(rec);
+    rec.type = journal_record::add;
+    rec.id = id;
+    rec.tx = txd.tx;
+    rec.kept_by_block = txd.kept_by_block;
+    rec.receive_time = txd.receive_time;
+    journal_append(rec);
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::on_tx_removed(const crypto::hash& id, const tx_details& txd)
+  {
+    fee_rate_entry e = AUTO_VAL_INIT(e);
+    e.fee = txd.fee;
+    e.blob_size = txd.blob_size;
+    e.id = id;
+    m_fee_rate_index.erase(e);
+    m_ready_cache.erase(id);
+    m_memory_usage -= std::min(m_memory_usage, get_tx_memory_usage(txd.tx));
+    ++m_pool_version;
+
+    journal_record rec = AUTO_VAL_INIT(rec);
+    rec.type = journal_record::remove;
+    rec.id = id;
+    journal_append(rec);
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::rebuild_fee_rate_index()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_fee_rate_index.clear();
+    m_ready_cache.clear();
+    m_memory_usage = 0;
+    for (auto& t : m_transactions)
+    {
+      fee_rate_entry e = AUTO_VAL_INIT(e);
+      e.fee = t.second.fee;
+      e.blob_size = t.second.blob_size;
+      e.id = t.first;
+      m_fee_rate_index.insert(e);
+      m_memory_usage += get_tx_memory_usage(t.second.tx);
+    }
+    ++m_pool_version;
+  }
+  //------------------------------------------------------
+  uint64_t tx_memory_pool::get_tx_memory_usage(const transaction& tx)
+  {
+    // m_transactions and m_fee_rate_index entries
+    uint64_t sz = sizeof(transactions_container::value_type) + sizeof(fee_rate_entry) + 2 * container_node_overhead;
+    sz += tx.vin.capacity() * sizeof(txin_v) + tx.vout.capacity() * sizeof(tx_out) + tx.extra.capacity();
+    sz += tx.signatures.capacity() * sizeof(std::vector<crypto::signature>);
+    for (const auto& sig : tx.signatures)
+      sz += sig.capacity() * sizeof(crypto::signature);
+    for (const auto& in : tx.vin)
+    {
+      if (in.type() != typeid(txin_to_key))
+        continue;
+      sz += boost::get<txin_to_key>(in).key_offsets.capacity() * sizeof(uint64_t);
+      // m_spent_key_images entry with its tx ids set
+      sz += sizeof(key_images_container::value_type) + sizeof(crypto::hash) + 2 * container_node_overhead;
+    }
+    return sz;
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::select_eviction_victims(const crypto::hash& id, uint64_t fee, size_t blob_size, bool kept_by_block, uint64_t excess, std::vector<crypto::hash>& victims)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    // from the lowest fee rate up, a tx not from a block may only push out txs paying less than it does
+    uint64_t freed = 0;
+    for (auto it = m_fee_rate_index.rbegin(); it != m_fee_rate_index.rend() && freed < excess; ++it)
+    {
+      auto tx_it = m_transactions.find(it->id);
+      if (it->id == id || tx_it == m_transactions.end() || tx_it->second.kept_by_block)
+        continue;
+      if (!kept_by_block && compare_fee_rates(fee, blob_size, it->fee, it->blob_size) <= 0)
+      {
+        LOG_PRINT_L1("Transaction " << id << " rejected: tx pool is full (" << m_memory_usage << " of " << m_max_memory_usage << " bytes) and its fee rate "
+          << fee << "/" << blob_size << " is not above the rate of " << it->id << " " << it->fee << "/" << it->blob_size << " it would push out");
+        return false;
+      }
+      victims.push_back(it->id);
+      freed += get_tx_memory_usage(tx_it->second.tx);
+    }
+    if (freed < excess)
+    {
+      LOG_PRINT_L1("Transaction " << id << " can't fit: tx pool is full (" << m_memory_usage << " of " << m_max_memory_usage << " bytes) with txs from blocks");
+      return false;
+    }
+    return true;
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::is_fee_rate_admitted(const crypto::hash& id, uint64_t fee, size_t blob_size, uint64_t memory_usage)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_memory_usage + memory_usage <= m_max_memory_usage)
+      return true;
+    std::vector<crypto::hash> victims;
+    return select_eviction_victims(id, fee, blob_size, false, m_memory_usage + memory_usage - m_max_memory_usage, victims);
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::evict_transactions(const crypto::hash& keep_id)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    if (m_memory_usage <= m_max_memory_usage)
+      return true;
+    auto keep_it = m_transactions.find(keep_id);
+    CHECK_AND_ASSERT_MES(keep_it != m_transactions.end(), false, "internal error: tx " << keep_id << " not found in tx pool at eviction");
+
+    // the pool may have changed since is_fee_rate_admitted(), so the victims are selected again
+    std::vector<crypto::hash> victims;
+    if (!select_eviction_victims(keep_id, keep_it->second.fee, keep_it->second.blob_size, keep_it->second.kept_by_block, m_memory_usage - m_max_memory_usage, victims)
+      && !keep_it->second.kept_by_block)
+    {
+      remove_transaction_keyimages(keep_it->second.tx);
+      on_tx_removed(keep_it->first, keep_it->second);
+      m_transactions.erase(keep_it);
+      return false;
+    }
+    // txs from blocks are kept over the limit, pushing out whatever can go
+    for (const auto& victim : victims)
+    {
+      auto tx_it = m_transactions.find(victim);
+      LOG_PRINT_L1("Tx " << tx_it->first << " evicted from tx pool, fee " << print_money(tx_it->second.fee) << ", size " << tx_it->second.blob_size
+        << ", pool memory usage " << m_memory_usage << " of " << m_max_memory_usage);
+      remove_transaction_keyimages(tx_it->second.tx);
+      on_tx_removed(tx_it->first, tx_it->second);
+      m_transactions.erase(tx_it);
+      ++m_evicted_count;
+    }
+    return true;
+  }
+  //------------------------------------------------------
+  bool tx_memory_pool::update_eviction_rate()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_evicted_last_minute = m_evicted_count - m_evicted_count_minute_ago;
+    m_evicted_count_minute_ago = m_evicted_count;
+    if (m_evicted_last_minute)
+      LOG_PRINT_L0("Tx pool is full: " << m_evicted_last_minute << " txs evicted during the last minute, memory usage " << m_memory_usage << " of " << m_max_memory_usage);
+    return true;
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::get_memory_stat(tx_pool_memory_stat& st) const
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    st.memory_usage = m_memory_usage;
+    st.max_memory_usage = m_max_memory_usage;
+    st.evicted_count = m_evicted_count;
+    st.evicted_last_minute = m_evicted_last_minute;
+  }
+  //------------------------------------------------------
+  void tx_memory_pool::set_max_memory_usage(uint64_t max_memory_usage)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_max_memory_usage = max_memory_usage;
+  }
 }
@@ -10,6 +10,8 @@ using namespace epee;
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
+#include <boost/program_options/options_description.hpp>
+#include <boost/program_options/variables_map.hpp>
 #include <boost/serialization/version.hpp>
 #include <boost/utility.hpp>
 
@@ -20,8 +22,13 @@ using namespace epee;
 #include "verification_context.h"
 #include "crypto/hash.h"
 #include "common/boost_serialization_helper.h"
+#include "common/journal_writer.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 
+namespace tools
+{
+  class worker_pool;
+}
 
 namespace currency
 {
@@ -30,6 +37,14 @@ namespace currency
   /*                                                                      */
   /************************************************************************/
 
+  struct tx_pool_memory_stat
+  {
+    uint64_t memory_usage;              // estimated bytes taken by txs and their key images
+    uint64_t max_memory_usage;
+    uint64_t evicted_count;             // since start
+    uint64_t evicted_last_minute;
+  };
+
   class tx_memory_pool: boost::noncopyable
   {
   public:
@@ -51,9 +66,14 @@ namespace currency
     void lock();
     void unlock();
     void purge_transactions();
+    // waits until the pool changes made so far are on the disk
+    void flush_journal();
+    // txs from the journal are revalidated on these threads, by the calling one only if not set
+    void set_verification_pool(tools::worker_pool* pool) { m_verification_pool = pool; }
 
     // load/store operations
-    bool init(const std::string& config_folder);
+    static void init_options(boost::program_options::options_description& desc);
+    bool init(const std::string& config_folder, const boost::program_options::variables_map& vm);
     bool deinit();
     bool fill_block_template(block &bl, size_t median_size, uint64_t already_generated_coins, uint64_t already_donated_coins, size_t &total_size, uint64_t &fee);
     bool get_transactions(std::list<transaction>& txs);
@@ -64,6 +84,9 @@ namespace currency
     bool get_all_transactions_details(std::list<tx_rpc_extended_info>& txs) const;
 
     size_t get_transactions_count();
+    void get_memory_stat(tx_pool_memory_stat& st) const;
+    // overrides --pool-max-size-mb, the pool is trimmed to it on the next add
+    void set_max_memory_usage(uint64_t max_memory_usage);
     bool remove_transaction_keyimages(const transaction& tx);
     bool have_key_images(const std::unordered_set<crypto::key_image>& kic, const transaction& tx);
     bool append_key_images(std::unordered_set<crypto::key_image>& kic, const transaction& tx);
@@ -102,15 +125,94 @@ namespace currency
       std::string decline_reason;
     };
 
+    // pool changes are appended to the journal as they happen, so the pool survives a crash
+    struct journal_record
+    {
+      enum { add = 1, remove = 2 };
+      uint8_t type;
+      crypto::hash id;
+      transaction tx;                     // for add only
+      bool kept_by_block;
+      uint64_t receive_time;
+
+      template<class archive_t>
+      void serialize(archive_t & ar, const unsigned int version)
+      {
+        ar & type;
+        ar & id;
+        if (type == add)
+        {
+          ar & tx;
+          ar & kept_by_block;
+          ar & receive_time;
+        }
+      }
+    };
+
   private:
+    // pool transactions ordered by fee per byte, highest first
+    struct fee_rate_entry
+    {
+      uint64_t fee;
+      size_t blob_size;
+      crypto::hash id;
+    };
+    struct fee_rate_greater
+    {
+      bool operator()(const fee_rate_entry& a, const fee_rate_entry& b) const;
+    };
+    typedef std::set<fee_rate_entry, fee_rate_greater> fee_rate_index;
+    static int compare_fee_rates(uint64_t a_fee, size_t a_blob_size, uint64_t b_fee, size_t b_blob_size);
+
+    // the last fill_block_template() result, valid while neither the pool nor the chain tip change
+    struct block_template_cache
+    {
+      bool valid;
+      crypto::hash top_id;
+      uint64_t pool_version;
+      size_t median_size;
+      uint64_t already_generated_coins;
+      uint64_t already_donated_coins;
+      std::vector<crypto::hash> tx_hashes;
+      size_t total_size;
+      uint64_t fee;
+    };
+
     bool remove_stuck_transactions();
     bool is_transaction_ready_to_go(tx_details& txd);
+    bool is_transaction_ready_to_go(const crypto::hash& id, tx_details& txd, const crypto::hash& top_id);
+    void on_tx_added(const crypto::hash& id, const tx_details& txd);
+    void on_tx_removed(const crypto::hash& id, const tx_details& txd);
+    void rebuild_fee_rate_index();
+    static uint64_t get_tx_memory_usage(const transaction& tx);
+    bool select_eviction_victims(const crypto::hash& id, uint64_t fee, size_t blob_size, bool kept_by_block, uint64_t excess, std::vector<crypto::hash>& victims);
+    bool is_fee_rate_admitted(const crypto::hash& id, uint64_t fee, size_t blob_size, uint64_t memory_usage);
+    bool evict_transactions(const crypto::hash& keep_id);
+    bool update_eviction_rate();
+    bool load_journal();
+    void compact_journal();
+    void journal_append(journal_record& rec);
+    bool revalidate_journal_transactions();
     typedef std::unordered_map<crypto::hash, tx_details > transactions_container;
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
     mutable epee::critical_section m_transactions_lock;
     transactions_container m_transactions;
     key_images_container m_spent_key_images;
+    fee_rate_index m_fee_rate_index;                              // not serialized, rebuilt on load
+    uint64_t m_pool_version;                                      // changes on every tx added or removed
+    crypto::hash m_ready_cache_top_id;                            // is_transaction_ready_to_go() results for this chain tip
+    std::unordered_map<crypto::hash, bool> m_ready_cache;
+    block_template_cache m_template_cache;
+    uint64_t m_memory_usage;                                      // get_tx_memory_usage() of all the txs in the pool
+    uint64_t m_max_memory_usage;
+    uint64_t m_evicted_count;
+    uint64_t m_evicted_count_minute_ago;
+    uint64_t m_evicted_last_minute;
+    epee::math_helper::once_a_time_seconds<60> m_eviction_rate_interval;
+    tools::journal_writer<journal_record> m_journal;             // written from its own thread, not under m_transactions_lock
+    std::list<journal_record> m_pending_revalidation;             // txs loaded from the journal, re-added to the pool on idle
+    tools::worker_pool* m_verification_pool;
     
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
@@ -155,6 +257,9 @@ namespace boost
       ar & td.last_failed_height;
       ar & td.last_failed_id;
       ar & td.receive_time;
+      // not stored in the pool file, the loaded txs go to the journal with it
+      if (archive_t::is_loading::value)
+        td.kept_by_block = false;
     }
   }
 }
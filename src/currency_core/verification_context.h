@@ -4,6 +4,8 @@
 
 
 #pragma once
+#include "crypto/hash.h"
+
 namespace currency
 {
   /************************************************************************/
@@ -15,6 +17,8 @@ namespace currency
     bool m_verifivation_failed; //bad tx, should drop connection
     bool m_verifivation_impossible; //the transaction is related with an alternative blockchain
     bool m_added_to_pool; 
+    bool m_admission_timed_out; //relayed tx was dropped unverified: too many txs were being verified at once
+    crypto::hash m_tx_hash; //set once the tx is parsed
   };
 
   struct block_verification_context
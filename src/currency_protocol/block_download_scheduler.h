@@ -0,0 +1,491 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <algorithm>
+#include <iterator>
+#include <list>
+#include <map>
+#include <set>
+#include <vector>
+#include <boost/uuid/uuid.hpp>
+#include <boost/uuid/nil_generator.hpp>
+
+#include "syncobj.h"
+#include "net/net_utils_base.h"
+#include "currency_protocol_defs.h"
+
+namespace currency
+{
+  // block of a downloaded range, parsed and checked against the range ids off the network threads
+  struct prevalidated_block
+  {
+    crypto::hash id;
+    block b;
+    std::vector<transaction> txs;       // in the order of b.tx_hashes
+    std::vector<crypto::hash> tx_ids;
+  };
+
+  /************************************************************************/
+  /* Splits the block ids learned from peers' chain entries into ranges,  */
+  /* hands the ranges out to several peers at once and gives downloaded   */
+  /* ranges back strictly in height order, to be applied by one thread.   */
+  /* A received range is prevalidated before it's ready to be applied     */
+  /* Ids below the verified ids height are checked against the embedded   */
+  /* block ids hashes before they get here, they are fetched ahead by one */
+  /* peer and downloaded from any peer that is high enough.               */
+  /************************************************************************/
+  class block_download_scheduler
+  {
+  public:
+    typedef epee::net_utils::connection_context_base peer_context;
+
+    // ids_window is the number of ids a chain entry brings, more ids are asked for when half of them is left;
+    // ranges ending more than max_blocks_ahead blocks beyond the next block to be applied are not handed out
+    block_download_scheduler(size_t range_size = BLOCKS_SYNCHRONIZING_DEFAULT_COUNT, size_t ids_window = BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT,
+      uint64_t range_timeout_ms = CURRENCY_PROTOCOL_SYNC_RANGE_TIMEOUT_MS, uint64_t max_blocks_ahead = CURRENCY_PROTOCOL_SYNC_MAX_BLOCKS_AHEAD) :
+      m_next_height(0), m_range_size(range_size ? range_size : 1), m_ids_window(ids_window), m_range_timeout_ms(range_timeout_ms),
+      m_max_blocks_ahead(std::max<uint64_t>(max_blocks_ahead, m_range_size)), m_target_height(0),
+      m_verified_ids_height(0), m_ids_fetcher(boost::uuids::nil_uuid()), m_ids_fetch_time(0)
+    {}
+
+    void set_verified_ids_height(uint64_t height)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      m_verified_ids_height = height;
+    }
+
+    // ids are the ones the local chain lacks, starting at start_height; returns false if they conflict with the chain
+    // being downloaded and the peer's chain isn't longer, the peer isn't used for downloading then
+    bool add_chain(const peer_context& peer, uint64_t start_height, const std::vector<crypto::hash>& ids, uint64_t remote_height)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      p.remote_height = remote_height;
+      p.waiting = false;
+      if (m_ids_fetcher == peer.m_connection_id)
+        m_ids_fetcher = boost::uuids::nil_uuid();
+
+      uint64_t conflict_height = 0;
+      if (!is_chain_consistent(start_height, ids, conflict_height))
+      {
+        if (remote_height <= m_target_height)
+          return false;
+        LOG_PRINT_L0("[" << epee::net_utils::print_connection_context_short(peer) << "] longer chain (" << remote_height << " blocks) differs from the one being downloaded ("
+          << m_target_height << " blocks) at height " << conflict_height << ", downloading it instead");
+        reset_unlocked();
+      }
+
+      if (m_ranges.empty())
+        m_next_height = start_height;
+      for (size_t i = 0; i != ids.size(); ++i)
+      {
+        uint64_t h = start_height + i;
+        if (h >= m_next_height && h >= get_end_height())
+          append_id(h, ids[i]);
+      }
+      p.chain_height = std::max(p.chain_height, start_height + ids.size());
+      m_target_height = std::max(m_target_height, remote_height);
+      return true;
+    }
+
+    // next range for the peer to download, the lowest one that is free, that the peer has and that is within the window
+    bool get_range(const peer_context& peer, uint64_t now, std::list<crypto::hash>& ids)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      if (p.has_range)
+        return false;
+
+      double best_speed = get_best_speed();
+      bool is_slow = p.speed * CURRENCY_PROTOCOL_SYNC_SLOW_PEER_RATIO < best_speed;
+      uint64_t available_height = std::min(get_available_height(p), get_window_end_height());
+      for (auto it = m_ranges.begin(); it != m_ranges.end(); ++it)
+      {
+        range& r = it->second;
+        if (r.start_height + r.ids.size() > available_height)
+          break;
+        if (r.downloaded || r.prevalidating)
+          continue;
+        bool is_head = it == m_ranges.begin();
+        if (r.owner != boost::uuids::nil_uuid())
+        {
+          // blocks behind the head are downloaded while it's still loading, a much faster peer takes it over
+          auto owner_it = m_peers.find(r.owner);
+          bool owner_is_slow = owner_it == m_peers.end() || owner_it->second.speed * CURRENCY_PROTOCOL_SYNC_SLOW_PEER_RATIO < p.speed;
+          if (!is_head || !owner_is_slow || !has_downloaded_ranges())
+            continue;
+          LOG_PRINT_L1("[" << epee::net_utils::print_connection_context_short(peer) << "] takes over blocks range " << r.start_height << " from a slower peer");
+        }
+        else if (is_head && is_slow && has_downloaded_ranges())
+        {
+          continue;
+        }
+        assign_range(p, r, now);
+        ids.assign(r.ids.begin(), r.ids.end());
+        return true;
+      }
+      return false;
+    }
+
+    // response to the range assigned to the peer arrived, returns false if the range isn't needed anymore (taken over by another
+    // peer or reset meanwhile), otherwise it's held until on_range_prevalidated or on_range_rejected and its ids are given back
+    bool on_range_received(const peer_context& peer, size_t blocks_count, uint64_t now, uint64_t& start_height, std::vector<crypto::hash>& ids)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      if (!p.has_range)
+        return false;
+      p.has_range = false;
+      uint64_t elapsed_ms = std::max<uint64_t>(now - p.range_request_time, 1);
+      double speed = blocks_count * 1000.0 / elapsed_ms;
+      p.speed = p.speed > 0 ? (p.speed * 3 + speed) / 4 : speed;
+
+      auto it = m_ranges.find(p.range_start_height);
+      if (it == m_ranges.end() || it->second.downloaded || it->second.prevalidating)
+        return false;
+      range& r = it->second;
+      r.prevalidating = true;
+      r.owner = boost::uuids::nil_uuid();
+      start_height = r.start_height;
+      ids = r.ids;
+      return true;
+    }
+
+    // blocks of a received range, in the order of its ids, the range is ready to be applied then
+    bool on_range_prevalidated(uint64_t start_height, std::vector<prevalidated_block>& blocks, const peer_context& source)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_ranges.find(start_height);
+      if (it == m_ranges.end() || !it->second.prevalidating)
+        return false; // ranges were reset meanwhile
+      range& r = it->second;
+      CHECK_AND_ASSERT_MES(blocks.size() == r.ids.size() && blocks.front().id == r.ids.front() && blocks.back().id == r.ids.back(), false,
+        "prevalidated blocks don't match range " << r.start_height);
+      r.blocks.assign(std::make_move_iterator(blocks.begin()), std::make_move_iterator(blocks.end()));
+      r.prevalidating = false;
+      r.downloaded = true;
+      r.source = source;
+      return true;
+    }
+
+    // received range turned out to be invalid, it's free to be downloaded from another peer
+    void on_range_rejected(uint64_t start_height)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_ranges.find(start_height);
+      if (it != m_ranges.end())
+        it->second.prevalidating = false;
+    }
+
+    bool has_ready_range()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_ranges.size() && m_ranges.begin()->second.downloaded;
+    }
+
+    // takes the next range to be applied if it's downloaded
+    bool pop_ready_range(uint64_t& start_height, std::list<prevalidated_block>& blocks, peer_context& source)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      if (m_ranges.empty() || !m_ranges.begin()->second.downloaded)
+        return false;
+      range& r = m_ranges.begin()->second;
+      start_height = r.start_height;
+      blocks.swap(r.blocks);
+      source = r.source;
+      m_next_height = r.start_height + r.ids.size();
+      m_ranges.erase(m_ranges.begin());
+      return true;
+    }
+
+    // more ids are needed from the peer if it has them and the ones known are running out
+    bool need_more_ids(const peer_context& peer)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      if (!p.chain_height)
+        return true;
+      if (p.chain_height >= p.remote_height)
+        return false;
+      return m_ranges.empty() || m_ranges.begin()->first + m_ids_window / 2 > p.chain_height;
+    }
+
+    // verified ids are fetched ahead of the downloads by one peer at a time, up to the verified ids height
+    bool need_ids_ahead(const peer_context& peer, uint64_t now)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      if (!p.chain_height || m_ranges.empty() || get_end_height() >= std::min(m_verified_ids_height, p.remote_height))
+        return false;
+      if (m_ids_fetcher != boost::uuids::nil_uuid() && m_ids_fetcher != peer.m_connection_id && now - m_ids_fetch_time < m_range_timeout_ms)
+        return false;
+      m_ids_fetcher = peer.m_connection_id;
+      m_ids_fetch_time = now;
+      return true;
+    }
+
+    // last id of the chain being downloaded, chain requests start from it
+    bool get_last_id(crypto::hash& id)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      if (m_ranges.empty())
+        return false;
+      id = m_ranges.rbegin()->second.ids.back();
+      return true;
+    }
+
+    bool has_block_id(const crypto::hash& id)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (const auto& r : m_ranges)
+        if (std::find(r.second.ids.begin(), r.second.ids.end(), id) != r.second.ids.end())
+          return true;
+      return false;
+    }
+
+    // everything the peer has is applied
+    bool is_peer_synchronized(const peer_context& peer)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      peer_info& p = get_peer(peer);
+      return p.chain_height && p.chain_height >= p.remote_height && (m_ranges.empty() || m_ranges.begin()->first >= p.chain_height);
+    }
+
+    void set_peer_waiting(const peer_context& peer)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      get_peer(peer).waiting = true;
+    }
+
+    // peers waiting for work, the flag is cleared
+    void get_waiting_peers(std::set<boost::uuids::uuid>& peers)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (auto& p : m_peers)
+      {
+        if (p.second.waiting)
+          peers.insert(p.first);
+        p.second.waiting = false;
+      }
+    }
+
+    // forgets closed connections and frees their ranges, returns peers that didn't deliver a range in time
+    void on_idle(const std::set<boost::uuids::uuid>& connections, uint64_t now, std::list<peer_context>& stalled_peers)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (auto it = m_peers.begin(); it != m_peers.end();)
+      {
+        if (!connections.count(it->first))
+        {
+          m_peers.erase(it++);
+          continue;
+        }
+        if (it->second.has_range && now - it->second.range_request_time >= m_range_timeout_ms)
+        {
+          stalled_peers.push_back(it->second.context);
+          m_peers.erase(it++);
+          continue;
+        }
+        ++it;
+      }
+      for (auto& r : m_ranges)
+      {
+        if (r.second.owner != boost::uuids::nil_uuid() && !m_peers.count(r.second.owner))
+          r.second.owner = boost::uuids::nil_uuid();
+      }
+      if (!m_peers.count(m_ids_fetcher))
+        m_ids_fetcher = boost::uuids::nil_uuid();
+    }
+
+    // drops everything, used when the downloaded blocks turn out to be invalid
+    void reset()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      reset_unlocked();
+    }
+
+    uint64_t get_target_height()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_target_height;
+    }
+
+    size_t get_ranges_count()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_ranges.size();
+    }
+
+    // ranges by stage, the ones being prevalidated are the rest of get_ranges_count()
+    void get_ranges_stat(size_t& pending, size_t& downloading, size_t& ready)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      pending = downloading = ready = 0;
+      for (const auto& r : m_ranges)
+      {
+        if (r.second.downloaded)
+          ++ready;
+        else if (r.second.owner != boost::uuids::nil_uuid())
+          ++downloading;
+        else if (!r.second.prevalidating)
+          ++pending;
+      }
+    }
+
+  private:
+    struct range
+    {
+      uint64_t start_height;
+      std::vector<crypto::hash> ids;
+      boost::uuids::uuid owner;                // peer downloading it, nil if none
+      uint64_t request_time;
+      bool prevalidating;                      // received, not ready to be applied yet
+      bool downloaded;
+      std::list<prevalidated_block> blocks;    // in the order of ids
+      peer_context source;
+    };
+
+    struct peer_info
+    {
+      peer_context context;
+      uint64_t chain_height;                   // end of the downloaded chain's ids the peer is known to have
+      uint64_t remote_height;
+      double speed;                            // blocks per second, averaged
+      bool has_range;
+      uint64_t range_start_height;
+      uint64_t range_request_time;
+      bool waiting;
+    };
+
+    peer_info& get_peer(const peer_context& peer)
+    {
+      auto it = m_peers.find(peer.m_connection_id);
+      if (it == m_peers.end())
+      {
+        peer_info p = AUTO_VAL_INIT(p);
+        p.context = peer;
+        it = m_peers.insert(std::make_pair(peer.m_connection_id, p)).first;
+      }
+      return it->second;
+    }
+
+    // verified ids are the same for every peer, the peer is known to have them if it's high enough
+    uint64_t get_available_height(const peer_info& p)
+    {
+      return std::max(p.chain_height, std::min(std::min(get_end_height(), m_verified_ids_height), p.remote_height));
+    }
+
+    // ranges are downloaded up to this height, the window starts at the next block to be applied
+    uint64_t get_window_end_height()
+    {
+      uint64_t head_height = m_ranges.empty() ? m_next_height : m_ranges.begin()->first;
+      return head_height + m_max_blocks_ahead;
+    }
+
+    uint64_t get_end_height()
+    {
+      if (m_ranges.empty())
+        return m_next_height;
+      const range& r = m_ranges.rbegin()->second;
+      return r.start_height + r.ids.size();
+    }
+
+    bool is_chain_consistent(uint64_t start_height, const std::vector<crypto::hash>& ids, uint64_t& conflict_height)
+    {
+      if (m_ranges.empty())
+        return true;
+      if (start_height > get_end_height())
+      {
+        conflict_height = get_end_height();
+        return false;
+      }
+      for (size_t i = 0; i != ids.size(); ++i)
+      {
+        uint64_t h = start_height + i;
+        if (h < m_next_height)
+          continue;
+        if (h >= get_end_height())
+          break;
+        const range& r = std::prev(m_ranges.upper_bound(h))->second;
+        if (r.ids[h - r.start_height] != ids[i])
+        {
+          conflict_height = h;
+          return false;
+        }
+      }
+      return true;
+    }
+
+    void append_id(uint64_t height, const crypto::hash& id)
+    {
+      if (m_ranges.size())
+      {
+        range& last = m_ranges.rbegin()->second;
+        if (last.ids.size() < m_range_size && last.owner == boost::uuids::nil_uuid() && !last.prevalidating && !last.downloaded)
+        {
+          last.ids.push_back(id);
+          return;
+        }
+      }
+      range& r = m_ranges[height];
+      r.start_height = height;
+      r.ids.push_back(id);
+      r.owner = boost::uuids::nil_uuid();
+      r.request_time = 0;
+      r.prevalidating = false;
+      r.downloaded = false;
+    }
+
+    void assign_range(peer_info& p, range& r, uint64_t now)
+    {
+      r.owner = p.context.m_connection_id;
+      r.request_time = now;
+      p.has_range = true;
+      p.range_start_height = r.start_height;
+      p.range_request_time = now;
+    }
+
+    double get_best_speed()
+    {
+      double best_speed = 0;
+      for (const auto& p : m_peers)
+        best_speed = std::max(best_speed, p.second.speed);
+      return best_speed;
+    }
+
+    bool has_downloaded_ranges()
+    {
+      for (const auto& r : m_ranges)
+        if (r.second.downloaded || r.second.prevalidating)
+          return true;
+      return false;
+    }
+
+    void reset_unlocked()
+    {
+      m_ranges.clear();
+      m_target_height = 0;
+      m_ids_fetcher = boost::uuids::nil_uuid();
+      for (auto& p : m_peers)
+      {
+        p.second.chain_height = 0;
+        p.second.has_range = false;
+      }
+    }
+
+    epee::critical_section m_lock;
+    std::map<uint64_t, range> m_ranges;       // by start height, contiguous, the first one is the next to be applied
+    std::map<boost::uuids::uuid, peer_info> m_peers;
+    uint64_t m_next_height;                    // height of the first block not applied yet
+    size_t m_range_size;
+    size_t m_ids_window;
+    uint64_t m_range_timeout_ms;
+    uint64_t m_max_blocks_ahead;
+    uint64_t m_target_height;
+    uint64_t m_verified_ids_height;            // ids below it are checked against the block ids hashes
+    boost::uuids::uuid m_ids_fetcher;          // peer fetching verified ids ahead, nil if none
+    uint64_t m_ids_fetch_time;
+  };
+}
@@ -14,6 +14,11 @@ namespace currency
 
 #define BC_COMMANDS_POOL_BASE 2000
 
+//CORE_SYNC_DATA::features flags
+#define CURRENCY_PROTOCOL_FEATURE_TX_ANNOUNCE     0x0000000000000001   //txs are relayed as hash announcements, blobs are sent on request
+#define CURRENCY_PROTOCOL_FEATURE_COMPACT_BLOCKS  0x0000000000000002   //new blocks are relayed without tx blobs, see NOTIFY_NEW_COMPACT_BLOCK
+#define CURRENCY_PROTOCOL_FEATURE_BULK_BLOCK_IDS  0x0000000000000004   //chain entries are up to BLOCKS_IDS_SYNCHRONIZING_BULK_COUNT ids long
+
 
   /************************************************************************/
   /*                                                                      */
@@ -111,12 +116,14 @@ namespace currency
     crypto::hash  top_id;
     uint64_t last_checkpoint_height;
     std::string client_version;
+    uint64_t features;
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(current_height)
       KV_SERIALIZE_VAL_POD_AS_BLOB(top_id)
       KV_SERIALIZE(last_checkpoint_height)
       KV_SERIALIZE(client_version)
+      KV_SERIALIZE(features)
     END_KV_SERIALIZE_MAP()
   };
 
@@ -152,4 +159,93 @@ namespace currency
     };
   };
 
+  /************************************************************************/
+  /* Sent instead of NOTIFY_NEW_TRANSACTIONS to peers that announced      */
+  /* CURRENCY_PROTOCOL_FEATURE_TX_ANNOUNCE, blobs are requested with      */
+  /* NOTIFY_REQUEST_TXS and come back as NOTIFY_NEW_TRANSACTIONS          */
+  /************************************************************************/
+  struct NOTIFY_TX_ANNOUNCE
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 8;
+
+    struct request
+    {
+      std::list<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct NOTIFY_REQUEST_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 9;
+
+    struct request
+    {
+      std::list<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  /************************************************************************/
+  /* Sent instead of NOTIFY_NEW_BLOCK to peers that announced             */
+  /* CURRENCY_PROTOCOL_FEATURE_COMPACT_BLOCKS: the block blob has the     */
+  /* header, miner tx and tx hashes, the receiver takes the txs from its  */
+  /* pool and asks for the missing ones with NOTIFY_REQUEST_BLOCK_TXS     */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+
+    struct request
+    {
+      blobdata block;
+      uint64_t current_blockchain_height;
+      uint32_t hop;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block)
+        KV_SERIALIZE(current_blockchain_height)
+        KV_SERIALIZE(hop)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct NOTIFY_REQUEST_BLOCK_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request
+    {
+      crypto::hash block_id;
+      std::list<crypto::hash> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_id)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
+  struct NOTIFY_RESPONSE_BLOCK_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request
+    {
+      crypto::hash block_id;
+      std::list<blobdata> txs;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_id)
+        KV_SERIALIZE(txs)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
 }
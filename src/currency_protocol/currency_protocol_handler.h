@@ -5,11 +5,24 @@
 #pragma once
 
 #include <boost/program_options/variables_map.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/uuid/uuid.hpp>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "storages/levin_abstract_invoke2.h"
 #include "warnings.h"
 #include "currency_protocol_defs.h"
+#include "block_download_scheduler.h"
+#include "pending_compact_blocks.h"
+#include "tx_relay_tracker.h"
 #include "currency_protocol_handler_common.h"
+#include "currency_core/checkpoints.h"
 #include "currency_core/connection_context.h"
 #include "currency_core/currency_stat_info.h"
 #include "currency_core/verification_context.h"
@@ -38,9 +51,16 @@ namespace currency
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_GET_OBJECTS, &currency_protocol_handler::handle_response_get_objects)
       HANDLE_NOTIFY_T2(NOTIFY_REQUEST_CHAIN, &currency_protocol_handler::handle_request_chain)
       HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_CHAIN_ENTRY, &currency_protocol_handler::handle_response_chain_entry)
+      HANDLE_NOTIFY_T2(NOTIFY_TX_ANNOUNCE, &currency_protocol_handler::handle_notify_tx_announce)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_TXS, &currency_protocol_handler::handle_request_txs)
+      HANDLE_NOTIFY_T2(NOTIFY_NEW_COMPACT_BLOCK, &currency_protocol_handler::handle_notify_new_compact_block)
+      HANDLE_NOTIFY_T2(NOTIFY_REQUEST_BLOCK_TXS, &currency_protocol_handler::handle_request_block_txs)
+      HANDLE_NOTIFY_T2(NOTIFY_RESPONSE_BLOCK_TXS, &currency_protocol_handler::handle_response_block_txs)
     END_INVOKE_MAP2()
 
     bool on_idle();
+    //sends due tx announcements, called more often than on_idle
+    bool on_tx_relay_idle();
     
     static void init_options(boost::program_options::options_description& desc);
 
@@ -60,6 +80,7 @@ namespace currency
     uint64_t get_core_current_height();    
     uint64_t get_max_seen_height();
     void set_want_stop(){ m_want_stop = true; }
+    void get_sync_pipeline_stat(sync_pipeline_stat& st);
   private:
     //----------------- commands handlers ----------------------------------------------
     int handle_notify_new_block(int command, NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& context);
@@ -68,18 +89,48 @@ namespace currency
     int handle_response_get_objects(int command, NOTIFY_RESPONSE_GET_OBJECTS::request& arg, currency_connection_context& context);
     int handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, currency_connection_context& context);
     int handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, currency_connection_context& context);
+    int handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, currency_connection_context& context);
+    int handle_request_txs(int command, NOTIFY_REQUEST_TXS::request& arg, currency_connection_context& context);
+    int handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, currency_connection_context& context);
+    int handle_request_block_txs(int command, NOTIFY_REQUEST_BLOCK_TXS::request& arg, currency_connection_context& context);
+    int handle_response_block_txs(int command, NOTIFY_RESPONSE_BLOCK_TXS::request& arg, currency_connection_context& context);
 
 
     //----------------- i_bc_protocol_layout ---------------------------------------
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& exclude_context);
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, currency_connection_context& exclude_context);
+    virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::list<crypto::hash>& ids, currency_connection_context& exclude_context);
     //----------------------------------------------------------------------------------
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, currency_connection_context& context);
-    bool request_missing_objects(currency_connection_context& context, bool check_having_blocks);
+    bool request_missing_objects(currency_connection_context& context);
+    //short chain history led by the id the next chain entry should start from, to get whole block ids groups
+    bool get_chain_request_ids(std::list<crypto::hash>& ids);
+    //sync pipeline: network threads only queue received ranges, a pool of workers parses and prevalidates them
+    //and one applier thread adds them to the blockchain in height order
+    struct received_blocks_range
+    {
+      epee::net_utils::connection_context_base source;
+      uint64_t start_height;
+      std::vector<crypto::hash> ids;
+      std::list<block_complete_entry> blocks;
+    };
+    void start_sync_pipeline();
+    void stop_sync_pipeline();
+    void prevalidation_worker();
+    bool prevalidate_blocks(received_blocks_range& range, std::vector<prevalidated_block>& blocks);
+    void applier_worker();
+    bool apply_blocks(const std::list<prevalidated_block>& blocks, const epee::net_utils::connection_context_base& source);
     size_t get_synchronizing_connections_count();
     bool on_connection_synchronized();  
     bool do_force_handshake_idle_connections();
     bool check_stop_flag_and_exit(currency_connection_context& context);
+    //adds a block whose txs are in the pool already, is_compact is set for blocks rebuilt from NOTIFY_NEW_COMPACT_BLOCK
+    int process_new_block(NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& context, bool is_compact);
+    //returns false if the block is invalid, missed_txs are the ones neither in the pool nor in the blockchain
+    bool get_compact_block_missed_txs(const blobdata& block_blob, block& b, crypto::hash& id, std::list<crypto::hash>& missed_txs);
+    void get_relay_peers(uint64_t feature, const currency_connection_context& exclude_context, std::list<boost::uuids::uuid>& feature_peers,
+      std::list<boost::uuids::uuid>& other_peers);
+    static bool get_tx_id_from_blob(const blobdata& tx_blob, crypto::hash& id);
     t_core& m_core;
 
     nodetool::p2p_endpoint_stub<connection_context> m_p2p_stub;
@@ -91,7 +142,22 @@ namespace currency
     std::atomic<uint64_t> m_core_inital_height;
     std::atomic<uint64_t> m_core_current_height;
     std::atomic<bool> m_want_stop;
+    block_download_scheduler m_download_scheduler;
 
+    std::mutex m_sync_pipeline_lock;
+    std::condition_variable m_prevalidation_cv;
+    std::condition_variable m_applier_cv;
+    std::deque<received_blocks_range> m_prevalidation_queue;
+    std::list<boost::thread> m_prevalidation_threads;
+    boost::thread m_applier_thread;
+    size_t m_prevalidation_busy_workers;
+    bool m_applier_busy;
+    bool m_stop_sync_pipeline;
+    std::atomic<uint64_t> m_blocks_applied;
+
+    tx_relay_tracker m_tx_relay;
+
+    pending_compact_blocks m_pending_compact_blocks;
 
 
     template<class t_parametr>
@@ -103,6 +169,16 @@ namespace currency
         return m_p2p->invoke_notify_to_peer(t_parametr::ID, blob, context);
       }
 
+      //to a connection known by id only, the rest of the context is not needed to find it
+      template<class t_parametr>
+      bool post_notify(typename t_parametr::request& arg, const boost::uuids::uuid& connection_id)
+      {
+        LOG_PRINT_L2("[" << epee::string_tools::get_str_from_guid_a(connection_id) << "] post " << typeid(t_parametr).name() << " -->");
+        std::string blob;
+        epee::serialization::store_t_to_binary(arg, blob);
+        return m_p2p->invoke_notify_to_peer(t_parametr::ID, blob, epee::net_utils::connection_context_base(connection_id, 0, 0, false));
+      }
+
       template<class t_parametr>
       bool relay_post_notify(typename t_parametr::request& arg, currency_connection_context& exlude_context)
       {
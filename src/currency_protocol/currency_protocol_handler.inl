@@ -4,6 +4,7 @@
 
 #include <boost/interprocess/detail/atomic.hpp>
 #include "currency_core/currency_format_utils.h"
+#include "common/parallel_utils.h"
 #include "profile_tools.h"
 namespace currency
 {
@@ -21,7 +22,11 @@ namespace currency
                                                                                                               m_max_height_seen(0),
                                                                                                               m_core_inital_height(0),
                                                                                                               m_core_current_height(0),
-                                                                                                              m_want_stop(false)
+                                                                                                              m_want_stop(false),
+                                                                                                              m_prevalidation_busy_workers(0),
+                                                                                                              m_applier_busy(false),
+                                                                                                              m_stop_sync_pipeline(false),
+                                                                                                              m_blocks_applied(0)
 
   {
     if(!m_p2p)
@@ -39,6 +44,7 @@ namespace currency
   {
     if (command_line::has_arg(vm, arg_currency_protocol_explicit_set_online))
       m_been_synchronized = true;
+    start_sync_pipeline();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------  
@@ -46,7 +52,7 @@ namespace currency
   bool t_currency_protocol_handler<t_core>::deinit()
   {
     m_want_stop = true;
-
+    stop_sync_pipeline();
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------  
@@ -67,26 +73,7 @@ namespace currency
     --context.m_callback_request_count;
 
     if(context.m_state == currency_connection_context::state_synchronizing)
-    {
-      NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
-
-      bool have_called = false;
-      m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
-      {
-        m_core.get_short_chain_history(r.block_ids);
-        return true;
-      });
-      if (have_called)
-      {
-        LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size());
-        post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
-      }
-      else
-      {
-        LOG_PRINT_CCONTEXT_MAGENTA("[On_callback] Changed connection state to state_idle while core is in batch update", LOG_LEVEL_0);
-        context.m_state = currency_connection_context::state_idle;
-      }
-    }
+      request_missing_objects(context);
 
     return true;
   }
@@ -135,6 +122,7 @@ namespace currency
   bool t_currency_protocol_handler<t_core>::process_payload_sync_data(const CORE_SYNC_DATA& hshd, currency_connection_context& context, bool is_inital)
   {
     context.m_remote_version = hshd.client_version;
+    context.m_remote_features = hshd.features;
     context.m_remote_blockchain_height = hshd.current_height;
     LOG_PRINT_MAGENTA("[PROCESS_PAYLOAD_SYNC_DATA][m_been_synchronized=" << m_been_synchronized << "]: hshd.current_height = " << hshd.current_height << "(" << hshd.top_id << ")", LOG_LEVEL_3);
     if (context.m_state == currency_connection_context::state_befor_handshake && !is_inital)
@@ -242,6 +230,7 @@ namespace currency
   bool t_currency_protocol_handler<t_core>::get_payload_sync_data(CORE_SYNC_DATA& hshd)
   {
     hshd.client_version = PROJECT_VERSION_LONG;
+    hshd.features = CURRENCY_PROTOCOL_FEATURE_TX_ANNOUNCE | CURRENCY_PROTOCOL_FEATURE_COMPACT_BLOCKS | CURRENCY_PROTOCOL_FEATURE_BULK_BLOCK_IDS;
     bool have_called = false;
     
     m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
@@ -291,14 +280,28 @@ namespace currency
         return 1;
       }
     }
-    
 
+    return process_new_block(arg, context, false);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::process_new_block(NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& context, bool is_compact)
+  {
     block_verification_context bvc = boost::value_initialized<block_verification_context>();
     m_core.pause_mine();
     m_core.handle_incoming_block(arg.b.block, bvc);
     m_core.resume_mine();
     if(bvc.m_verifivation_failed)
     {
+      //txs of a compact block might have left the pool after they were looked up, the peer is not to blame then
+      block b = AUTO_VAL_INIT(b);
+      crypto::hash id = null_hash;
+      std::list<crypto::hash> missed_txs;
+      if (is_compact && get_compact_block_missed_txs(arg.b.block, b, id, missed_txs) && missed_txs.size())
+      {
+        LOG_PRINT_CCONTEXT_L1("Compact block " << id << " lost " << missed_txs.size() << " txs from the pool, left to synchronization");
+        return 1;
+      }
       LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
       m_p2p->drop_connection(context);
       return 1;
@@ -307,7 +310,6 @@ namespace currency
     {
       m_core_current_height = bvc.height;
       ++arg.hop;
-      //TODO: Add here announce protocol usage
       relay_block(arg, context);
     }else if(bvc.m_marked_as_orphaned)
     {
@@ -331,32 +333,270 @@ namespace currency
       return 1;
 
 
-    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end();)
+    std::vector<currency::tx_verification_context> tvcs;
+    m_core.handle_incoming_txs(arg.txs, tvcs, false);
+
+    //the sender has these txs, and they are not awaited from anyone else anymore; ids come from the verification, blobs are parsed once
+    std::list<crypto::hash> received_ids, relayed_ids;
+    size_t i = 0, timed_out_count = 0;
+    for(auto tx_blob_it = arg.txs.begin(); tx_blob_it!=arg.txs.end(); ++i)
     {
-      currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-      m_core.handle_incoming_tx(*tx_blob_it, tvc, false);
-      if(tvc.m_verifivation_failed)
+      if (tvcs[i].m_tx_hash != null_hash)
+        received_ids.push_back(tvcs[i].m_tx_hash);
+      if (tvcs[i].m_admission_timed_out)
+        ++timed_out_count;
+      if(tvcs[i].m_verifivation_failed)
       {
         LOG_PRINT_CCONTEXT_L0("Tx verification failed, dropping connection");
         m_p2p->drop_connection(context);
 
         return 1;
       }
-      if(tvc.m_should_be_relayed)
+      if(tvcs[i].m_should_be_relayed)
+      {
+        relayed_ids.push_back(tvcs[i].m_tx_hash);
         ++tx_blob_it;
+      }
       else
         arg.txs.erase(tx_blob_it++);
     }
+    m_tx_relay.on_txs_received(context.m_connection_id, received_ids, epee::misc_utils::get_tick_count());
+    if (timed_out_count)
+      LOG_PRINT_CCONTEXT_L0(timed_out_count << " of " << tvcs.size() << " txs dropped unverified, tx verification is overloaded");
 
     if(arg.txs.size())
     {
-      //TODO: add announce usage here
-      relay_transactions(arg, context);
+      relay_transactions(arg, relayed_ids, context);
     }
 
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::handle_notify_tx_announce(int command, NOTIFY_TX_ANNOUNCE::request& arg, currency_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_TX_ANNOUNCE: " << arg.txs.size() << " txs");
+
+    if (!m_synchronized || context.m_state != currency_connection_context::state_normal || context.m_remote_blockchain_height <= 1)
+      return 1;
+
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Announced txs count is to big (" << arg.txs.size() << ")expected not more then " << CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT << ", dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    std::list<crypto::hash> unknown_ids;
+    for (const auto& id : arg.txs)
+    {
+      if (!m_core.get_tx_pool().have_tx(id) && !m_core.get_blockchain_storage().have_tx(id))
+        unknown_ids.push_back(id);
+    }
+
+    //every tx is requested from one peer at a time, the others that announced it are asked in turn from on_tx_relay_idle if it doesn't come in time
+    NOTIFY_REQUEST_TXS::request req;
+    m_tx_relay.on_announce(context.m_connection_id, arg.txs, unknown_ids, epee::misc_utils::get_tick_count(), req.txs);
+
+    if (req.txs.size())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_TXS: txs.size()=" << req.txs.size());
+      post_notify<NOTIFY_REQUEST_TXS>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::handle_request_txs(int command, NOTIFY_REQUEST_TXS::request& arg, currency_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_TXS: " << arg.txs.size() << " txs");
+
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Requested txs count is to big (" << arg.txs.size() << ")expected not more then " << CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT << ", dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    //txs that left the pool since they were announced are just not sent
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    for (const auto& id : arg.txs)
+    {
+      transaction tx = AUTO_VAL_INIT(tx);
+      if (m_core.get_tx_pool().get_transaction(id, tx))
+        rsp.txs.push_back(t_serializable_object_to_blob(tx));
+    }
+
+    if (rsp.txs.size())
+    {
+      LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_NEW_TRANSACTIONS: txs.size()=" << rsp.txs.size());
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, currency_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_NEW_COMPACT_BLOCK (hop " << arg.hop << ")");
+    if (!m_synchronized || context.m_state != currency_connection_context::state_normal || context.m_remote_blockchain_height <= 1)
+      return 1;
+
+    block b = AUTO_VAL_INIT(b);
+    crypto::hash id = null_hash;
+    std::list<crypto::hash> missed_txs;
+    if (!get_compact_block_missed_txs(arg.block, b, id, missed_txs))
+    {
+      LOG_PRINT_CCONTEXT_L0("Compact block verification failed: failed to parse block, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+    if (m_core.have_block(id))
+      return 1;
+
+    if (missed_txs.empty())
+    {
+      NOTIFY_NEW_BLOCK::request full_arg = AUTO_VAL_INIT(full_arg);
+      full_arg.b.block = arg.block;
+      full_arg.current_blockchain_height = arg.current_blockchain_height;
+      full_arg.hop = arg.hop;
+      return process_new_block(full_arg, context, true);
+    }
+
+    if (missed_txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_PRINT_CCONTEXT_L1("Compact block " << id << " misses " << missed_txs.size() << " txs, left to synchronization");
+      return 1;
+    }
+
+    //missing txs are asked from one peer at a time, the others that announced the block are asked in turn if it doesn't answer in time
+    if (m_pending_compact_blocks.add_other_peer(id, context.m_connection_id))
+      return 1;
+
+    //the missing txs are taken as the block's ones, so the block has to be worth it
+    if (!m_core.get_blockchain_storage().check_new_block_header(b, id))
+    {
+      LOG_PRINT_CCONTEXT_L1("Compact block " << id << " header is not checked against the top, left to synchronization");
+      return 1;
+    }
+
+    if (!m_pending_compact_blocks.add(id, arg, missed_txs, context.m_connection_id, epee::misc_utils::get_tick_count()))
+      return 1;
+
+    NOTIFY_REQUEST_BLOCK_TXS::request req = AUTO_VAL_INIT(req);
+    req.block_id = id;
+    req.txs.swap(missed_txs);
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_BLOCK_TXS: block " << id << ", txs.size()=" << req.txs.size());
+    post_notify<NOTIFY_REQUEST_BLOCK_TXS>(req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::handle_request_block_txs(int command, NOTIFY_REQUEST_BLOCK_TXS::request& arg, currency_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_BLOCK_TXS: block " << arg.block_id << ", " << arg.txs.size() << " txs");
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Requested block txs count is to big (" << arg.txs.size() << ")expected not more then " << CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT << ", dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    //the block was relayed after it had been added, so its txs are mostly in the blockchain already
+    std::vector<crypto::hash> ids(arg.txs.begin(), arg.txs.end());
+    std::list<transaction> txs;
+    std::list<crypto::hash> missed_txs;
+    m_core.get_transactions(ids, txs, missed_txs);
+    for (const auto& id : missed_txs)
+    {
+      transaction tx = AUTO_VAL_INIT(tx);
+      if (m_core.get_tx_pool().get_transaction(id, tx))
+        txs.push_back(tx);
+    }
+
+    NOTIFY_RESPONSE_BLOCK_TXS::request rsp = AUTO_VAL_INIT(rsp);
+    rsp.block_id = arg.block_id;
+    for (const auto& tx : txs)
+      rsp.txs.push_back(t_serializable_object_to_blob(tx));
+    LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_RESPONSE_BLOCK_TXS: block " << arg.block_id << ", txs.size()=" << rsp.txs.size());
+    post_notify<NOTIFY_RESPONSE_BLOCK_TXS>(rsp, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_currency_protocol_handler<t_core>::handle_response_block_txs(int command, NOTIFY_RESPONSE_BLOCK_TXS::request& arg, currency_connection_context& context)
+  {
+    LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_BLOCK_TXS: block " << arg.block_id << ", " << arg.txs.size() << " txs");
+
+    if (arg.txs.size() > CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT)
+    {
+      LOG_ERROR_CCONTEXT("Block txs count is to big (" << arg.txs.size() << ")expected not more then " << CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT << ", dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    NOTIFY_NEW_COMPACT_BLOCK::request block_arg = AUTO_VAL_INIT(block_arg);
+    std::list<pending_compact_blocks::received_tx> txs;
+    bool has_invalid_blob = false;
+    if (!m_pending_compact_blocks.on_response(arg.block_id, context.m_connection_id, arg.txs, block_arg, txs, has_invalid_blob))
+    {
+      LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_BLOCK_TXS for block " << arg.block_id << " was not requested from this peer or came too late, ignored");
+      return 1;
+    }
+    if (has_invalid_blob)
+    {
+      LOG_PRINT_CCONTEXT_L0("Compact block verification failed: failed to parse transaction, dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
+    if (!m_synchronized || context.m_state != currency_connection_context::state_normal)
+      return 1;
+
+    //only the txs the block misses get here, and the block's header has been checked already
+    for (const auto& rtx : txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      m_core.handle_incoming_tx(rtx.tx, tvc, true, rtx.id);
+      if (tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L0("Compact block verification failed: transaction verification failed, dropping connection");
+        m_p2p->drop_connection(context);
+        return 1;
+      }
+    }
+
+    block b = AUTO_VAL_INIT(b);
+    crypto::hash id = null_hash;
+    std::list<crypto::hash> missed_txs;
+    get_compact_block_missed_txs(block_arg.block, b, id, missed_txs);
+    if (missed_txs.size())
+    {
+      LOG_PRINT_CCONTEXT_L1("Compact block " << id << " still misses " << missed_txs.size() << " txs, left to synchronization");
+      return 1;
+    }
+
+    NOTIFY_NEW_BLOCK::request full_arg = AUTO_VAL_INIT(full_arg);
+    full_arg.b.block = block_arg.block;
+    full_arg.current_blockchain_height = block_arg.current_blockchain_height;
+    full_arg.hop = block_arg.hop;
+    return process_new_block(full_arg, context, true);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::get_compact_block_missed_txs(const blobdata& block_blob, block& b, crypto::hash& id, std::list<crypto::hash>& missed_txs)
+  {
+    if (!parse_and_validate_block_from_blob(block_blob, b))
+      return false;
+    id = get_block_hash(b);
+    for (const auto& tx_id : b.tx_hashes)
+    {
+      if (!m_core.get_tx_pool().have_tx(tx_id) && !m_core.get_blockchain_storage().have_tx(tx_id))
+        missed_txs.push_back(tx_id);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   int t_currency_protocol_handler<t_core>::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, currency_connection_context& context)
   {
@@ -415,172 +655,309 @@ namespace currency
 
     context.m_remote_blockchain_height = arg.current_blockchain_height;
 
-    PROF_L2_DO(uint64_t syncing_conn_count_sum = get_synchronizing_connections_count(); uint64_t syncing_conn_count_count = 1);
+    if (arg.blocks.size() != context.m_requested_objects.size())
+    {
+      LOG_PRINT_CCONTEXT_RED("returned " << arg.blocks.size() << " blocks while " << context.m_requested_objects.size() << " were requested, dropping connection", LOG_LEVEL_0);
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+    context.m_requested_objects.clear();
+    CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
 
-    bool have_called = false;
-    int res = m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<int>(have_called, [&]()
+    //blocks are parsed and checked against the requested range by the prevalidation workers, the network thread only queues them
+    received_blocks_range range = AUTO_VAL_INIT(range);
+    range.source = context;
+    if (!m_download_scheduler.on_range_received(context, arg.blocks.size(), epee::misc_utils::get_tick_count(), range.start_height, range.ids))
     {
-      PROF_L1_START(block_complete_entries_prevalidation_time);
-      size_t count = 0;
-      for (const block_complete_entry& block_entry : arg.blocks)
+      LOG_PRINT_CCONTEXT_L2("blocks range is not needed anymore, skipped");
+    }
+    else
+    {
+      range.blocks.swap(arg.blocks);
+      std::lock_guard<std::mutex> lk(m_sync_pipeline_lock);
+      m_prevalidation_queue.push_back(std::move(range));
+      m_prevalidation_cv.notify_one();
+    }
+
+    //the peer goes on with the next range while the blocks are being prevalidated and applied
+    request_missing_objects(context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::start_sync_pipeline()
+  {
+    std::lock_guard<std::mutex> lk(m_sync_pipeline_lock);
+    m_stop_sync_pipeline = false;
+    size_t workers_count = tools::get_default_worker_threads_count();
+    for (size_t i = 0; i != workers_count; ++i)
+      m_prevalidation_threads.push_back(boost::thread(boost::bind(&t_currency_protocol_handler<t_core>::prevalidation_worker, this)));
+    m_applier_thread = boost::thread(boost::bind(&t_currency_protocol_handler<t_core>::applier_worker, this));
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::stop_sync_pipeline()
+  {
+    {
+      std::lock_guard<std::mutex> lk(m_sync_pipeline_lock);
+      m_stop_sync_pipeline = true;
+      m_prevalidation_queue.clear();
+    }
+    m_prevalidation_cv.notify_all();
+    m_applier_cv.notify_all();
+    for (auto& th : m_prevalidation_threads)
+      th.join();
+    m_prevalidation_threads.clear();
+    if (m_applier_thread.joinable())
+      m_applier_thread.join();
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::prevalidation_worker()
+  {
+    while (true)
+    {
+      received_blocks_range range = AUTO_VAL_INIT(range);
       {
-        CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
+        std::unique_lock<std::mutex> lk(m_sync_pipeline_lock);
+        m_prevalidation_cv.wait(lk, [&](){ return m_stop_sync_pipeline || m_prevalidation_queue.size(); });
+        if (m_stop_sync_pipeline)
+          return;
+        range = std::move(m_prevalidation_queue.front());
+        m_prevalidation_queue.pop_front();
+        ++m_prevalidation_busy_workers;
+      }
 
-        ++count;
-        block b;
-        if (!parse_and_validate_block_from_blob(block_entry.block, b))
-        {
-          LOG_ERROR_CCONTEXT("sent wrong block: failed to parse and validate block: \r\n"
-            << string_tools::buff_to_hex_nodelimer(block_entry.block) << "\r\n dropping connection");
-          m_p2p->drop_connection(context);
-          m_p2p->add_ip_fail(context.m_remote_ip);
-          return 1;
-        }
-        //to avoid concurrency in core between connections, suspend connections which delivered block later then first one
-        if (count == 2)
-        {
-          if (m_core.have_block(get_block_hash(b)))
-          {
-            LOG_PRINT_MAGENTA("[RESPONSE_GET_OBJECTS]: m_state set state_idle", LOG_LEVEL_3);
-            context.m_state = currency_connection_context::state_idle;
-            context.m_needed_objects.clear();
-            context.m_requested_objects.clear();
-            LOG_PRINT_CCONTEXT_L1("Connection set to idle state.");
-            return 1;
-          }
-        }
+      std::vector<prevalidated_block> blocks;
+      if (prevalidate_blocks(range, blocks))
+      {
+        m_download_scheduler.on_range_prevalidated(range.start_height, blocks, range.source);
+      }
+      else if (!m_want_stop)
+      {
+        //the range is downloaded from another peer then
+        m_download_scheduler.on_range_rejected(range.start_height);
+        m_p2p->drop_connection(range.source);
+        m_p2p->add_ip_fail(range.source.m_remote_ip);
+      }
 
-        auto req_it = context.m_requested_objects.find(get_block_hash(b));
-        if (req_it == context.m_requested_objects.end())
+      {
+        std::lock_guard<std::mutex> lk(m_sync_pipeline_lock);
+        --m_prevalidation_busy_workers;
+      }
+      m_applier_cv.notify_one();
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::prevalidate_blocks(received_blocks_range& range, std::vector<prevalidated_block>& blocks)
+  {
+    //only the checks that don't need the blockchain are done here, the rest is up to the core when the blocks are applied
+    PROF_L1_START(prevalidation_time);
+    std::unordered_map<crypto::hash, prevalidated_block> parsed;
+    for (const block_complete_entry& block_entry : range.blocks)
+    {
+      if (m_want_stop)
+        return false;
+
+      prevalidated_block pb = AUTO_VAL_INIT(pb);
+      if (block_entry.block.size() > get_max_block_size() || !parse_and_validate_block_from_blob(block_entry.block, pb.b))
+      {
+        LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong block: failed to parse and validate block: \r\n"
+          << string_tools::buff_to_hex_nodelimer(block_entry.block) << "\r\n dropping connection");
+        return false;
+      }
+      pb.id = get_block_hash(pb.b);
+      if (pb.b.tx_hashes.size() != block_entry.txs.size())
+      {
+        LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << string_tools::pod_to_hex(pb.id)
+          << ", tx_hashes.size()=" << pb.b.tx_hashes.size() << " mismatch with block_complete_entry.m_txs.size()=" << block_entry.txs.size() << ", dropping connection");
+        return false;
+      }
+
+      for (const blobdata& tx_blob : block_entry.txs)
+      {
+        transaction tx = AUTO_VAL_INIT(tx);
+        crypto::hash tx_id = null_hash;
+        crypto::hash tx_prefix_hash = null_hash;
+        const crypto::hash& expected_id = pb.b.tx_hashes[pb.txs.size()];
+        if (tx_blob.size() > get_max_tx_size() || !parse_and_validate_tx_from_blob(tx_blob, tx, tx_id, tx_prefix_hash) || tx_id != expected_id)
         {
-          LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << string_tools::pod_to_hex(get_blob_hash(block_entry.block))
-            << " wasn't requested, dropping connection");
-          m_p2p->drop_connection(context);
-          return 1;
+          LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong NOTIFY_RESPONSE_GET_OBJECTS: tx " << string_tools::pod_to_hex(expected_id)
+            << " of block " << string_tools::pod_to_hex(pb.id) << " failed to parse or has another id, dropping connection");
+          return false;
         }
-        if (b.tx_hashes.size() != block_entry.txs.size())
+        if (!check_inputs_types_supported(tx) || !check_outs_valid(tx) || !check_money_overflow(tx))
         {
-          LOG_ERROR_CCONTEXT("sent wrong NOTIFY_RESPONSE_GET_OBJECTS: block with id=" << string_tools::pod_to_hex(get_blob_hash(block_entry.block))
-            << ", tx_hashes.size()=" << b.tx_hashes.size() << " mismatch with block_complete_entry.m_txs.size()=" << block_entry.txs.size() << ", dropping connection");
-          m_p2p->drop_connection(context);
-          return 1;
+          LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong NOTIFY_RESPONSE_GET_OBJECTS: tx " << string_tools::pod_to_hex(tx_id)
+            << " of block " << string_tools::pod_to_hex(pb.id) << " has unsupported inputs or invalid outputs, dropping connection");
+          return false;
         }
-
-        context.m_requested_objects.erase(req_it);
+        pb.txs.push_back(std::move(tx));
+        pb.tx_ids.push_back(tx_id);
       }
-      PROF_L1_FINISH(block_complete_entries_prevalidation_time);
-
-      PROF_L2_DO(syncing_conn_count_sum += get_synchronizing_connections_count(); ++syncing_conn_count_count);
+      crypto::hash id = pb.id;
+      parsed[id] = std::move(pb);
+    }
 
-      if (context.m_requested_objects.size())
+    for (const crypto::hash& id : range.ids)
+    {
+      auto it = parsed.find(id);
+      if (it == parsed.end())
       {
-        LOG_PRINT_CCONTEXT_RED("returned not all requested objects (context.m_requested_objects.size()="
-          << context.m_requested_objects.size() << "), dropping connection", LOG_LEVEL_0);
-        m_p2p->drop_connection(context);
-        return 1;
+        LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong NOTIFY_RESPONSE_GET_OBJECTS: requested block with id=" << string_tools::pod_to_hex(id)
+          << " is missing, dropping connection");
+        return false;
       }
-
-      PROF_L1_START(blocks_handle_time);
+      blocks.push_back(std::move(it->second));
+    }
+    if (parsed.size() != range.ids.size())
+    {
+      LOG_ERROR("[" << net_utils::print_connection_context_short(range.source) << "] sent wrong NOTIFY_RESPONSE_GET_OBJECTS: " << parsed.size() - range.ids.size()
+        << " blocks weren't requested, dropping connection");
+      return false;
+    }
+    PROF_L1_FINISH(prevalidation_time);
+    LOG_PRINT_L2("[" << net_utils::print_connection_context_short(range.source) << "] " << blocks.size() << " blocks prevalidated in " << print_mcsec_as_ms(prevalidation_time) << " ms");
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::applier_worker()
+  {
+    //the only thread that applies downloaded ranges, whichever connections they came from
+    while (true)
+    {
       {
-        m_core.pause_mine();
-        m_core.get_tx_pool().lock();
-        m_core.get_blockchain_storage().start_batch_exclusive_operation();
-        bool success = false;
-        misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler([&, this](){
-          boost::bind(&t_core::resume_mine, &m_core);
-          m_core.get_blockchain_storage().finish_batch_exclusive_operation(success);
-          m_core.get_tx_pool().unlock();
-        });
+        std::unique_lock<std::mutex> lk(m_sync_pipeline_lock);
+        m_applier_cv.wait(lk, [&](){ return m_stop_sync_pipeline || (!m_want_stop && m_download_scheduler.has_ready_range()); });
+        if (m_stop_sync_pipeline)
+          return;
+        m_applier_busy = true;
+      }
 
-        BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
+      bool have_called = false;
+      m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
+      {
+        uint64_t start_height = 0;
+        std::list<prevalidated_block> blocks;
+        epee::net_utils::connection_context_base source;
+        while (!m_p2p->is_stop_signal_sent() && !m_want_stop && m_download_scheduler.pop_ready_range(start_height, blocks, source))
         {
-          CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
-          //process transactions
-          PROF_L1_START(transactions_process_time);
-          BOOST_FOREACH(auto& tx_blob, block_entry.txs)
+          if (!apply_blocks(blocks, source))
           {
-            //CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
-            if (check_stop_flag_and_exit(context)) 
-            {             
-              LOG_PRINT_YELLOW("Stop flag detected within NOTIFY_RESPONSE_GET_OBJECTS. ", LOG_LEVEL_0);
-              //commit transaction
-              success = true;
-              return 1; 
-            }
-            tx_verification_context tvc = AUTO_VAL_INIT(tvc);
-            m_core.handle_incoming_tx(tx_blob, tvc, true);
-            if (tvc.m_verifivation_failed)
-            {
-              LOG_ERROR_CCONTEXT("transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
-                << string_tools::pod_to_hex(get_blob_hash(tx_blob)) << ", dropping connection");
-              m_p2p->drop_connection(context);
-              return 1;
-            }
+            //what is downloaded after an invalid block can't be trusted, the chain is learned anew
+            m_download_scheduler.reset();
+            return false;
           }
-          PROF_L1_FINISH(transactions_process_time);
-
-          //process block
-          PROF_L1_START(block_process_time);
-          block_verification_context bvc = boost::value_initialized<block_verification_context>();
+          m_blocks_applied += blocks.size();
+          blocks.clear();
+        }
+        return true;
+      });
 
-          m_core.handle_incoming_block(block_entry.block, bvc, false);
+      std::unique_lock<std::mutex> lk(m_sync_pipeline_lock);
+      m_applier_busy = false;
+      if (!have_called)
+        m_applier_cv.wait_for(lk, std::chrono::milliseconds(CURRENCY_PROTOCOL_SYNC_APPLY_RETRY_MS), [&](){ return m_stop_sync_pipeline; });
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::apply_blocks(const std::list<prevalidated_block>& blocks, const epee::net_utils::connection_context_base& source)
+  {
+    PROF_L1_START(blocks_handle_time);
+    {
+      m_core.pause_mine();
+      m_core.get_tx_pool().lock();
+      m_core.get_blockchain_storage().start_batch_exclusive_operation();
+      bool success = false;
+      misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler([&, this](){
+        boost::bind(&t_core::resume_mine, &m_core);
+        m_core.get_blockchain_storage().finish_batch_exclusive_operation(success);
+        m_core.get_tx_pool().unlock();
+      });
 
-          if (bvc.m_verifivation_failed)
+      BOOST_FOREACH(const prevalidated_block& pb, blocks)
+      {
+        //process transactions, they are parsed already
+        PROF_L1_START(transactions_process_time);
+        for (size_t i = 0; i != pb.txs.size(); ++i)
+        {
+          if (m_p2p->is_stop_signal_sent() || m_want_stop)
           {
-            LOG_PRINT_CCONTEXT_L0("Block verification failed, dropping connection");
-            m_p2p->drop_connection(context);
-            m_p2p->add_ip_fail(context.m_remote_ip);
-            return 1;
+            LOG_PRINT_YELLOW("Stop flag detected while applying downloaded blocks. ", LOG_LEVEL_0);
+            //commit transaction
+            success = true;
+            return false;
           }
-          if (bvc.m_marked_as_orphaned)
+          tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+          m_core.handle_incoming_tx(pb.txs[i], tvc, true, pb.tx_ids[i]);
+          if (tvc.m_verifivation_failed)
           {
-            LOG_PRINT_CCONTEXT_L0("Block received at sync phase was marked as orphaned, dropping connection");
-            m_p2p->drop_connection(context);
-            m_p2p->add_ip_fail(context.m_remote_ip);
-            return 1;
+            LOG_ERROR("[" << net_utils::print_connection_context_short(source) << "] transaction verification failed on NOTIFY_RESPONSE_GET_OBJECTS, \r\ntx_id = "
+              << string_tools::pod_to_hex(pb.tx_ids[i]) << ", dropping connection");
+            m_p2p->drop_connection(source);
+            return false;
           }
-          m_core_current_height = bvc.height;
-          PROF_L1_FINISH(block_process_time);
-          PROF_L1_DO(LOG_PRINT_CCONTEXT_L2("Block process time: " << print_mcsec_as_ms(block_process_time + transactions_process_time) << "(" << print_mcsec_as_ms(transactions_process_time) << "/" << print_mcsec_as_ms(block_process_time) << ") ms"));
-
-          PROF_L2_DO(syncing_conn_count_sum += get_synchronizing_connections_count(); ++syncing_conn_count_count);
         }
-        success = true;
-      }
-      PROF_L1_FINISH(blocks_handle_time);
-
-      uint64_t current_height = m_core.get_current_blockchain_height();
-      LOG_PRINT_CCONTEXT_YELLOW(">>>>>>>>> sync progress: " << arg.blocks.size() << " blocks added"
-        "(" << print_mcsec_as_ms(blocks_handle_time) << "+" << print_mcsec_as_ms(block_complete_entries_prevalidation_time) << "), now have "
-        << current_height << " of " << context.m_remote_blockchain_height
-        << " ( " << std::fixed << std::setprecision(2) << current_height * 100.0 / context.m_remote_blockchain_height << "% ) and "
-        << context.m_remote_blockchain_height - current_height << " blocks left"
-        , LOG_LEVEL_0);
-
-        PROF_L2_DO(syncing_conn_count_sum += get_synchronizing_connections_count(); ++syncing_conn_count_count);
-     
+        PROF_L1_FINISH(transactions_process_time);
 
+        //process block
+        PROF_L1_START(block_process_time);
+        block_verification_context bvc = boost::value_initialized<block_verification_context>();
 
-#if PROFILING_LEVEL >= 2
-      double syncing_conn_count_av = syncing_conn_count_sum / static_cast<double>(syncing_conn_count_count);
-      size_t blocks_count = arg.blocks.size();
-      LOG_PRINT_CCONTEXT_YELLOW("NOTIFY_RESPONSE_GET_OBJECTS: " << blocks_count << " blocks were prevalidated in " << block_complete_entries_prevalidation_time / 1000
-        << " ms (" << std::fixed << std::setprecision(2) << block_complete_entries_prevalidation_time / 1000.0f / blocks_count << " ms per block av) and handled in " << blocks_handle_time / 1000
-        << " ms (" << std::fixed << std::setprecision(2) << blocks_handle_time / 1000.0f / blocks_count << " ms per block av)"
-        << " syncing conns av: " << std::fixed << std::setprecision(2) << syncing_conn_count_av, LOG_LEVEL_1);
-#endif
+        m_core.handle_incoming_block(pb.b, bvc, false);
 
-      request_missing_objects(context, true);
-      return 1;
-    });
-
-    if (!have_called)
-    {
-      context.m_state = currency_connection_context::state_idle;
-      LOG_PRINT_CCONTEXT_MAGENTA("[HANDLE_RESPONSE_GET_OBJECTS]: Core blocked response, m_state set state_idle", LOG_LEVEL_0);
+        if (bvc.m_verifivation_failed)
+        {
+          LOG_PRINT_L0("[" << net_utils::print_connection_context_short(source) << "] Block verification failed, dropping connection");
+          m_p2p->drop_connection(source);
+          m_p2p->add_ip_fail(source.m_remote_ip);
+          return false;
+        }
+        if (bvc.m_marked_as_orphaned)
+        {
+          LOG_PRINT_L0("[" << net_utils::print_connection_context_short(source) << "] Block received at sync phase was marked as orphaned, dropping connection");
+          m_p2p->drop_connection(source);
+          m_p2p->add_ip_fail(source.m_remote_ip);
+          return false;
+        }
+        m_core_current_height = bvc.height;
+        PROF_L1_FINISH(block_process_time);
+        PROF_L1_DO(LOG_PRINT_L2("[" << net_utils::print_connection_context_short(source) << "] Block process time: " << print_mcsec_as_ms(block_process_time + transactions_process_time) << "(" << print_mcsec_as_ms(transactions_process_time) << "/" << print_mcsec_as_ms(block_process_time) << ") ms"));
+      }
+      success = true;
     }
-      
-    return res;
+    PROF_L1_FINISH(blocks_handle_time);
+
+    uint64_t current_height = m_core.get_current_blockchain_height();
+    uint64_t target_height = std::max<uint64_t>(m_download_scheduler.get_target_height(), current_height);
+    sync_pipeline_stat st = AUTO_VAL_INIT(st);
+    get_sync_pipeline_stat(st);
+    LOG_PRINT_YELLOW(">>>>>>>>> sync progress: " << blocks.size() << " blocks added (" << print_mcsec_as_ms(blocks_handle_time) << "), now have "
+      << current_height << " of " << target_height
+      << " ( " << std::fixed << std::setprecision(2) << current_height * 100.0 / target_height << "% ) and "
+      << target_height - current_height << " blocks left, ranges: " << st.ranges_downloading << " downloading, " << st.prevalidation_queue_size + st.prevalidation_busy_workers
+      << " prevalidating, " << st.ranges_ready << " ready, " << st.ranges_pending << " pending"
+      , LOG_LEVEL_0);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::get_sync_pipeline_stat(sync_pipeline_stat& st)
+  {
+    size_t pending = 0, downloading = 0, ready = 0;
+    m_download_scheduler.get_ranges_stat(pending, downloading, ready);
+    st.ranges_pending = pending;
+    st.ranges_downloading = downloading;
+    st.ranges_ready = ready;
+    st.blocks_applied = m_blocks_applied;
+    std::lock_guard<std::mutex> lk(m_sync_pipeline_lock);
+    st.prevalidation_queue_size = m_prevalidation_queue.size();
+    st.prevalidation_busy_workers = m_prevalidation_busy_workers;
+    st.prevalidation_workers = m_prevalidation_threads.size();
+    st.applier_busy = m_applier_busy ? 1 : 0;
   }
 #undef CHECK_STOP_FLAG__DROP_AND_RETURN_IF_SET
   //------------------------------------------------------------------------------------------------------------------------
@@ -590,15 +967,34 @@ namespace currency
 
     size_t count_synced = 0;
     size_t count_total = 0;
+    std::set<boost::uuids::uuid> connections, waiting_peers;
+    std::list<epee::net_utils::connection_context_base> peers_to_wake, stalled_peers;
+    m_download_scheduler.get_waiting_peers(waiting_peers);
     m_p2p->for_each_connection([&](currency_connection_context& context, nodetool::peerid_type peer_id)->bool{
       if (context.m_state == currency_connection_context::state_normal && context.m_remote_blockchain_height > 1)
       {
         ++count_synced;
       }
       ++count_total;
+      connections.insert(context.m_connection_id);
+      if (context.m_state == currency_connection_context::state_synchronizing && waiting_peers.count(context.m_connection_id))
+      {
+        ++context.m_callback_request_count;
+        peers_to_wake.push_back(context);
+      }
       return true;
     });
 
+    //peers waiting for blocks to download get another try from their own threads
+    for (const auto& c : peers_to_wake)
+      m_p2p->request_callback(c);
+    m_download_scheduler.on_idle(connections, epee::misc_utils::get_tick_count(), stalled_peers);
+    for (const auto& c : stalled_peers)
+    {
+      LOG_PRINT_L0("[" << net_utils::print_connection_context_short(c) << "] didn't deliver requested blocks in time, dropping connection");
+      m_p2p->drop_connection(c);
+    }
+
     if (count_total && count_synced  && count_synced > count_total / 2 && !m_synchronized)
     {
       on_connection_synchronized();
@@ -612,10 +1008,58 @@ namespace currency
       m_synchronized = false;
     }
 
+    {
+      std::set<boost::uuids::uuid> connections;
+      m_p2p->for_each_connection([&](currency_connection_context& context, nodetool::peerid_type peer_id)->bool{
+        connections.insert(context.m_connection_id);
+        return true;
+      });
+      std::list<pending_compact_blocks::block_txs_request> requests;
+      m_pending_compact_blocks.on_idle(connections, epee::misc_utils::get_tick_count(), requests);
+      for (auto& r : requests)
+        post_notify<NOTIFY_REQUEST_BLOCK_TXS>(r.req, r.peer);
+    }
+
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_currency_protocol_handler<t_core>::on_tx_relay_idle()
+  {
+    std::set<boost::uuids::uuid> connections;
+    m_p2p->for_each_connection([&](currency_connection_context& context, nodetool::peerid_type peer_id)->bool{
+      connections.insert(context.m_connection_id);
+      return true;
+    });
+
+    tx_relay_tracker::peer_txs_list announces, requests;
+    m_tx_relay.on_idle(connections, epee::misc_utils::get_tick_count(), announces, requests);
+
+    for (auto& a : announces)
+    {
+      NOTIFY_TX_ANNOUNCE::request req;
+      req.txs.swap(a.second);
+      post_notify<NOTIFY_TX_ANNOUNCE>(req, a.first);
+    }
+    //txs the asked peers didn't send in time
+    for (auto& r : requests)
+    {
+      NOTIFY_REQUEST_TXS::request req;
+      req.txs.swap(r.second);
+      post_notify<NOTIFY_REQUEST_TXS>(req, r.first);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::get_tx_id_from_blob(const blobdata& tx_blob, crypto::hash& id)
+  {
+    transaction tx = AUTO_VAL_INIT(tx);
+    crypto::hash prefix_hash = null_hash;
+    return parse_and_validate_tx_from_blob(tx_blob, tx, id, prefix_hash);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_currency_protocol_handler<t_core>::handle_request_chain(int command, NOTIFY_REQUEST_CHAIN::request& arg, currency_connection_context& context)
   {
     LOG_PRINT_CCONTEXT_L2("NOTIFY_REQUEST_CHAIN: m_been_synchronized = " << m_been_synchronized  << "m_block_ids.size()=" << arg.block_ids.size());
@@ -635,7 +1079,8 @@ namespace currency
     bool have_called = false;
     int res = m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
     {
-      if (!m_core.find_blockchain_supplement(arg.block_ids, r))
+      size_t max_count = context.m_remote_features & CURRENCY_PROTOCOL_FEATURE_BULK_BLOCK_IDS ? BLOCKS_IDS_SYNCHRONIZING_BULK_COUNT : BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT;
+      if (!m_core.find_blockchain_supplement(arg.block_ids, r, max_count))
       {
         LOG_ERROR_CCONTEXT("Internal error: failed to handle NOTIFY_REQUEST_CHAIN.");
         return 1;
@@ -658,62 +1103,73 @@ namespace currency
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
-  bool t_currency_protocol_handler<t_core>::request_missing_objects(currency_connection_context& context, bool check_having_blocks)
+  bool t_currency_protocol_handler<t_core>::request_missing_objects(currency_connection_context& context)
   {
-    if(context.m_needed_objects.size())
+    std::list<crypto::hash> ids;
+    uint64_t now = epee::misc_utils::get_tick_count();
+    bool fetch_ids_ahead = m_download_scheduler.need_ids_ahead(context, now);
+    if (!fetch_ids_ahead && m_download_scheduler.get_range(context, now, ids))
     {
-      //we know objects that we need, request this objects
+      //the scheduler knows which blocks we need, request the range it gave to this peer
       NOTIFY_REQUEST_GET_OBJECTS::request req;
-      size_t count = 0;
-      auto it = context.m_needed_objects.begin();
-
-      while(it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
-      {
-        if( !(check_having_blocks && m_core.have_block(*it)))
-        {
-          req.blocks.push_back(*it);
-          ++count;
-          context.m_requested_objects.insert(*it);
-        }
-        context.m_needed_objects.erase(it++);
-      }
+      req.blocks = ids;
+      context.m_requested_objects.insert(ids.begin(), ids.end());
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size());
       post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);    
-    }else if(context.m_last_response_height < context.m_remote_blockchain_height-1)
+    }else if(fetch_ids_ahead || m_download_scheduler.need_more_ids(context))
     {//we have to fetch more objects ids, request blockchain entry
      
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       bool have_called = false;
       m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
       {
-        return m_core.get_short_chain_history(r.block_ids);
+        return get_chain_request_ids(r.block_ids);
       });
       if (!have_called)
       {
-        LOG_PRINT_CCONTEXT_MAGENTA("[REQUEST_MISSING_OBJECTS] core request blocked, m_state set state_idle", LOG_LEVEL_0);
-        context.m_state = currency_connection_context::state_idle;
+        //blocks are being applied, asked again on idle
+        LOG_PRINT_CCONTEXT_L2("[REQUEST_MISSING_OBJECTS] core request blocked, waiting");
+        m_download_scheduler.set_peer_waiting(context);
       }
       else
       {
         LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size());
         post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
       }
-    }else
+    }else if(m_download_scheduler.is_peer_synchronized(context))
     { 
-      CHECK_AND_ASSERT_MES(context.m_last_response_height == context.m_remote_blockchain_height-1 
-                           && !context.m_needed_objects.size() 
-                           && !context.m_requested_objects.size(), false, "request_missing_blocks final condition failed!" 
-                           << "\r\nm_last_response_height=" << context.m_last_response_height
-                           << "\r\nm_remote_blockchain_height=" << context.m_remote_blockchain_height
-                           << "\r\nm_needed_objects.size()=" << context.m_needed_objects.size()
-                           << "\r\nm_requested_objects.size()=" << context.m_requested_objects.size()
-                           << "\r\non connection [" << net_utils::print_connection_context_short(context)<< "]");
-      
       LOG_PRINT_CCONTEXT_MAGENTA("[REQUEST_MISSING_OBJECTS] m_state set state_normal", LOG_LEVEL_0);
       context.m_state = currency_connection_context::state_normal;
       LOG_PRINT_CCONTEXT_GREEN(" SYNCHRONIZED OK", LOG_LEVEL_0);
       do_force_handshake_idle_connections();
+    }else
+    {
+      //all the peer has is being downloaded by others, it gets a range when one frees up
+      LOG_PRINT_CCONTEXT_L2("[REQUEST_MISSING_OBJECTS] nothing to request, waiting");
+      m_download_scheduler.set_peer_waiting(context);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::get_chain_request_ids(std::list<crypto::hash>& ids)
+  {
+    if (!m_core.get_short_chain_history(ids))
+      return false;
+
+    //the peer answers from the first id it knows, the ids being downloaded are continued rather than asked for again
+    crypto::hash last_id = null_hash;
+    if (m_download_scheduler.get_last_id(last_id))
+    {
+      ids.push_front(last_id);
+      return true;
     }
+
+    //below the block ids hashes height the entry starts from the last block of a group, so that the groups after it are whole
+    uint64_t height = m_core.get_current_blockchain_height();
+    uint64_t group_start = height - height % CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE;
+    if (group_start && height < m_core.get_blockchain_storage().get_checkpoints().get_block_ids_hashes_height())
+      ids.push_front(m_core.get_block_id_by_height(group_start - 1));
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -783,15 +1239,15 @@ namespace currency
     }
 
     bool have_called = false;
-    m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
+    bool r = m_core.get_blockchain_storage().template call_if_no_batch_exclusive_operation<bool>(have_called, [&]()
     {
-      if (!m_core.have_block(arg.m_block_ids.front()))
+      if (!m_core.have_block(arg.m_block_ids.front()) && !m_download_scheduler.has_block_id(arg.m_block_ids.front()))
       {
         LOG_ERROR_CCONTEXT("sent m_block_ids starting from unknown id: "
           << string_tools::pod_to_hex(arg.m_block_ids.front()) << " , dropping connection");
         m_p2p->drop_connection(context);
         m_p2p->add_ip_fail(context.m_remote_ip);
-        return 1;
+        return false;
       }
 
       context.m_remote_blockchain_height = arg.total_height;
@@ -802,21 +1258,64 @@ namespace currency
           << "\r\nm_start_height=" << arg.start_height
           << "\r\nm_block_ids.size()=" << arg.m_block_ids.size());
         m_p2p->drop_connection(context);
+        return false;
+      }
+
+      //ids below the block ids hashes height are taken in whole groups that match the hashes, the rest comes with the next entry
+      std::vector<crypto::hash> entry_ids(arg.m_block_ids.begin(), arg.m_block_ids.end());
+      const checkpoints& cp = m_core.get_blockchain_storage().get_checkpoints();
+      uint64_t hashes_height = cp.get_block_ids_hashes_height();
+      size_t checked_count = 0;
+      if (!cp.check_block_ids(arg.start_height, entry_ids, checked_count))
+      {
+        LOG_ERROR_CCONTEXT("sent m_block_ids that don't match block ids hashes, dropping connection");
+        m_p2p->drop_connection(context);
+        m_p2p->add_ip_fail(context.m_remote_ip);
+        return false;
+      }
+      if (arg.start_height < hashes_height && arg.start_height + checked_count < hashes_height && context.m_last_response_height + 1 < arg.total_height)
+      {
+        if (!checked_count)
+        {
+          LOG_PRINT_CCONTEXT_MAGENTA("[HANDLE_RESPONSE_CHAIN_ENTRY]: no whole block ids group to check, m_state set to state_idle", LOG_LEVEL_0);
+          context.m_state = currency_connection_context::state_idle;
+          return false;
+        }
+        entry_ids.resize(checked_count);
       }
+      m_download_scheduler.set_verified_ids_height(hashes_height);
 
-      for(auto& bl_id: arg.m_block_ids)
+      //the ids from the first unknown one on are handed to the download scheduler
+      uint64_t start_height = arg.start_height;
+      std::vector<crypto::hash> ids;
+      for(auto& bl_id: entry_ids)
       {
         if (check_stop_flag_and_exit(context))
-          return 1;
-        if (!m_core.have_block(bl_id))
-          context.m_needed_objects.push_back(bl_id);
+          return false;
+        if (ids.empty() && m_core.have_block(bl_id))
+          ++start_height;
+        else
+          ids.push_back(bl_id);
       }
 
-      request_missing_objects(context, false);
-      return 1;
+      if (!m_download_scheduler.add_chain(context, start_height, ids, arg.total_height))
+      {
+        LOG_PRINT_CCONTEXT_MAGENTA("[HANDLE_RESPONSE_CHAIN_ENTRY]: chain differs from the one being downloaded, m_state set to state_idle", LOG_LEVEL_0);
+        context.m_state = currency_connection_context::state_idle;
+        return false;
+      }
+      return true;
     });
 
+    if (!have_called)
+    {
+      LOG_PRINT_CCONTEXT_L2("[HANDLE_RESPONSE_CHAIN_ENTRY]: core request blocked, waiting");
+      m_download_scheduler.set_peer_waiting(context);
+      return 1;
+    }
 
+    if (r)
+      request_missing_objects(context);
 
     return 1;
   }
@@ -824,12 +1323,88 @@ namespace currency
   template<class t_core> 
   bool t_currency_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_BLOCK>(arg, exclude_context);
+    std::list<boost::uuids::uuid> compact_peers, legacy_peers;
+    get_relay_peers(CURRENCY_PROTOCOL_FEATURE_COMPACT_BLOCKS, exclude_context, compact_peers, legacy_peers);
+
+    if (compact_peers.size())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      compact_arg.block = arg.b.block;
+      compact_arg.current_blockchain_height = arg.current_blockchain_height;
+      compact_arg.hop = arg.hop;
+      LOG_PRINT_L2("[" << net_utils::print_connection_context_short(exclude_context) << "] post relay NOTIFY_NEW_COMPACT_BLOCK to " << compact_peers.size() << " peers -->");
+      std::string arg_buff;
+      epee::serialization::store_t_to_binary(compact_arg, arg_buff);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, arg_buff, compact_peers);
+    }
+
+    if (legacy_peers.size())
+    {
+      //a block that came compact has no tx blobs, older peers need them
+      block b = AUTO_VAL_INIT(b);
+      if (arg.b.txs.empty() && parse_and_validate_block_from_blob(arg.b.block, b) && b.tx_hashes.size())
+      {
+        std::vector<crypto::hash> ids(b.tx_hashes.begin(), b.tx_hashes.end());
+        std::list<transaction> txs;
+        std::list<crypto::hash> missed_txs;
+        m_core.get_transactions(ids, txs, missed_txs);
+        CHECK_AND_ASSERT_MES(missed_txs.empty(), false, "failed to relay block " << get_block_hash(b) << ": " << missed_txs.size() << " txs not found in blockchain");
+        for (const auto& tx : txs)
+          arg.b.txs.push_back(t_serializable_object_to_blob(tx));
+      }
+      LOG_PRINT_L2("[" << net_utils::print_connection_context_short(exclude_context) << "] post relay NOTIFY_NEW_BLOCK to " << legacy_peers.size() << " peers -->");
+      std::string arg_buff;
+      epee::serialization::store_t_to_binary(arg, arg_buff);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_BLOCK::ID, arg_buff, legacy_peers);
+    }
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::get_relay_peers(uint64_t feature, const currency_connection_context& exclude_context, std::list<boost::uuids::uuid>& feature_peers,
+    std::list<boost::uuids::uuid>& other_peers)
+  {
+    m_p2p->for_each_connection([&](currency_connection_context& context, nodetool::peerid_type peer_id)->bool{
+      if (!peer_id || context.m_connection_id == exclude_context.m_connection_id)
+        return true;
+      if (context.m_remote_features & feature)
+        feature_peers.push_back(context.m_connection_id);
+      else
+        other_peers.push_back(context.m_connection_id);
+      return true;
+    });
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   bool t_currency_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, currency_connection_context& exclude_context)
   {
-    return relay_post_notify<NOTIFY_NEW_TRANSACTIONS>(arg, exclude_context);
+    std::list<crypto::hash> ids;
+    for (const auto& tx_blob : arg.txs)
+    {
+      crypto::hash id = null_hash;
+      if (get_tx_id_from_blob(tx_blob, id))
+        ids.push_back(id);
+    }
+    return relay_transactions(arg, ids, exclude_context);
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core> 
+  bool t_currency_protocol_handler<t_core>::relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::list<crypto::hash>& ids, currency_connection_context& exclude_context)
+  {
+    std::list<boost::uuids::uuid> announce_peers, legacy_peers;
+    get_relay_peers(CURRENCY_PROTOCOL_FEATURE_TX_ANNOUNCE, exclude_context, announce_peers, legacy_peers);
+
+    //hashes are announced in batches from on_tx_relay_idle, blobs go only where they are requested
+    m_tx_relay.add_to_announce(announce_peers, ids, epee::misc_utils::get_tick_count());
+
+    //older peers don't know announcements, they are flooded with blobs as before
+    if (legacy_peers.size())
+    {
+      LOG_PRINT_L2("[" << net_utils::print_connection_context_short(exclude_context) << "] post relay NOTIFY_NEW_TRANSACTIONS to " << legacy_peers.size() << " peers -->");
+      std::string arg_buff;
+      epee::serialization::store_t_to_binary(arg, arg_buff);
+      m_p2p->relay_notify_to_list(NOTIFY_NEW_TRANSACTIONS::ID, arg_buff, legacy_peers);
+    }
+    return true;
   }
 }
@@ -9,6 +9,18 @@
 #include "currency_core/connection_context.h"
 namespace currency
 {
+  struct sync_pipeline_stat
+  {
+    uint64_t ranges_pending;             // block ranges known, not requested from peers yet
+    uint64_t ranges_downloading;
+    uint64_t prevalidation_queue_size;   // received ranges waiting for a prevalidation worker
+    uint64_t prevalidation_busy_workers;
+    uint64_t prevalidation_workers;
+    uint64_t ranges_ready;               // prevalidated ranges waiting to be applied
+    uint64_t applier_busy;
+    uint64_t blocks_applied;             // since start
+  };
+
   /************************************************************************/
   /*                                                                      */
   /************************************************************************/
@@ -16,6 +28,8 @@ namespace currency
   {
     virtual bool relay_block(NOTIFY_NEW_BLOCK::request& arg, currency_connection_context& exclude_context)=0;
     virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, currency_connection_context& exclude_context)=0;
+    //ids are the ones of arg.txs, in the same order, for the callers that have them already
+    virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& arg, const std::list<crypto::hash>& ids, currency_connection_context& exclude_context)=0;
     //virtual bool request_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, currency_connection_context& context)=0;
   };
 
@@ -32,6 +46,10 @@ namespace currency
     {
       return false;
     }
+    virtual bool relay_transactions(NOTIFY_NEW_TRANSACTIONS::request& /*arg*/, const std::list<crypto::hash>& /*ids*/, currency_connection_context& /*exclude_context*/)
+    {
+      return false;
+    }
 
   };
 }
@@ -0,0 +1,157 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <algorithm>
+#include <list>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/uuid/uuid.hpp>
+
+#include "syncobj.h"
+#include "currency_protocol_defs.h"
+#include "currency_core/currency_format_utils.h"
+
+namespace currency
+{
+  /************************************************************************/
+  /* Compact blocks waiting for the txs they miss. The txs are asked from */
+  /* the first peer that announced the block, the peers that announced it */
+  /* after that are asked in turn if the previous one doesn't answer in   */
+  /* time. Only the txs that were asked for are taken from a response.    */
+  /* Peers are known by connection id.                                    */
+  /************************************************************************/
+  class pending_compact_blocks
+  {
+  public:
+    struct block_txs_request
+    {
+      boost::uuids::uuid peer;
+      NOTIFY_REQUEST_BLOCK_TXS::request req;
+    };
+
+    struct received_tx
+    {
+      crypto::hash id;
+      transaction tx;
+    };
+
+    pending_compact_blocks(uint64_t request_timeout_ms = CURRENCY_PROTOCOL_BLOCK_TXS_REQUEST_TIMEOUT_MS) : m_request_timeout_ms(request_timeout_ms)
+    {}
+
+    // returns true if the block is pending already, the peer is remembered to be asked for its txs later then
+    bool add_other_peer(const crypto::hash& id, const boost::uuids::uuid& peer)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_blocks.find(id);
+      if (it == m_blocks.end())
+        return false;
+      pending_block& pb = it->second;
+      if (pb.peer == peer || std::find(pb.other_peers.begin(), pb.other_peers.end(), peer) != pb.other_peers.end())
+        return true;
+      pb.other_peers.push_back(peer);
+      return true;
+    }
+
+    // returns true if missed_txs are to be requested from the peer now
+    bool add(const crypto::hash& id, const NOTIFY_NEW_COMPACT_BLOCK::request& arg, const std::list<crypto::hash>& missed_txs, const boost::uuids::uuid& peer, uint64_t now)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      if (add_other_peer(id, peer))
+        return false;
+      pending_block& pb = m_blocks[id];
+      pb.arg = arg;
+      pb.missed_txs.insert(missed_txs.begin(), missed_txs.end());
+      pb.peer = peer;
+      pb.request_time = now;
+      return true;
+    }
+
+    // takes the block if its txs were requested from the peer; txs are the ones among the requested, parsed, and
+    // has_invalid_blob is set if any of the blobs can't be parsed
+    bool on_response(const crypto::hash& id, const boost::uuids::uuid& peer, const std::list<blobdata>& tx_blobs, NOTIFY_NEW_COMPACT_BLOCK::request& arg,
+      std::list<received_tx>& txs, bool& has_invalid_blob)
+    {
+      has_invalid_blob = false;
+      pending_block pb;
+      {
+        CRITICAL_REGION_LOCAL(m_lock);
+        auto it = m_blocks.find(id);
+        if (it == m_blocks.end() || it->second.peer != peer)
+          return false;
+        pb = it->second;
+        m_blocks.erase(it);
+      }
+
+      arg = pb.arg;
+      for (const auto& tx_blob : tx_blobs)
+      {
+        received_tx rtx = AUTO_VAL_INIT(rtx);
+        crypto::hash prefix_hash = null_hash;
+        if (!parse_and_validate_tx_from_blob(tx_blob, rtx.tx, rtx.id, prefix_hash))
+        {
+          has_invalid_blob = true;
+          continue;
+        }
+        //each requested tx is taken once, anything else the peer sends is dropped
+        if (pb.missed_txs.erase(rtx.id))
+          txs.push_back(rtx);
+      }
+      return true;
+    }
+
+    // timed out requests go to the next peer that announced the block, the blocks nobody else can be asked for are forgotten
+    void on_idle(const std::set<boost::uuids::uuid>& connections, uint64_t now, std::list<block_txs_request>& requests)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (auto it = m_blocks.begin(); it != m_blocks.end();)
+      {
+        pending_block& pb = it->second;
+        if (now - pb.request_time < m_request_timeout_ms && connections.count(pb.peer))
+        {
+          ++it;
+          continue;
+        }
+        while (pb.other_peers.size() && !connections.count(pb.other_peers.front()))
+          pb.other_peers.pop_front();
+        if (pb.other_peers.empty())
+        {
+          it = m_blocks.erase(it);
+          continue;
+        }
+        pb.peer = pb.other_peers.front();
+        pb.other_peers.pop_front();
+        pb.request_time = now;
+
+        block_txs_request r;
+        r.peer = pb.peer;
+        r.req.block_id = it->first;
+        r.req.txs.assign(pb.missed_txs.begin(), pb.missed_txs.end());
+        requests.push_back(r);
+        ++it;
+      }
+    }
+
+    size_t size()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_blocks.size();
+    }
+
+  private:
+    struct pending_block
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request arg;
+      std::unordered_set<crypto::hash> missed_txs;
+      boost::uuids::uuid peer;                    //the one the txs are requested from
+      std::list<boost::uuids::uuid> other_peers;  //announced the block too, asked in this order if needed
+      uint64_t request_time;
+    };
+
+    epee::critical_section m_lock;
+    std::unordered_map<crypto::hash, pending_block> m_blocks;
+    uint64_t m_request_timeout_ms;
+  };
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <algorithm>
+#include <deque>
+#include <iterator>
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/uuid/uuid.hpp>
+
+#include "syncobj.h"
+#include "crypto/crypto.h"
+#include "currency_protocol_defs.h"
+
+namespace currency
+{
+  /************************************************************************/
+  /* State of tx hash announcements: per peer, the hashes waiting to be   */
+  /* announced to it and the ones it's known to have, which are not       */
+  /* announced to it (a bounded number of the latest ones); and the       */
+  /* announced txs requested from some peer, the other peers that         */
+  /* announced them are asked in turn if the request times out.           */
+  /* Peers are known by connection id.                                    */
+  /************************************************************************/
+  class tx_relay_tracker
+  {
+  public:
+    typedef std::list<std::pair<boost::uuids::uuid, std::list<crypto::hash> > > peer_txs_list;
+
+    tx_relay_tracker(uint64_t request_timeout_ms = CURRENCY_PROTOCOL_TX_REQUEST_TIMEOUT_MS, size_t max_known_per_peer = CURRENCY_PROTOCOL_MAX_KNOWN_TXS_PER_PEER,
+      uint64_t announce_interval_ms = CURRENCY_PROTOCOL_TX_ANNOUNCE_INTERVAL_MS, size_t max_announce_count = CURRENCY_PROTOCOL_MAX_TXS_REQUEST_COUNT) :
+      m_request_timeout_ms(request_timeout_ms), m_max_known_per_peer(max_known_per_peer), m_announce_interval_ms(announce_interval_ms), m_max_announce_count(max_announce_count)
+    {}
+
+    // the peer sent these txs, so it has them and they are not awaited from anyone anymore
+    void on_txs_received(const boost::uuids::uuid& peer, const std::list<crypto::hash>& ids, uint64_t now)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      relay_peer& p = get_peer(peer, now);
+      for (const auto& id : ids)
+      {
+        mark_known(p, id);
+        m_requested.erase(id);
+      }
+    }
+
+    // the peer announced ids, unknown_ids are the ones missing here; to_request gets those not requested from anyone
+    // else lately, they are marked as requested, the peer is remembered to be asked for the others later if needed
+    void on_announce(const boost::uuids::uuid& peer, const std::list<crypto::hash>& ids, const std::list<crypto::hash>& unknown_ids, uint64_t now,
+      std::list<crypto::hash>& to_request)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      relay_peer& p = get_peer(peer, now);
+      for (const auto& id : ids)
+        mark_known(p, id);
+      for (const auto& id : unknown_ids)
+      {
+        auto it = m_requested.find(id);
+        if (it != m_requested.end() && now - it->second.request_time < m_request_timeout_ms)
+        {
+          tx_request& r = it->second;
+          if (r.peer != peer && std::find(r.other_peers.begin(), r.other_peers.end(), peer) == r.other_peers.end())
+            r.other_peers.push_back(peer);
+          continue;
+        }
+        tx_request& r = m_requested[id];
+        r.peer = peer;
+        r.request_time = now;
+        r.other_peers.remove(peer);
+        to_request.push_back(id);
+      }
+    }
+
+    // ids are to be announced to the peers that don't know them yet
+    void add_to_announce(const std::list<boost::uuids::uuid>& peers, const std::list<crypto::hash>& ids, uint64_t now)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (const auto& c : peers)
+      {
+        relay_peer& p = get_peer(c, now);
+        for (const auto& id : ids)
+        {
+          if (mark_known(p, id))
+            p.pending.push_back(id);
+        }
+      }
+    }
+
+    // takes the announcements that are due (no more than max_announce_count hashes per peer at once, the rest goes on
+    // the next call), forgets closed connections; timed out requests go to the next peer that announced the tx, in
+    // messages of no more than max_announce_count hashes, the txs nobody else can be asked for are forgotten
+    void on_idle(const std::set<boost::uuids::uuid>& connections, uint64_t now, peer_txs_list& announces, peer_txs_list& requests)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      for (auto it = m_peers.begin(); it != m_peers.end();)
+      {
+        if (!connections.count(it->first))
+        {
+          m_peers.erase(it++);
+          continue;
+        }
+        relay_peer& p = it->second;
+        if (p.pending.size() && p.next_announce_time <= now)
+        {
+          announces.push_back(std::make_pair(it->first, std::list<crypto::hash>()));
+          std::list<crypto::hash>& txs = announces.back().second;
+          auto last = p.pending.begin();
+          std::advance(last, std::min<size_t>(p.pending.size(), m_max_announce_count));
+          txs.splice(txs.end(), p.pending, p.pending.begin(), last);
+          if (p.pending.empty())
+            p.next_announce_time = get_next_announce_time(now);
+        }
+        ++it;
+      }
+
+      std::map<boost::uuids::uuid, std::list<crypto::hash> > txs_by_peer;
+      for (auto it = m_requested.begin(); it != m_requested.end();)
+      {
+        tx_request& r = it->second;
+        if (now - r.request_time < m_request_timeout_ms && connections.count(r.peer))
+        {
+          ++it;
+          continue;
+        }
+        while (r.other_peers.size() && !connections.count(r.other_peers.front()))
+          r.other_peers.pop_front();
+        if (r.other_peers.empty())
+        {
+          it = m_requested.erase(it);
+          continue;
+        }
+        r.peer = r.other_peers.front();
+        r.other_peers.pop_front();
+        r.request_time = now;
+        txs_by_peer[r.peer].push_back(it->first);
+        ++it;
+      }
+      for (auto& t : txs_by_peer)
+      {
+        while (t.second.size())
+        {
+          requests.push_back(std::make_pair(t.first, std::list<crypto::hash>()));
+          std::list<crypto::hash>& txs = requests.back().second;
+          auto last = t.second.begin();
+          std::advance(last, std::min<size_t>(t.second.size(), m_max_announce_count));
+          txs.splice(txs.end(), t.second, t.second.begin(), last);
+        }
+      }
+    }
+
+    bool is_known_by(const boost::uuids::uuid& peer, const crypto::hash& id)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_peers.find(peer);
+      return it != m_peers.end() && it->second.known.count(id);
+    }
+
+    size_t get_known_count(const boost::uuids::uuid& peer)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      auto it = m_peers.find(peer);
+      return it == m_peers.end() ? 0 : it->second.known.size();
+    }
+
+    size_t get_requested_count()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_requested.size();
+    }
+
+    size_t get_peers_count()
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      return m_peers.size();
+    }
+
+  private:
+    struct relay_peer
+    {
+      std::list<crypto::hash> pending;              //hashes to be announced at next_announce_time
+      std::unordered_set<crypto::hash> known;       //hashes the peer is known to have, not announced to it
+      std::deque<crypto::hash> known_order;         //to forget the oldest known hashes
+      uint64_t next_announce_time;
+    };
+
+    struct tx_request
+    {
+      boost::uuids::uuid peer;                      //the one the tx is requested from
+      uint64_t request_time;
+      std::list<boost::uuids::uuid> other_peers;    //announced the tx too, asked in this order if needed
+    };
+
+    relay_peer& get_peer(const boost::uuids::uuid& peer, uint64_t now)
+    {
+      auto it = m_peers.find(peer);
+      if (it == m_peers.end())
+      {
+        relay_peer p = AUTO_VAL_INIT(p);
+        p.next_announce_time = get_next_announce_time(now);
+        it = m_peers.insert(std::make_pair(peer, p)).first;
+      }
+      return it->second;
+    }
+
+    // returns false if the peer knew the hash already
+    bool mark_known(relay_peer& p, const crypto::hash& id)
+    {
+      if (!p.known.insert(id).second)
+        return false;
+      p.known_order.push_back(id);
+      if (p.known_order.size() > m_max_known_per_peer)
+      {
+        p.known.erase(p.known_order.front());
+        p.known_order.pop_front();
+      }
+      return true;
+    }
+
+    uint64_t get_next_announce_time(uint64_t now)
+    {
+      //randomized, so that the order txs come from peers tells less about where they came from
+      return now + m_announce_interval_ms / 2 + (m_announce_interval_ms ? crypto::rand<uint64_t>() % m_announce_interval_ms : 0);
+    }
+
+    epee::critical_section m_lock;
+    std::map<boost::uuids::uuid, relay_peer> m_peers;
+    std::unordered_map<crypto::hash, tx_request> m_requested;  //announced tx hash -> who it was requested from, when
+    uint64_t m_request_timeout_ms;
+    size_t m_max_known_per_peer;
+    uint64_t m_announce_interval_ms;
+    size_t m_max_announce_count;
+  };
+}
@@ -215,13 +215,13 @@ int main(int argc, char* argv[])
   rpc_server.send_stop_signal();
   rpc_server.timed_wait_server_stop(5000);
 
-  //deinitialize components
+  //deinitialize components, currency_protocol goes first to stop applying downloaded blocks to the core
+  LOG_PRINT_L0("Deinitializing currency_protocol...");
+  cprotocol.deinit();
   LOG_PRINT_L0("Deinitializing core...");
   ccore.deinit();
   LOG_PRINT_L0("Deinitializing rpc server ...");
   rpc_server.deinit();
-  LOG_PRINT_L0("Deinitializing currency_protocol...");
-  cprotocol.deinit();
   LOG_PRINT_L0("Deinitializing p2p...");
   p2psrv.deinit();
 
@@ -10,6 +10,7 @@
 #include "p2p/net_node.h"
 #include "currency_protocol/currency_protocol_handler.h"
 #include "common/util.h"
+#include "file_io_utils.h"
 #include "crypto/hash.h"
 #include "warnings.h"
 
@@ -40,6 +41,7 @@ public:
     m_cmd_binder.set_handler("make_alias", boost::bind(&daemon_commands_handler::make_alias, this, _1), "Puts alias reservation record into block template, if alias is free");
     m_cmd_binder.set_handler("set_donations", boost::bind(&daemon_commands_handler::set_donations, this, _1), "Set donations mode: true if you vote for donation, and false - if against");
     m_cmd_binder.set_handler("print_ki", boost::bind(&daemon_commands_handler::print_ki, this, _1), "Print details of the specified key image");
+    m_cmd_binder.set_handler("save_block_ids_hashes", boost::bind(&daemon_commands_handler::save_block_ids_hashes, this, _1), "Save hashes of block ids groups below the height for embedding into checkpoints, save_block_ids_hashes <file_path> <height>");
     m_cmd_binder.set_handler("print_deadlock_guard", boost::bind(&daemon_commands_handler::print_deadlock_guard, this, _1), "Print all threads which is blocked or involved in mutex ownership");
     //m_cmd_binder.set_handler("save", boost::bind(&daemon_commands_handler::save, this, _1), "Save blockchain");
     //m_cmd_binder.set_handler("get_transactions_statics", boost::bind(&daemon_commands_handler::get_transactions_statistics, this, _1), "Calculates transactions statistics");
@@ -414,5 +416,29 @@ private:
 
     return true;
   }
+  //--------------------------------------------------------------------------------
+  bool save_block_ids_hashes(const std::vector<std::string>& args)
+  {
+    uint64_t height = 0;
+    if (args.size() != 2 || !string_tools::get_xtype_from_string(height, args[1]))
+    {
+      std::cout << "Usage: save_block_ids_hashes <file_path> <height>" << std::endl;
+      return true;
+    }
+
+    std::string blob;
+    if (!m_srv.get_payload_object().get_core().get_blockchain_storage().get_block_ids_hashes(height, blob))
+    {
+      std::cout << "failed to get block ids hashes below height " << height << std::endl;
+      return true;
+    }
+    if (!file_io_utils::save_string_to_file(args[0], blob))
+    {
+      std::cout << "failed to save block ids hashes to " << args[0] << std::endl;
+      return true;
+    }
+    std::cout << blob.size() / sizeof(crypto::hash) << " block ids hashes (" << blob.size() / sizeof(crypto::hash) * CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE << " blocks) saved to " << args[0] << std::endl;
+    return true;
+  }
 };
 POP_WARNINGS
@@ -28,6 +28,11 @@ namespace tools
       return m_rpc.on_get_blocks(req, res, m_cntxt_stub);
     }
     //------------------------------------------------------------------------------------------------------------------------------
+    bool call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& req, currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& res)
+    {
+      return m_rpc.on_get_blocks_ids(req, res, m_cntxt_stub);
+    }
+    //------------------------------------------------------------------------------------------------------------------------------
     bool call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& req, currency::COMMAND_RPC_GET_INFO::response& res)
     {
       return m_rpc.on_get_info(req, res, m_cntxt_stub);
@@ -58,6 +63,11 @@ namespace tools
       return true;
     }
     //------------------------------------------------------------------------------------------------------------------------------
+    std::shared_ptr<i_core_proxy> clone()
+    {
+      return std::shared_ptr<i_core_proxy>(new core_fast_rpc_proxy(m_rpc));
+    }
+    //------------------------------------------------------------------------------------------------------------------------------
     bool call_COMMAND_RPC_GET_ALL_ALIASES(currency::COMMAND_RPC_GET_ALL_ALIASES::response& res)
     {
       currency::COMMAND_RPC_GET_ALL_ALIASES::request req = AUTO_VAL_INIT(req);
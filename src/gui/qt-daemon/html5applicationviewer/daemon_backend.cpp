@@ -322,7 +322,13 @@ void daemon_backend::main_worker(const po::variables_map& vm)
   m_rpc_server.send_stop_signal();
   m_rpc_server.timed_wait_server_stop(60000);
 
-  //deinitialize components
+  //deinitialize components, currency_protocol goes first to stop applying downloaded blocks to the core
+
+  LOG_PRINT_L0("Deinitializing currency_protocol...");
+  dsi.text_state = "Deinitializing currency_protocol";
+  m_pview->update_daemon_status(dsi);
+  m_cprotocol.deinit();
+
 
   LOG_PRINT_L0("Deinitializing core...");
   dsi.text_state = "Deinitializing core";
@@ -336,12 +342,6 @@ void daemon_backend::main_worker(const po::variables_map& vm)
   m_rpc_server.deinit();
 
 
-  LOG_PRINT_L0("Deinitializing currency_protocol...");
-  dsi.text_state = "Deinitializing currency_protocol";
-  m_pview->update_daemon_status(dsi);
-  m_cprotocol.deinit();
-
-
   LOG_PRINT_L0("Deinitializing p2p...");
   dsi.text_state = "Deinitializing p2p";
   m_pview->update_daemon_status(dsi);
@@ -319,6 +319,7 @@ namespace nodetool
 
     m_net_server.add_idle_handler(boost::bind(&node_server<t_payload_net_handler>::idle_worker, this), 1000);
     m_net_server.add_idle_handler(boost::bind(&t_payload_net_handler::on_idle, &m_payload_handler), 1000);
+    m_net_server.add_idle_handler(boost::bind(&t_payload_net_handler::on_tx_relay_idle, &m_payload_handler), 100);
 
     //go to loop
     LOG_PRINT("Run net_service loop( " << thrds_count << " threads)...", LOG_LEVEL_0);
@@ -1076,9 +1077,21 @@ namespace nodetool
       return true;
     });
 
+    epee::net_utils::shared_buffer buff = epee::net_utils::make_shared_buffer(data_buff.data(), data_buff.size());
     BOOST_FOREACH(const auto& c_id, connections)
     {
-      m_net_server.get_config_object().notify(command, data_buff, c_id);
+      m_net_server.get_config_object().notify(command, buff, c_id);
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const std::string& data_buff, const std::list<boost::uuids::uuid>& connections)
+  {
+    epee::net_utils::shared_buffer buff = epee::net_utils::make_shared_buffer(data_buff.data(), data_buff.size());
+    BOOST_FOREACH(const auto& c_id, connections)
+    {
+      m_net_server.get_config_object().notify(command, buff, c_id);
     }
     return true;
   }
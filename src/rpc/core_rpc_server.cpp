@@ -83,6 +83,12 @@ namespace currency
     res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block().convert_to<uint64_t>();
     res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
+    tx_pool_memory_stat pool_st = AUTO_VAL_INIT(pool_st);
+    m_core.get_tx_pool().get_memory_stat(pool_st);
+    res.tx_pool_memory_usage = pool_st.memory_usage;
+    res.tx_pool_max_memory_usage = pool_st.max_memory_usage;
+    res.tx_pool_evicted_count = pool_st.evicted_count;
+    res.tx_pool_evicted_last_minute = pool_st.evicted_last_minute;
     res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
@@ -105,6 +111,15 @@ namespace currency
     
     res.synchronization_start_height = m_p2p.get_payload_object().get_core_inital_height();
     res.max_net_seen_height = m_p2p.get_payload_object().get_max_seen_height();
+    sync_pipeline_stat sync_st = AUTO_VAL_INIT(sync_st);
+    m_p2p.get_payload_object().get_sync_pipeline_stat(sync_st);
+    res.sync_ranges_pending = sync_st.ranges_pending;
+    res.sync_ranges_downloading = sync_st.ranges_downloading;
+    res.sync_prevalidation_queue_size = sync_st.prevalidation_queue_size;
+    res.sync_prevalidation_busy_workers = sync_st.prevalidation_busy_workers;
+    res.sync_prevalidation_workers = sync_st.prevalidation_workers;
+    res.sync_ranges_ready = sync_st.ranges_ready;
+    res.sync_applier_busy = sync_st.applier_busy;
 
     block_extended_info last_block_ei = AUTO_VAL_INIT(last_block_ei);
     m_core.get_blockchain_storage().get_block_extended_info_by_height(res.height - 1, last_block_ei);
@@ -134,7 +149,8 @@ namespace currency
 
     PROF_L2_START(find_blockchain_supplement_time);
     std::list<std::pair<block, std::list<transaction> > > bs;
-    if(!m_core.find_blockchain_supplement(req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
+    std::list<std::vector<std::vector<uint64_t> > > global_outs_indexes;
+    if(!m_core.find_blockchain_supplement(req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT, req.need_global_outs_indexes ? &global_outs_indexes : nullptr))
     {
       res.status = "Failed";
       return false;
@@ -143,16 +159,34 @@ namespace currency
 
     PROF_L2_START(bs_to_res_time);
     size_t txs_count = 0;
+    res.compact_txs = req.compact_txs;
     for (auto& b : bs)
     {
       res.blocks.resize(res.blocks.size()+1);
       res.blocks.back().block = block_to_blob(b.first);
       for(auto& t : b.second)
       {
-        res.blocks.back().txs.push_back(tx_to_blob(t));
+        if (req.compact_txs)
+        {
+          compact_tx_entry cte = AUTO_VAL_INIT(cte);
+          get_compact_tx_entry(t, cte);
+          res.blocks.back().txs.push_back(t_serializable_object_to_blob(cte));
+        }
+        else
+        {
+          res.blocks.back().txs.push_back(tx_to_blob(t));
+        }
         ++txs_count;
       }
     }
+    for (auto& block_indexes : global_outs_indexes)
+    {
+      res.global_outs_indexes.resize(res.global_outs_indexes.size() + 1);
+      auto& txs_indexes = res.global_outs_indexes.back().txs;
+      txs_indexes.resize(block_indexes.size());
+      for (size_t i = 0; i != block_indexes.size(); ++i)
+        txs_indexes[i].indexes.swap(block_indexes[i]);
+    }
     PROF_L2_FINISH(bs_to_res_time);
     PROF_L2_LOG_PRINT("RPC: on_get_blocks: " << res.blocks.size() << " blocks, " << txs_count << " txs, timings: " << print_mcsec_as_ms(find_blockchain_supplement_time) << "/" << print_mcsec_as_ms(bs_to_res_time), LOG_LEVEL_1);
 
@@ -160,6 +194,23 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_blocks_ids(const COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& res, connection_context& cntx)
+  {
+    CHECK_CORE_READY();
+
+    PROF_L2_START(find_blockchain_ids_supplement_time);
+    if(!m_core.find_blockchain_ids_supplement(req.block_ids, res.ids, res.timestamps, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_IDS_FAST_MAX_COUNT))
+    {
+      res.status = "Failed";
+      return false;
+    }
+    PROF_L2_FINISH(find_blockchain_ids_supplement_time);
+    PROF_L2_LOG_PRINT("RPC: on_get_blocks_ids: " << res.ids.size() << " ids, timing: " << print_mcsec_as_ms(find_blockchain_ids_supplement_time), LOG_LEVEL_1);
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_random_outs(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res, connection_context& cntx)
   {
     CHECK_CORE_READY();
@@ -322,6 +373,12 @@ namespace currency
     tx_verification_context tvc = AUTO_VAL_INIT(tvc);
     if(!m_core.handle_incoming_tx(tx_blob, tvc, false))
     {
+      if (tvc.m_admission_timed_out)
+      {
+        LOG_PRINT_L0("[on_send_raw_tx]: tx verification is overloaded, try again later");
+        res.status = CORE_RPC_STATUS_BUSY;
+        return true;
+      }
       LOG_PRINT_L0("[on_send_raw_tx]: Failed to process tx");
       res.status = "Failed";
       return true;
@@ -337,7 +394,7 @@ namespace currency
 
     NOTIFY_NEW_TRANSACTIONS::request r;
     r.txs.push_back(tx_blob);
-    m_core.get_protocol()->relay_transactions(r, fake_context);
+    m_core.get_protocol()->relay_transactions(r, std::list<crypto::hash>(1, tvc.m_tx_hash), fake_context);
     //TODO: make sure that tx has reached other nodes here, probably wait to receive reflections from other nodes
     res.status = CORE_RPC_STATUS_OK;
     return true;
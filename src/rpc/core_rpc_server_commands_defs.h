@@ -70,27 +70,83 @@ struct EMPTY_STRUCT {
     };
   };
 
+  struct tx_global_outs_indexes
+  {
+    std::vector<uint64_t> indexes;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(indexes)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct block_global_outs_indexes
+  {
+    std::vector<tx_global_outs_indexes> txs; // miner tx goes first, then txs in the order of block_complete_entry::txs
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(txs)
+    END_KV_SERIALIZE_MAP()
+  };
+
   struct COMMAND_RPC_GET_BLOCKS_FAST
   {
 
     struct request
     {
       std::list<crypto::hash> block_ids; //*first 10 blocks id goes sequential, next goes in pow(2,n) offset, like 2, 4, 8, 16, 32, 64 and so on, and the last one is always genesis block */
+      bool need_global_outs_indexes;     // if set, response contains global outputs indexes for every transaction (same as get_o_indexes.bin)
+      bool compact_txs;                  // if set, txs of blocks are given as compact_tx_entry blobs, for wallet scanning
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+        KV_SERIALIZE(need_global_outs_indexes)
+        KV_SERIALIZE(compact_txs)
       END_KV_SERIALIZE_MAP()
     };
 
     struct response
     {
       std::list<block_complete_entry> blocks;
+      std::list<block_global_outs_indexes> global_outs_indexes; // one entry per block, empty unless requested
+      bool        compact_txs;          // txs are compact_tx_entry blobs, daemons that don't support it leave it unset
       uint64_t    start_height;
       uint64_t    current_height;
       std::string status;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(blocks)
+        KV_SERIALIZE(global_outs_indexes)
+        KV_SERIALIZE(compact_txs)
+        KV_SERIALIZE(start_height)
+        KV_SERIALIZE(current_height)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+  //-----------------------------------------------
+  // ids and timestamps of blocks only, for wallets to skip the part of the chain that is older than their accounts
+  struct COMMAND_RPC_GET_BLOCKS_IDS_FAST
+  {
+    struct request
+    {
+      std::list<crypto::hash> block_ids; // same as COMMAND_RPC_GET_BLOCKS_FAST::request::block_ids
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::list<crypto::hash> ids;       // ids of blocks starting from start_height
+      std::list<uint64_t> timestamps;    // timestamps of the same blocks
+      uint64_t    start_height;
+      uint64_t    current_height;
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(timestamps)
         KV_SERIALIZE(start_height)
         KV_SERIALIZE(current_height)
         KV_SERIALIZE(status)
@@ -321,6 +377,10 @@ struct EMPTY_STRUCT {
       uint64_t difficulty;
       uint64_t tx_count;
       uint64_t tx_pool_size;
+      uint64_t tx_pool_memory_usage;
+      uint64_t tx_pool_max_memory_usage;
+      uint64_t tx_pool_evicted_count;
+      uint64_t tx_pool_evicted_last_minute;
       uint64_t alt_blocks_count;
       uint64_t outgoing_connections_count;
       uint64_t incoming_connections_count;
@@ -334,6 +394,13 @@ struct EMPTY_STRUCT {
       uint64_t daemon_network_state;
       uint64_t synchronization_start_height;
       uint64_t max_net_seen_height;
+      uint64_t sync_ranges_pending;
+      uint64_t sync_ranges_downloading;
+      uint64_t sync_prevalidation_queue_size;
+      uint64_t sync_prevalidation_busy_workers;
+      uint64_t sync_prevalidation_workers;
+      uint64_t sync_ranges_ready;
+      uint64_t sync_applier_busy;
       uint64_t transactions_cnt_per_day;
       uint64_t transactions_volume_per_day;
       uint64_t already_generated_coins;
@@ -349,6 +416,10 @@ struct EMPTY_STRUCT {
         KV_SERIALIZE(difficulty)
         KV_SERIALIZE(tx_count)
         KV_SERIALIZE(tx_pool_size)
+        KV_SERIALIZE(tx_pool_memory_usage)
+        KV_SERIALIZE(tx_pool_max_memory_usage)
+        KV_SERIALIZE(tx_pool_evicted_count)
+        KV_SERIALIZE(tx_pool_evicted_last_minute)
         KV_SERIALIZE(alt_blocks_count)
         KV_SERIALIZE(outgoing_connections_count)
         KV_SERIALIZE(incoming_connections_count)
@@ -362,6 +433,13 @@ struct EMPTY_STRUCT {
         KV_SERIALIZE(daemon_network_state)
         KV_SERIALIZE(synchronization_start_height)
         KV_SERIALIZE(max_net_seen_height)
+        KV_SERIALIZE(sync_ranges_pending)
+        KV_SERIALIZE(sync_ranges_downloading)
+        KV_SERIALIZE(sync_prevalidation_queue_size)
+        KV_SERIALIZE(sync_prevalidation_busy_workers)
+        KV_SERIALIZE(sync_prevalidation_workers)
+        KV_SERIALIZE(sync_ranges_ready)
+        KV_SERIALIZE(sync_applier_busy)
         KV_SERIALIZE(transactions_cnt_per_day)
         KV_SERIALIZE(transactions_volume_per_day)
         KV_SERIALIZE(already_generated_coins)
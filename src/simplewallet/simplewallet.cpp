@@ -6,6 +6,7 @@
 #include <boost/lexical_cast.hpp>
 #include <boost/program_options.hpp>
 #include <boost/algorithm/string.hpp>
+#include <boost/filesystem.hpp>
 #include "include_base_utils.h"
 #include "common/command_line.h"
 #include "common/util.h"
@@ -16,6 +17,7 @@
 #include "storages/http_abstract_invoke.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "wallet/wallet_rpc_server.h"
+#include "wallet/wallets_scanner.h"
 #include "crypto/mnemonic-encoding.h"
 #include "version.h"
 #include "string_coding.h"
@@ -43,9 +45,15 @@ namespace
   const command_line::arg_descriptor<std::string> arg_daemon_host = {"daemon-host", "Use daemon instance at host <arg> instead of localhost", ""};
   const command_line::arg_descriptor<std::string> arg_password = {"password", "Wallet password", "", true};
   const command_line::arg_descriptor<std::string> arg_restore_seed = { "restore-seed", "Restore wallet from the 24-word seed", ""};
+  const command_line::arg_descriptor<uint64_t> arg_restore_timestamp = { "restore-timestamp", "Unix time the restored wallet was created at, older blocks are synced as ids only", 0, true };
+  const command_line::arg_descriptor<uint64_t> arg_restore_height = { "restore-height", "Height to sync the restored wallet from, lower blocks are synced as ids only", 0, true };
   const command_line::arg_descriptor<int> arg_daemon_port = { "daemon-port", "Use daemon instance at port <arg> instead of default", 0 };
   const command_line::arg_descriptor<uint32_t> arg_log_level = { "set-log", "", 0, true };
   const command_line::arg_descriptor<bool> arg_offline_mode = { "offline-mode", "Don't connect to daemon, work offline (for cold-signing process)", false, true };
+  const command_line::arg_descriptor<std::string> arg_scan_wallets_list = { "scan-wallets-list", "Refresh all wallets listed in file <arg> in one pass over the blockchain, one wallet file per line", "", true };
+  const command_line::arg_descriptor<std::string> arg_scan_passwords_file = { "scan-passwords-file", "Passwords of the wallets in --scan-wallets-list mode, one per line: <wallet file><TAB><password>; the file must be accessible by its owner only (0600), passwords of the wallets missing in it are asked for", "", true };
+  const command_line::arg_descriptor<uint32_t> arg_scan_refresh_interval = { "scan-refresh-interval", "Seconds between refresh passes in --scan-wallets-list mode, 0 means refresh once and exit", 0, true };
+  const command_line::arg_descriptor<uint32_t> arg_scan_threads = { "scan-threads", "Number of threads to scan blocks with, 0 means number of CPU cores", 0, true };
 
   const command_line::arg_descriptor< std::vector<std::string> > arg_command = {"command", ""};
 
@@ -175,6 +183,8 @@ bool simple_wallet::help(const std::vector<std::string> &args/* = std::vector<st
 
 simple_wallet::simple_wallet()
   : m_daemon_port(0)
+  , m_restore_timestamp(0)
+  , m_restore_height(0)
   , m_refresh_progress_reporter(*this)
   , m_offline_mode(false)
 {
@@ -322,6 +332,8 @@ void simple_wallet::handle_command_line(const boost::program_options::variables_
   m_daemon_port    = command_line::get_arg(vm, arg_daemon_port);
   m_restore_wallet = command_line::get_arg(vm, arg_restore_wallet);
   m_restore_seed   = command_line::get_arg(vm, arg_restore_seed);
+  m_restore_timestamp = command_line::get_arg(vm, arg_restore_timestamp);
+  m_restore_height = command_line::get_arg(vm, arg_restore_height);
 }
 //----------------------------------------------------------------------------------------------------
 bool simple_wallet::try_connect_to_daemon()
@@ -383,7 +395,8 @@ bool simple_wallet::restore_wallet(const std::string &wallet_file, const std::st
   try
   {
     std::vector<unsigned char> seed = crypto::mnemonic_encoding::text2binary(restore_seed);
-    m_wallet->restore(epee::string_encoding::convert_to_unicode(wallet_file), seed, password);
+    m_wallet->restore(epee::string_encoding::convert_to_unicode(wallet_file), seed, password, m_restore_timestamp);
+    m_wallet->set_restore_height(m_restore_height);
     message_writer(epee::log_space::console_color_white, true) << "Wallet restored: " << m_wallet->get_account().get_public_address_str();
     std::cout << "view key: " << string_tools::pod_to_hex(m_wallet->get_account().get_keys().m_view_secret_key) << std::endl << std::flush;
   }
@@ -1748,6 +1761,173 @@ void simple_wallet::set_offline_mode(bool offline_mode)
   m_offline_mode = offline_mode;
 }
 //----------------------------------------------------------------------------------------------------
+namespace
+{
+  std::string get_daemon_address(const po::variables_map& vm)
+  {
+    std::string daemon_address  = command_line::get_arg(vm, arg_daemon_address);
+    std::string daemon_host     = command_line::get_arg(vm, arg_daemon_host);
+    int daemon_port = command_line::get_arg(vm, arg_daemon_port);
+    if (daemon_host.empty())
+      daemon_host = "localhost";
+    if (!daemon_port)
+      daemon_port = RPC_DEFAULT_PORT;
+    if (daemon_address.empty())
+      daemon_address = std::string("http://") + daemon_host + ":" + std::to_string(daemon_port);
+    return daemon_address;
+  }
+
+  // overwrites the text, so that passwords don't stay in freed memory
+  void wipe_string(std::string& s)
+  {
+    s.replace(0, s.size(), s.size(), '\0');
+    s.clear();
+  }
+
+  // passwords file lines are <wallet file><TAB><password>, the file must not be accessible by anyone but its owner
+  bool load_scan_passwords(const std::string& passwords_file, std::map<std::string, std::string>& passwords)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::file_status st = boost::filesystem::status(passwords_file, ec);
+    if (ec || !boost::filesystem::is_regular_file(st))
+    {
+      LOG_ERROR("Failed to read wallets passwords from " << passwords_file);
+      return false;
+    }
+#ifndef WIN32
+    if (st.permissions() & (boost::filesystem::group_all | boost::filesystem::others_all))
+    {
+      LOG_ERROR("Wallets passwords file " << passwords_file << " is accessible by others, set its permissions to 0600");
+      return false;
+    }
+#endif
+
+    std::string content;
+    if (!file_io_utils::load_file_to_string(passwords_file, content))
+    {
+      LOG_ERROR("Failed to read wallets passwords from " << passwords_file);
+      return false;
+    }
+    std::vector<std::string> lines;
+    boost::split(lines, content, boost::is_any_of("\r\n"));
+    for (auto& line : lines)
+    {
+      if (line.empty())
+        continue;
+      size_t tab_pos = line.find('\t');
+      if (tab_pos == std::string::npos)
+      {
+        LOG_ERROR("Wrong line in wallets passwords file " << passwords_file << ", expected <wallet file><TAB><password>");
+        return false;
+      }
+      passwords[line.substr(0, tab_pos)] = line.substr(tab_pos + 1);
+      wipe_string(line);
+    }
+    wipe_string(content);
+    return true;
+  }
+
+  bool run_wallets_scanner(const po::variables_map& vm)
+  {
+    std::string list_file = command_line::get_arg(vm, arg_scan_wallets_list);
+    std::string list;
+    if (!file_io_utils::load_file_to_string(list_file, list))
+    {
+      LOG_ERROR("Failed to read wallets list from " << list_file);
+      return false;
+    }
+
+    std::map<std::string, std::string> passwords;
+    if (command_line::has_arg(vm, arg_scan_passwords_file) && !load_scan_passwords(command_line::get_arg(vm, arg_scan_passwords_file), passwords))
+      return false;
+
+    std::string daemon_address = get_daemon_address(vm);
+    tools::wallets_scanner scanner;
+    scanner.init(daemon_address);
+    if (command_line::get_arg(vm, arg_scan_threads))
+      scanner.set_threads_count(command_line::get_arg(vm, arg_scan_threads));
+
+    std::vector<std::string> lines;
+    boost::split(lines, list, boost::is_any_of("\r\n"));
+    for (const auto& wallet_file : lines)
+    {
+      if (wallet_file.empty())
+        continue;
+      if (wallet_file.find('\t') != std::string::npos)
+      {
+        LOG_ERROR("Wrong line in wallets list " << list_file << ": passwords are not taken from it, put them to --" << arg_scan_passwords_file.name);
+        return false;
+      }
+
+      // wallets missing in the passwords file are asked for theirs
+      tools::password_container pwd_container;
+      auto it = passwords.find(wallet_file);
+      if (it != passwords.end())
+      {
+        pwd_container.password(std::string(it->second));
+        wipe_string(it->second);
+        passwords.erase(it);
+      }
+      else
+      {
+        std::cout << "Wallet " << wallet_file << " ";
+        if (!pwd_container.read_password())
+        {
+          LOG_ERROR("Failed to read password for wallet " << wallet_file);
+          return false;
+        }
+      }
+
+      std::shared_ptr<tools::wallet2> w(new tools::wallet2());
+      try
+      {
+        w->load(string_encoding::convert_to_unicode(wallet_file), pwd_container.password());
+        w->init(daemon_address);
+        // all the threads are used by the scanner to look through many wallets at once
+        w->set_scan_threads_count(1);
+        w->set_refresh_prefetch_depth(0);
+      }
+      catch (const std::exception& e)
+      {
+        LOG_ERROR("Failed to load wallet " << wallet_file << ": " << e.what());
+        return false;
+      }
+      scanner.add_wallet(w);
+    }
+    for (auto& p : passwords)
+      wipe_string(p.second);
+    LOG_PRINT_L0("Loaded " << scanner.get_wallets_count() << " wallets, scanning with " << scanner.get_threads_count() << " threads");
+
+    std::atomic<bool> stop(false);
+    tools::signal_handler::install([&scanner, &stop] {
+      stop = true;
+      scanner.stop();
+    });
+
+    uint32_t interval = command_line::get_arg(vm, arg_scan_refresh_interval);
+    do
+    {
+      try
+      {
+        size_t blocks_fetched = 0;
+        scanner.refresh(blocks_fetched);
+      }
+      catch (const std::exception& e)
+      {
+        LOG_ERROR("Wallets refresh failed: " << e.what());
+      }
+      size_t failed = scanner.store();
+      if (failed)
+        LOG_ERROR(failed << " wallets failed to store");
+
+      for (uint32_t i = 0; i < interval && !stop; ++i)
+        boost::this_thread::sleep_for(boost::chrono::seconds(1));
+    } while (interval && !stop);
+
+    return true;
+  }
+}
+//----------------------------------------------------------------------------------------------------
 int main(int argc, char* argv[])
 {
 #ifdef WIN32
@@ -1767,6 +1947,8 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_params, arg_generate_new_wallet);
   command_line::add_arg(desc_params, arg_restore_wallet);
   command_line::add_arg(desc_params, arg_restore_seed);
+  command_line::add_arg(desc_params, arg_restore_timestamp);
+  command_line::add_arg(desc_params, arg_restore_height);
   command_line::add_arg(desc_params, arg_password);
   command_line::add_arg(desc_params, arg_daemon_address);
   command_line::add_arg(desc_params, arg_daemon_host);
@@ -1774,6 +1956,10 @@ int main(int argc, char* argv[])
   command_line::add_arg(desc_params, arg_command);
   command_line::add_arg(desc_params, arg_log_level);
   command_line::add_arg(desc_params, arg_offline_mode);
+  command_line::add_arg(desc_params, arg_scan_wallets_list);
+  command_line::add_arg(desc_params, arg_scan_passwords_file);
+  command_line::add_arg(desc_params, arg_scan_refresh_interval);
+  command_line::add_arg(desc_params, arg_scan_threads);
   command_line::add_arg(desc_params, command_line::arg_log_file);
   command_line::add_arg(desc_params, command_line::arg_log_level);
   tools::wallet_rpc_server::init_options(desc_params);
@@ -1834,7 +2020,12 @@ int main(int argc, char* argv[])
 
   bool offline_mode = command_line::get_arg(vm, arg_offline_mode);
 
-  if(command_line::has_arg(vm, tools::wallet_rpc_server::arg_rpc_bind_port))
+  if(command_line::has_arg(vm, arg_scan_wallets_list))
+  {
+    log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL, LOG_LEVEL_2);
+    return run_wallets_scanner(vm) ? 0 : 1;
+  }
+  else if(command_line::has_arg(vm, tools::wallet_rpc_server::arg_rpc_bind_port))
   {
     log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL, LOG_LEVEL_2);
     w.set_offline_mode(offline_mode);
@@ -1857,16 +2048,7 @@ int main(int argc, char* argv[])
 
     std::string wallet_file     = command_line::get_arg(vm, arg_wallet_file);    
     std::string wallet_password = command_line::get_arg(vm, arg_password);
-    std::string daemon_address  = command_line::get_arg(vm, arg_daemon_address);
-    std::string daemon_host     = command_line::get_arg(vm, arg_daemon_host);
-
-    int daemon_port = command_line::get_arg(vm, arg_daemon_port);
-    if (daemon_host.empty())
-      daemon_host = "localhost";
-    if (!daemon_port)
-      daemon_port = RPC_DEFAULT_PORT;
-    if (daemon_address.empty())
-      daemon_address = std::string("http://") + daemon_host + ":" + std::to_string(daemon_port);
+    std::string daemon_address  = get_daemon_address(vm);
 
     tools::wallet2 wal;
     try
@@ -153,6 +153,8 @@ namespace currency
 
     std::string m_restore_wallet;
     std::string m_restore_seed;
+    uint64_t m_restore_timestamp;
+    uint64_t m_restore_height;
 
     std::string m_daemon_address;
     std::string m_daemon_host;
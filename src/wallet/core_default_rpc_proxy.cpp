@@ -27,6 +27,11 @@ namespace tools
     return net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/getblocks.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool default_http_core_proxy::call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& req, currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& res)
+  {
+    return net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/getblocks_ids.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool default_http_core_proxy::call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& req, currency::COMMAND_RPC_GET_INFO::response& res)
   {
     return net_utils::invoke_http_json_remote_command2(m_daemon_address + "/getinfo", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
@@ -67,6 +72,13 @@ namespace tools
     return epee::net_utils::invoke_http_json_rpc("/json_rpc", "relay_txs", req, rsp, m_http_client);
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  std::shared_ptr<i_core_proxy> default_http_core_proxy::clone()
+  {
+    std::shared_ptr<default_http_core_proxy> proxy(new default_http_core_proxy());
+    proxy->set_connection_addr(m_daemon_address);
+    return proxy;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool default_http_core_proxy::check_connection()
   {
     if (m_http_client.is_connected())
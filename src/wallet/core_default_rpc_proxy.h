@@ -18,6 +18,7 @@ namespace tools
     bool set_connection_addr(const std::string& url);
     bool call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(const currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& rqt, currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& rsp);
     bool call_COMMAND_RPC_GET_BLOCKS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& rsp);
+    bool call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& rsp);
     bool call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& rqt, currency::COMMAND_RPC_GET_INFO::response& rsp);
     bool call_COMMAND_RPC_GET_TX_POOL(const currency::COMMAND_RPC_GET_TX_POOL::request& rqt, currency::COMMAND_RPC_GET_TX_POOL::response& rsp);
     bool call_COMMAND_RPC_GET_ALIASES_BY_ADDRESS(const currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& rqt, currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& rsp);
@@ -31,6 +32,7 @@ namespace tools
     bool call_COMMAND_RPC_RELAY_TXS(const currency::COMMAND_RPC_RELAY_TXS::request& req, currency::COMMAND_RPC_RELAY_TXS::response& rsp);
 
     bool check_connection();
+    std::shared_ptr<i_core_proxy> clone();
     bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr, currency::payment_id_t& payment_id);
     
     epee::net_utils::http::http_simple_client m_http_client;
@@ -4,6 +4,7 @@
 
 
 #pragma once
+#include <memory>
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "currency_core/account.h"
 
@@ -17,6 +18,7 @@ namespace tools
     virtual bool set_connection_addr(const std::string& url) = 0;
     virtual bool call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(const currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& rqt, currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& rsp) = 0;
     virtual bool call_COMMAND_RPC_GET_BLOCKS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& rsp) = 0;
+    virtual bool call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& rsp) = 0;
     virtual bool call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& rqt, currency::COMMAND_RPC_GET_INFO::response& rsp) = 0;
     virtual bool call_COMMAND_RPC_GET_TX_POOL(const currency::COMMAND_RPC_GET_TX_POOL::request& rqt, currency::COMMAND_RPC_GET_TX_POOL::response& rsp) = 0;
     virtual bool call_COMMAND_RPC_GET_ALIASES_BY_ADDRESS(const currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& rqt, currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& rsp) = 0;
@@ -32,6 +34,8 @@ namespace tools
     
 
     virtual bool check_connection() = 0;
+    // creates independent proxy to the same daemon, to be used from another thread; empty if not supported
+    virtual std::shared_ptr<i_core_proxy> clone() { return std::shared_ptr<i_core_proxy>(); }
     virtual bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr, currency::payment_id_t& payment_id) = 0;
   };
 }
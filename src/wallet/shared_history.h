@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace tools
+{
+  struct no_history_index
+  {
+    template<class item_t>
+    void add(const item_t& /*item*/, size_t /*pos*/) {}
+  };
+
+  /* Append-only sequence made of immutable segments, each one referencing the previous (older) one. Copies share
+   * all the segments, so a copy is a snapshot that stays valid while the original one grows or is cut.
+   * Appending creates a new tail segment; while the previous segment isn't bigger, the two are merged, so there are
+   * O(log n) segments and each item is copied O(log n) times in total. Cutting copies only the segment at the cut.
+   * index_t is built for every segment: add(item, pos) is called for each item with its position in the segment.
+   */
+  template<class item_t, class index_t = no_history_index>
+  class shared_history
+  {
+  public:
+    struct segment
+    {
+      std::shared_ptr<const segment> prev;
+      uint64_t base;                    // position of items[0] in the whole sequence
+      std::vector<item_t> items;
+      index_t index;
+    };
+    typedef std::shared_ptr<const segment> segment_ptr;
+
+    uint64_t size() const { return m_tail ? m_tail->base + m_tail->items.size() : 0; }
+    bool empty() const { return !m_tail; }
+    void clear() { m_tail.reset(); }
+
+    const item_t& operator[](uint64_t i) const
+    {
+      const segment* s = m_tail.get();
+      while (s->base > i)
+        s = s->prev.get();
+      return s->items[i - s->base];
+    }
+
+    template<class it_t>
+    void append(it_t first, it_t last)
+    {
+      if (first == last)
+        return;
+      std::vector<item_t> items(first, last);
+      segment_ptr prev = m_tail;
+      while (prev && prev->items.size() <= items.size())
+      {
+        items.insert(items.begin(), prev->items.begin(), prev->items.end());
+        prev = prev->prev;
+      }
+      m_tail = make_segment(prev, std::move(items));
+    }
+
+    // cuts the sequence down to new_size items
+    void truncate(uint64_t new_size)
+    {
+      while (m_tail && m_tail->base >= new_size)
+        m_tail = m_tail->prev;
+      if (!m_tail || size() <= new_size)
+        return;
+      std::vector<item_t> items(m_tail->items.begin(), m_tail->items.begin() + (new_size - m_tail->base));
+      m_tail = make_segment(m_tail->prev, std::move(items));
+    }
+
+    // position of the first item pred is true for, the sequence is expected to be partitioned by pred (false ones first)
+    template<class pred_t>
+    uint64_t partition_point(pred_t pred) const
+    {
+      const segment* s = m_tail.get();
+      while (s && pred(s->items.front()))
+        s = s->prev.get();
+      if (!s)
+        return 0;
+      return s->base + (std::partition_point(s->items.begin(), s->items.end(), [&](const item_t& item) { return !pred(item); }) - s->items.begin());
+    }
+
+    // oldest first
+    std::vector<segment_ptr> get_segments() const
+    {
+      std::vector<segment_ptr> segments;
+      for (segment_ptr s = m_tail; s; s = s->prev)
+        segments.push_back(s);
+      std::reverse(segments.begin(), segments.end());
+      return segments;
+    }
+
+  private:
+    static segment_ptr make_segment(const segment_ptr& prev, std::vector<item_t>&& items)
+    {
+      std::shared_ptr<segment> s(new segment());
+      s->prev = prev;
+      s->base = prev ? prev->base + prev->items.size() : 0;
+      s->items = std::move(items);
+      for (size_t i = 0; i != s->items.size(); ++i)
+        s->index.add(s->items[i], i);
+      return s;
+    }
+
+    segment_ptr m_tail;
+  };
+}
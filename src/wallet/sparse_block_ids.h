@@ -0,0 +1,203 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <deque>
+#include <list>
+#include <map>
+#include <vector>
+#include <boost/serialization/deque.hpp>
+#include <boost/serialization/map.hpp>
+#include <boost/serialization/utility.hpp>
+
+#include "common/crypto_boost_serialization.h"
+#include "currency_core/currency_basic.h"
+
+#define SPARSE_BLOCK_IDS_DEFAULT_RECENT_COUNT         1000
+#define SPARSE_BLOCK_IDS_CHECKPOINTS_PER_OCTAVE       8
+#define SPARSE_BLOCK_IDS_PRUNE_INTERVAL               64
+
+namespace tools
+{
+  /* Ids of the blocks the wallet is synchronized with, without keeping one id per block since genesis.
+   * Ids of the last recent_count blocks are all kept (reorgs are expected to happen within this window),
+   * below them only checkpoint ids remain, spaced exponentially with the distance from the top:
+   * about SPARSE_BLOCK_IDS_CHECKPOINTS_PER_OCTAVE ids per every doubling of the distance, genesis is always kept.
+   */
+  class sparse_block_ids
+  {
+  public:
+    explicit sparse_block_ids(size_t recent_count = SPARSE_BLOCK_IDS_DEFAULT_RECENT_COUNT) : m_recent_count(recent_count ? recent_count : 1), m_size(0)
+    {}
+
+    uint64_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+    size_t stored_ids_count() const { return m_recent.size() + m_checkpoints.size(); }
+
+    void clear()
+    {
+      m_recent.clear();
+      m_checkpoints.clear();
+      m_size = 0;
+    }
+
+    void push_back(const crypto::hash& id)
+    {
+      m_recent.push_back(id);
+      ++m_size;
+      while (m_recent.size() > m_recent_count)
+      {
+        uint64_t height = m_size - m_recent.size();
+        if (is_checkpoint_height(height))
+          m_checkpoints[height] = m_recent.front();
+        m_recent.pop_front();
+      }
+      if (m_size % SPARSE_BLOCK_IDS_PRUNE_INTERVAL == 0)
+        prune_checkpoints();
+    }
+
+    // replaces content with the full list of ids (e.g. from the old wallet file format)
+    void assign(const std::vector<crypto::hash>& ids)
+    {
+      clear();
+      for (const auto& id : ids)
+        push_back(id);
+      prune_checkpoints();
+    }
+
+    // cuts the chain down to new_size blocks
+    void truncate(uint64_t new_size)
+    {
+      if (new_size >= m_size)
+        return;
+      uint64_t recent_start = m_size - m_recent.size();
+      if (new_size > recent_start)
+        m_recent.erase(m_recent.begin() + (new_size - recent_start), m_recent.end());
+      else
+        m_recent.clear();
+      m_checkpoints.erase(m_checkpoints.lower_bound(new_size), m_checkpoints.end());
+      m_size = new_size;
+    }
+
+    // returns false if the id at this height is not kept
+    bool get(uint64_t height, crypto::hash& id) const
+    {
+      if (height >= m_size)
+        return false;
+      uint64_t recent_start = m_size - m_recent.size();
+      if (height >= recent_start)
+      {
+        id = m_recent[height - recent_start];
+        return true;
+      }
+      auto it = m_checkpoints.find(height);
+      if (it == m_checkpoints.end())
+        return false;
+      id = it->second;
+      return true;
+    }
+
+    // currency::null_hash if the top id is not kept (may happen only after truncating below the recent ids)
+    crypto::hash back() const
+    {
+      crypto::hash id = currency::null_hash;
+      if (m_size)
+        get(m_size - 1, id);
+      return id;
+    }
+
+    // true if all the ids from the given height up to the top are kept
+    bool has_ids_from(uint64_t height) const
+    {
+      return height >= m_size - m_recent.size();
+    }
+
+    bool get_ids_from(uint64_t height, std::vector<crypto::hash>& ids) const
+    {
+      if (!has_ids_from(height))
+        return false;
+      uint64_t recent_start = m_size - m_recent.size();
+      ids.assign(m_recent.begin() + (height - recent_start), m_recent.end());
+      return true;
+    }
+
+    /* Ids for getblocks.bin: 10 sequential ones from the top, then with doubling step, genesis at the end.
+     * Where the exact id is not kept, the nearest lower checkpoint goes instead.
+     */
+    void get_short_chain_history(std::list<crypto::hash>& ids) const
+    {
+      if (!m_size)
+        return;
+      size_t i = 0;
+      size_t current_multiplier = 1;
+      size_t current_back_offset = 1;
+      uint64_t last_height = m_size;
+      while (current_back_offset < m_size)
+      {
+        uint64_t height = m_size - current_back_offset;
+        crypto::hash id = currency::null_hash;
+        if (!get(height, id))
+        {
+          auto it = m_checkpoints.upper_bound(height);
+          if (it == m_checkpoints.begin())
+            break;
+          --it;
+          height = it->first;
+          id = it->second;
+        }
+        if (height < last_height)
+        {
+          ids.push_back(id);
+          last_height = height;
+        }
+        if (i < 10)
+        {
+          ++current_back_offset;
+        }else
+        {
+          current_back_offset += current_multiplier *= 2;
+        }
+        ++i;
+      }
+      crypto::hash genesis_id = currency::null_hash;
+      if (last_height != 0 && get(0, genesis_id))
+        ids.push_back(genesis_id);
+    }
+
+    template <class t_archive>
+    inline void serialize(t_archive &a, const unsigned int ver)
+    {
+      a & m_size;
+      a & m_recent;
+      a & m_checkpoints;
+    }
+
+  private:
+    bool is_checkpoint_height(uint64_t height) const
+    {
+      uint64_t distance = m_size - height;
+      uint64_t step = 1;
+      while (step * 2 * SPARSE_BLOCK_IDS_CHECKPOINTS_PER_OCTAVE <= distance)
+        step *= 2;
+      return height % step == 0;
+    }
+
+    // checkpoint steps only grow with the distance, so pruning never needs ids that were dropped before
+    void prune_checkpoints()
+    {
+      for (auto it = m_checkpoints.begin(); it != m_checkpoints.end(); )
+      {
+        if (is_checkpoint_height(it->first))
+          ++it;
+        else
+          it = m_checkpoints.erase(it);
+      }
+    }
+
+    size_t m_recent_count;
+    uint64_t m_size;
+    std::deque<crypto::hash> m_recent;                 // ids of blocks [m_size - m_recent.size(), m_size)
+    std::map<uint64_t, crypto::hash> m_checkpoints;    // height -> id, all below the recent ids
+  };
+}
@@ -0,0 +1,186 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <list>
+#include <map>
+#include <set>
+#include <unordered_map>
+
+#include "currency_core/currency_format_utils.h"
+
+namespace tools
+{
+  /* Index of wallet's unspent outputs (referenced by transfer index), kept up to date incrementally,
+   * so that outputs selection doesn't have to walk through the whole transfers container.
+   * Unlocked outputs are bucketed by amount; locked ones wait in a queue ordered by the chain size
+   * at which they become spendable. Outputs locked by timestamp are additionally held until that time.
+   */
+  class unspent_outputs_index
+  {
+  public:
+    unspent_outputs_index() : m_chain_size(0), m_time(0)
+    {}
+
+    void clear()
+    {
+      m_entries.clear();
+      m_unlocked.clear();
+      m_locked_by_height.clear();
+      m_locked_by_time.clear();
+    }
+
+    // unlock_chain_size -- minimum local chain size the output is spendable at,
+    // unlock_time -- minimum timestamp the output is spendable at (0 if not locked by time)
+    void add(size_t transfer_index, uint64_t amount, uint8_t mix_attr, uint64_t unlock_chain_size, uint64_t unlock_time)
+    {
+      remove(transfer_index);
+      entry& e = m_entries[transfer_index];
+      e.amount = amount;
+      e.mix_attr = mix_attr;
+      e.unlock_chain_size = unlock_chain_size;
+      e.unlock_time = unlock_time;
+
+      if (unlock_chain_size > m_chain_size)
+        m_locked_by_height.insert(std::make_pair(unlock_chain_size, transfer_index));
+      else if (unlock_time > m_time)
+        m_locked_by_time.insert(std::make_pair(unlock_time, transfer_index));
+      else
+        m_unlocked[amount].insert(transfer_index);
+    }
+
+    void remove(size_t transfer_index)
+    {
+      auto it = m_entries.find(transfer_index);
+      if (it == m_entries.end())
+        return;
+
+      const entry& e = it->second;
+      if (!erase_from_queue(m_locked_by_height, e.unlock_chain_size, transfer_index) &&
+          !erase_from_queue(m_locked_by_time, e.unlock_time, transfer_index))
+      {
+        auto bucket_it = m_unlocked.find(e.amount);
+        if (bucket_it != m_unlocked.end())
+        {
+          bucket_it->second.erase(transfer_index);
+          if (bucket_it->second.empty())
+            m_unlocked.erase(bucket_it);
+        }
+      }
+      m_entries.erase(it);
+    }
+
+    // moves outputs that became spendable into amount buckets; only growth is handled here,
+    // on chain size decrease (i.e. detach) the index should be rebuilt
+    void set_chain_size(uint64_t chain_size)
+    {
+      m_chain_size = chain_size;
+      while (!m_locked_by_height.empty() && m_locked_by_height.begin()->first <= m_chain_size)
+      {
+        size_t transfer_index = m_locked_by_height.begin()->second;
+        m_locked_by_height.erase(m_locked_by_height.begin());
+        const entry& e = m_entries[transfer_index];
+        if (e.unlock_time > m_time)
+          m_locked_by_time.insert(std::make_pair(e.unlock_time, transfer_index));
+        else
+          m_unlocked[e.amount].insert(transfer_index);
+      }
+    }
+
+    void set_time(uint64_t time)
+    {
+      m_time = time;
+      while (!m_locked_by_time.empty() && m_locked_by_time.begin()->first <= m_time)
+      {
+        size_t transfer_index = m_locked_by_time.begin()->second;
+        m_locked_by_time.erase(m_locked_by_time.begin());
+        m_unlocked[m_entries[transfer_index].amount].insert(transfer_index);
+      }
+    }
+
+    /* Same strategy as wallet2::select_indices_for_transfer(): take the smallest amount that covers the rest of
+     * needed money, otherwise take the biggest amount and repeat. Within an amount the latest transfer is taken first.
+     */
+    uint64_t select(uint64_t needed_money, size_t fake_outputs_count, std::list<size_t>& selected_indexes) const
+    {
+      std::set<size_t> taken;
+      uint64_t found_money = 0;
+      while (found_money < needed_money)
+      {
+        size_t transfer_index = 0;
+        auto it = m_unlocked.lower_bound(needed_money - found_money);
+        for (; it != m_unlocked.end(); ++it)
+          if (pick_from_bucket(it->second, fake_outputs_count, taken, transfer_index))
+            break;
+
+        if (it != m_unlocked.end())
+        {
+          found_money += it->first;
+          selected_indexes.push_back(transfer_index);
+          break;
+        }
+
+        auto rit = m_unlocked.rbegin();
+        for (; rit != m_unlocked.rend(); ++rit)
+          if (pick_from_bucket(rit->second, fake_outputs_count, taken, transfer_index))
+            break;
+
+        if (rit == m_unlocked.rend())
+          break;
+
+        found_money += rit->first;
+        selected_indexes.push_back(transfer_index);
+        taken.insert(transfer_index);
+      }
+      return found_money;
+    }
+
+    size_t size() const { return m_entries.size(); }
+    size_t unlocked_amounts_count() const { return m_unlocked.size(); }
+
+  private:
+    struct entry
+    {
+      uint64_t amount;
+      uint8_t mix_attr;
+      uint64_t unlock_chain_size;
+      uint64_t unlock_time;
+    };
+
+    static bool erase_from_queue(std::multimap<uint64_t, size_t>& queue, uint64_t key, size_t transfer_index)
+    {
+      auto range = queue.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it)
+      {
+        if (it->second == transfer_index)
+        {
+          queue.erase(it);
+          return true;
+        }
+      }
+      return false;
+    }
+
+    bool pick_from_bucket(const std::set<size_t>& bucket, size_t fake_outputs_count, const std::set<size_t>& taken, size_t& transfer_index) const
+    {
+      for (auto it = bucket.rbegin(); it != bucket.rend(); ++it)
+      {
+        if (taken.count(*it))
+          continue;
+        if (!currency::is_mixattr_applicable_for_fake_outs_counter(m_entries.at(*it).mix_attr, fake_outputs_count))
+          continue;
+        transfer_index = *it;
+        return true;
+      }
+      return false;
+    }
+
+    std::unordered_map<size_t, entry> m_entries;                // all unspent outputs
+    std::map<uint64_t, std::set<size_t> > m_unlocked;           // amount -> transfer indices
+    std::multimap<uint64_t, size_t> m_locked_by_height;         // unlock chain size -> transfer index
+    std::multimap<uint64_t, size_t> m_locked_by_time;           // unlock time -> transfer index
+    uint64_t m_chain_size;
+    uint64_t m_time;
+  };
+}
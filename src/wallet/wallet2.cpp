@@ -3,6 +3,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 
+#include <deque>
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
 
@@ -57,20 +58,193 @@ std::shared_ptr<i_core_proxy> wallet2::get_core_proxy()
   return m_core_proxy;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b)
+void wallet2::parse_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, uint64_t min_timestamp, size_t threads_count, std::vector<block_scan_result>& results)
 {
-  crypto::hash tx_hash = get_transaction_hash(tx);
+  std::vector<const currency::block_complete_entry*> entries;
+  entries.reserve(res.blocks.size());
+  for (auto& bl_entry : res.blocks)
+    entries.push_back(&bl_entry);
 
-  std::string recipient, recipient_alias;
-  process_unconfirmed(tx, recipient, recipient_alias);
-  std::vector<size_t> outs;
-  uint64_t tx_money_got_in_outs = 0;
-  crypto::public_key tx_pub_key = null_pkey;
-  bool r = parse_and_validate_tx_extra(tx, tx_pub_key);
-  CHECK_AND_THROW_WALLET_EX(!r, error::tx_extra_parse_error, tx);
+  // global outputs indexes are optional: daemons that don't support them return nothing
+  std::vector<const currency::block_global_outs_indexes*> entries_indexes;
+  if (res.global_outs_indexes.size() == res.blocks.size())
+  {
+    entries_indexes.reserve(res.global_outs_indexes.size());
+    for (auto& bl_indexes : res.global_outs_indexes)
+      entries_indexes.push_back(&bl_indexes);
+  }
+
+  results.clear();
+  results.resize(entries.size());
+
+  tools::parallel_for(entries.size(), threads_count, [&](size_t i)
+  {
+    block_scan_result& bsr = results[i];
+    const currency::block_complete_entry& bl_entry = *entries[i];
+    bsr.txs_parsed = false;
+    bsr.block_parsed = currency::parse_and_validate_block_from_blob(bl_entry.block, bsr.b);
+    if (!bsr.block_parsed)
+      return;
+    bsr.id = get_block_hash(bsr.b);
+
+    //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
+    if (bsr.b.timestamp + 60 * 60 * 24 <= min_timestamp)
+      return;
+    bsr.txs_parsed = true;
+
+    bsr.txs.resize(bl_entry.txs.size() + 1);
+    bsr.txs[0].tx = bsr.b.miner_tx;
+    bsr.txs[0].tx_parsed = true;
+    bsr.txs[0].compact = false;
+    size_t j = 1;
+    for (auto& txblob : bl_entry.txs)
+    {
+      tx_scan_result& tsr = bsr.txs[j++];
+      tsr.compact = res.compact_txs;
+      if (!res.compact_txs)
+      {
+        tsr.tx_parsed = parse_and_validate_tx_from_blob(txblob, tsr.tx);
+        continue;
+      }
+      // compact entry doesn't have tx hash, it's taken from the block
+      compact_tx_entry cte = AUTO_VAL_INIT(cte);
+      tsr.tx_parsed = j - 2 < bsr.b.tx_hashes.size() && t_unserializable_object_from_blob(cte, txblob);
+      if (!tsr.tx_parsed)
+        continue;
+      get_tx_from_compact_entry(cte, tsr.tx);
+      tsr.tx_hash = bsr.b.tx_hashes[j - 2];
+      tsr.tx_pub_key = cte.tx_pub_key;
+      tsr.extra_parsed = cte.extra_parsed != 0;
+    }
 
-  r = lookup_acc_outs(m_account.get_keys(), tx, tx_pub_key, outs, tx_money_got_in_outs);
-  CHECK_AND_THROW_WALLET_EX(!r, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
+    for (auto& tsr : bsr.txs)
+    {
+      if (tsr.compact)
+        continue;
+      tsr.tx_pub_key = null_pkey;
+      tsr.extra_parsed = false;
+      if (!tsr.tx_parsed)
+        continue;
+      tsr.tx_hash = get_transaction_hash(tsr.tx);
+      tsr.extra_parsed = parse_and_validate_tx_extra(tsr.tx, tsr.tx_pub_key);
+    }
+
+    if (!entries_indexes.empty() && entries_indexes[i]->txs.size() == bsr.txs.size())
+    {
+      for (size_t k = 0; k != bsr.txs.size(); ++k)
+        bsr.txs[k].global_outs_indexes = entries_indexes[i]->txs[k].indexes;
+    }
+  });
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_block_to_be_scanned(const block_scan_result& bsr) const
+{
+  return bsr.txs_parsed && bsr.b.timestamp + 60 * 60 * 24 > m_account.get_createtime();
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_block_to_be_fast_forwarded(uint64_t height, uint64_t timestamp) const
+{
+  // same time margin as in is_block_to_be_scanned, so only blocks that wouldn't be scanned anyway are skipped
+  return height < m_restore_height || timestamp + 60 * 60 * 24 <= m_account.get_createtime();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::lookup_outs(const tx_scan_result& tsr, tx_outs_lookup& lookup) const
+{
+  // must not touch any mutable wallet state, as it's called from several threads at once
+  lookup.money_got_in_outs = 0;
+  lookup.outs.clear();
+  lookup.outs_looked_up = tsr.extra_parsed && lookup_acc_outs(m_account.get_keys(), tsr.tx, tsr.tx_pub_key, lookup.outs, lookup.money_got_in_outs);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::is_tx_related(const tx_scan_result& tsr, const tx_outs_lookup& lookup) const
+{
+  if (!lookup.outs.empty() || m_unconfirmed_txs.count(tsr.tx_hash))
+    return true;
+  for (const auto& in : tsr.tx.vin)
+  {
+    if (in.type() == typeid(currency::txin_to_key) && m_key_images.count(boost::get<currency::txin_to_key>(in).k_image))
+      return true;
+  }
+  return false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fetch_full_txs(const std::list<crypto::hash>& tx_ids, full_txs_container& txs)
+{
+  currency::COMMAND_RPC_GET_TRANSACTIONS::request req = AUTO_VAL_INIT(req);
+  currency::COMMAND_RPC_GET_TRANSACTIONS::response res = AUTO_VAL_INIT(res);
+  for (const auto& id : tx_ids)
+    req.txs_hashes.push_back(string_tools::pod_to_hex(id));
+  bool r = m_core_proxy->call_COMMAND_RPC_GET_TRANSACTIONS(req, res);
+  CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "gettransactions");
+  CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "gettransactions");
+  CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
+  for (const auto& tx_hex : res.txs_as_hex)
+  {
+    currency::blobdata tx_blob;
+    r = string_tools::parse_hexstr_to_binbuff(tx_hex, tx_blob);
+    CHECK_AND_THROW_WALLET_EX(!r, error::wallet_internal_error, "failed to parse tx hex returned by gettransactions");
+    currency::transaction tx;
+    r = parse_and_validate_tx_from_blob(tx_blob, tx);
+    CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, tx_blob);
+    txs[get_transaction_hash(tx)] = tx;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fetch_related_full_txs(const std::vector<block_scan_result>& blocks, const blocks_outs_lookups& lookups, size_t first_block, uint64_t start_height, full_txs_container& txs)
+{
+  // one request for all the blocks of a response; blocks the wallet has already are not processed again, so they are skipped
+  std::list<crypto::hash> related_tx_ids;
+  for (size_t b = first_block; b < blocks.size() && b < lookups.size(); ++b)
+  {
+    const block_scan_result& bsr = blocks[b];
+    crypto::hash local_bl_id = null_hash;
+    if (!bsr.block_parsed || (start_height + b < m_blockchain.size() && m_blockchain.get(start_height + b, local_bl_id) && local_bl_id == bsr.id))
+      continue;
+    for (size_t i = 1; i < bsr.txs.size() && i < lookups[b].size(); ++i)
+      if (bsr.txs[i].compact && bsr.txs[i].tx_parsed && !txs.count(bsr.txs[i].tx_hash) && is_tx_related(bsr.txs[i], lookups[b][i]))
+        related_tx_ids.push_back(bsr.txs[i].tx_hash);
+  }
+  if (!related_tx_ids.empty())
+    fetch_full_txs(related_tx_ids, txs);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::scan_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::vector<block_scan_result>& results, blocks_outs_lookups& lookups) const
+{
+  // stage 1: parse blocks and tx blobs
+  parse_blocks(res, m_account.get_createtime(), m_scan_threads_count, results);
+
+  // stage 2: look for own outputs, transactions of all the blocks are spread over threads
+  lookups.clear();
+  lookups.resize(results.size());
+  std::vector<std::pair<const tx_scan_result*, tx_outs_lookup*> > txs;
+  for (size_t i = 0; i != results.size(); ++i)
+  {
+    if (!is_block_to_be_scanned(results[i]))
+      continue;
+    lookups[i].resize(results[i].txs.size());
+    for (size_t j = 0; j != results[i].txs.size(); ++j)
+      if (results[i].txs[j].tx_parsed)
+        txs.push_back(std::make_pair(&results[i].txs[j], &lookups[i][j]));
+  }
+
+  tools::parallel_for(txs.size(), m_scan_threads_count, [&](size_t i)
+  {
+    lookup_outs(*txs[i].first, *txs[i].second);
+  });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_new_transaction(const tx_scan_result& tsr, const tx_outs_lookup& lookup, uint64_t height, const currency::block& b)
+{
+  const currency::transaction& tx = tsr.tx;
+  const crypto::hash& tx_hash = tsr.tx_hash;
+
+  std::string recipient, recipient_alias;
+  process_unconfirmed(tx_hash, recipient, recipient_alias);
+  CHECK_AND_THROW_WALLET_EX(!tsr.extra_parsed, error::tx_extra_parse_error, tx);
+  const crypto::public_key& tx_pub_key = tsr.tx_pub_key;
+  CHECK_AND_THROW_WALLET_EX(!lookup.outs_looked_up, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
+  const std::vector<size_t>& outs = lookup.outs;
+  uint64_t tx_money_got_in_outs = lookup.money_got_in_outs;
 
   money_transfer2_details mtd;
 
@@ -78,13 +252,21 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
   {
     //good news - got money! take care about it
     //usually we have only one transfer for user in transaction
-    currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
     currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response res = AUTO_VAL_INIT(res);
-    req.txid = tx_hash;
-    bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(req, res);
-    CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
-    CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
-    CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
+    if (!tsr.global_outs_indexes.empty())
+    {
+      // already delivered along with the block
+      res.o_indexes = tsr.global_outs_indexes;
+    }
+    else
+    {
+      currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
+      req.txid = tx_hash;
+      bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(req, res);
+      CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
+      CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
+      CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
+    }
     CHECK_AND_THROW_WALLET_EX(res.o_indexes.size() != tx.vout.size(), error::wallet_internal_error,
       "transactions outputs size=" + std::to_string(tx.vout.size()) +
       " not match with COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES response size=" + std::to_string(res.o_indexes.size()));
@@ -152,6 +334,7 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
 
       if (ki != null_key_image)
         m_key_images[td.m_key_image] = m_transfers.size()-1;
+      add_to_unspent_index(m_transfers.size() - 1);
 
       LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << tx_hash);
       if (0 != m_callback)
@@ -196,6 +379,8 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
         payment.m_block_height = height;
         payment.m_unlock_time  = tx.unlock_time;
         m_payments.emplace(payment_id, payment);
+        m_payments_by_height.emplace(std::make_pair(height, payment_id), payment);
+        m_journal_tracking.new_payments.push_back(std::make_pair(payment_id, payment));
         LOG_PRINT_L2("Payment found: " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
       }
     }
@@ -260,37 +445,59 @@ void wallet2::handle_money_spent2(const currency::block& b, const currency::tran
     m_callback->on_transfer2(wti);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_unconfirmed(const currency::transaction& tx, std::string& recipient, std::string& recipient_alias)
+void wallet2::process_unconfirmed(const crypto::hash& tx_hash, std::string& recipient, std::string& recipient_alias)
 {
-  auto unconf_it = m_unconfirmed_txs.find(get_transaction_hash(tx));
+  auto unconf_it = m_unconfirmed_txs.find(tx_hash);
   if (unconf_it != m_unconfirmed_txs.end())
   {
     recipient = unconf_it->second.m_recipient;
     recipient_alias = unconf_it->second.m_recipient_alias;
     m_unconfirmed_txs.erase(unconf_it);
+    m_journal_tracking.unconfirmed_txs_changed = true;
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height)
+void wallet2::process_new_blockchain_entry(const block_scan_result& bsr, const std::vector<tx_outs_lookup>& lookups, const currency::block_complete_entry& bche, uint64_t height, full_txs_container& full_txs)
 {
+  const currency::block& b = bsr.b;
+  const crypto::hash& bl_id = bsr.id;
   //handle transactions from new block
   CHECK_AND_THROW_WALLET_EX(height != m_blockchain.size(), error::wallet_internal_error,
     "current_index=" + std::to_string(height) + ", m_blockchain.size()=" + std::to_string(m_blockchain.size()));
 
-  //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
-  if(b.timestamp + 60*60*24 > m_account.get_createtime())
+  if(!lookups.empty())
   {
+    CHECK_AND_THROW_WALLET_EX(bsr.txs.size() != bche.txs.size() + 1 || lookups.size() != bsr.txs.size(), error::wallet_internal_error,
+      "scanned txs count=" + std::to_string(bsr.txs.size()) + ", looked up txs count=" + std::to_string(lookups.size()) + " doesn't match block entry txs count=" + std::to_string(bche.txs.size()));
+
     TIME_MEASURE_START(miner_tx_handle_time);
-    process_new_transaction(b.miner_tx, height, b);
+    process_new_transaction(bsr.txs[0], lookups[0], height, b);
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
+    size_t tx_index = 1;
     BOOST_FOREACH(auto& txblob, bche.txs)
     {
-      currency::transaction tx;
-      bool r = parse_and_validate_tx_from_blob(txblob, tx);
-      CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, txblob);
-      process_new_transaction(tx, height, b);
+      const tx_scan_result& tsr = bsr.txs[tx_index];
+      CHECK_AND_THROW_WALLET_EX(!tsr.tx_parsed, error::tx_parse_error, txblob);
+      // full txs are fetched for the whole response beforehand (see fetch_related_full_txs), but a tx may also turn out
+      // to spend an output received earlier in the same response, then it's fetched alone
+      if (tsr.compact && is_tx_related(tsr, lookups[tx_index]))
+      {
+        if (!full_txs.count(tsr.tx_hash))
+          fetch_full_txs(std::list<crypto::hash>(1, tsr.tx_hash), full_txs);
+        auto it = full_txs.find(tsr.tx_hash);
+        CHECK_AND_THROW_WALLET_EX(it == full_txs.end(), error::wallet_internal_error, "daemon didn't return transaction " + string_tools::pod_to_hex(tsr.tx_hash));
+        tx_scan_result full_tsr = tsr;
+        full_tsr.tx = it->second;
+        full_tsr.compact = false;
+        process_new_transaction(full_tsr, lookups[tx_index], height, b);
+      }
+      else
+      {
+        process_new_transaction(tsr, lookups[tx_index], height, b);
+      }
+      ++tx_index;
     }
     TIME_MEASURE_FINISH(txs_handle_time);
     LOG_PRINT_L2("Processed block: " << bl_id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
@@ -300,6 +507,7 @@ void wallet2::process_new_blockchain_entry(const currency::block& b, currency::b
   }
   m_blockchain.push_back(bl_id);
   ++m_local_bc_height;
+  m_unspent_index.set_chain_size(m_blockchain.size());
 
   if (0 != m_callback)
     m_callback->on_new_block(height, b);
@@ -307,73 +515,64 @@ void wallet2::process_new_blockchain_entry(const currency::block& b, currency::b
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_short_chain_history(std::list<crypto::hash>& ids)
 {
-  size_t i = 0;
-  size_t current_multiplier = 1;
-  size_t sz = m_blockchain.size();
-  if(!sz)
-    return;
-  size_t current_back_offset = 1;
-  bool genesis_included = false;
-  while(current_back_offset < sz)
-  {
-    ids.push_back(m_blockchain[sz-current_back_offset]);
-    if(sz-current_back_offset == 0)
-      genesis_included = true;
-    if(i < 10)
-    {
-      ++current_back_offset;
-    }else
-    {
-      current_back_offset += current_multiplier *= 2;
-    }
-    ++i;
-  }
-  if(!genesis_included)
-    ids.push_back(m_blockchain[0]);
+  m_blockchain.get_short_chain_history(ids);
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::pull_blocks(size_t& blocks_added)
+void wallet2::fetch_blocks(i_core_proxy& proxy, const std::list<crypto::hash>& block_ids, size_t local_chain_size, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res) const
 {
-  blocks_added = 0;
   currency::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
-  currency::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
-  PROF_L2_START(get_short_chain_history_time);
-  get_short_chain_history(req.block_ids);
-  PROF_L2_FINISH(get_short_chain_history_time);
-  PROF_L2_START(rpc_get_blocks_time);
-  bool r = m_core_proxy->call_COMMAND_RPC_GET_BLOCKS_FAST(req, res);
+  req.block_ids = block_ids;
+  req.need_global_outs_indexes = true;
+  req.compact_txs = m_compact_sync;
+  bool r = proxy.call_COMMAND_RPC_GET_BLOCKS_FAST(req, res);
   CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "getblocks.bin");
   CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
   CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
-  CHECK_AND_THROW_WALLET_EX(m_blockchain.size() <= res.start_height, error::wallet_internal_error,
+  CHECK_AND_THROW_WALLET_EX(local_chain_size <= res.start_height, error::wallet_internal_error,
     "wrong daemon response: m_start_height=" + std::to_string(res.start_height) +
-    " not less than local blockchain size=" + std::to_string(m_blockchain.size()));
-  PROF_L2_FINISH(rpc_get_blocks_time);
+    " not less than local blockchain size=" + std::to_string(local_chain_size));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_fetched_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, const std::vector<block_scan_result>& scanned_blocks, const blocks_outs_lookups& lookups, size_t& blocks_added)
+{
+  CHECK_AND_THROW_WALLET_EX(scanned_blocks.size() != res.blocks.size() || lookups.size() != res.blocks.size(), error::wallet_internal_error,
+    "scanned blocks count=" + std::to_string(scanned_blocks.size()) + ", looked up blocks count=" + std::to_string(lookups.size()) + " doesn't match fetched blocks count=" + std::to_string(res.blocks.size()));
+
+  full_txs_container full_txs;
+  fetch_related_full_txs(scanned_blocks, lookups, 0, res.start_height, full_txs);
 
-  PROF_L2_START(process_blocks_time);
   size_t current_index = res.start_height;
+  size_t block_index = 0;
   for(auto& bl_entry : res.blocks)
   {
-    currency::block bl;
-    r = currency::parse_and_validate_block_from_blob(bl_entry.block, bl);
-    CHECK_AND_THROW_WALLET_EX(!r, error::block_parse_error, bl_entry.block);
+    const block_scan_result& bsr = scanned_blocks[block_index];
+    const std::vector<tx_outs_lookup>& bl_lookups = lookups[block_index++];
+    CHECK_AND_THROW_WALLET_EX(!bsr.block_parsed, error::block_parse_error, bl_entry.block);
 
-    crypto::hash bl_id = get_block_hash(bl);
+    const crypto::hash& bl_id = bsr.id;
+    crypto::hash local_bl_id = null_hash;
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bsr, bl_lookups, bl_entry, current_index, full_txs);
       ++blocks_added;
     }
-    else if(bl_id != m_blockchain[current_index])
+    else if(!m_blockchain.get(current_index, local_bl_id))
+    {
+      // the daemon went below recent block ids, i.e. the split is deeper than them; local id can't be compared, so resync from here
+      LOG_PRINT_L0("Block id @ " << current_index << " is not kept by the wallet, resyncing from this height");
+      detach_blockchain(current_index);
+      process_new_blockchain_entry(bsr, bl_lookups, bl_entry, current_index, full_txs);
+    }
+    else if(bl_id != local_bl_id)
     {
       //split detected here !!!
       CHECK_AND_THROW_WALLET_EX(current_index == res.start_height, error::wallet_internal_error,
         "wrong daemon response: split starts from the first block in response " + string_tools::pod_to_hex(bl_id) + 
         " (height " + std::to_string(res.start_height) + "), local block id at this height: " +
-        string_tools::pod_to_hex(m_blockchain[current_index]));
+        string_tools::pod_to_hex(local_bl_id));
 
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bsr, bl_lookups, bl_entry, current_index, full_txs);
     }
     else
     {
@@ -382,9 +581,226 @@ void wallet2::pull_blocks(size_t& blocks_added)
 
     ++current_index;
   }
+  publish_read_view();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_blocks(size_t& blocks_added, uint64_t& daemon_height)
+{
+  blocks_added = 0;
+  currency::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+  PROF_L2_START(get_short_chain_history_time);
+  std::list<crypto::hash> block_ids;
+  get_short_chain_history(block_ids);
+  PROF_L2_FINISH(get_short_chain_history_time);
+  PROF_L2_START(rpc_get_blocks_time);
+  fetch_blocks(*m_core_proxy, block_ids, m_blockchain.size(), res);
+  daemon_height = res.current_height;
+  PROF_L2_FINISH(rpc_get_blocks_time);
+
+  PROF_L2_START(scan_blocks_time);
+  std::vector<block_scan_result> scanned_blocks;
+  blocks_outs_lookups lookups;
+  scan_blocks(res, scanned_blocks, lookups);
+  PROF_L2_FINISH(scan_blocks_time);
+
+  PROF_L2_START(process_blocks_time);
+  process_fetched_blocks(res, scanned_blocks, lookups, blocks_added);
   PROF_L2_FINISH(process_blocks_time);
   PROF_L2_LOG_PRINT("pull_blocks: " << res.blocks.size() << " blocks processed, timings: short_chain_history: " << print_mcsec_as_ms(get_short_chain_history_time)
-    << ", rpc_get_blocks: " << print_mcsec_as_ms(rpc_get_blocks_time) << ", process_blocks: " << print_mcsec_as_ms(process_blocks_time), LOG_LEVEL_2);
+    << ", rpc_get_blocks: " << print_mcsec_as_ms(rpc_get_blocks_time) << ", scan_blocks(" << m_scan_threads_count << " threads): " << print_mcsec_as_ms(scan_blocks_time)
+    << ", process_blocks: " << print_mcsec_as_ms(process_blocks_time), LOG_LEVEL_2);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fast_forward_blockchain(size_t& blocks_added)
+{
+  blocks_added = 0;
+  TIME_MEASURE_START_MS(fast_forward_time);
+  while (!m_fast_forward_done && m_run.load(std::memory_order_relaxed))
+  {
+    // even the oldest possible block would be scanned, nothing to skip
+    if (!is_block_to_be_fast_forwarded(m_blockchain.size(), 0))
+    {
+      m_fast_forward_done = true;
+      break;
+    }
+
+    currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request req = AUTO_VAL_INIT(req);
+    currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response res = AUTO_VAL_INIT(res);
+    get_short_chain_history(req.block_ids);
+    bool r = m_core_proxy->call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(req, res);
+    if (!r)
+    {
+      // the daemon may be too old to have this call, then all the blocks are fetched in full as before
+      LOG_PRINT_L1("getblocks_ids.bin failed, blocks will be fetched in full");
+      m_fast_forward_done = true;
+      break;
+    }
+    CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks_ids.bin");
+    CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
+    CHECK_AND_THROW_WALLET_EX(res.ids.size() != res.timestamps.size(), error::wallet_internal_error,
+      "wrong daemon response: ids count=" + std::to_string(res.ids.size()) + " doesn't match timestamps count=" + std::to_string(res.timestamps.size()));
+    CHECK_AND_THROW_WALLET_EX(m_blockchain.size() <= res.start_height, error::wallet_internal_error,
+      "wrong daemon response: m_start_height=" + std::to_string(res.start_height) +
+      " not less than local blockchain size=" + std::to_string(m_blockchain.size()));
+
+    size_t added = 0;
+    uint64_t height = res.start_height;
+    auto ts_it = res.timestamps.begin();
+    for (auto id_it = res.ids.begin(); id_it != res.ids.end(); ++id_it, ++ts_it, ++height)
+    {
+      if (height < m_blockchain.size())
+      {
+        crypto::hash local_bl_id = null_hash;
+        bool kept = m_blockchain.get(height, local_bl_id);
+        if (kept && local_bl_id == *id_it)
+          continue;
+        CHECK_AND_THROW_WALLET_EX(kept && height == res.start_height, error::wallet_internal_error,
+          "wrong daemon response: split starts from the first block id in response " + string_tools::pod_to_hex(*id_it) +
+          " (height " + std::to_string(res.start_height) + "), local block id at this height: " + string_tools::pod_to_hex(local_bl_id));
+        detach_blockchain(height);
+      }
+      if (!is_block_to_be_fast_forwarded(height, *ts_it))
+      {
+        m_fast_forward_done = true;
+        break;
+      }
+      m_blockchain.push_back(*id_it);
+      ++m_local_bc_height;
+      ++added;
+    }
+    m_unspent_index.set_chain_size(m_blockchain.size());
+    blocks_added += added;
+    if (!added || m_blockchain.size() >= res.current_height)
+      m_fast_forward_done = true;
+  }
+  TIME_MEASURE_FINISH_MS(fast_forward_time);
+  if (blocks_added)
+  {
+    publish_read_view();
+    LOG_PRINT_L0("Skipped " << blocks_added << " blocks older than the account (ids only) in " << fast_forward_time << " ms, synchronized up to height " << m_blockchain.size());
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::pull_blocks_pipelined(size_t& blocks_added)
+{
+  blocks_added = 0;
+  std::shared_ptr<i_core_proxy> fetch_proxy = m_core_proxy->clone();
+  if (!fetch_proxy)
+  {
+    LOG_PRINT_L2("core proxy can't be cloned, blocks prefetching disabled");
+    return;
+  }
+
+  std::deque<std::shared_ptr<fetched_blocks_batch> > batches;
+  bool stop_fetching = false;
+  bool fetching_done = false;
+  boost::mutex batches_lock;
+  boost::condition_variable batches_cv;
+
+  // Fetcher thread requests the next batch as if the previous ones were already applied, so it keeps
+  // its own copy of the expected chain. It never speculates past a split reported by the daemon.
+  sparse_block_ids expected_chain(m_blockchain);
+  auto fetcher = [&]()
+  {
+    for (;;)
+    {
+      {
+        boost::unique_lock<boost::mutex> lk(batches_lock);
+        while (!stop_fetching && batches.size() >= m_refresh_prefetch_depth)
+          batches_cv.wait(lk);
+        if (stop_fetching || !m_run.load(std::memory_order_relaxed))
+          break;
+      }
+
+      std::shared_ptr<fetched_blocks_batch> batch(new fetched_blocks_batch());
+      batch->expected_chain_size = expected_chain.size();
+      batch->expected_top_id = expected_chain.back();
+      batch->extends_expected_chain = false;
+      bool last_batch = true;
+      try
+      {
+        std::list<crypto::hash> block_ids;
+        expected_chain.get_short_chain_history(block_ids);
+        fetch_blocks(*fetch_proxy, block_ids, expected_chain.size(), batch->res);
+        scan_blocks(batch->res, batch->scanned_blocks, batch->lookups);
+
+        const std::vector<block_scan_result>& sb = batch->scanned_blocks;
+        batch->extends_expected_chain = batch->res.start_height + 1 == expected_chain.size() && !sb.empty() && sb.front().block_parsed && sb.front().id == expected_chain.back();
+
+        expected_chain.truncate(batch->res.start_height);
+        bool all_parsed = true;
+        for (auto& bsr : sb)
+        {
+          if (!(all_parsed = bsr.block_parsed))
+            break;
+          expected_chain.push_back(bsr.id);
+        }
+        last_batch = !batch->extends_expected_chain || !all_parsed || expected_chain.size() <= batch->expected_chain_size ||
+          expected_chain.size() >= batch->res.current_height;
+      }
+      catch (...)
+      {
+        batch->error = std::current_exception();
+      }
+
+      boost::unique_lock<boost::mutex> lk(batches_lock);
+      batches.push_back(batch);
+      fetching_done = last_batch;
+      batches_cv.notify_all();
+      if (last_batch)
+        break;
+    }
+  };
+
+  boost::thread fetch_thread(fetcher);
+  auto stop_fetcher = epee::misc_utils::create_scope_leave_handler([&]()
+  {
+    {
+      boost::unique_lock<boost::mutex> lk(batches_lock);
+      stop_fetching = true;
+      batches_cv.notify_all();
+    }
+    fetch_thread.join();
+  });
+
+  TIME_MEASURE_START_MS(pipeline_time);
+  size_t batches_processed = 0;
+  while (m_run.load(std::memory_order_relaxed))
+  {
+    std::shared_ptr<fetched_blocks_batch> batch;
+    {
+      boost::unique_lock<boost::mutex> lk(batches_lock);
+      while (batches.empty() && !fetching_done)
+        batches_cv.wait(lk);
+      if (batches.empty())
+        break;
+      batch = batches.front();
+      batches.pop_front();
+      batches_cv.notify_all();
+    }
+
+    if (batch->error)
+      std::rethrow_exception(batch->error);
+
+    if (m_blockchain.size() != batch->expected_chain_size || m_blockchain.back() != batch->expected_top_id)
+    {
+      // local chain went another way than expected, so this batch and all fetched after it are useless
+      LOG_PRINT_L1("Prefetched blocks batch doesn't match local blockchain (height " << m_blockchain.size() << "), discarding speculative batches");
+      break;
+    }
+
+    if (!batch->extends_expected_chain)
+      LOG_PRINT_L1("Chain split detected at height " << batch->res.start_height << " while prefetching blocks, stopped fetching ahead");
+
+    PROF_L2_START(process_blocks_time);
+    process_fetched_blocks(batch->res, batch->scanned_blocks, batch->lookups, blocks_added);
+    PROF_L2_FINISH(process_blocks_time);
+    PROF_L2_LOG_PRINT("pull_blocks_pipelined: " << batch->res.blocks.size() << " blocks processed in " << print_mcsec_as_ms(process_blocks_time), LOG_LEVEL_2);
+    ++batches_processed;
+  }
+  TIME_MEASURE_FINISH_MS(pipeline_time);
+  LOG_PRINT_L1("Prefetching refresh: " << blocks_added << " blocks in " << batches_processed << " batches, " << pipeline_time << " ms ("
+    << (blocks_added * 1000) / (pipeline_time ? pipeline_time : 1) << " blocks/s), prefetch depth: " << m_refresh_prefetch_depth);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh()
@@ -495,6 +911,7 @@ void wallet2::scan_tx_pool()
         m_callback->on_transfer2(wti);
     }
   }
+  publish_read_view();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
@@ -503,16 +920,32 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
   blocks_fetched = 0;
   size_t added_blocks = 0;
   size_t try_count = 0;
+  uint64_t daemon_height = 0;
   crypto::hash last_tx_hash_id = m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash;
+  TIME_MEASURE_START_MS(refresh_time);
 
   while(m_run.load(std::memory_order_relaxed))
   {
     try
     {
-      pull_blocks(added_blocks);
+      added_blocks = 0;
+      if(!m_fast_forward_done)
+      {
+        // pull_blocks resets added_blocks, so the skipped blocks are counted before it
+        fast_forward_blockchain(added_blocks);
+        blocks_fetched += added_blocks;
+        added_blocks = 0;
+      }
+      pull_blocks(added_blocks, daemon_height);
       blocks_fetched += added_blocks;
       if(!added_blocks)
         break;
+      if(m_refresh_prefetch_depth && m_blockchain.size() < daemon_height)
+      {
+        // there are more blocks to sync, overlap network with processing
+        pull_blocks_pipelined(added_blocks);
+        blocks_fetched += added_blocks;
+      }
     }
     catch (const std::exception&)
     {
@@ -532,10 +965,12 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
   if(last_tx_hash_id != (m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash))
     received_money = true;
 
-  LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance: " << print_money(balance()) << ", unlocked: " << print_money(unlocked_balance()));
+  TIME_MEASURE_FINISH_MS(refresh_time);
+  LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << " (" << (blocks_fetched * 1000) / (refresh_time ? refresh_time : 1) << " blocks/s)"
+    << ", balance: " << print_money(balance()) << ", unlocked: " << print_money(unlocked_balance()));
   if (blocks_fetched)
     resend_unconfirmed();
-
+  publish_read_view_if_stale();
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::refresh(size_t & blocks_fetched, bool& received_money, bool& ok)
@@ -586,8 +1021,8 @@ void wallet2::detach_blockchain(uint64_t height)
     LOG_ERROR("internal condition failure: transfers_detached: " << transfers_detached << ", elements removed:" << transfers_size_before - m_transfers.size());
   }
 
-  size_t blocks_detached = m_blockchain.end() - (m_blockchain.begin()+height);
-  m_blockchain.erase(m_blockchain.begin()+height, m_blockchain.end());
+  size_t blocks_detached = m_blockchain.size() - height;
+  m_blockchain.truncate(height);
   m_local_bc_height -= blocks_detached;
 
   for (auto it = m_payments.begin(); it != m_payments.end(); )
@@ -597,6 +1032,26 @@ void wallet2::detach_blockchain(uint64_t height)
     else
       ++it;
   }
+  m_payments_by_height.erase(m_payments_by_height.lower_bound(std::make_pair(height, currency::payment_id_t())), m_payments_by_height.end());
+  m_published_payments_height = std::min(m_published_payments_height, height);
+
+  // history of the detached blocks, it's added again as they are processed on the new chain
+  auto hist_it = std::find_if(m_transfer_history.begin(), m_transfer_history.end(), [&](const wallet_rpc::wallet_transfer_info& wti){ return wti.height >= height; });
+  m_transfer_history.erase(hist_it, m_transfer_history.end());
+  m_published_history_count = std::min<uint64_t>(m_published_history_count, m_transfer_history.size());
+
+  // the same cut is to be replayed from the journal
+  journal_tracking& jt = m_journal_tracking;
+  jt.blockchain_size = std::min<uint64_t>(jt.blockchain_size, m_blockchain.size());
+  jt.transfers_count = std::min<uint64_t>(jt.transfers_count, m_transfers.size());
+  jt.history_count = std::min<uint64_t>(jt.history_count, m_transfer_history.size());
+  jt.payments_detach_height = std::min<uint64_t>(jt.payments_detach_height, height);
+  jt.updated_transfers.erase(jt.updated_transfers.lower_bound(m_transfers.size()), jt.updated_transfers.end());
+  jt.new_payments.erase(std::remove_if(jt.new_payments.begin(), jt.new_payments.end(),
+    [height](const std::pair<currency::payment_id_t, payment_details>& p) { return height <= p.second.m_block_height; }), jt.new_payments.end());
+
+  // some of remaining outputs may become locked again, detach is rare enough to simply rebuild the index
+  rebuild_unspent_index();
 
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
 }
@@ -612,6 +1067,7 @@ bool wallet2::clear()
   m_blockchain.clear();
   m_transfers.clear();
   m_payments.clear();
+  m_payments_by_height.clear();
   m_key_images.clear();
   // m_pending_key_images.clear();
   m_transfer_history.clear();
@@ -622,6 +1078,11 @@ bool wallet2::clear()
   currency::generate_genesis_block(b);
   m_blockchain.push_back(get_block_hash(b));
   m_local_bc_height = 1;
+  m_fast_forward_done = false;
+  rebuild_unspent_index();
+  reset_journal_tracking(true);
+  m_published_payments_height = m_published_history_count = 0;
+  publish_read_view();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -728,7 +1189,7 @@ std::vector<unsigned char> wallet2::generate(const std::wstring& wallet_, const
 }
 
 //----------------------------------------------------------------------------------------------------
-void wallet2::restore(const std::wstring& wallet_, const std::vector<unsigned char>& restore_seed, const std::string& password)
+void wallet2::restore(const std::wstring& wallet_, const std::vector<unsigned char>& restore_seed, const std::string& password, uint64_t restore_timestamp /* = 0 */)
 {
   clear();
   prepare_file_names(wallet_);
@@ -738,6 +1199,7 @@ void wallet2::restore(const std::wstring& wallet_, const std::vector<unsigned ch
   CHECK_AND_THROW_WALLET_EX(boost::filesystem::exists(m_keys_file, ignored_ec), error::file_exists, string_encoding::convert_to_ansii(m_keys_file));
 
   m_account.restore(restore_seed);
+  m_account.set_createtime(restore_timestamp);
   m_account_public_address = m_account.get_keys().m_account_address;
 
   bool r = store_keys(m_keys_file, password);
@@ -765,6 +1227,7 @@ bool wallet2::prepare_file_names(const std::wstring& file_path)
   }
 
   m_pending_ki_file = string_tools::cut_off_extension(m_wallet_file) + L".outkey2ki";
+  m_journal_file = m_wallet_file + L".journal";
 
   // make sure file path is accessible and exists
   boost::filesystem::path pp = boost::filesystem::path(file_path).parent_path();
@@ -847,6 +1310,8 @@ void wallet2::load(const std::wstring& wallet_, const std::string& password)
 
   // wallet data file exists
   bool r = tools::unserialize_obj_from_file(*this, m_wallet_file);
+  if (r)
+    load_journal();
 
   bool need_to_resync = false;
   if (!r || m_blockchain.empty() ||
@@ -869,6 +1334,10 @@ void wallet2::load(const std::wstring& wallet_, const std::string& password)
     m_account_public_address = m_account.get_keys().m_account_address;
   }
   m_local_bc_height = m_blockchain.size();
+  rebuild_unspent_index();
+  rebuild_payments_index();
+  m_published_payments_height = m_published_history_count = 0;
+  publish_read_view();
 
   LOG_PRINT_L0("Loaded wallet data from " << string_encoding::convert_to_ansii(m_wallet_file));
   LOG_PRINT_L0("(pending_key_images: " << m_pending_key_images.size() << ", pki file elements: " << m_pending_key_images_file_container.size() << ", tx_keys: " << m_tx_keys.size() << ")");
@@ -879,9 +1348,219 @@ void wallet2::store()
   LOG_PRINT_L0("(before storing: pending_key_images: " << m_pending_key_images.size() << ", pki file elements: " << m_pending_key_images_file_container.size() << ", tx_keys: " << m_tx_keys.size() << ")");
 
   m_account_public_address = m_account.get_keys().m_account_address;
-  bool r = tools::serialize_obj_to_file(*this, m_wallet_file);
+
+  // the journal can't carry block ids that are already out of the recent ones, i.e. after a long refresh
+  if (!m_journal_tracking.snapshot_required && m_journal.is_open() && m_journal.get_snapshot_id() == m_snapshot_id &&
+    m_blockchain.has_ids_from(m_journal_tracking.blockchain_size))
+  {
+    boost::system::error_code ec;
+    uint64_t snapshot_size = boost::filesystem::file_size(m_wallet_file, ec);
+    if (ec)
+      snapshot_size = 0;
+    // keep appending until the journal gets too big compared to the snapshot, then compact it into the new snapshot
+    if (m_journal.size_bytes() < std::max<uint64_t>(WALLET_JOURNAL_COMPACTION_MIN_SIZE, snapshot_size / WALLET_JOURNAL_COMPACTION_SNAPSHOT_RATIO))
+    {
+      if (store_journal_record())
+        return;
+      LOG_PRINT_RED_L0("Failed to append wallet journal " << string_encoding::convert_to_ansii(m_journal_file) << ", storing whole wallet data");
+    }
+  }
+
+  store_snapshot();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_snapshot()
+{
+  do
+  {
+    m_snapshot_id = crypto::rand<uint64_t>();
+  } while (m_snapshot_id == 0);
+
+  // write to temporary file first, so a crash can't leave a half-written wallet file; its data has to be on the disk
+  // before the rename, and the rename before the journal is reset, or a crash could keep the rename but not the data
+  std::wstring tmp_file = m_wallet_file + L".tmp";
+  bool r = tools::serialize_obj_to_file(*this, tmp_file) && tools::journal_file::sync_file(tmp_file);
+  THROW_IF_FALSE_WALLET_EX(r, error::file_save_error, string_encoding::convert_to_ansii(tmp_file));
+  boost::system::error_code ec;
+  boost::filesystem::rename(tmp_file, m_wallet_file, ec);
+  THROW_IF_FALSE_WALLET_EX(!ec, error::file_save_error, string_encoding::convert_to_ansii(m_wallet_file));
+  r = tools::journal_file::sync_file(boost::filesystem::path(m_wallet_file).parent_path().wstring(), true);
   THROW_IF_FALSE_WALLET_EX(r, error::file_save_error, string_encoding::convert_to_ansii(m_wallet_file));
   LOG_PRINT_L0("Stored wallet data into " << string_encoding::convert_to_ansii(m_wallet_file));
+
+  // records of the old journal are already in the snapshot; if it can't be reset it won't match the new snapshot id anyway
+  r = m_journal.create(m_journal_file, m_snapshot_id) && m_journal.sync();
+  if (!r)
+    LOG_ERROR("Failed to reset wallet journal " << string_encoding::convert_to_ansii(m_journal_file));
+  reset_journal_tracking(!r);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::store_journal_record()
+{
+  const journal_tracking& jt = m_journal_tracking;
+  journal_record rec = AUTO_VAL_INIT(rec);
+  rec.blockchain_base = jt.blockchain_size;
+  m_blockchain.get_ids_from(jt.blockchain_size, rec.new_block_ids);
+  rec.transfers_base = jt.transfers_count;
+  rec.new_transfers.assign(m_transfers.begin() + jt.transfers_count, m_transfers.end());
+  for (uint64_t i : jt.updated_transfers)
+  {
+    if (i >= jt.transfers_count)
+      break; // goes with new transfers as is
+    transfer_update tu = AUTO_VAL_INIT(tu);
+    tu.m_index = i;
+    tu.m_spent = m_transfers[i].m_spent;
+    tu.m_key_image = m_transfers[i].m_key_image;
+    rec.updated_transfers.push_back(tu);
+  }
+  rec.history_base = jt.history_count;
+  rec.new_history.assign(m_transfer_history.begin() + jt.history_count, m_transfer_history.end());
+  rec.payments_detach_height = jt.payments_detach_height;
+  rec.new_payments = jt.new_payments;
+  rec.unconfirmed_txs_changed = jt.unconfirmed_txs_changed;
+  if (jt.unconfirmed_txs_changed)
+    rec.unconfirmed_txs = m_unconfirmed_txs;
+  rec.new_tx_keys = jt.new_tx_keys;
+  rec.new_pending_key_images = jt.new_pending_key_images;
+
+  // detach always sets payments_detach_height, so a pure cut is not missed here
+  if (rec.new_block_ids.empty() && rec.new_transfers.empty() && rec.updated_transfers.empty() && rec.new_history.empty() &&
+    rec.payments_detach_height == UINT64_MAX && rec.new_payments.empty() && !rec.unconfirmed_txs_changed && rec.new_tx_keys.empty() && rec.new_pending_key_images.empty())
+  {
+    LOG_PRINT_L1("No wallet changes to store");
+    return true;
+  }
+
+  std::string buff;
+  if (!tools::serialize_obj_to_buff(rec, buff) || !m_journal.append(buff))
+    return false;
+  // the record is what store() leaves on disk, so it has to get there before store() returns
+  if (!m_journal.sync())
+    return false;
+
+  reset_journal_tracking(false);
+  LOG_PRINT_L0("Stored wallet changes into " << string_encoding::convert_to_ansii(m_journal_file) << ": " << rec.new_block_ids.size() << " blocks, " << rec.new_transfers.size() << " transfers, "
+    << rec.updated_transfers.size() << " transfer updates, " << buff.size() << " bytes, journal records: " << m_journal.records_count());
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_journal()
+{
+  std::vector<std::string> records;
+  bool corrupted = false;
+  std::string reason;
+  bool r = m_journal.open(m_journal_file, records, &corrupted, &reason);
+  if (!r)
+  {
+    LOG_ERROR("Failed to open wallet journal " << string_encoding::convert_to_ansii(m_journal_file) << ": " << reason);
+    reset_journal_tracking(true);
+    return;
+  }
+  if (corrupted)
+    LOG_PRINT_RED_L0("Wallet journal " << string_encoding::convert_to_ansii(m_journal_file) << " is corrupted: " << reason);
+
+  if (m_snapshot_id == 0 || m_journal.get_snapshot_id() != m_snapshot_id)
+  {
+    // journal was written on top of another wallet file (e.g. the process crashed right after compaction)
+    if (!records.empty())
+      LOG_PRINT_L0("Wallet journal doesn't match wallet file, " << records.size() << " records ignored");
+    reset_journal_tracking(true);
+    return;
+  }
+
+  size_t applied = 0;
+  for (; applied != records.size(); ++applied)
+  {
+    journal_record rec = AUTO_VAL_INIT(rec);
+    if (!tools::unserialize_obj_from_buff(rec, records[applied]))
+    {
+      LOG_ERROR("Failed to parse wallet journal record #" << applied);
+      break;
+    }
+    try
+    {
+      apply_journal_record(rec);
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("Failed to apply wallet journal record #" << applied << ": " << e.what());
+      break;
+    }
+  }
+
+  // in case of failure the rest of the journal is dropped by writing a new snapshot on the next store
+  reset_journal_tracking(applied != records.size());
+  LOG_PRINT_L0("Replayed " << applied << " of " << records.size() << " wallet journal records from " << string_encoding::convert_to_ansii(m_journal_file));
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::apply_journal_record(const journal_record& rec)
+{
+  THROW_IF_FALSE_WALLET_INT_ERR_EX(rec.blockchain_base <= m_blockchain.size() && rec.transfers_base <= m_transfers.size() && rec.history_base <= m_transfer_history.size(),
+    "journal record doesn't match wallet state: blockchain " << rec.blockchain_base << "/" << m_blockchain.size() << ", transfers " << rec.transfers_base << "/" << m_transfers.size()
+    << ", history " << rec.history_base << "/" << m_transfer_history.size());
+  for (const auto& tu : rec.updated_transfers)
+    THROW_IF_FALSE_WALLET_INT_ERR_EX(tu.m_index < rec.transfers_base, "journal record has wrong transfer update index: " << tu.m_index << ", transfers base: " << rec.transfers_base);
+
+  m_blockchain.truncate(rec.blockchain_base);
+  for (const auto& id : rec.new_block_ids)
+    m_blockchain.push_back(id);
+
+  for (size_t i = rec.transfers_base; i != m_transfers.size(); ++i)
+    m_key_images.erase(m_transfers[i].m_key_image);
+  m_transfers.erase(m_transfers.begin() + rec.transfers_base, m_transfers.end());
+  for (const auto& td : rec.new_transfers)
+  {
+    m_transfers.push_back(td);
+    if (td.m_key_image != null_key_image)
+      m_key_images[td.m_key_image] = m_transfers.size() - 1;
+  }
+  for (const auto& tu : rec.updated_transfers)
+  {
+    transfer_details& td = m_transfers[tu.m_index];
+    td.m_spent = tu.m_spent;
+    td.m_key_image = tu.m_key_image;
+    if (tu.m_key_image != null_key_image)
+      m_key_images[tu.m_key_image] = tu.m_index;
+  }
+
+  m_transfer_history.erase(m_transfer_history.begin() + rec.history_base, m_transfer_history.end());
+  m_published_history_count = std::min(m_published_history_count, rec.history_base);
+  m_transfer_history.insert(m_transfer_history.end(), rec.new_history.begin(), rec.new_history.end());
+
+  if (rec.payments_detach_height != UINT64_MAX)
+  {
+    m_published_payments_height = std::min(m_published_payments_height, rec.payments_detach_height);
+    for (auto it = m_payments.begin(); it != m_payments.end(); )
+    {
+      if (rec.payments_detach_height <= it->second.m_block_height)
+        it = m_payments.erase(it);
+      else
+        ++it;
+    }
+  }
+  for (const auto& p : rec.new_payments)
+    m_payments.emplace(p.first, p.second);
+
+  if (rec.unconfirmed_txs_changed)
+    m_unconfirmed_txs = rec.unconfirmed_txs;
+  m_tx_keys.insert(rec.new_tx_keys.begin(), rec.new_tx_keys.end());
+  for (const auto& p : rec.new_pending_key_images)
+    m_pending_key_images[p.first] = p.second;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_journal_tracking(bool snapshot_required)
+{
+  journal_tracking& jt = m_journal_tracking;
+  jt.snapshot_required = snapshot_required;
+  jt.blockchain_size = m_blockchain.size();
+  jt.transfers_count = m_transfers.size();
+  jt.history_count = m_transfer_history.size();
+  jt.payments_detach_height = UINT64_MAX;
+  jt.updated_transfers.clear();
+  jt.new_payments.clear();
+  jt.unconfirmed_txs_changed = false;
+  jt.new_tx_keys.clear();
+  jt.new_pending_key_images.clear();
 }
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::unlocked_balance()
@@ -920,9 +1599,11 @@ void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) con
   incoming_transfers = m_transfers;
 }
 //----------------------------------------------------------------------------------------------------
-bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const 
+// goes from the newest transfer back, returns false if the older ones don't need to be scanned
+template<class history_t>
+bool get_transfers_from_history(const history_t& history, const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res)
 {
-  uint64_t tr_count = m_transfer_history.size();
+  uint64_t tr_count = history.size();
   if (!tr_count)
     return true;
   uint64_t i = tr_count;
@@ -930,7 +1611,7 @@ bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request
   do
   {
     --i;
-    const wallet_rpc::wallet_transfer_info& thi = m_transfer_history[i];
+    const wallet_rpc::wallet_transfer_info& thi = history[i];
 
     // handle filter_by_height
     if (req.filter_by_height)
@@ -941,7 +1622,7 @@ bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request
       if (thi.height < req.min_height)
       {
         //no need to scan more
-        break;
+        return false;
       }
       if (thi.height > req.max_height)
       {
@@ -954,6 +1635,23 @@ bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request
     if (!thi.is_income && req.out)
       res.out.push_back(thi);   
   } while (i != 0);
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void get_payments_from_container(const wallet2::payment_container& container, const payment_id_t& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height)
+{
+  auto range = container.equal_range(payment_id);
+  std::for_each(range.first, range.second, [&payments, &min_height](const wallet2::payment_container::value_type& x) {
+    if (min_height < x.second.m_block_height)
+    {
+      payments.push_back(x.second);
+    }
+  });
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const 
+{
+  get_transfers_from_history(m_transfer_history, req, res);
 
   if (req.pool)
   {
@@ -976,13 +1674,99 @@ bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(const payment_id_t& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height) const
 {
-  auto range = m_payments.equal_range(payment_id);
-  std::for_each(range.first, range.second, [&payments, &min_height](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height)
+  get_payments_from_container(m_payments, payment_id, payments, min_height);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::read_view::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const
+{
+  std::vector<transfer_history_container::segment_ptr> segments = transfer_history.get_segments();
+  for (auto it = segments.rbegin(); it != segments.rend(); ++it)
+  {
+    if (!get_transfers_from_history((*it)->items, req, res))
+      break;
+  }
+  if (req.pool)
+    res.pool.insert(res.pool.end(), pool.begin(), pool.end());
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::read_view::get_payments(const payment_id_t& payment_id, std::list<payment_details>& payments, uint64_t min_height) const
+{
+  for (const auto& s : this->payments.get_segments())
+  {
+    auto range = s->index.positions.equal_range(payment_id);
+    for (auto it = range.first; it != range.second; ++it)
     {
-      payments.push_back(x.second);
+      const payment_details& pd = s->items[it->second].second;
+      if (min_height < pd.m_block_height)
+        payments.push_back(pd);
     }
-  });
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::read_view::get_payments_since(uint64_t min_height, payments_list& payments, const std::unordered_set<payment_id_t>* payment_ids) const
+{
+  if (min_height == UINT64_MAX)
+    return;
+  uint64_t start = this->payments.partition_point([min_height](const std::pair<payment_id_t, payment_details>& p) { return min_height < p.second.m_block_height; });
+  for (const auto& s : this->payments.get_segments())
+  {
+    if (s->base + s->items.size() <= start)
+      continue;
+    for (size_t i = start > s->base ? start - s->base : 0; i != s->items.size(); ++i)
+    {
+      if (payment_ids && !payment_ids->count(s->items[i].first))
+        continue;
+      payments.push_back(s->items[i]);
+    }
+  }
+}
+//----------------------------------------------------------------------------------------------------
+std::shared_ptr<const wallet2::read_view> wallet2::get_read_view() const
+{
+  CRITICAL_REGION_LOCAL(m_read_view_lock);
+  return m_read_view;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::publish_read_view()
+{
+  std::shared_ptr<read_view> v(new read_view());
+  std::shared_ptr<const read_view> prev = get_read_view();
+  v->blockchain_size = m_blockchain.size();
+  v->balance = balance();
+  v->unlocked_balance = unlocked_balance();
+  // the transfers that wait only for their unlock time, the others are unlocked by new blocks
+  v->next_unlock_time = UINT64_MAX;
+  for (const auto& td : m_transfers)
+  {
+    if (!td.m_spent && td.m_tx.unlock_time >= CURRENCY_MAX_BLOCK_NUMBER && td.m_block_height + DEFAULT_TX_SPENDABLE_AGE <= m_blockchain.size() &&
+      !is_tx_spendtime_unlocked(td.m_tx.unlock_time))
+      v->next_unlock_time = std::min(v->next_unlock_time, td.m_tx.unlock_time - CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS);
+  }
+  // the previous view's payments and history are shared, only what has changed since it was published is replaced
+  v->payments = prev->payments;
+  v->payments.truncate(v->payments.partition_point([this](const std::pair<payment_id_t, payment_details>& p) { return m_published_payments_height <= p.second.m_block_height; }));
+  std::vector<std::pair<payment_id_t, payment_details> > new_payments;
+  for (auto it = m_payments_by_height.lower_bound(std::make_pair(m_published_payments_height, payment_id_t())); it != m_payments_by_height.end(); ++it)
+    new_payments.push_back(std::make_pair(it->first.second, it->second));
+  v->payments.append(new_payments.begin(), new_payments.end());
+  v->transfer_history = prev->transfer_history;
+  v->transfer_history.truncate(m_published_history_count);
+  v->transfer_history.append(m_transfer_history.begin() + m_published_history_count, m_transfer_history.end());
+  get_unconfirmed_transfers(v->pool);
+  for (auto& inc : m_unconfirmed_in_transfers)
+    v->pool.push_back(inc.second);
+  m_published_payments_height = m_blockchain.size();
+  m_published_history_count = m_transfer_history.size();
+
+  CRITICAL_REGION_LOCAL(m_read_view_lock);
+  m_read_view = v;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::publish_read_view_if_stale()
+{
+  if (get_read_view()->next_unlock_time <= static_cast<uint64_t>(time(NULL)))
+    publish_read_view();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::sign_transfer(const std::string& tx_sources_blob, std::string& signed_tx_blob, currency::transaction& tx)
@@ -1080,6 +1864,7 @@ void wallet2::cancel_transfer(const std::string& tx_sources_blob)
     spent_flag = false; // clear the flag
     LOG_PRINT_L1("clearing spent flag of transfer #" << s.transfer_index << " due to cancelling a transaction");
   }
+  publish_read_view();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_param, const currency::create_tx_res& create_tx_result, bool do_not_relay)
@@ -1156,7 +1941,8 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
   }
   add_sent_unconfirmed_tx(tx, create_tx_param.change_amount, recipient);
 
-  m_tx_keys.insert(std::make_pair(tx_hash, create_tx_result.txkey.sec));
+  if (m_tx_keys.insert(std::make_pair(tx_hash, create_tx_result.txkey.sec)).second)
+    m_journal_tracking.new_tx_keys.push_back(std::make_pair(tx_hash, create_tx_result.txkey.sec));
 
   // handle change key images for watch-only wallets
   if (m_is_view_only)
@@ -1199,6 +1985,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
       {
         m_pending_key_images[p.first] = p.second;
         m_pending_key_images_file_container.push_back(tools::out_key_to_ki(p.first, p.second));
+        m_journal_tracking.new_pending_key_images.push_back(p);
         LOG_PRINT_L2("for tx " << tx_hash << " pending key image added (" << p.first << ", " << p.second << ")");
       }
     }
@@ -1213,6 +2000,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
       }
       tr.m_key_image = p.second;
       m_key_images[p.second] = p.first;
+      m_journal_tracking.updated_transfers.insert(p.first);
       LOG_PRINT_L2("for tx " << tx_hash << " key image " << p.second << " was associated with transfer # " << p.first);
     }
   }
@@ -1224,6 +2012,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
     << "Balance: " << print_money(balance()) << ENDL
     << "Unlocked: " << print_money(unlocked_balance()) << ENDL
     << "Please, wait for confirmation for your balance to be unlocked.");
+  publish_read_view();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_recent_transfers_history(std::vector<wallet_rpc::wallet_transfer_info>& trs, size_t offset, size_t count)
@@ -1295,6 +2084,47 @@ bool wallet2::is_transfer_unlocked(const transfer_details& td) const
   return true;
 }
 //----------------------------------------------------------------------------------------------------
+void wallet2::add_to_unspent_index(size_t transfer_index)
+{
+  const transfer_details& td = m_transfers[transfer_index];
+  const currency::tx_out& out = td.m_tx.vout[td.m_internal_output_index];
+  THROW_IF_FALSE_WALLET_INT_ERR_EX(out.target.type() == typeid(currency::txout_to_key), "wrong output type in transfer #" << transfer_index);
+
+  // the same conditions as in is_transfer_unlocked(), expressed as minimum chain size and timestamp
+  uint64_t unlock_chain_size = td.m_block_height + DEFAULT_TX_SPENDABLE_AGE;
+  uint64_t unlock_time = 0;
+  if (td.m_tx.unlock_time < CURRENCY_MAX_BLOCK_NUMBER)
+  {
+    if (td.m_tx.unlock_time + 1 > CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+      unlock_chain_size = std::max<uint64_t>(unlock_chain_size, td.m_tx.unlock_time + 1 - CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  }
+  else
+  {
+    unlock_time = td.m_tx.unlock_time - CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS;
+  }
+
+  m_unspent_index.add(transfer_index, out.amount, boost::get<currency::txout_to_key>(out.target).mix_attr, unlock_chain_size, unlock_time);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_unspent_index()
+{
+  m_unspent_index.clear();
+  m_unspent_index.set_chain_size(m_blockchain.size());
+  m_unspent_index.set_time(static_cast<uint64_t>(time(NULL)));
+  for (size_t i = 0; i != m_transfers.size(); ++i)
+  {
+    if (!m_transfers[i].m_spent)
+      add_to_unspent_index(i);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_payments_index()
+{
+  m_payments_by_height.clear();
+  for (const auto& p : m_payments)
+    m_payments_by_height.emplace(std::make_pair(p.second.m_block_height, p.first), p.second);
+}
+//----------------------------------------------------------------------------------------------------
 bool wallet2::is_tx_spendtime_unlocked(uint64_t unlock_time) const
 {
   if(unlock_time < CURRENCY_MAX_BLOCK_NUMBER)
@@ -1384,37 +2214,30 @@ uint64_t wallet2::select_indices_for_transfer(std::list<size_t>& selected_indexe
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::select_transfers(uint64_t needed_money, size_t fake_outputs_count, uint64_t dust, const std::vector<size_t>& outs_to_spend, std::list<transfer_container::iterator>& selected_transfers)
 {
-  std::map<uint64_t, std::list<size_t> > found_free_amounts;
-
-  std::vector<size_t> outs_indices_allowed_to_be_spent;
-  outs_indices_allowed_to_be_spent.reserve(m_transfers.size());
+  std::list<size_t> selected_indexes;
+  uint64_t found_money = 0;
   if (outs_to_spend.empty())
   {
-    // if outs_to_spend is empty -- it means all outs are allowed to be spent
-    for (size_t i = 0; i < m_transfers.size(); ++i)
-      outs_indices_allowed_to_be_spent.push_back(i);
+    // if outs_to_spend is empty -- it means all outs are allowed to be spent, use the index instead of going through all transfers
+    m_unspent_index.set_time(static_cast<uint64_t>(time(NULL)));
+    found_money = m_unspent_index.select(needed_money, fake_outputs_count, selected_indexes);
   }
   else
   {
-    for (size_t idx : outs_to_spend)
+    std::map<uint64_t, std::list<size_t> > found_free_amounts;
+    for (size_t i : outs_to_spend)
     {
-      CHECK_AND_THROW_WALLET_EX(!(idx < m_transfers.size()), error::wallet_common_error, std::string("invalid output index given: ") + std::to_string(idx));
-      outs_indices_allowed_to_be_spent.push_back(idx);
-    }
-  }
-
-  for (size_t i : outs_indices_allowed_to_be_spent)
-  {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && is_transfer_unlocked(td) && 
-      currency::is_mixattr_applicable_for_fake_outs_counter(boost::get<currency::txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).mix_attr, fake_outputs_count))
-    {
-      found_free_amounts[td.m_tx.vout[td.m_internal_output_index].amount].push_back(i);
+      CHECK_AND_THROW_WALLET_EX(!(i < m_transfers.size()), error::wallet_common_error, std::string("invalid output index given: ") + std::to_string(i));
+      const transfer_details& td = m_transfers[i];
+      if (!td.m_spent && is_transfer_unlocked(td) &&
+        currency::is_mixattr_applicable_for_fake_outs_counter(boost::get<currency::txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).mix_attr, fake_outputs_count))
+      {
+        found_free_amounts[td.m_tx.vout[td.m_internal_output_index].amount].push_back(i);
+      }
     }
+    found_money = select_indices_for_transfer(selected_indexes, found_free_amounts, needed_money);
   }
 
-  std::list<size_t> selected_indexes;
-  uint64_t found_money = select_indices_for_transfer(selected_indexes, found_free_amounts, needed_money);
   for(auto i: selected_indexes)
     selected_transfers.push_back(m_transfers.begin() + i);
   
@@ -1462,6 +2285,7 @@ uint64_t wallet2::select_transfers(uint64_t needed_money, size_t fake_outputs_co
 void wallet2::add_sent_unconfirmed_tx(const currency::transaction& tx, uint64_t change_amount, std::string recipient)
 {
   unconfirmed_transfer_details& utd = m_unconfirmed_txs[currency::get_transaction_hash(tx)];
+  m_journal_tracking.unconfirmed_txs_changed = true;
   utd.m_change = change_amount;
   utd.m_sent_time = time(NULL);
   utd.m_tx = tx;
@@ -1707,6 +2531,7 @@ void wallet2::sweep_below(size_t fake_outs_count, const currency::account_public
     size_t low_bound = 0;
     size_t high_bound = st_index_upper_boundary;
     create_tx_arg create_tx_param_ok = create_tx_param;
+    create_tx_res create_tx_result_ok = create_tx_result;
     for (;;)
     {
       if (low_bound + 1 >= high_bound)
@@ -1714,6 +2539,7 @@ void wallet2::sweep_below(size_t fake_outs_count, const currency::account_public
         st_index_upper_boundary = low_bound;
         res = rc_ok;
         create_tx_param = create_tx_param_ok;
+        create_tx_result = create_tx_result_ok;
         break;
       }
       st_index_upper_boundary = (low_bound + high_bound) / 2;
@@ -1722,6 +2548,7 @@ void wallet2::sweep_below(size_t fake_outs_count, const currency::account_public
       {
         low_bound = st_index_upper_boundary;
         create_tx_param_ok = create_tx_param;
+        create_tx_result_ok = create_tx_result;
       }
       else if (res == rc_too_many_outputs)
       {
@@ -1761,9 +2588,7 @@ void wallet2::sweep_below(size_t fake_outs_count, const currency::account_public
     return;
   }
 
-  r = currency::construct_tx(m_account.get_keys(), create_tx_param, create_tx_result);
-  CHECK_AND_THROW_WALLET_EX(!r, error::wallet_internal_error, "can't construct tx, create_tx_param: " + obj_to_json_str(create_tx_param));
-
+  // create_tx_result already holds the signed transaction built by the last successful try, no need to sign it once again
   if (p_result_tx != nullptr)
     *p_result_tx = create_tx_result.tx;
 
@@ -1800,6 +2625,11 @@ void wallet2::set_transfer_spent_flag(uint64_t transfer_index, bool spent_flag)
 
   bool old_spent_flag = m_transfers[transfer_index].m_spent;
   m_transfers[transfer_index].m_spent = spent_flag;
+  m_journal_tracking.updated_transfers.insert(transfer_index);
+  if (spent_flag)
+    m_unspent_index.remove(transfer_index);
+  else
+    add_to_unspent_index(transfer_index);
 
   LOG_PRINT_L2("transfer #" << transfer_index << " spent flag change: " << old_spent_flag << " -> " << spent_flag);
 }
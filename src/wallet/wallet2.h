@@ -7,9 +7,14 @@
 #include <memory>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/utility.hpp>
+#include <map>
+#include <set>
+#include <unordered_set>
 #include <atomic>
 
 #include "include_base_utils.h"
+#include "syncobj.h"
 
 #include "currency_core/account_boost_serialization.h"
 #include "currency_core/currency_basic_impl.h"
@@ -23,8 +28,17 @@
 #include "core_default_rpc_proxy.h"
 #include "wallet_errors.h"
 #include "common/pod_array_file_container.h"
+#include "common/journal_file.h"
+#include "common/parallel_utils.h"
+#include "unspent_outputs_index.h"
+#include "sparse_block_ids.h"
+#include "shared_history.h"
 
 #define DEFAULT_TX_SPENDABLE_AGE                               10
+#define WALLET_DEFAULT_REFRESH_PREFETCH_DEPTH                  1
+#define WALLET_MAX_REFRESH_PREFETCH_DEPTH                      2
+#define WALLET_JOURNAL_COMPACTION_MIN_SIZE                     (16 * 1024 * 1024) // journal is merged into the snapshot when it gets bigger than this
+#define WALLET_JOURNAL_COMPACTION_SNAPSHOT_RATIO               2                  // ...and bigger than snapshot size / ratio
 
 namespace tools
 {
@@ -80,12 +94,23 @@ namespace tools
 
   typedef tools::pod_array_file_container<out_key_to_ki> pending_ki_file_container_t;
 
+  class wallets_scanner;
+
   class wallet2
   {
-    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0) {};
+    friend class wallets_scanner;
+
+    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0), m_scan_threads_count(1),
+      m_refresh_prefetch_depth(0), m_compact_sync(true), m_restore_height(0), m_fast_forward_done(false), m_snapshot_id(0),
+      m_read_view(new read_view()), m_published_payments_height(0), m_published_history_count(0) { reset_journal_tracking(true); };
   public:
-    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0)
-    {};
+    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0),
+      m_scan_threads_count(tools::get_default_worker_threads_count()), m_refresh_prefetch_depth(WALLET_DEFAULT_REFRESH_PREFETCH_DEPTH),
+      m_compact_sync(true), m_restore_height(0), m_fast_forward_done(false), m_snapshot_id(0),
+      m_read_view(new read_view()), m_published_payments_height(0), m_published_history_count(0)
+    {
+      reset_journal_tracking(true);
+    };
     struct transfer_details
     {
       uint64_t m_block_height;
@@ -122,9 +147,133 @@ namespace tools
     };
     
     typedef std::unordered_multimap<currency::payment_id_t, payment_details> payment_container;
+    // the same payments ordered by (block height, payment id), for queries of recent payments
+    typedef std::multimap<std::pair<uint64_t, currency::payment_id_t>, payment_details> payments_by_height_container;
+    typedef std::list<std::pair<currency::payment_id_t, payment_details> > payments_list;
+
+    // positions of the payments in a payments history segment by payment id
+    struct payment_id_index
+    {
+      std::unordered_multimap<currency::payment_id_t, size_t> positions;
+      void add(const std::pair<currency::payment_id_t, payment_details>& p, size_t pos) { positions.emplace(p.first, pos); }
+    };
+    // payments in (block height, payment id) order
+    typedef shared_history<std::pair<currency::payment_id_t, payment_details>, payment_id_index> payments_history;
+    typedef shared_history<wallet_rpc::wallet_transfer_info> transfer_history_container;
 
     typedef std::vector<transfer_details> transfer_container;
 
+    // results of stateless (thread-safe) scanning of a transaction, computed before any wallet state is touched
+    // account independent part of tx scanning, may be shared by several wallets
+    struct tx_scan_result
+    {
+      currency::transaction tx;
+      crypto::hash tx_hash;
+      crypto::public_key tx_pub_key;
+      bool tx_parsed;
+      bool extra_parsed;
+      bool compact;                               // tx has only outputs and key images (see compact_tx_entry), full one is fetched if it's related to the wallet
+      std::vector<uint64_t> global_outs_indexes;  // empty if daemon didn't provide them along with the block
+    };
+
+    struct block_scan_result
+    {
+      currency::block b;
+      crypto::hash id;
+      bool block_parsed;
+      bool txs_parsed;                  // false for blocks older than the accounts creation time
+      std::vector<tx_scan_result> txs;  // miner tx goes first
+    };
+
+    // account specific part: own outputs of a transaction
+    struct tx_outs_lookup
+    {
+      bool outs_looked_up;
+      std::vector<size_t> outs;
+      uint64_t money_got_in_outs;
+    };
+
+    // per block, per tx; empty for blocks that are not scanned for the account
+    typedef std::vector<std::vector<tx_outs_lookup> > blocks_outs_lookups;
+    // full txs fetched for compact ones that turned out to be related to the wallet, by tx hash
+    typedef std::unordered_map<crypto::hash, currency::transaction> full_txs_container;
+
+    // blocks batch fetched in background while the previous one is being processed
+    struct fetched_blocks_batch
+    {
+      size_t expected_chain_size;       // local chain state the request was built for
+      crypto::hash expected_top_id;
+      bool extends_expected_chain;      // false if daemon reported a split
+      currency::COMMAND_RPC_GET_BLOCKS_FAST::response res;
+      std::vector<block_scan_result> scanned_blocks;
+      blocks_outs_lookups lookups;
+      std::exception_ptr error;
+    };
+
+    struct transfer_update
+    {
+      uint64_t m_index;
+      bool m_spent;
+      crypto::key_image m_key_image;
+    };
+
+    // wallet state delta, appended to the journal by store() instead of rewriting the whole wallet file
+    struct journal_record
+    {
+      uint64_t blockchain_base;                 // m_blockchain is cut to this size before new ids are appended
+      std::vector<crypto::hash> new_block_ids;
+      uint64_t transfers_base;                  // the same for m_transfers
+      std::vector<transfer_details> new_transfers;
+      std::vector<transfer_update> updated_transfers;
+      uint64_t history_base;                    // the same for m_transfer_history
+      std::vector<wallet_rpc::wallet_transfer_info> new_history;
+      uint64_t payments_detach_height;          // payments at and above this height are removed before new ones are added
+      std::vector<std::pair<currency::payment_id_t, payment_details> > new_payments;
+      bool unconfirmed_txs_changed;
+      std::unordered_map<crypto::hash, unconfirmed_transfer_details> unconfirmed_txs;
+      std::vector<std::pair<crypto::hash, crypto::secret_key> > new_tx_keys;
+      std::vector<std::pair<crypto::public_key, crypto::key_image> > new_pending_key_images;
+    };
+
+    // changes made since the last store(), i.e. what goes to the next journal record
+    struct journal_tracking
+    {
+      bool snapshot_required;
+      uint64_t blockchain_size;
+      uint64_t transfers_count;
+      uint64_t history_count;
+      uint64_t payments_detach_height;
+      std::set<uint64_t> updated_transfers;
+      std::vector<std::pair<currency::payment_id_t, payment_details> > new_payments;
+      bool unconfirmed_txs_changed;
+      std::vector<std::pair<crypto::hash, crypto::secret_key> > new_tx_keys;
+      std::vector<std::pair<crypto::public_key, crypto::key_image> > new_pending_key_images;
+    };
+
+    /* Wallet state for read-only queries, published by publish_read_view() after every applied blocks batch and after
+     * sending money. Views are immutable, so they are read from other threads while the wallet is being refreshed or
+     * a transfer is being built. Payments and transfers history are shared with the previous view except for the
+     * part changed since it was published.
+     */
+    struct read_view
+    {
+      read_view() : blockchain_size(0), balance(0), unlocked_balance(0), next_unlock_time(UINT64_MAX)
+      {}
+
+      uint64_t blockchain_size;
+      uint64_t balance;
+      uint64_t unlocked_balance;
+      uint64_t next_unlock_time;                                  // when the first time locked transfer unlocks, UINT64_MAX if none
+      payments_history payments;
+      transfer_history_container transfer_history;
+      std::vector<wallet_rpc::wallet_transfer_info> pool;       // unconfirmed outgoing and incoming transfers
+
+      void get_payments(const currency::payment_id_t& payment_id, std::list<payment_details>& payments, uint64_t min_height = 0) const;
+      // payments above min_height in height order, only the ones with given ids if payment_ids is not null
+      void get_payments_since(uint64_t min_height, payments_list& payments, const std::unordered_set<currency::payment_id_t>* payment_ids = nullptr) const;
+      bool get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const;
+    };
+
     struct keys_file_data
     {
       crypto::chacha8_iv iv;
@@ -137,7 +286,8 @@ namespace tools
     };
 
     std::vector<unsigned char> generate(const std::wstring& wallet, const std::string& password);
-    void restore(const std::wstring& wallet, const std::vector<unsigned char>& restore_seed, const std::string& password);
+    // restore_timestamp - account creation time if known, blocks that are older are synced as ids only
+    void restore(const std::wstring& wallet, const std::vector<unsigned char>& restore_seed, const std::string& password, uint64_t restore_timestamp = 0);
     void load(const std::wstring& wallet, const std::string& password);    
     void store();
     std::wstring get_wallet_path(){ return m_keys_file; }
@@ -152,6 +302,17 @@ namespace tools
     bool deinit();
 
     void stop() { m_run.store(false, std::memory_order_relaxed); }
+    void set_scan_threads_count(size_t count) { m_scan_threads_count = count != 0 ? count : 1; }
+    size_t get_scan_threads_count() const { return m_scan_threads_count; }
+    // number of getblocks.bin requests kept in flight while refreshing, 0 - fetch and process batches one by one
+    void set_refresh_prefetch_depth(size_t depth) { m_refresh_prefetch_depth = std::min<size_t>(depth, WALLET_MAX_REFRESH_PREFETCH_DEPTH); }
+    size_t get_refresh_prefetch_depth() const { return m_refresh_prefetch_depth; }
+    // request only the txs data needed for scanning (compact_tx_entry), full txs are fetched just for related ones
+    void set_compact_sync(bool enabled) { m_compact_sync = enabled; }
+    bool get_compact_sync() const { return m_compact_sync; }
+    // blocks below this height are synced as ids only, without looking for transfers in them (not stored, applies to the current session)
+    void set_restore_height(uint64_t height) { m_restore_height = height; m_fast_forward_done = false; }
+    uint64_t get_restore_height() const { return m_restore_height; }
 
     i_wallet2_callback* callback() const { return m_callback; }
     void callback(i_wallet2_callback* callback) { m_callback = callback; }
@@ -202,12 +363,27 @@ namespace tools
     bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr, currency::payment_id_t& payment_id);
     bool store_keys(const std::wstring& keys_file_name, const std::string& password, bool save_as_view_wallet = false);
     uint64_t get_blockchain_current_height() const { return m_local_bc_height; }
+    // may be called from any thread
+    std::shared_ptr<const read_view> get_read_view() const;
+    void publish_read_view();
+    // time locked transfers unlock without new blocks, so the view is republished once its next_unlock_time comes
+    void publish_read_view_if_stale();
     template <class t_archive>
     inline void serialize(t_archive &a, const unsigned int ver)
     {
       if(ver < 5)
         return;
-      a & m_blockchain;
+      if (ver < 13)
+      {
+        // older wallet files have ids of all blocks since genesis
+        std::vector<crypto::hash> blockchain;
+        a & blockchain;
+        m_blockchain.assign(blockchain);
+      }
+      else
+      {
+        a & m_blockchain;
+      }
       a & m_transfers;
       a & m_account_public_address;
       a & m_key_images;
@@ -226,6 +402,9 @@ namespace tools
       if (ver < 11)
         return;
       a & m_pending_key_images;
+      if (ver < 12)
+        return;
+      a & m_snapshot_id;
     }
     static uint64_t select_indices_for_transfer(std::list<size_t>& ind, std::map<uint64_t, std::list<size_t> >& found_free_amounts, uint64_t needed_money);
     //----------------------------------------------------------------------------------------------------
@@ -234,17 +413,37 @@ namespace tools
   private:
 
     void load_keys(const std::wstring& keys_file_name, const std::string& password);
-    void process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b);
-    void process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height);
+    void process_new_transaction(const tx_scan_result& tsr, const tx_outs_lookup& lookup, uint64_t height, const currency::block& b);
+    void process_new_blockchain_entry(const block_scan_result& bsr, const std::vector<tx_outs_lookup>& lookups, const currency::block_complete_entry& bche, uint64_t height, full_txs_container& full_txs);
+    static void parse_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, uint64_t min_timestamp, size_t threads_count, std::vector<block_scan_result>& results);
+    bool is_block_to_be_scanned(const block_scan_result& bsr) const;
+    bool is_block_to_be_fast_forwarded(uint64_t height, uint64_t timestamp) const;
+    void fast_forward_blockchain(size_t& blocks_added);
+    void lookup_outs(const tx_scan_result& tsr, tx_outs_lookup& lookup) const;
+    bool is_tx_related(const tx_scan_result& tsr, const tx_outs_lookup& lookup) const;
+    void fetch_full_txs(const std::list<crypto::hash>& tx_ids, full_txs_container& txs);
+    void fetch_related_full_txs(const std::vector<block_scan_result>& blocks, const blocks_outs_lookups& lookups, size_t first_block, uint64_t start_height, full_txs_container& txs);
+    void scan_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, std::vector<block_scan_result>& results, blocks_outs_lookups& lookups) const;
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time) const;
     bool is_transfer_unlocked(const transfer_details& td) const;
+    void add_to_unspent_index(size_t transfer_index);
+    void rebuild_unspent_index();
+    void rebuild_payments_index();
     bool clear();
-    void pull_blocks(size_t& blocks_added);
+    void pull_blocks(size_t& blocks_added, uint64_t& daemon_height);
+    void pull_blocks_pipelined(size_t& blocks_added);
+    void fetch_blocks(i_core_proxy& proxy, const std::list<crypto::hash>& block_ids, size_t local_chain_size, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res) const;
+    void process_fetched_blocks(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, const std::vector<block_scan_result>& scanned_blocks, const blocks_outs_lookups& lookups, size_t& blocks_added);
     uint64_t select_transfers(uint64_t needed_money, size_t fake_outputs_count, uint64_t dust, const std::vector<size_t>& outs_to_spend, std::list<transfer_container::iterator>& selected_transfers);
     bool prepare_file_names(const std::wstring& file_path);
-    void process_unconfirmed(const currency::transaction& tx, std::string& recipient, std::string& recipient_alias);
+    void store_snapshot();
+    bool store_journal_record();
+    void load_journal();
+    void apply_journal_record(const journal_record& rec);
+    void reset_journal_tracking(bool snapshot_required);
+    void process_unconfirmed(const crypto::hash& tx_hash, std::string& recipient, std::string& recipient_alias);
     void add_sent_unconfirmed_tx(const currency::transaction& tx, uint64_t change_amount, std::string recipient);
     void update_current_tx_limit();
     void prepare_wti(wallet_rpc::wallet_transfer_info& wti, uint64_t height, uint64_t timestamp, const currency::transaction& tx, uint64_t amount, const money_transfer2_details& td)const;
@@ -262,30 +461,46 @@ namespace tools
     std::wstring m_wallet_file;
     std::wstring m_keys_file;
     std::wstring m_pending_ki_file;
-    std::vector<crypto::hash> m_blockchain;
+    std::wstring m_journal_file;
+    sparse_block_ids m_blockchain;
     std::atomic<uint64_t> m_local_bc_height; //temporary workaround 
     std::unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
 
     transfer_container m_transfers;
     payment_container m_payments;
+    payments_by_height_container m_payments_by_height; // not serialized, rebuilt on load
     std::unordered_map<crypto::key_image, size_t> m_key_images;
+    unspent_outputs_index m_unspent_index; // not serialized, rebuilt on load
     std::unordered_map<crypto::public_key, crypto::key_image> m_pending_key_images; // (out_pk -> ki) pairs of change outputs to be added in watch-only wallet without spend sec key
     pending_ki_file_container_t m_pending_key_images_file_container;
     currency::account_public_address m_account_public_address;
     uint64_t m_upper_transaction_size_limit; //TODO: auto-calc this value or request from daemon, now use some fixed value
 
     std::atomic<bool> m_run;
+    size_t m_scan_threads_count;
+    size_t m_refresh_prefetch_depth;
+    bool m_compact_sync;
+    uint64_t m_restore_height;
+    bool m_fast_forward_done;
     std::vector<wallet_rpc::wallet_transfer_info> m_transfer_history;
     std::unordered_map<crypto::hash, wallet_rpc::wallet_transfer_info> m_unconfirmed_in_transfers;
     uint64_t m_unconfirmed_balance;
     std::shared_ptr<i_core_proxy> m_core_proxy;
     i_wallet2_callback* m_callback;
     std::unordered_map<crypto::hash, crypto::secret_key> m_tx_keys;
+    uint64_t m_snapshot_id;             // binds the journal to the wallet file it was written on top of
+    journal_file m_journal;
+    journal_tracking m_journal_tracking;
+
+    mutable epee::critical_section m_read_view_lock;
+    std::shared_ptr<const read_view> m_read_view;
+    uint64_t m_published_payments_height;   // the published read view has the same payments below this height
+    uint64_t m_published_history_count;     // and the same first transfers history items
   };
 }
 
 
-BOOST_CLASS_VERSION(tools::wallet2, 11)
+BOOST_CLASS_VERSION(tools::wallet2, 13)
 BOOST_CLASS_VERSION(tools::wallet2::unconfirmed_transfer_details, 3)
 BOOST_CLASS_VERSION(tools::wallet_rpc::wallet_transfer_info, 3)
 
@@ -328,6 +543,32 @@ namespace boost
       a & x.m_unlock_time;
     }
     
+    template <class Archive>
+    inline void serialize(Archive& a, tools::wallet2::transfer_update& x, const boost::serialization::version_type ver)
+    {
+      a & x.m_index;
+      a & x.m_spent;
+      a & x.m_key_image;
+    }
+
+    template <class Archive>
+    inline void serialize(Archive& a, tools::wallet2::journal_record& x, const boost::serialization::version_type ver)
+    {
+      a & x.blockchain_base;
+      a & x.new_block_ids;
+      a & x.transfers_base;
+      a & x.new_transfers;
+      a & x.updated_transfers;
+      a & x.history_base;
+      a & x.new_history;
+      a & x.payments_detach_height;
+      a & x.new_payments;
+      a & x.unconfirmed_txs_changed;
+      a & x.unconfirmed_txs;
+      a & x.new_tx_keys;
+      a & x.new_pending_key_images;
+    }
+
     template <class Archive>
     inline void serialize(Archive& a, tools::wallet_rpc::wallet_transfer_info_details& x, const boost::serialization::version_type ver)
     {
@@ -36,13 +36,14 @@ namespace tools
         size_t blocks_fetched = 0;
         bool received_money = false;
         bool ok;
+        CRITICAL_REGION_LOCAL(m_wallet_lock);
         m_wallet.refresh(blocks_fetched, received_money, ok);
         return true;
       }, 20000);
     }
 
-    //DO NOT START THIS SERVER IN MORE THEN 1 THREADS WITHOUT REFACTORING
-    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(1, true);
+    // calls that change the wallet are serialized with m_wallet_lock, the others are served from the wallet's read view
+    return epee::http_server_impl_base<wallet_rpc_server, connection_context>::run(WALLET_RPC_SERVER_THREADS_COUNT, true);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::handle_command_line(const boost::program_options::variables_map& vm)
@@ -64,8 +65,16 @@ namespace tools
   {
     try
     {
-      res.balance = m_wallet.balance();
-      res.unlocked_balance = m_wallet.unlocked_balance();
+      std::shared_ptr<const wallet2::read_view> view = m_wallet.get_read_view();
+      // a time locked transfer has unlocked since the view was published, a busy wallet publishes a new one on its own
+      if (view->next_unlock_time <= static_cast<uint64_t>(time(NULL)) && CRITICAL_SECTION_TRY_LOCK(m_wallet_lock))
+      {
+        m_wallet.publish_read_view_if_stale();
+        CRITICAL_SECTION_UNLOCK(m_wallet_lock);
+        view = m_wallet.get_read_view();
+      }
+      res.balance = view->balance;
+      res.unlocked_balance = view->unlocked_balance;
     }
     catch (std::exception& e)
     {
@@ -93,6 +102,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_transfer(const wallet_rpc::COMMAND_RPC_TRANSFER::request& req, wallet_rpc::COMMAND_RPC_TRANSFER::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     currency::payment_id_t payment_id;
     if (!req.payment_id_hex.empty() && !currency::parse_payment_id_from_hex_str(req.payment_id_hex, payment_id))
     {
@@ -184,6 +194,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_store(const wallet_rpc::COMMAND_RPC_STORE::request& req, wallet_rpc::COMMAND_RPC_STORE::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     try
     {
       m_wallet.store();
@@ -209,7 +220,7 @@ namespace tools
 
     res.payments.clear();
     std::list<wallet2::payment_details> payment_list;
-    m_wallet.get_payments(payment_id, payment_list);
+    m_wallet.get_read_view()->get_payments(payment_id, payment_list);
     for (auto & payment : payment_list)
     {
       if (payment.m_unlock_time && !req.allow_locked_transactions)
@@ -233,7 +244,9 @@ namespace tools
   bool wallet_rpc_server::on_get_bulk_payments(const wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::request& req, wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
     res.payments.clear();
+    std::shared_ptr<const wallet2::read_view> view = m_wallet.get_read_view();
 
+    std::vector<currency::payment_id_t> payment_ids;
     for (auto & payment_id_str : req.payment_ids)
     {
       currency::payment_id_t payment_id;
@@ -246,32 +259,73 @@ namespace tools
         er.message = "Payment ID has invalid format: " + payment_id_str;
         return false;
       }
+      payment_ids.push_back(payment_id);
+    }
 
-      std::list<wallet2::payment_details> payment_list;
-      m_wallet.get_payments(payment_id, payment_list, req.min_block_height);
+    auto add_payment = [&res](const std::string& payment_id_str, const wallet2::payment_details& payment)
+    {
+      wallet_rpc::payment_details rpc_payment;
+      rpc_payment.payment_id   = payment_id_str;
+      rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.m_tx_hash);
+      rpc_payment.amount       = payment.m_amount;
+      rpc_payment.block_height = payment.m_block_height;
+      rpc_payment.unlock_time  = payment.m_unlock_time;
+      res.payments.push_back(std::move(rpc_payment));
+    };
 
+    // for many ids and a recent height one range scan of the height index tells which ids got payments since then,
+    // only those are looked up, so the result is the same: in the request order, repeated ids included
+    std::unordered_set<currency::payment_id_t> paid_ids;
+    bool filter_paid_ids = req.min_block_height != 0 && payment_ids.size() > 1;
+    if (filter_paid_ids)
+    {
+      std::unordered_set<currency::payment_id_t> ids_set(payment_ids.begin(), payment_ids.end());
+      wallet2::payments_list recent_payments;
+      view->get_payments_since(req.min_block_height, recent_payments, &ids_set);
+      for (auto& payment : recent_payments)
+        paid_ids.insert(payment.first);
+    }
+
+    for (size_t i = 0; i != payment_ids.size(); ++i)
+    {
+      if (filter_paid_ids && !paid_ids.count(payment_ids[i]))
+        continue;
+      std::list<wallet2::payment_details> payment_list;
+      view->get_payments(payment_ids[i], payment_list, req.min_block_height);
       for (auto & payment : payment_list)
-      {
-        wallet_rpc::payment_details rpc_payment;
-        rpc_payment.payment_id   = payment_id_str;
-        rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.m_tx_hash);
-        rpc_payment.amount       = payment.m_amount;
-        rpc_payment.block_height = payment.m_block_height;
-        rpc_payment.unlock_time  = payment.m_unlock_time;
-        res.payments.push_back(std::move(rpc_payment));
-      }
+        add_payment(req.payment_ids[i], payment);
     }
 
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool wallet_rpc_server::on_get_payments_since(const wallet_rpc::COMMAND_RPC_GET_PAYMENTS_SINCE::request& req, wallet_rpc::COMMAND_RPC_GET_PAYMENTS_SINCE::response& res, epee::json_rpc::error& er, connection_context& cntx)
+  {
+    std::shared_ptr<const wallet2::read_view> view = m_wallet.get_read_view();
+    wallet2::payments_list payment_list;
+    view->get_payments_since(req.min_block_height, payment_list);
+    for (auto & payment : payment_list)
+    {
+      wallet_rpc::payment_details rpc_payment;
+      rpc_payment.payment_id   = epee::string_tools::buff_to_hex_nodelimer(payment.first);
+      rpc_payment.tx_hash      = epee::string_tools::pod_to_hex(payment.second.m_tx_hash);
+      rpc_payment.amount       = payment.second.m_amount;
+      rpc_payment.block_height = payment.second.m_block_height;
+      rpc_payment.unlock_time  = payment.second.m_unlock_time;
+      res.payments.push_back(std::move(rpc_payment));
+    }
+    res.blockchain_height = view->blockchain_size;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
-    return m_wallet.get_transfers(req, res);
+    return m_wallet.get_read_view()->get_transfers(req, res);
   }
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_convert_address(const wallet_rpc::COMMAND_RPC_CONVERT_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_CONVERT_ADDRESS::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     //
     // 1/2 standard address + payment id => integrated address
     if (!req.address_str.empty() && req.integrated_address_str.empty())
@@ -321,6 +375,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_maketelepod(const wallet_rpc::COMMAND_RPC_MAKETELEPOD::request& req, wallet_rpc::COMMAND_RPC_MAKETELEPOD::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     //check available balance
     if (m_wallet.unlocked_balance() <= req.amount)
     { 
@@ -424,6 +479,16 @@ namespace tools
       return false;
     }
 
+    crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+    crypto::precomputed_public_key spend_public_key = AUTO_VAL_INIT(spend_public_key);
+    if (!crypto::generate_key_derivation(tx_pub_key, acc.get_keys().m_view_secret_key, derivation) ||
+      !crypto::precompute_public_key(acc.get_keys().m_account_address.m_spend_public_key, spend_public_key))
+    {
+      LOG_ERROR("Failed to derive keys for tx pub key " << tx_pub_key);
+      status = "BAD";
+      return false;
+    }
+
     //prepare inputs
     std::vector<currency::tx_source_entry> sources;
     size_t i = 0;
@@ -431,7 +496,7 @@ namespace tools
     for (auto& o : get_ind_rsp.o_indexes)
     {
       //check if input is for telepod's address
-      if (currency::is_out_to_acc(acc.get_keys(), boost::get<currency::txout_to_key>(tx.vout[i].target), tx_pub_key, i))
+      if (currency::is_out_to_acc(boost::get<currency::txout_to_key>(tx.vout[i].target), derivation, spend_public_key, i))
       {
         //income output 
         amount += tx.vout[i].amount;
@@ -475,6 +540,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_clonetelepod(const wallet_rpc::COMMAND_RPC_CLONETELEPOD::request& req, wallet_rpc::COMMAND_RPC_CLONETELEPOD::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     currency::transaction tx2 = AUTO_VAL_INIT(tx2);
     //new destination account 
     currency::account_base acc2 = AUTO_VAL_INIT(acc2);
@@ -510,6 +576,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_telepodstatus(const wallet_rpc::COMMAND_RPC_TELEPODSTATUS::request& req, wallet_rpc::COMMAND_RPC_TELEPODSTATUS::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     currency::transaction tx2 = AUTO_VAL_INIT(tx2);
     //new destination account 
     currency::account_base acc2 = AUTO_VAL_INIT(acc2);
@@ -549,6 +616,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_withdrawtelepod(const wallet_rpc::COMMAND_RPC_WITHDRAWTELEPOD::request& req, wallet_rpc::COMMAND_RPC_WITHDRAWTELEPOD::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     currency::transaction tx2 = AUTO_VAL_INIT(tx2);
     //parse destination add 
     currency::account_public_address acc_addr = AUTO_VAL_INIT(acc_addr);
@@ -586,6 +654,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sweep_below(const wallet_rpc::COMMAND_SWEEP_BELOW::request& req, wallet_rpc::COMMAND_SWEEP_BELOW::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     currency::payment_id_t payment_id;
     if (!req.payment_id_hex.empty() && !currency::parse_payment_id_from_hex_str(req.payment_id_hex, payment_id))
     {
@@ -661,6 +730,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_sign_transfer(const wallet_rpc::COMMAND_SIGN_TRANSFER::request& req, wallet_rpc::COMMAND_SIGN_TRANSFER::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     try
     {
       currency::transaction tx = AUTO_VAL_INIT(tx);
@@ -694,6 +764,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_submit_transfer(const wallet_rpc::COMMAND_SUBMIT_TRANSFER::request& req, wallet_rpc::COMMAND_SUBMIT_TRANSFER::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     std::string tx_unsigned_blob;
     if (!string_tools::parse_hexstr_to_binbuff(req.tx_unsigned_hex, tx_unsigned_blob))
     {
@@ -733,6 +804,7 @@ namespace tools
   //------------------------------------------------------------------------------------------------------------------------------
   bool wallet_rpc_server::on_cancel_transfer(const wallet_rpc::COMMAND_CANCEL_TRANSFER::request& req, wallet_rpc::COMMAND_CANCEL_TRANSFER::response& res, epee::json_rpc::error& er, connection_context& cntx)
   {
+    CRITICAL_REGION_LOCAL(m_wallet_lock);
     try
     {
       std::string tx_unsigned_blob;
@@ -10,6 +10,9 @@
 #include "wallet_rpc_server_commans_defs.h"
 #include "wallet2.h"
 #include "common/command_line.h"
+
+#define WALLET_RPC_SERVER_THREADS_COUNT      4
+
 namespace tools
 {
   /************************************************************************/
@@ -41,6 +44,7 @@ namespace tools
         MAP_JON_RPC_WE("store",               on_store,                 wallet_rpc::COMMAND_RPC_STORE)
         MAP_JON_RPC_WE("get_payments",        on_get_payments,          wallet_rpc::COMMAND_RPC_GET_PAYMENTS)
         MAP_JON_RPC_WE("get_bulk_payments",   on_get_bulk_payments,     wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS)
+        MAP_JON_RPC_WE("get_payments_since",  on_get_payments_since,    wallet_rpc::COMMAND_RPC_GET_PAYMENTS_SINCE)
         MAP_JON_RPC_WE("get_transfers",       on_get_transfers,         wallet_rpc::COMMAND_RPC_GET_TRANSFERS)
         MAP_JON_RPC_WE("convert_address",     on_convert_address,       wallet_rpc::COMMAND_RPC_CONVERT_ADDRESS)
         MAP_JON_RPC_WE("sweep_below",         on_sweep_below,           wallet_rpc::COMMAND_SWEEP_BELOW)
@@ -63,6 +67,7 @@ namespace tools
       bool on_store(const wallet_rpc::COMMAND_RPC_STORE::request& req, wallet_rpc::COMMAND_RPC_STORE::response& res, epee::json_rpc::error& er, connection_context& cntx);
       bool on_get_payments(const wallet_rpc::COMMAND_RPC_GET_PAYMENTS::request& req, wallet_rpc::COMMAND_RPC_GET_PAYMENTS::response& res, epee::json_rpc::error& er, connection_context& cntx);
       bool on_get_bulk_payments(const wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::request& req, wallet_rpc::COMMAND_RPC_GET_BULK_PAYMENTS::response& res, epee::json_rpc::error& er, connection_context& cntx);
+      bool on_get_payments_since(const wallet_rpc::COMMAND_RPC_GET_PAYMENTS_SINCE::request& req, wallet_rpc::COMMAND_RPC_GET_PAYMENTS_SINCE::response& res, epee::json_rpc::error& er, connection_context& cntx);
       bool on_get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res, epee::json_rpc::error& er, connection_context& cntx);
       bool on_convert_address(const wallet_rpc::COMMAND_RPC_CONVERT_ADDRESS::request& req, wallet_rpc::COMMAND_RPC_CONVERT_ADDRESS::response& res, epee::json_rpc::error& er, connection_context& cntx);
       bool on_sweep_below(const wallet_rpc::COMMAND_SWEEP_BELOW::request& req, wallet_rpc::COMMAND_SWEEP_BELOW::response& res, epee::json_rpc::error& er, connection_context& cntx);
@@ -79,6 +84,7 @@ namespace tools
       bool build_transaction_from_telepod(const wallet_rpc::telepod& tlp, const currency::account_public_address& acc2, currency::transaction& tx2, std::string& status);
 
       wallet2& m_wallet;
+      epee::critical_section m_wallet_lock;   // refresh and calls that change the wallet or use its daemon connection
       std::string m_port;
       std::string m_bind_ip;
   };
@@ -251,6 +251,30 @@ namespace wallet_rpc
     };
   };
 
+  // all the payments with payment id above the given height, in height order
+  struct COMMAND_RPC_GET_PAYMENTS_SINCE
+  {
+    struct request
+    {
+      uint64_t min_block_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(min_block_height)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::list<payment_details> payments;
+      uint64_t blockchain_height;             // wallet is synchronized up to this height, the next query may start from it
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(payments)
+        KV_SERIALIZE(blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_TRANSFERS
   {
     struct request
@@ -0,0 +1,294 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "include_base_utils.h"
+using namespace epee;
+
+#include "wallets_scanner.h"
+#include "profile_tools.h"
+#include "string_coding.h"
+
+namespace tools
+{
+//----------------------------------------------------------------------------------------------------
+wallets_scanner::wallets_scanner() : m_core_proxy(new default_http_core_proxy()), m_threads_count(get_default_worker_threads_count()), m_run(true)
+{}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::init(const std::string& daemon_address)
+{
+  m_core_proxy->set_connection_addr(daemon_address);
+}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::set_core_proxy(const std::shared_ptr<i_core_proxy>& proxy)
+{
+  CHECK_AND_THROW_WALLET_EX(!proxy, error::wallet_internal_error, "null core proxy given to wallets scanner");
+  m_core_proxy = proxy;
+}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::add_wallet(const std::shared_ptr<wallet2>& w)
+{
+  CHECK_AND_THROW_WALLET_EX(!w, error::wallet_internal_error, "null wallet given to wallets scanner");
+  if (!m_run)
+    w->stop();
+  m_wallets.push_back(w);
+}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::stop()
+{
+  m_run = false;
+  // wallets check their own flag while fast forwarding and refreshing on their own
+  for (auto& w : m_wallets)
+    w->stop();
+}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::refresh(size_t& blocks_fetched)
+{
+  blocks_fetched = 0;
+  TIME_MEASURE_START_MS(refresh_time);
+
+  // wallets that went another way than the lead one (i.e. left on a stale fork) or failed, they are refreshed one by one
+  std::vector<bool> excluded(m_wallets.size(), false);
+
+  // blocks older than an account are not fetched for it at all, it joins the others from its start point
+  for (size_t i = 0; i != m_wallets.size() && m_run.load(std::memory_order_relaxed); ++i)
+  {
+    if (m_wallets[i]->m_fast_forward_done)
+      continue;
+    try
+    {
+      size_t skipped = 0;
+      m_wallets[i]->fast_forward_blockchain(skipped);
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("wallets scanner: failed to fast forward wallet " << m_wallets[i]->get_account().get_public_address_str() << ": " << e.what() << ", it will be refreshed separately");
+      excluded[i] = true;
+    }
+  }
+
+  size_t try_count = 0;
+  while (m_run.load(std::memory_order_relaxed))
+  {
+    size_t blocks_added = 0;
+    try
+    {
+      if (!pull_blocks(excluded, blocks_added))
+        break;
+      blocks_fetched += blocks_added;
+    }
+    catch (const std::exception& e)
+    {
+      if (try_count >= 3)
+      {
+        LOG_ERROR("wallets scanner: pull_blocks failed, try_count=" << try_count << ": " << e.what());
+        throw;
+      }
+      LOG_PRINT_L1("wallets scanner: another try pull_blocks (try_count=" << try_count << ")...");
+      ++try_count;
+    }
+  }
+  TIME_MEASURE_FINISH_MS(refresh_time);
+
+  // all the wallets are expected to end up at the same top, the rest catch up on their own
+  size_t lead = 0;
+  for (size_t i = 0; i != m_wallets.size(); ++i)
+    if (!excluded[i] && (excluded[lead] || m_wallets[i]->m_blockchain.size() < m_wallets[lead]->m_blockchain.size()))
+      lead = i;
+
+  size_t refreshed_separately = 0;
+  for (size_t i = 0; i != m_wallets.size() && m_run.load(std::memory_order_relaxed); ++i)
+  {
+    wallet2& w = *m_wallets[i];
+    if (!excluded[i] && !excluded[lead] && w.m_blockchain.size() == m_wallets[lead]->m_blockchain.size() && w.m_blockchain.back() == m_wallets[lead]->m_blockchain.back())
+    {
+      w.publish_read_view_if_stale();
+      continue;
+    }
+    size_t fetched = 0;
+    bool received_money = false, ok = false;
+    w.refresh(fetched, received_money, ok);
+    if (!ok)
+      LOG_ERROR("wallets scanner: failed to refresh wallet " << w.get_account().get_public_address_str());
+    ++refreshed_separately;
+  }
+
+  LOG_PRINT_L0("Wallets scanner: " << m_wallets.size() << " wallets refreshed, " << blocks_fetched << " blocks in " << refresh_time << " ms ("
+    << (blocks_fetched * 1000) / (refresh_time ? refresh_time : 1) << " blocks/s), " << refreshed_separately << " wallets refreshed separately");
+}
+//----------------------------------------------------------------------------------------------------
+bool wallets_scanner::pull_blocks(std::vector<bool>& excluded, size_t& blocks_added)
+{
+  blocks_added = 0;
+
+  // the most behind wallet leads, the others join as soon as the batch reaches their top
+  size_t lead = m_wallets.size();
+  for (size_t i = 0; i != m_wallets.size(); ++i)
+    if (!excluded[i] && (lead == m_wallets.size() || m_wallets[i]->m_blockchain.size() < m_wallets[lead]->m_blockchain.size()))
+      lead = i;
+  if (lead == m_wallets.size())
+    return false;
+  wallet2& lw = *m_wallets[lead];
+
+  PROF_L2_START(rpc_get_blocks_time);
+  std::list<crypto::hash> block_ids;
+  lw.get_short_chain_history(block_ids);
+  currency::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
+  lw.fetch_blocks(*m_core_proxy, block_ids, lw.m_blockchain.size(), res);
+  PROF_L2_FINISH(rpc_get_blocks_time);
+
+  std::vector<participant> participants;
+  uint64_t min_createtime = UINT64_MAX;
+  for (size_t i = 0; i != m_wallets.size(); ++i)
+  {
+    if (excluded[i])
+      continue;
+    wallet2& w = *m_wallets[i];
+    participant p = AUTO_VAL_INIT(p);
+    p.wallet_index = i;
+    p.same_as_lead = i == lead || (w.m_blockchain.size() == lw.m_blockchain.size() && w.m_blockchain.back() == lw.m_blockchain.back());
+    if (!p.same_as_lead)
+    {
+      uint64_t sz = w.m_blockchain.size();
+      if (sz <= res.start_height || sz > res.start_height + res.blocks.size())
+        continue; // the batch doesn't reach this wallet's top yet
+      p.first_block = static_cast<size_t>(sz - res.start_height);
+    }
+    participants.push_back(p);
+    min_createtime = std::min<uint64_t>(min_createtime, w.m_account.get_createtime());
+  }
+
+  PROF_L2_START(parse_blocks_time);
+  std::vector<wallet2::block_scan_result> blocks;
+  wallet2::parse_blocks(res, min_createtime, m_threads_count, blocks);
+  PROF_L2_FINISH(parse_blocks_time);
+
+  // a wallet joins only if its top block is the one the batch continues
+  for (auto it = participants.begin(); it != participants.end(); )
+  {
+    if (it->same_as_lead)
+    {
+      ++it;
+      continue;
+    }
+    const wallet2::block_scan_result& top = blocks[it->first_block - 1];
+    if (top.block_parsed && top.id == m_wallets[it->wallet_index]->m_blockchain.back())
+    {
+      ++it;
+      continue;
+    }
+    LOG_PRINT_L1("wallets scanner: wallet " << m_wallets[it->wallet_index]->get_account().get_public_address_str() << " is not on the daemon's chain, it will be refreshed separately");
+    excluded[it->wallet_index] = true;
+    it = participants.erase(it);
+  }
+
+  PROF_L2_START(process_blocks_time);
+  lookup_and_process(res, blocks, participants, excluded, blocks_added);
+  PROF_L2_FINISH(process_blocks_time);
+  PROF_L2_LOG_PRINT("wallets scanner: " << res.blocks.size() << " blocks for " << participants.size() << " wallets, timings: rpc_get_blocks: " << print_mcsec_as_ms(rpc_get_blocks_time)
+    << ", parse_blocks: " << print_mcsec_as_ms(parse_blocks_time) << ", lookup and process(" << m_threads_count << " threads): " << print_mcsec_as_ms(process_blocks_time), LOG_LEVEL_2);
+
+  return blocks_added != 0;
+}
+//----------------------------------------------------------------------------------------------------
+void wallets_scanner::lookup_and_process(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, const std::vector<wallet2::block_scan_result>& blocks,
+  const std::vector<participant>& participants, std::vector<bool>& excluded, size_t& lead_blocks_added)
+{
+  std::vector<const currency::block_complete_entry*> entries;
+  for (auto& bl_entry : res.blocks)
+    entries.push_back(&bl_entry);
+
+  // lookups are kept for a group of wallets at a time to bound memory usage
+  size_t group_start = 0;
+  while (group_start != participants.size() && m_run.load(std::memory_order_relaxed))
+  {
+    size_t group_end = group_start;
+    size_t lookups_count = 0;
+    std::vector<wallet2::blocks_outs_lookups> lookups;
+    std::vector<std::tuple<const wallet2*, const wallet2::tx_scan_result*, wallet2::tx_outs_lookup*> > tasks;
+    while (group_end != participants.size() && (group_end == group_start || lookups_count < WALLETS_SCANNER_MAX_LOOKUPS_PER_PASS))
+    {
+      const participant& p = participants[group_end++];
+      const wallet2& w = *m_wallets[p.wallet_index];
+      lookups.push_back(wallet2::blocks_outs_lookups(blocks.size()));
+      wallet2::blocks_outs_lookups& wl = lookups.back();
+      for (size_t b = p.first_block; b != blocks.size(); ++b)
+      {
+        if (!w.is_block_to_be_scanned(blocks[b]))
+          continue;
+        wl[b].resize(blocks[b].txs.size());
+        lookups_count += wl[b].size();
+      }
+    }
+
+    // every output is checked against all the accounts of the group at once
+    for (size_t k = group_start; k != group_end; ++k)
+    {
+      const wallet2* w = m_wallets[participants[k].wallet_index].get();
+      wallet2::blocks_outs_lookups& wl = lookups[k - group_start];
+      for (size_t b = 0; b != wl.size(); ++b)
+        for (size_t t = 0; t != wl[b].size(); ++t)
+          if (blocks[b].txs[t].tx_parsed)
+            tasks.push_back(std::make_tuple(w, &blocks[b].txs[t], &wl[b][t]));
+    }
+    tools::parallel_for(tasks.size(), m_threads_count, [&](size_t i)
+    {
+      std::get<0>(tasks[i])->lookup_outs(*std::get<1>(tasks[i]), *std::get<2>(tasks[i]));
+    });
+
+    for (size_t k = group_start; k != group_end; ++k)
+    {
+      const participant& p = participants[k];
+      wallet2& w = *m_wallets[p.wallet_index];
+      const wallet2::blocks_outs_lookups& wl = lookups[k - group_start];
+      size_t added = 0;
+      try
+      {
+        if (p.same_as_lead)
+        {
+          w.process_fetched_blocks(res, blocks, wl, added);
+        }
+        else
+        {
+          wallet2::full_txs_container full_txs;
+          w.fetch_related_full_txs(blocks, wl, p.first_block, res.start_height, full_txs);
+          for (size_t b = p.first_block; b != blocks.size(); ++b)
+          {
+            CHECK_AND_THROW_WALLET_EX(!blocks[b].block_parsed, error::block_parse_error, entries[b]->block);
+            w.process_new_blockchain_entry(blocks[b], wl[b], *entries[b], res.start_height + b, full_txs);
+            ++added;
+          }
+          w.publish_read_view();
+        }
+      }
+      catch (const std::exception& e)
+      {
+        LOG_ERROR("wallets scanner: failed to process blocks for wallet " << w.get_account().get_public_address_str() << ": " << e.what() << ", it will be refreshed separately");
+        excluded[p.wallet_index] = true;
+      }
+      if (p.same_as_lead)
+        lead_blocks_added = std::max(lead_blocks_added, added);
+    }
+    group_start = group_end;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+size_t wallets_scanner::store()
+{
+  size_t failed = 0;
+  for (auto& w : m_wallets)
+  {
+    try
+    {
+      w->store();
+    }
+    catch (const std::exception& e)
+    {
+      LOG_ERROR("wallets scanner: failed to store wallet " << w->get_account().get_public_address_str() << ": " << e.what());
+      ++failed;
+    }
+  }
+  return failed;
+}
+//----------------------------------------------------------------------------------------------------
+}
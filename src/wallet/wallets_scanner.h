@@ -0,0 +1,59 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include <atomic>
+#include <memory>
+#include <tuple>
+#include <vector>
+
+#include "wallet2.h"
+
+#define WALLETS_SCANNER_MAX_LOOKUPS_PER_PASS    (1024 * 1024)
+
+namespace tools
+{
+  /* Refreshes many wallets (typically view-only ones) in one pass over the chain: every blocks batch is fetched
+   * and parsed once, then outputs are looked up for all the accounts in parallel and the results are dispatched
+   * to the wallets. Wallets are loaded and stored by the caller as usual, so wallet files stay the same.
+   */
+  class wallets_scanner
+  {
+  public:
+    wallets_scanner();
+
+    void init(const std::string& daemon_address);
+    void set_threads_count(size_t threads_count) { m_threads_count = threads_count ? threads_count : 1; }
+    size_t get_threads_count() const { return m_threads_count; }
+    // wallet is expected to be loaded and initialized with the same daemon
+    void add_wallet(const std::shared_ptr<wallet2>& w);
+    size_t get_wallets_count() const { return m_wallets.size(); }
+    const std::vector<std::shared_ptr<wallet2> >& get_wallets() const { return m_wallets; }
+
+    void refresh(size_t& blocks_fetched);
+    // returns number of wallets that failed to store
+    size_t store();
+    // interrupts refresh(), including the wallets refreshed separately; may be called from another thread
+    void stop();
+    // replaces the connection to the daemon, the wallets keep their own ones
+    void set_core_proxy(const std::shared_ptr<i_core_proxy>& proxy);
+
+  private:
+    struct participant
+    {
+      size_t wallet_index;
+      size_t first_block;               // index in the batch of the first block that is new for the wallet
+      bool same_as_lead;                // has the same chain as the lead wallet, takes the whole batch
+    };
+
+    bool pull_blocks(std::vector<bool>& excluded, size_t& blocks_added);
+    void lookup_and_process(const currency::COMMAND_RPC_GET_BLOCKS_FAST::response& res, const std::vector<wallet2::block_scan_result>& blocks,
+      const std::vector<participant>& participants, std::vector<bool>& excluded, size_t& lead_blocks_added);
+
+    std::vector<std::shared_ptr<wallet2> > m_wallets;
+    std::shared_ptr<i_core_proxy> m_core_proxy;
+    size_t m_threads_count;
+    std::atomic<bool> m_run;
+  };
+}
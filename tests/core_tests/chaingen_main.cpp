@@ -80,6 +80,12 @@ int main(int argc, char* argv[])
 
     GENERATE_AND_PLAY(prun_ring_signatures);
     GENERATE_AND_PLAY(get_random_outs_test);
+    GENERATE_AND_PLAY(gen_concurrent_tx_admission);
+    GENERATE_AND_PLAY(gen_tx_pool_journal_reload);
+    GENERATE_AND_PLAY(gen_fast_sync_pow_skipped);
+    GENERATE_AND_PLAY(gen_fast_sync_checkpoint_failure_rollback);
+    GENERATE_AND_PLAY(gen_fast_sync_unverified_blocks_fork);
+    GENERATE_AND_PLAY(gen_fast_sync_batch_commit_after_failure);
     GENERATE_AND_PLAY(mix_attr_tests);
     GENERATE_AND_PLAY(gen_simple_chain_001);
     GENERATE_AND_PLAY(gen_simple_chain_split_1);
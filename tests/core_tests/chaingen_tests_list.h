@@ -17,6 +17,9 @@
 #include "mixin_attr.h"
 #include "get_random_outs.h"
 #include "pruning_ring_signatures.h"
+#include "tx_admission.h"
+#include "tx_pool_journal.h"
+#include "fast_sync.h"
 /************************************************************************/
 /*                                                                      */
 /************************************************************************/
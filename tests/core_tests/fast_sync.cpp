@@ -0,0 +1,334 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <thread>
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "fast_sync.h"
+
+using namespace epee;
+using namespace currency;
+
+namespace
+{
+  // blocks with the timestamp of the previous one push the difficulty up, next_diffic is the one for the block after them
+  // timestamps and cumulative_difficulties are the ones of the blocks after genesis up to blk_prev, the new blocks are added to them
+  bool lift_up_difficulty(std::vector<test_event_entry>& events, test_generator& generator, const block& blk_prev,
+                          const account_base& miner_account, size_t count, block& blk_last, wide_difficulty_type& next_diffic,
+                          std::vector<uint64_t>& timestamps, std::vector<wide_difficulty_type>& cumulative_difficulties)
+  {
+    blk_last = blk_prev;
+    for (size_t i = 0; i != count; ++i)
+    {
+      wide_difficulty_type diffic = next_difficulty(timestamps, cumulative_difficulties);
+      block blk = AUTO_VAL_INIT(blk);
+      if (!generator.construct_block_manually(blk, blk_last, miner_account,
+        test_generator::bf_timestamp | test_generator::bf_diffic, 0, 0, blk_last.timestamp, crypto::hash(), diffic))
+        return false;
+      timestamps.push_back(blk.timestamp);
+      cumulative_difficulties.push_back((cumulative_difficulties.empty() ? 0 : cumulative_difficulties.back()) + diffic);
+      events.push_back(blk);
+      blk_last = blk;
+    }
+    next_diffic = next_difficulty(timestamps, cumulative_difficulties);
+    return true;
+  }
+
+  bool lift_up_difficulty(std::vector<test_event_entry>& events, test_generator& generator, const block& blk_0,
+                          const account_base& miner_account, size_t count, block& blk_last, wide_difficulty_type& next_diffic)
+  {
+    std::vector<uint64_t> timestamps;
+    std::vector<wide_difficulty_type> cumulative_difficulties;
+    return lift_up_difficulty(events, generator, blk_0, miner_account, count, blk_last, next_diffic, timestamps, cumulative_difficulties);
+  }
+
+  // the nonce is one off a found one, so the PoW doesn't fit the difficulty
+  bool construct_block_with_bad_pow(test_generator& generator, block& blk, const block& blk_prev,
+                                    const account_base& miner_account, wide_difficulty_type diffic)
+  {
+    CHECK_AND_ASSERT_MES(1 < diffic, false, "difficulty " << diffic << " is too low for a bad PoW");
+    uint64_t timestamp = blk_prev.timestamp;
+    do
+    {
+      ++timestamp;
+      blk.miner_tx.set_null();
+      if (!generator.construct_block_manually(blk, blk_prev, miner_account,
+        test_generator::bf_diffic | test_generator::bf_timestamp, 0, 0, timestamp, crypto::hash(), diffic))
+        return false;
+    }
+    while (0 == blk.nonce);
+    --blk.nonce;
+
+    // the generator knows the block by its id with the good nonce, blocks on top of the bad one need it too
+    crypto::hash prev_id = get_block_hash(blk_prev);
+    std::vector<size_t> block_sizes;
+    generator.get_last_n_block_sizes(block_sizes, prev_id, CURRENCY_REWARD_BLOCKS_WINDOW);
+    generator.add_block(blk, 0, block_sizes, generator.get_already_generated_coins(prev_id), generator.get_already_donated_coins(prev_id), diffic);
+    return true;
+  }
+}
+
+gen_fast_sync_base::gen_fast_sync_base()
+  : m_invalid_block_index(0)
+{
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_base, set_checkpoint);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_base, mark_invalid_block);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_base, check_blocks_unverified);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_base, check_blocks_confirmed);
+}
+
+bool gen_fast_sync_base::check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& /*blk*/)
+{
+  if (m_invalid_block_index == event_idx)
+    return bvc.m_verifivation_failed && !bvc.m_added_to_main_chain;
+  else
+    return !bvc.m_verifivation_failed;
+}
+
+bool gen_fast_sync_base::set_checkpoint(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  for (size_t i = events.size(); i != ev_index; --i)
+  {
+    if (typeid(block) != events[i - 1].type())
+      continue;
+    const block& b = boost::get<block>(events[i - 1]);
+    checkpoints cp;
+    cp.add_checkpoint(get_block_height(b), string_tools::pod_to_hex(get_block_hash(b)));
+    c.set_checkpoints(std::move(cp));
+    return true;
+  }
+  return false;
+}
+
+bool gen_fast_sync_base::mark_invalid_block(currency::core& /*c*/, size_t ev_index, const std::vector<test_event_entry>& /*events*/)
+{
+  m_invalid_block_index = ev_index + 1;
+  return true;
+}
+
+bool gen_fast_sync_base::check_blocks_unverified(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  // every block after genesis is below the checkpoint
+  CHECK_EQ(1, c.get_blockchain_storage().get_fast_sync_unverified_height());
+  return check_top_block(c, ev_index, events);
+}
+
+bool gen_fast_sync_base::check_blocks_confirmed(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_EQ(0, c.get_blockchain_storage().get_fast_sync_unverified_height());
+  return check_top_block(c, ev_index, events);
+}
+
+bool gen_fast_sync_base::check_top_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  for (size_t i = ev_index; i != 0; --i)
+  {
+    if (i - 1 == m_invalid_block_index || typeid(block) != events[i - 1].type())
+      continue;
+    const block& b = boost::get<block>(events[i - 1]);
+    CHECK_EQ(get_block_hash(b), c.get_tail_id());
+    CHECK_EQ(get_block_height(b) + 1, c.get_current_blockchain_height());
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+bool gen_fast_sync_pow_skipped::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  DO_CALLBACK(events, "set_checkpoint");
+
+  block blk_2 = AUTO_VAL_INIT(blk_2);
+  wide_difficulty_type diffic = 0;
+  if (!lift_up_difficulty(events, generator, blk_0, miner_account, 2, blk_2, diffic))
+    return false;
+  block blk_3 = AUTO_VAL_INIT(blk_3);
+  if (!construct_block_with_bad_pow(generator, blk_3, blk_2, miner_account, diffic))
+    return false;
+  events.push_back(blk_3);
+  DO_CALLBACK(events, "check_blocks_unverified");
+
+  // the checkpoint, with the lowest difficulty PoW as well
+  block blk_4 = AUTO_VAL_INIT(blk_4);
+  if (!generator.construct_block_manually(blk_4, blk_3, miner_account, test_generator::bf_diffic))
+    return false;
+  events.push_back(blk_4);
+  DO_CALLBACK(events, "check_blocks_confirmed");
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+gen_fast_sync_checkpoint_failure_rollback::gen_fast_sync_checkpoint_failure_rollback()
+{
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_checkpoint_failure_rollback, check_rolled_back);
+}
+
+bool gen_fast_sync_checkpoint_failure_rollback::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  DO_CALLBACK(events, "set_checkpoint");
+
+  // alice's chain is not the one of the checkpoint
+  MAKE_NEXT_BLOCK(events, blk_1a, blk_0, alice_account);
+  MAKE_NEXT_BLOCK(events, blk_2a, blk_1a, alice_account);
+  DO_CALLBACK(events, "check_blocks_unverified");
+  DO_CALLBACK(events, "mark_invalid_block");
+  MAKE_NEXT_BLOCK(events, blk_3a, blk_2a, alice_account);
+  DO_CALLBACK(events, "check_rolled_back");
+
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  DO_CALLBACK(events, "check_blocks_confirmed");
+  return true;
+}
+
+bool gen_fast_sync_checkpoint_failure_rollback::check_rolled_back(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_EQ(1, c.get_current_blockchain_height());
+  CHECK_EQ(get_block_hash(boost::get<block>(events[0])), c.get_tail_id());
+  CHECK_EQ(0, c.get_blockchain_storage().get_fast_sync_unverified_height());
+  return true;
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+gen_fast_sync_unverified_blocks_fork::gen_fast_sync_unverified_blocks_fork()
+  : m_fork_index(0)
+{
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_unverified_blocks_fork, start_fork);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_unverified_blocks_fork, check_fork_kept);
+}
+
+bool gen_fast_sync_unverified_blocks_fork::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  DO_CALLBACK(events, "set_checkpoint");
+
+  block blk_2 = AUTO_VAL_INIT(blk_2);
+  wide_difficulty_type diffic = 0;
+  std::vector<uint64_t> timestamps;
+  std::vector<wide_difficulty_type> cumulative_difficulties;
+  if (!lift_up_difficulty(events, generator, blk_0, miner_account, 2, blk_2, diffic, timestamps, cumulative_difficulties))
+    return false;
+  // alice's blocks have the lowest difficulty PoW, they are the chain of the checkpoint
+  block blk_3 = AUTO_VAL_INIT(blk_3);
+  if (!generator.construct_block_manually(blk_3, blk_2, alice_account, test_generator::bf_diffic))
+    return false;
+  events.push_back(blk_3);
+  DO_CALLBACK(events, "check_blocks_unverified");
+
+  // a fork that fails the PoW check doesn't touch them
+  DO_CALLBACK(events, "mark_invalid_block");
+  block blk_3_bad = AUTO_VAL_INIT(blk_3_bad);
+  if (!construct_block_with_bad_pow(generator, blk_3_bad, blk_2, miner_account, diffic))
+    return false;
+  events.push_back(blk_3_bad);
+  DO_CALLBACK(events, "check_blocks_unverified");
+
+  // a fork with good PoW and more cumulative difficulty is kept as alternative, only the checkpoint settles them
+  DO_CALLBACK(events, "start_fork");
+  block blk_4f = AUTO_VAL_INIT(blk_4f);
+  if (!lift_up_difficulty(events, generator, blk_2, miner_account, 2, blk_4f, diffic, timestamps, cumulative_difficulties))
+    return false;
+  DO_CALLBACK(events, "check_fork_kept");
+
+  block blk_4 = AUTO_VAL_INIT(blk_4);
+  if (!generator.construct_block_manually(blk_4, blk_3, alice_account, test_generator::bf_diffic))
+    return false;
+  events.push_back(blk_4);
+  // the checkpoint
+  block blk_5 = AUTO_VAL_INIT(blk_5);
+  if (!generator.construct_block_manually(blk_5, blk_4, alice_account, test_generator::bf_diffic))
+    return false;
+  events.push_back(blk_5);
+  DO_CALLBACK(events, "check_blocks_confirmed");
+  return true;
+}
+
+bool gen_fast_sync_unverified_blocks_fork::start_fork(currency::core& /*c*/, size_t ev_index, const std::vector<test_event_entry>& /*events*/)
+{
+  m_fork_index = ev_index;
+  return true;
+}
+
+bool gen_fast_sync_unverified_blocks_fork::check_fork_kept(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_EQ(1, c.get_blockchain_storage().get_fast_sync_unverified_height());
+  CHECK_EQ(ev_index - m_fork_index - 1, c.get_alternative_blocks_count());
+  return check_top_block(c, m_fork_index, events);
+}
+
+//----------------------------------------------------------------------------------------------------------------------
+
+gen_fast_sync_batch_commit_after_failure::gen_fast_sync_batch_commit_after_failure()
+{
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_batch_commit_after_failure, start_batch);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_batch_commit_after_failure, finish_batch);
+  REGISTER_CALLBACK_METHOD(gen_fast_sync_batch_commit_after_failure, check_batch_committed);
+}
+
+bool gen_fast_sync_batch_commit_after_failure::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0, miner_account);
+
+  DO_CALLBACK(events, "start_batch");
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  // fails on the timestamp check, after its nested db transaction is opened
+  DO_CALLBACK(events, "mark_invalid_block");
+  block blk_4_bad = AUTO_VAL_INIT(blk_4_bad);
+  if (!generator.construct_block_manually(blk_4_bad, blk_3, miner_account, test_generator::bf_timestamp, 0, 0, time(NULL) + 60 * 60 + CURRENCY_BLOCK_FUTURE_TIME_LIMIT))
+    return false;
+  events.push_back(blk_4_bad);
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3, miner_account);
+  DO_CALLBACK(events, "finish_batch");
+  DO_CALLBACK(events, "check_batch_committed");
+
+  MAKE_NEXT_BLOCK(events, blk_5, blk_4, miner_account);
+  DO_CALLBACK(events, "check_batch_committed");
+  return true;
+}
+
+bool gen_fast_sync_batch_commit_after_failure::start_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  return c.get_blockchain_storage().start_batch_exclusive_operation();
+}
+
+bool gen_fast_sync_batch_commit_after_failure::finish_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  return c.get_blockchain_storage().finish_batch_exclusive_operation(false);
+}
+
+bool gen_fast_sync_batch_commit_after_failure::check_batch_committed(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  // another thread reads the chain the way it is in the db
+  crypto::hash top_id = null_hash;
+  uint64_t height = 0;
+  std::thread reader([&]()
+  {
+    top_id = c.get_tail_id();
+    height = c.get_current_blockchain_height();
+  });
+  reader.join();
+  CHECK_EQ(c.get_tail_id(), top_id);
+  CHECK_EQ(c.get_current_blockchain_height(), height);
+  return check_top_block(c, ev_index, events);
+}
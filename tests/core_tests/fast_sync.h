@@ -0,0 +1,68 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Fast sync: blocks below the top checkpoint (the last block of the    */
+/* test) are added without PoW check until a checkpoint confirms them.  */
+/************************************************************************/
+struct gen_fast_sync_base : public test_chain_unit_base
+{
+  gen_fast_sync_base();
+
+  bool check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& /*blk*/);
+
+  bool set_checkpoint(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool mark_invalid_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_blocks_unverified(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_blocks_confirmed(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+protected:
+  // the top block is the last one before ev_index, except for the one marked invalid
+  bool check_top_block(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+private:
+  size_t m_invalid_block_index;
+};
+
+// a block with wrong PoW is taken below the checkpoint, the checkpoint clears the unverified height
+struct gen_fast_sync_pow_skipped : public gen_fast_sync_base
+{
+  bool generate(std::vector<test_event_entry>& events) const;
+};
+
+// a wrong chain is rolled back when it comes to the checkpoint, then the right one is taken
+struct gen_fast_sync_checkpoint_failure_rollback : public gen_fast_sync_base
+{
+  gen_fast_sync_checkpoint_failure_rollback();
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_rolled_back(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
+
+// a fork of unverified blocks doesn't replace them, even with good PoW and more cumulative difficulty
+struct gen_fast_sync_unverified_blocks_fork : public gen_fast_sync_base
+{
+  gen_fast_sync_unverified_blocks_fork();
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool start_fork(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_fork_kept(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+private:
+  size_t m_fork_index;
+};
+
+// blocks added in a batch before a failed one are committed with it
+struct gen_fast_sync_batch_commit_after_failure : public gen_fast_sync_base
+{
+  gen_fast_sync_batch_commit_after_failure();
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool start_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool finish_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_batch_committed(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include <boost/thread.hpp>
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "tx_admission.h"
+
+using namespace epee;
+using namespace currency;
+
+#define TX_ADMISSION_TEST_BATCHES_COUNT 8
+
+gen_concurrent_tx_admission::gen_concurrent_tx_admission()
+{
+  REGISTER_CALLBACK_METHOD(gen_concurrent_tx_admission, check_concurrent_admission);
+}
+
+bool gen_concurrent_tx_admission::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);                                           //  0
+  MAKE_ACCOUNT(events, bob_account);                                                                    //  1
+  MAKE_ACCOUNT(events, carol_account);                                                                  //  2
+  MAKE_ACCOUNT(events, alice_account);                                                                  //  3
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);                                                  // <N blocks>
+
+  MAKE_TX_LIST_START(events, txs_blk_1, miner_account, bob_account, MK_COINS(10), blk_0r);
+  MAKE_TX_LIST(events, txs_blk_1, miner_account, carol_account, MK_COINS(10), blk_0r);
+  MAKE_NEXT_BLOCK_TX_LIST(events, blk_1, blk_0r, miner_account, txs_blk_1);
+  REWIND_BLOCKS(events, blk_1r, blk_1, miner_account);                                                  // <N blocks>
+
+  DO_CALLBACK(events, "check_concurrent_admission");
+  return true;
+}
+
+bool gen_concurrent_tx_admission::check_concurrent_admission(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  const account_base& bob_account = boost::get<account_base>(events[1]);
+  const account_base& carol_account = boost::get<account_base>(events[2]);
+  const account_base& alice_account = boost::get<account_base>(events[3]);
+
+  block head = AUTO_VAL_INIT(head);
+  CHECK_TEST_CONDITION(c.get_block_by_hash(c.get_tail_id(), head));
+
+  // tx_1 and tx_2 spend the same output of bob, tx_3 doesn't conflict with them
+  std::vector<test_event_entry> chain_events(events.begin(), events.begin() + ev_index);
+  transaction tx_1, tx_2, tx_3;
+  CHECK_TEST_CONDITION(construct_tx_to_key(chain_events, tx_1, head, bob_account, alice_account, MK_COINS(1), TESTS_DEFAULT_FEE, 0));
+  CHECK_TEST_CONDITION(construct_tx_to_key(chain_events, tx_2, head, bob_account, alice_account, MK_COINS(2), TESTS_DEFAULT_FEE, 0));
+  CHECK_TEST_CONDITION(construct_tx_to_key(chain_events, tx_3, head, carol_account, alice_account, MK_COINS(1), TESTS_DEFAULT_FEE, 0));
+  crypto::hash tx_1_id = get_transaction_hash(tx_1);
+  crypto::hash tx_2_id = get_transaction_hash(tx_2);
+  crypto::hash tx_3_id = get_transaction_hash(tx_3);
+
+  std::list<blobdata> blobs;
+  blobs.push_back(tx_to_blob(tx_1));
+  blobs.push_back(tx_to_blob(tx_2));
+  blobs.push_back(tx_to_blob(tx_3));
+
+  // several connections deliver the same batch at once, each batch is verified in parallel too
+  std::vector<std::vector<tx_verification_context> > batches_tvcs(TX_ADMISSION_TEST_BATCHES_COUNT);
+  std::vector<boost::thread> threads;
+  for (size_t i = 0; i != TX_ADMISSION_TEST_BATCHES_COUNT; ++i)
+    threads.push_back(boost::thread([&, i](){ c.handle_incoming_txs(blobs, batches_tvcs[i], false); }));
+  for (auto& th : threads)
+    th.join();
+  std::vector<tx_verification_context> tvcs;
+  for (const auto& batch_tvcs : batches_tvcs)
+  {
+    CHECK_EQ(blobs.size(), batch_tvcs.size());
+    tvcs.insert(tvcs.end(), batch_tvcs.begin(), batch_tvcs.end());
+  }
+
+  // whichever of the conflicting txs was committed first wins, its copies are not failures
+  CHECK_EQ(2, c.get_pool_transactions_count());
+  CHECK_TEST_CONDITION(c.get_tx_pool().have_tx(tx_3_id));
+  bool tx_1_won = c.get_tx_pool().have_tx(tx_1_id);
+  CHECK_TEST_CONDITION(tx_1_won != c.get_tx_pool().have_tx(tx_2_id));
+  const crypto::hash& winner_id = tx_1_won ? tx_1_id : tx_2_id;
+
+  size_t added_count = 0;
+  for (const auto& tvc : tvcs)
+  {
+    CHECK_TEST_CONDITION(!tvc.m_admission_timed_out);
+    if (tvc.m_tx_hash == winner_id || tvc.m_tx_hash == tx_3_id)
+      CHECK_TEST_CONDITION(!tvc.m_verifivation_failed);
+    else
+      CHECK_TEST_CONDITION(tvc.m_verifivation_failed && !tvc.m_added_to_pool);
+    if (tvc.m_added_to_pool)
+      ++added_count;
+  }
+  CHECK_EQ(2, added_count);
+
+  // the loser is still rejected when it comes alone
+  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+  c.handle_incoming_tx(tx_1_won ? tx_2 : tx_1, tvc, false);
+  CHECK_TEST_CONDITION(tvc.m_verifivation_failed);
+  CHECK_EQ(2, c.get_pool_transactions_count());
+  return true;
+}
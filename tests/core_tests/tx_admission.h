@@ -0,0 +1,27 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once 
+#include "chaingen.h"
+
+/************************************************************************/
+/* Batches of relayed txs are verified concurrently: copies of one tx   */
+/* and txs spending the same key image race for the pool commit.        */
+/************************************************************************/
+struct gen_concurrent_tx_admission : public test_chain_unit_base
+{
+  gen_concurrent_tx_admission();
+
+  bool check_tx_verification_context(const currency::tx_verification_context& tvc, bool tx_added, size_t event_idx, const currency::transaction& /*tx*/)
+  {
+    return !tvc.m_verifivation_failed;
+  }
+  bool check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& /*blk*/)
+  {
+    return !bvc.m_verifivation_failed;
+  }
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_concurrent_admission(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -0,0 +1,110 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "string_coding.h"
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "tx_pool_journal.h"
+
+using namespace epee;
+using namespace currency;
+
+gen_tx_pool_journal_reload::gen_tx_pool_journal_reload()
+{
+  REGISTER_CALLBACK_METHOD(gen_tx_pool_journal_reload, check_journal_reload);
+}
+
+bool gen_tx_pool_journal_reload::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);                                           //  0
+  MAKE_ACCOUNT(events, bob_account);                                                                    //  1
+  // each tx below spends a coinbase of its own, they all have to be unlocked
+  REWIND_BLOCKS_N(events, blk_0r, blk_0, miner_account, CURRENCY_MINED_MONEY_UNLOCK_WINDOW + 3);
+
+  // all three go to the pool, then the first one is mined and removed from it
+  MAKE_TX_LIST_START(events, txs, miner_account, bob_account, MK_COINS(1), blk_0r);
+  MAKE_TX_LIST(events, txs, miner_account, bob_account, MK_COINS(2), blk_0r);
+  MAKE_TX_LIST(events, txs, miner_account, bob_account, MK_COINS(3), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, txs.front());
+
+  DO_CALLBACK(events, "check_journal_reload");
+  return true;
+}
+
+bool gen_tx_pool_journal_reload::check_journal_reload(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  std::vector<crypto::hash> tx_ids;
+  for (size_t i = 0; i != ev_index; ++i)
+  {
+    if (typeid(transaction) == events[i].type())
+      tx_ids.push_back(get_transaction_hash(boost::get<transaction>(events[i])));
+  }
+  CHECK_EQ(3, tx_ids.size());
+  CHECK_EQ(2, c.get_pool_transactions_count());
+
+  // the journal is written by its own thread, take a copy once it's on the disk
+  c.get_tx_pool().flush_journal();
+  std::string reload_folder = c.get_config_folder() + "/journal_reload";
+  std::string journal_path = reload_folder + "/" CURRENCY_POOLDATA_JOURNAL_FILENAME;
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(reload_folder, ec);
+  CHECK_TEST_CONDITION(tools::create_directories_if_necessary(reload_folder));
+  boost::filesystem::copy_file(c.get_config_folder() + "/" CURRENCY_POOLDATA_JOURNAL_FILENAME, journal_path, ec);
+  CHECK_TEST_CONDITION(!ec);
+
+  // the mined tx was added and then removed
+  {
+    tools::journal_file j;
+    std::vector<std::string> records;
+    bool corrupted = true;
+    CHECK_TEST_CONDITION(j.open(epee::string_encoding::utf8_to_wstring(journal_path), records, &corrupted));
+    CHECK_TEST_CONDITION(!corrupted);
+    CHECK_EQ(4, records.size());
+    std::vector<tx_memory_pool::journal_record> recs(records.size());
+    for (size_t i = 0; i != records.size(); ++i)
+      CHECK_TEST_CONDITION(tools::unserialize_obj_from_buff(recs[i], records[i]));
+    for (size_t i = 0; i != tx_ids.size(); ++i)
+    {
+      CHECK_TEST_CONDITION(recs[i].type == tx_memory_pool::journal_record::add);
+      CHECK_TEST_CONDITION(recs[i].id == tx_ids[i]);
+    }
+    CHECK_TEST_CONDITION(recs[3].type == tx_memory_pool::journal_record::remove);
+    CHECK_TEST_CONDITION(recs[3].id == tx_ids[0]);
+  }
+
+  // a crash while appending leaves a torn record at the end
+  {
+    boost::filesystem::ofstream out(journal_path, std::ios::binary | std::ios::app);
+    uint32_t torn_header[2] = { 1000, 0 };
+    out.write(reinterpret_cast<const char*>(torn_header), sizeof torn_header);
+    out.write("torn", 4);
+  }
+
+  tx_memory_pool pool(c.get_blockchain_storage());
+  boost::program_options::variables_map vm;
+  CHECK_TEST_CONDITION(pool.init(reload_folder, vm));
+  // the loaded txs are revalidated on idle
+  pool.on_idle();
+  CHECK_EQ(2, pool.get_transactions_count());
+  CHECK_TEST_CONDITION(!pool.have_tx(tx_ids[0]));
+  CHECK_TEST_CONDITION(pool.have_tx(tx_ids[1]));
+  CHECK_TEST_CONDITION(pool.have_tx(tx_ids[2]));
+  pool.deinit();
+
+  // the torn record is cut off, the journal is compacted to the pool
+  {
+    tools::journal_file j;
+    std::vector<std::string> records;
+    bool corrupted = true;
+    CHECK_TEST_CONDITION(j.open(epee::string_encoding::utf8_to_wstring(journal_path), records, &corrupted));
+    CHECK_TEST_CONDITION(!corrupted);
+    CHECK_EQ(2, records.size());
+  }
+  boost::filesystem::remove_all(reload_folder, ec);
+  return true;
+}
@@ -0,0 +1,27 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once 
+#include "chaingen.h"
+
+/************************************************************************/
+/* Pool changes go to the journal, another pool loaded from a copy of   */
+/* it (with a torn record at the end) gets the same transactions.       */
+/************************************************************************/
+struct gen_tx_pool_journal_reload : public test_chain_unit_base
+{
+  gen_tx_pool_journal_reload();
+
+  bool check_tx_verification_context(const currency::tx_verification_context& tvc, bool tx_added, size_t event_idx, const currency::transaction& /*tx*/)
+  {
+    return !tvc.m_verifivation_failed && tx_added;
+  }
+  bool check_block_verification_context(const currency::block_verification_context& bvc, size_t event_idx, const currency::block& /*blk*/)
+  {
+    return !bvc.m_verifivation_failed;
+  }
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_journal_reload(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
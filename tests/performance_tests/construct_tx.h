@@ -10,18 +10,18 @@
 
 #include "multi_tx_test_base.h"
 
-template<size_t a_in_count, size_t a_out_count>
-class test_construct_tx : private multi_tx_test_base<a_in_count>
+// a_threads_count is the number of threads ring signatures are generated with, 0 - default worker threads count
+template<size_t a_in_count, size_t a_ring_size, size_t a_threads_count>
+class test_construct_tx : private multi_tx_test_base<a_ring_size>
 {
   static_assert(0 < a_in_count, "in_count must be greater than 0");
-  static_assert(0 < a_out_count, "out_count must be greater than 0");
 
 public:
-  static const size_t loop_count = (a_in_count + a_out_count < 100) ? 100 : 10;
-  static const size_t in_count  = a_in_count;
-  static const size_t out_count = a_out_count;
+  static const size_t loop_count = (a_in_count * a_ring_size < 100) ? 100 : 10;
+  static const size_t in_count = a_in_count;
+  static const size_t threads_count = a_threads_count;
 
-  typedef multi_tx_test_base<a_in_count> base_class;
+  typedef multi_tx_test_base<a_ring_size> base_class;
 
   bool init()
   {
@@ -30,19 +30,24 @@ public:
     if (!base_class::init())
       return false;
 
-    m_alice.generate();
+    // every input spends the same ring, the tx is not meant to be valid, only the cost of building it matters
+    tx_source_entry source_entry = this->m_sources.front();
+    for (size_t i = 1; i < in_count; ++i)
+      this->m_sources.push_back(source_entry);
 
-    for (size_t i = 0; i < out_count; ++i)
-    {
-      m_destinations.push_back(tx_destination_entry(this->m_source_amount / out_count, m_alice.get_keys().m_account_address));
-    }
+    m_alice.generate();
+    uint64_t amount = this->m_source_amount * in_count;
+    m_destinations.push_back(tx_destination_entry(amount / 2, m_alice.get_keys().m_account_address));
+    m_destinations.push_back(tx_destination_entry(amount - amount / 2, m_alice.get_keys().m_account_address));
 
     return true;
   }
 
   bool test()
   {
-    return currency::construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, m_destinations, m_tx, 0);
+    currency::keypair txkey = AUTO_VAL_INIT(txkey);
+    return currency::construct_tx(this->m_miners[this->real_source_idx].get_keys(), this->m_sources, m_destinations, std::vector<uint8_t>(), m_tx, txkey, 0,
+      CURRENCY_TO_KEY_OUT_RELAXED, threads_count);
   }
 
 private:
@@ -36,3 +36,29 @@ private:
   crypto::key_derivation m_key_derivation;
   crypto::public_key m_spend_public_key;
 };
+
+class test_derive_public_key_precomputed : public single_tx_test_base
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    if (!single_tx_test_base::init())
+      return false;
+
+    crypto::generate_key_derivation(m_tx_pub_key, m_bob.get_keys().m_view_secret_key, m_key_derivation);
+    return crypto::precompute_public_key(m_bob.get_keys().m_account_address.m_spend_public_key, m_spend_public_key);
+  }
+
+  bool test()
+  {
+    currency::keypair in_ephemeral;
+    crypto::derive_public_key(m_key_derivation, 0, m_spend_public_key, in_ephemeral.pub);
+    return true;
+  }
+
+private:
+  crypto::key_derivation m_key_derivation;
+  crypto::precomputed_public_key m_spend_public_key;
+};
@@ -21,3 +21,40 @@ public:
     return currency::is_out_to_acc(m_bob.get_keys(), tx_out, m_tx_pub_key, 0);
   }
 };
+
+template<size_t a_out_count>
+class test_lookup_acc_outs
+{
+public:
+  static const size_t out_count = a_out_count;
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    using namespace currency;
+
+    m_bob.generate();
+    keypair txkey = keypair::generate();
+    add_tx_pub_key_to_extra(m_tx, txkey.pub);
+    for (size_t i = 0; i < out_count; ++i)
+    {
+      if (!construct_tx_out(m_bob.get_keys().m_account_address, txkey.sec, i, 1, m_tx))
+        return false;
+    }
+
+    m_tx_pub_key = txkey.pub;
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<size_t> outs;
+    uint64_t money_transfered = 0;
+    return currency::lookup_acc_outs(m_bob.get_keys(), m_tx, m_tx_pub_key, outs, money_transfered) && outs.size() == out_count;
+  }
+
+private:
+  currency::account_base m_bob;
+  currency::transaction m_tx;
+  crypto::public_key m_tx_pub_key;
+};
@@ -43,40 +43,42 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_wild_keccak2, 100000000);
 
   measure_keccak_over_scratchpad();
-  /*
-  TEST_PERFORMANCE2(test_construct_tx, 1, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 100);
-  TEST_PERFORMANCE2(test_construct_tx, 1, 1000);
-
-  TEST_PERFORMANCE2(test_construct_tx, 2, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 2, 100);
-
-  TEST_PERFORMANCE2(test_construct_tx, 10, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 10, 100);
 
-  TEST_PERFORMANCE2(test_construct_tx, 100, 1);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 2);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 10);
-  TEST_PERFORMANCE2(test_construct_tx, 100, 100);
+  TEST_PERFORMANCE0(test_is_out_to_acc);
+  TEST_PERFORMANCE1(test_lookup_acc_outs, 1);
+  TEST_PERFORMANCE1(test_lookup_acc_outs, 2);
+  TEST_PERFORMANCE1(test_lookup_acc_outs, 10);
+  TEST_PERFORMANCE0(test_derive_public_key);
+  TEST_PERFORMANCE0(test_derive_public_key_precomputed);
 
+  /*
   TEST_PERFORMANCE1(test_check_ring_signature, 1);
   TEST_PERFORMANCE1(test_check_ring_signature, 2);
   TEST_PERFORMANCE1(test_check_ring_signature, 10);
   TEST_PERFORMANCE1(test_check_ring_signature, 100);
 
-  TEST_PERFORMANCE0(test_is_out_to_acc);
   TEST_PERFORMANCE0(test_generate_key_image_helper);
   TEST_PERFORMANCE0(test_generate_key_derivation);
   TEST_PERFORMANCE0(test_generate_key_image);
-  TEST_PERFORMANCE0(test_derive_public_key);
   TEST_PERFORMANCE0(test_derive_secret_key);
   */
+
+  // inputs count / ring size sweeps of construct_tx, with one signing thread, then with all the cores
+  TEST_PERFORMANCE3(test_construct_tx, 1, 1, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 1, 5, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 10, 1, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 10, 5, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 10, 10, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 50, 5, 1);
+  TEST_PERFORMANCE3(test_construct_tx, 100, 5, 1);
+
+  reset_process_affinity();
+  TEST_PERFORMANCE3(test_construct_tx, 10, 1, 0);
+  TEST_PERFORMANCE3(test_construct_tx, 10, 5, 0);
+  TEST_PERFORMANCE3(test_construct_tx, 10, 10, 0);
+  TEST_PERFORMANCE3(test_construct_tx, 50, 5, 0);
+  TEST_PERFORMANCE3(test_construct_tx, 100, 5, 0);
+
   std::cout << "Tests finished. Elapsed time: " << timer.elapsed_ms() / 1000 << " sec" << std::endl;
 
   return 0;
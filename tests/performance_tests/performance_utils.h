@@ -35,6 +35,27 @@ void set_process_affinity(int core)
 #endif
 }
 
+// lets threads started after this call run on any core, e.g. for tests of parallel code
+void reset_process_affinity()
+{
+#if defined(WIN32)
+  DWORD_PTR process_mask = 0, system_mask = 0;
+  if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask))
+    SetProcessAffinityMask(GetCurrentProcess(), system_mask);
+#elif defined(__MACH__)
+//#warning reset_process_affinity is not currently supported on MacOS
+#else
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  for (int i = 0; i < CPU_SETSIZE; ++i)
+    CPU_SET(i, &cpuset);
+  if (0 != pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+  {
+    std::cout << "pthread_setaffinity_np - ERROR" << std::endl;
+  }
+#endif
+}
+
 void set_thread_high_priority()
 {
 #if defined(WIN32)
@@ -0,0 +1,235 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "include_base_utils.h"
+#include "currency_protocol/block_download_scheduler.h"
+
+namespace
+{
+  crypto::hash get_test_block_id(uint64_t height)
+  {
+    return crypto::cn_fast_hash(&height, sizeof height);
+  }
+
+  std::vector<crypto::hash> get_test_chain(uint64_t from_height, uint64_t to_height, uint64_t salt = 0)
+  {
+    std::vector<crypto::hash> ids;
+    for (uint64_t h = from_height; h != to_height; ++h)
+      ids.push_back(get_test_block_id(h + salt));
+    return ids;
+  }
+
+  currency::block_download_scheduler::peer_context make_test_peer(uint8_t n)
+  {
+    boost::uuids::uuid id = boost::uuids::nil_uuid();
+    id.data[0] = n;
+    return currency::block_download_scheduler::peer_context(id, n, n, false);
+  }
+
+  // blocks are told apart by their ids only, it's enough for the scheduler
+  std::vector<currency::prevalidated_block> make_test_blocks(const std::list<crypto::hash>& ids)
+  {
+    std::vector<currency::prevalidated_block> blocks(ids.size());
+    auto it = ids.begin();
+    for (auto& b : blocks)
+      b.id = *it++;
+    return blocks;
+  }
+
+  bool receive_test_range(currency::block_download_scheduler& s, const currency::block_download_scheduler::peer_context& peer, const std::list<crypto::hash>& ids, uint64_t now)
+  {
+    uint64_t start_height = 0;
+    std::vector<crypto::hash> range_ids;
+    if (!s.on_range_received(peer, ids.size(), now, start_height, range_ids))
+      return false;
+    auto blocks = make_test_blocks(ids);
+    return s.on_range_prevalidated(start_height, blocks, peer);
+  }
+}
+
+TEST(block_download_scheduler, ranges_go_to_several_peers_and_come_back_in_order)
+{
+  currency::block_download_scheduler s(10, 100, 1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2), p3 = make_test_peer(3);
+  ASSERT_TRUE(s.add_chain(p1, 5, get_test_chain(5, 35), 35));
+  ASSERT_TRUE(s.add_chain(p2, 5, get_test_chain(5, 35), 35));
+  ASSERT_TRUE(s.add_chain(p3, 5, get_test_chain(5, 35), 35));
+  ASSERT_EQ(3, s.get_ranges_count());
+
+  std::list<crypto::hash> r1, r2, r3, r4;
+  ASSERT_TRUE(s.get_range(p1, 0, r1));
+  ASSERT_TRUE(s.get_range(p2, 0, r2));
+  ASSERT_TRUE(s.get_range(p3, 0, r3));
+  ASSERT_FALSE(s.get_range(p3, 0, r4));     // busy with its range
+  ASSERT_EQ(get_test_block_id(5), r1.front());
+  ASSERT_EQ(get_test_block_id(15), r2.front());
+  ASSERT_EQ(get_test_block_id(25), r3.front());
+
+  // the last range arrives first, it waits for the ones before it
+  ASSERT_TRUE(receive_test_range(s, p3, r3, 100));
+  ASSERT_FALSE(s.has_ready_range());
+  ASSERT_TRUE(receive_test_range(s, p1, r1, 100));
+  ASSERT_TRUE(s.has_ready_range());
+
+  uint64_t start_height = 0;
+  std::list<currency::prevalidated_block> blocks;
+  currency::block_download_scheduler::peer_context source;
+  ASSERT_TRUE(s.pop_ready_range(start_height, blocks, source));
+  ASSERT_EQ(5, start_height);
+  ASSERT_EQ(10, blocks.size());
+  ASSERT_EQ(get_test_block_id(5), blocks.front().id);
+  ASSERT_EQ(p1.m_connection_id, source.m_connection_id);
+  ASSERT_FALSE(s.pop_ready_range(start_height, blocks, source));
+
+  ASSERT_TRUE(receive_test_range(s, p2, r2, 100));
+  ASSERT_TRUE(s.pop_ready_range(start_height, blocks, source));
+  ASSERT_EQ(15, start_height);
+  ASSERT_TRUE(s.pop_ready_range(start_height, blocks, source));
+  ASSERT_EQ(25, start_height);
+  ASSERT_EQ(0, s.get_ranges_count());
+  ASSERT_TRUE(s.is_peer_synchronized(p1));
+}
+
+TEST(block_download_scheduler, stalled_peer_range_is_reassigned)
+{
+  currency::block_download_scheduler s(10, 100, 1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  ASSERT_TRUE(s.add_chain(p1, 0, get_test_chain(0, 10), 10));
+  ASSERT_TRUE(s.add_chain(p2, 0, get_test_chain(0, 10), 10));
+
+  std::list<crypto::hash> r1, r2;
+  ASSERT_TRUE(s.get_range(p1, 0, r1));
+  ASSERT_FALSE(s.get_range(p2, 0, r2));
+
+  std::set<boost::uuids::uuid> connections = { p1.m_connection_id, p2.m_connection_id };
+  std::list<currency::block_download_scheduler::peer_context> stalled;
+  s.on_idle(connections, 500, stalled);
+  ASSERT_TRUE(stalled.empty());
+  s.on_idle(connections, 1000, stalled);
+  ASSERT_EQ(1, stalled.size());
+  ASSERT_EQ(p1.m_connection_id, stalled.front().m_connection_id);
+
+  ASSERT_TRUE(s.get_range(p2, 1000, r2));
+  ASSERT_EQ(r1, r2);
+}
+
+TEST(block_download_scheduler, conflicting_chains)
+{
+  currency::block_download_scheduler s(10, 100, 1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2), p3 = make_test_peer(3);
+  ASSERT_TRUE(s.add_chain(p1, 0, get_test_chain(0, 20), 20));
+
+  // shorter fork is not downloaded
+  std::vector<crypto::hash> fork = get_test_chain(0, 5);
+  std::vector<crypto::hash> fork_tail = get_test_chain(5, 15, 1000);
+  fork.insert(fork.end(), fork_tail.begin(), fork_tail.end());
+  ASSERT_FALSE(s.add_chain(p2, 0, fork, 15));
+
+  // longer one replaces the chain being downloaded
+  fork_tail = get_test_chain(15, 30, 1000);
+  fork.insert(fork.end(), fork_tail.begin(), fork_tail.end());
+  ASSERT_TRUE(s.add_chain(p3, 0, fork, 30));
+  ASSERT_EQ(30, s.get_target_height());
+  std::list<crypto::hash> r1, r3;
+  ASSERT_FALSE(s.get_range(p1, 0, r1));
+  ASSERT_TRUE(s.need_more_ids(p1));
+  ASSERT_TRUE(s.get_range(p3, 0, r3));
+  ASSERT_EQ(get_test_block_id(0), r3.front());
+  ASSERT_EQ(get_test_block_id(9 + 1000), r3.back());
+}
+
+TEST(block_download_scheduler, rejected_range_is_downloaded_again)
+{
+  currency::block_download_scheduler s(10, 100, 1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  ASSERT_TRUE(s.add_chain(p1, 0, get_test_chain(0, 10), 10));
+  ASSERT_TRUE(s.add_chain(p2, 0, get_test_chain(0, 10), 10));
+
+  std::list<crypto::hash> r1, r2;
+  ASSERT_TRUE(s.get_range(p1, 0, r1));
+  uint64_t start_height = 0;
+  std::vector<crypto::hash> ids;
+  ASSERT_TRUE(s.on_range_received(p1, r1.size(), 100, start_height, ids));
+  ASSERT_EQ(0, start_height);
+  ASSERT_EQ(10, ids.size());
+
+  // nobody gets the range while it's being prevalidated
+  ASSERT_FALSE(s.get_range(p2, 100, r2));
+  size_t pending = 0, downloading = 0, ready = 0;
+  s.get_ranges_stat(pending, downloading, ready);
+  ASSERT_EQ(0, pending + downloading + ready);
+
+  s.on_range_rejected(start_height);
+  ASSERT_TRUE(s.get_range(p2, 100, r2));
+  ASSERT_EQ(r1, r2);
+  s.get_ranges_stat(pending, downloading, ready);
+  ASSERT_EQ(1, downloading);
+  ASSERT_TRUE(receive_test_range(s, p2, r2, 200));
+  ASSERT_TRUE(s.has_ready_range());
+}
+
+TEST(block_download_scheduler, verified_ids_are_fetched_ahead_by_one_peer)
+{
+  currency::block_download_scheduler s(10, 100, 1000);
+  s.set_verified_ids_height(100);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  ASSERT_TRUE(s.add_chain(p1, 0, get_test_chain(0, 20), 200));
+  ASSERT_TRUE(s.add_chain(p2, 0, get_test_chain(0, 10), 200));
+
+  ASSERT_TRUE(s.need_ids_ahead(p1, 0));
+  ASSERT_FALSE(s.need_ids_ahead(p2, 0));
+  ASSERT_TRUE(s.need_ids_ahead(p2, 1000));   // the first one took too long
+
+  // the next entry continues from the last id known
+  crypto::hash last_id = currency::null_hash;
+  ASSERT_TRUE(s.get_last_id(last_id));
+  ASSERT_EQ(get_test_block_id(19), last_id);
+  ASSERT_TRUE(s.has_block_id(last_id));
+  ASSERT_TRUE(s.add_chain(p2, 19, get_test_chain(19, 100), 200));
+  ASSERT_FALSE(s.need_ids_ahead(p1, 1000));  // the rest isn't verified
+
+  // p1 didn't send these ids, but verified ids are the same for everybody
+  std::list<crypto::hash> r;
+  for (uint64_t h = 0; h != 100; h += 10)
+  {
+    ASSERT_TRUE(s.get_range(h % 20 ? p2 : p1, 1000, r));
+    ASSERT_EQ(get_test_block_id(h), r.front());
+    ASSERT_TRUE(receive_test_range(s, h % 20 ? p2 : p1, r, 1100));
+  }
+}
+
+TEST(block_download_scheduler, ranges_are_not_handed_out_beyond_window)
+{
+  currency::block_download_scheduler s(10, 100, 1000, 30);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2), p3 = make_test_peer(3), p4 = make_test_peer(4);
+  for (const auto& p : { p1, p2, p3, p4 })
+    ASSERT_TRUE(s.add_chain(p, 0, get_test_chain(0, 100), 100));
+
+  std::list<crypto::hash> r1, r2, r3, r4;
+  ASSERT_TRUE(s.get_range(p1, 0, r1));
+  ASSERT_TRUE(s.get_range(p2, 0, r2));
+  ASSERT_TRUE(s.get_range(p3, 0, r3));
+  ASSERT_FALSE(s.get_range(p4, 0, r4));     // the window is full even though p4 is idle
+
+  // downloaded ranges keep the window where it is until they are applied
+  ASSERT_TRUE(receive_test_range(s, p2, r2, 100));
+  ASSERT_TRUE(receive_test_range(s, p3, r3, 100));
+  ASSERT_FALSE(s.get_range(p4, 100, r4));
+  ASSERT_TRUE(receive_test_range(s, p1, r1, 100));
+  ASSERT_FALSE(s.get_range(p4, 100, r4));
+
+  uint64_t start_height = 0;
+  std::list<currency::prevalidated_block> blocks;
+  currency::block_download_scheduler::peer_context source;
+  ASSERT_TRUE(s.pop_ready_range(start_height, blocks, source));
+  ASSERT_EQ(0, start_height);
+  ASSERT_TRUE(s.get_range(p4, 100, r4));
+  ASSERT_EQ(get_test_block_id(30), r4.front());
+  ASSERT_FALSE(s.get_range(p1, 100, r1));
+}
@@ -0,0 +1,119 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <ctime>
+#include <list>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "currency_core/blockchain_storage.h"
+#include "currency_core/currency_format_utils.h"
+#include "currency_core/miner.h"
+#include "currency_core/tx_pool.h"
+
+using namespace currency;
+
+namespace
+{
+  const size_t test_blocks_count = 12;
+
+  // ids for getblocks_ids.bin are taken from the next blocks' prev_id, they must be the same as the hashed ones
+  class blockchain_ids_supplement_test : public ::testing::Test
+  {
+  protected:
+    blockchain_ids_supplement_test() : m_pool(m_chain), m_chain(m_pool)
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("blockchain_ids_supplement_test_%%%%%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_miner.generate();
+    }
+
+    ~blockchain_ids_supplement_test()
+    {
+      m_chain.deinit();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    virtual void SetUp()
+    {
+      boost::program_options::options_description desc;
+      blockchain_storage::init_options(desc);
+      tx_memory_pool::init_options(desc);
+      boost::program_options::variables_map vm;
+      boost::program_options::store(boost::program_options::basic_parsed_options<char>(&desc), vm);
+      boost::program_options::notify(vm);
+      ASSERT_TRUE(m_chain.init(vm, m_dir.string()));
+      uint64_t timestamp = time(nullptr) - test_blocks_count * DIFFICULTY_TARGET;
+      for (size_t i = 0; i != test_blocks_count; ++i)
+      {
+        block b = AUTO_VAL_INIT(b);
+        wide_difficulty_type diff = 0;
+        uint64_t height = 0;
+        ASSERT_TRUE(m_chain.create_block_template(b, m_miner.get_keys().m_account_address, diff, height, blobdata(), false, alias_info()));
+        b.timestamp = timestamp + i * DIFFICULTY_TARGET;
+        std::vector<crypto::hash> scratchpad;
+        m_chain.copy_scratchpad(scratchpad);
+        ASSERT_TRUE(miner::find_nonce_for_given_block(b, diff, height, [&](uint64_t index) -> crypto::hash&
+        {
+          return scratchpad[index % scratchpad.size()];
+        }));
+        block_verification_context bvc = AUTO_VAL_INIT(bvc);
+        ASSERT_TRUE(m_chain.add_new_block(b, bvc));
+        ASSERT_TRUE(bvc.m_added_to_main_chain);
+      }
+    }
+
+    // asked by a client that has the chain up to known_height
+    void check_supplement(uint64_t known_height, size_t max_count)
+    {
+      std::list<crypto::hash> qblock_ids;
+      qblock_ids.push_back(m_chain.get_block_id_by_height(known_height - 1));
+      if (known_height > 1)
+        qblock_ids.push_back(m_chain.get_block_id_by_height(0));
+      std::list<crypto::hash> ids;
+      std::list<uint64_t> timestamps;
+      uint64_t total_height = 0, start_height = 0;
+      ASSERT_TRUE(m_chain.find_blockchain_ids_supplement(qblock_ids, ids, timestamps, total_height, start_height, max_count));
+      ASSERT_EQ(m_chain.get_current_blockchain_height(), total_height);
+      ASSERT_EQ(known_height - 1, start_height);
+      ASSERT_EQ(std::min<uint64_t>(max_count, total_height - start_height), ids.size());
+      ASSERT_EQ(ids.size(), timestamps.size());
+      uint64_t height = start_height;
+      auto ts_it = timestamps.begin();
+      for (auto id_it = ids.begin(); id_it != ids.end(); ++id_it, ++ts_it, ++height)
+      {
+        block b = AUTO_VAL_INIT(b);
+        ASSERT_TRUE(m_chain.get_block_by_hash(*id_it, b));
+        ASSERT_EQ(get_block_hash(b), *id_it);
+        ASSERT_EQ(m_chain.get_block_id_by_height(height), *id_it);
+        ASSERT_EQ(b.timestamp, *ts_it);
+      }
+    }
+
+    boost::filesystem::path m_dir;
+    tx_memory_pool m_pool;
+    blockchain_storage m_chain;
+    account_base m_miner;
+  };
+}
+
+TEST_F(blockchain_ids_supplement_test, ids_up_to_the_top)
+{
+  check_supplement(1, 1000);
+  check_supplement(5, 1000);
+  check_supplement(m_chain.get_current_blockchain_height(), 1000);
+}
+
+TEST_F(blockchain_ids_supplement_test, ids_cut_by_max_count)
+{
+  check_supplement(1, 4);
+  check_supplement(5, 1);
+  check_supplement(m_chain.get_current_blockchain_height() - 4, 4);
+}
@@ -39,3 +39,61 @@ TEST(checkpoints_test, test_checkpoints_for_alternative)
   r = cp.is_height_passed_zone(11, 12);
   ASSERT_FALSE(r);
 }
+
+TEST(checkpoints_test, check_block_tells_checkpoints_apart)
+{
+  currency::checkpoints cp;
+  cp.add_checkpoint(5,  "0d6f94ae7e565c6d90ee0087d2feaad4617cd3038c4f8853f26756a6b6d535f3");
+  crypto::hash h = currency::null_hash;
+  epee::string_tools::parse_tpod_from_hex_string("0d6f94ae7e565c6d90ee0087d2feaad4617cd3038c4f8853f26756a6b6d535f3", h);
+
+  bool is_a_checkpoint = true;
+  ASSERT_TRUE(cp.check_block(4, currency::null_hash, is_a_checkpoint));
+  ASSERT_FALSE(is_a_checkpoint);
+  ASSERT_TRUE(cp.check_block(5, h, is_a_checkpoint));
+  ASSERT_TRUE(is_a_checkpoint);
+  ASSERT_FALSE(cp.check_block(5, currency::null_hash, is_a_checkpoint));
+  ASSERT_TRUE(is_a_checkpoint);
+}
+
+TEST(checkpoints_test, block_ids_hashes_check_whole_groups)
+{
+  const size_t group_size = CURRENCY_BLOCK_IDS_HASHES_GROUP_SIZE;
+  std::vector<crypto::hash> ids;
+  for (uint64_t h = 0; h != group_size * 3; ++h)
+    ids.push_back(crypto::cn_fast_hash(&h, sizeof h));
+
+  // the first two groups are embedded
+  std::string blob;
+  for (size_t g = 0; g != 2; ++g)
+  {
+    crypto::hash gh = currency::checkpoints::get_block_ids_group_hash(&ids[g * group_size]);
+    blob.append(reinterpret_cast<const char*>(&gh), sizeof gh);
+  }
+  currency::checkpoints cp;
+  ASSERT_FALSE(cp.add_block_ids_hashes(blob + "x"));
+  ASSERT_TRUE(cp.add_block_ids_hashes(blob));
+  ASSERT_EQ(group_size * 2, cp.get_block_ids_hashes_height());
+  ASSERT_EQ(group_size * 2 - 1, cp.get_top_checkpoint_height());
+  ASSERT_TRUE(cp.is_in_checkpoint_zone(group_size * 2 - 1));
+  ASSERT_FALSE(cp.is_in_checkpoint_zone(group_size * 2));
+
+  // entry from the last block of the first group on: its leading id and the second group are checked, the third one is above the hashes
+  size_t checked_count = 0;
+  std::vector<crypto::hash> entry(ids.begin() + group_size - 1, ids.end());
+  ASSERT_TRUE(cp.check_block_ids(group_size - 1, entry, checked_count));
+  ASSERT_EQ(group_size + 1, checked_count);
+
+  // a group cut short isn't checked
+  entry.assign(ids.begin(), ids.begin() + group_size * 2 - 1);
+  ASSERT_TRUE(cp.check_block_ids(0, entry, checked_count));
+  ASSERT_EQ(group_size, checked_count);
+
+  entry[group_size + 7] = currency::null_hash;
+  entry.push_back(ids[group_size * 2 - 1]);
+  ASSERT_FALSE(cp.check_block_ids(0, entry, checked_count));
+
+  // a group is passed once its last block is in the blockchain
+  ASSERT_FALSE(cp.is_height_passed_zone(group_size + 1, group_size * 2 - 2));
+  ASSERT_TRUE(cp.is_height_passed_zone(group_size + 1, group_size * 2 - 1));
+}
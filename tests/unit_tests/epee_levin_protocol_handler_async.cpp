@@ -5,6 +5,8 @@
 #include <mutex>
 #include <thread>
 
+#include <boost/uuid/uuid_generators.hpp>
+
 #include "gtest/gtest.h"
 
 #include "include_base_utils.h"
@@ -106,6 +108,8 @@ namespace
       , m_protocol_handler(this, protocol_config, m_context)
       , m_send_return(true)
     {
+      // connections are found by id when notified through the config
+      static_cast<epee::net_utils::connection_context_base&>(m_context) = epee::net_utils::connection_context_base(boost::uuids::random_generator()(), 0, 0, false);
     }
 
     void start()
@@ -123,6 +127,12 @@ namespace
       return m_send_return;
     }
 
+    virtual bool do_send_shared(const epee::net_utils::shared_buffer& buff)
+    {
+      m_last_shared_buffer = buff;
+      return do_send(buff->data(), buff->size());
+    }
+
     virtual bool close()                              { /*std::cout << "test_connection::close()" << std::endl; */return true; }
     virtual bool call_run_once_service_io()           { std::cout << "test_connection::call_run_once_service_io()" << std::endl; return true; }
     virtual bool request_callback()                   { std::cout << "test_connection::request_callback()" << std::endl; return true; }
@@ -135,6 +145,8 @@ namespace
     const std::string& last_send_data() const { return m_last_send_data; }
     void reset_last_send_data() { std::unique_lock<std::mutex> lock(m_mutex); m_last_send_data.clear(); }
 
+    const epee::net_utils::shared_buffer& last_shared_buffer() const { return m_last_shared_buffer; }
+
     bool send_return() const { return m_send_return; }
     void send_return(bool v) { m_send_return = v; }
 
@@ -149,6 +161,7 @@ namespace
     std::mutex m_mutex;
 
     std::string m_last_send_data;
+    epee::net_utils::shared_buffer m_last_shared_buffer;
 
     bool m_send_return;
   };
@@ -384,6 +397,38 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, notify_shares_buffer_between_connections)
+{
+  // Setup
+  const int expected_command = 2957212;
+
+  test_connection_ptr conn1 = create_connection();
+  test_connection_ptr conn2 = create_connection();
+
+  std::string in_data(256, 'n');
+  epee::net_utils::shared_buffer buff = epee::net_utils::make_shared_buffer(in_data.data(), in_data.size());
+
+  // Test
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, buff, conn1->m_protocol_handler.get_connection_id()));
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, buff, conn2->m_protocol_handler.get_connection_id()));
+
+  // Check that the body isn't copied and that the packet is the same as the one notify with a string makes
+  ASSERT_EQ(buff.get(), conn1->last_shared_buffer().get());
+  ASSERT_EQ(buff.get(), conn2->last_shared_buffer().get());
+
+  test_connection_ptr conn3 = create_connection();
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, in_data, conn3->m_protocol_handler.get_connection_id()));
+  ASSERT_EQ(conn3->last_send_data(), conn1->last_send_data());
+  ASSERT_EQ(2, conn1->send_counter());
+
+  epee::levin::bucket_head2 head;
+  ASSERT_EQ(sizeof(head) + in_data.size(), conn1->last_send_data().size());
+  memcpy(&head, conn1->last_send_data().data(), sizeof(head));
+  ASSERT_EQ(in_data.size(), head.m_cb);
+  ASSERT_EQ(expected_command, head.m_command);
+  ASSERT_EQ(in_data, conn1->last_send_data().substr(sizeof(head)));
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
@@ -497,6 +542,48 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_two_re
   ASSERT_EQ(2, m_commands_handler.invoke_counter());
 }
 
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_requests_split_at_any_place)
+{
+  prepare_buf();
+  m_buf.append(m_buf);
+  m_buf.append(m_buf);
+
+  for (size_t pos = 0; pos < m_buf.size(); pos += 7)
+  {
+    size_t cb = std::min<size_t>(7, m_buf.size() - pos);
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + pos, cb));
+  }
+  ASSERT_EQ(4, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, does_not_preallocate_announced_body)
+{
+  m_req_head.m_cb = max_packet_size;
+  prepare_buf();
+  m_buf.resize(sizeof(m_req_head) + 100);
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(100, m_conn->m_protocol_handler.m_cache_in_buffer.size());
+  ASSERT_GE(LEVIN_BODY_PREALLOCATE_MAX_SIZE, m_conn->m_protocol_handler.m_cache_in_buffer.capacity());
+  ASSERT_EQ(0, m_commands_handler.invoke_counter());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_body_bigger_than_preallocated)
+{
+  m_in_data.assign(3 * LEVIN_BODY_PREALLOCATE_MAX_SIZE + 5, 'b');
+  m_req_head.m_cb = m_in_data.size();
+  prepare_buf();
+
+  for (size_t pos = 0; pos < m_buf.size(); pos += 65536)
+  {
+    size_t cb = std::min<size_t>(65536, m_buf.size() - pos);
+    ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data() + pos, cb));
+  }
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(m_in_data, m_commands_handler.last_in_buf());
+}
+
 TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_response)
 {
   m_req_head.m_flags = LEVIN_PACKET_RESPONSE;
@@ -0,0 +1,149 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "common/journal_writer.h"
+
+namespace
+{
+  struct test_record
+  {
+    uint64_t n;
+
+    template<class archive_t>
+    void serialize(archive_t & ar, const unsigned int version)
+    {
+      ar & n;
+    }
+  };
+
+  test_record make_test_record(uint64_t n)
+  {
+    test_record rec = AUTO_VAL_INIT(rec);
+    rec.n = n;
+    return rec;
+  }
+
+  std::wstring get_test_journal_filename()
+  {
+    boost::filesystem::path p = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("journal_writer_test_%%%%%%%%");
+    return p.wstring();
+  }
+
+  // reads the journal back like on startup
+  std::vector<uint64_t> load_test_journal(const std::wstring& filename, bool& corrupted)
+  {
+    tools::journal_file j;
+    std::vector<std::string> records;
+    std::vector<uint64_t> res;
+    if (!j.open(filename, records, &corrupted))
+      return res;
+    for (auto& r : records)
+    {
+      test_record rec = AUTO_VAL_INIT(rec);
+      if (!tools::unserialize_obj_from_buff(rec, r))
+        break;
+      res.push_back(rec.n);
+    }
+    return res;
+  }
+}
+
+TEST(journal_writer, queued_records_are_written_in_order)
+{
+  std::wstring filename = get_test_journal_filename();
+  std::vector<std::string> records;
+  {
+    tools::journal_writer<test_record> w(1000);
+    ASSERT_TRUE(w.open(filename, records));
+    ASSERT_TRUE(records.empty());
+    for (uint64_t n = 0; n != 100; ++n)
+      w.append(make_test_record(n));
+    ASSERT_EQ(100, w.records_count());
+
+    // everything is on the disk after flush, while the writer is still open
+    ASSERT_TRUE(w.flush());
+    bool corrupted = true;
+    std::vector<uint64_t> loaded = load_test_journal(filename, corrupted);
+    ASSERT_FALSE(corrupted);
+    ASSERT_EQ(100, loaded.size());
+    for (uint64_t n = 0; n != 100; ++n)
+      ASSERT_EQ(n, loaded[n]);
+
+    // the rest is written on close
+    w.append(make_test_record(100));
+  }
+  bool corrupted = true;
+  ASSERT_EQ(101, load_test_journal(filename, corrupted).size());
+  boost::filesystem::remove(filename);
+}
+
+TEST(journal_writer, rewrite_replaces_journal_and_queued_records)
+{
+  std::wstring filename = get_test_journal_filename();
+  std::vector<std::string> records;
+  {
+    tools::journal_writer<test_record> w(1000);
+    ASSERT_TRUE(w.open(filename, records));
+    for (uint64_t n = 0; n != 10; ++n)
+      w.append(make_test_record(n));
+    w.flush();
+    w.append(make_test_record(10));
+
+    std::list<test_record> snapshot = { make_test_record(100), make_test_record(101) };
+    w.rewrite(snapshot);
+    w.append(make_test_record(102));
+    ASSERT_EQ(3, w.records_count());
+  }
+  bool corrupted = true;
+  ASSERT_EQ(std::vector<uint64_t>({ 100, 101, 102 }), load_test_journal(filename, corrupted));
+  ASSERT_FALSE(corrupted);
+  ASSERT_FALSE(boost::filesystem::exists(filename + L".tmp"));
+  boost::filesystem::remove(filename);
+}
+
+TEST(journal_writer, torn_tail_record_is_cut_off)
+{
+  std::wstring filename = get_test_journal_filename();
+  std::vector<std::string> records;
+  {
+    tools::journal_writer<test_record> w(1000);
+    ASSERT_TRUE(w.open(filename, records));
+    for (uint64_t n = 0; n != 5; ++n)
+      w.append(make_test_record(n));
+  }
+  uint64_t good_size = boost::filesystem::file_size(filename);
+
+  // a record header announcing more data than was written before the crash
+  {
+    boost::filesystem::ofstream out(filename, std::ios::binary | std::ios::app);
+    uint32_t torn_header[2] = { 100, 0 };
+    out.write(reinterpret_cast<const char*>(torn_header), sizeof torn_header);
+    out.write("torn", 4);
+  }
+
+  bool corrupted = false;
+  ASSERT_EQ(std::vector<uint64_t>({ 0, 1, 2, 3, 4 }), load_test_journal(filename, corrupted));
+  ASSERT_TRUE(corrupted);
+  ASSERT_EQ(good_size, boost::filesystem::file_size(filename));
+
+  // appending goes on after the last good record
+  {
+    tools::journal_writer<test_record> w(1000);
+    ASSERT_TRUE(w.open(filename, records));
+    ASSERT_EQ(5, records.size());
+    w.append(make_test_record(5));
+  }
+  ASSERT_EQ(std::vector<uint64_t>({ 0, 1, 2, 3, 4, 5 }), load_test_journal(filename, corrupted));
+  ASSERT_FALSE(corrupted);
+  boost::filesystem::remove(filename);
+}
@@ -0,0 +1,123 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <list>
+#include <boost/uuid/nil_generator.hpp>
+
+#include "include_base_utils.h"
+#include "currency_protocol/pending_compact_blocks.h"
+
+namespace
+{
+  currency::transaction make_test_tx(uint64_t n)
+  {
+    currency::transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    currency::txin_gen in;
+    in.height = n;
+    tx.vin.push_back(in);
+    return tx;
+  }
+
+  boost::uuids::uuid make_test_peer(uint8_t n)
+  {
+    boost::uuids::uuid id = boost::uuids::nil_uuid();
+    id.data[0] = n;
+    return id;
+  }
+
+  crypto::hash get_test_block_id(uint64_t n)
+  {
+    return crypto::cn_fast_hash(&n, sizeof n);
+  }
+}
+
+TEST(pending_compact_blocks, only_requested_txs_are_taken)
+{
+  currency::pending_compact_blocks pcb(1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  currency::transaction tx1 = make_test_tx(1), tx2 = make_test_tx(2), junk = make_test_tx(3);
+  std::list<crypto::hash> missed = { currency::get_transaction_hash(tx1), currency::get_transaction_hash(tx2) };
+  currency::NOTIFY_NEW_COMPACT_BLOCK::request arg = AUTO_VAL_INIT(arg);
+  arg.hop = 5;
+  ASSERT_TRUE(pcb.add(get_test_block_id(1), arg, missed, p1, 0));
+
+  std::list<currency::blobdata> blobs = { currency::tx_to_blob(tx1), currency::tx_to_blob(junk), currency::tx_to_blob(tx1) };
+  currency::NOTIFY_NEW_COMPACT_BLOCK::request res_arg = AUTO_VAL_INIT(res_arg);
+  std::list<currency::pending_compact_blocks::received_tx> txs;
+  bool has_invalid_blob = false;
+
+  // not asked from this peer
+  ASSERT_FALSE(pcb.on_response(get_test_block_id(1), p2, blobs, res_arg, txs, has_invalid_blob));
+  ASSERT_EQ(1, pcb.size());
+
+  ASSERT_TRUE(pcb.on_response(get_test_block_id(1), p1, blobs, res_arg, txs, has_invalid_blob));
+  ASSERT_FALSE(has_invalid_blob);
+  ASSERT_EQ(1, txs.size());
+  ASSERT_EQ(missed.front(), txs.front().id);
+  ASSERT_EQ(5, res_arg.hop);
+  ASSERT_EQ(0, pcb.size());
+
+  // the block is not pending anymore
+  txs.clear();
+  ASSERT_FALSE(pcb.on_response(get_test_block_id(1), p1, blobs, res_arg, txs, has_invalid_blob));
+}
+
+TEST(pending_compact_blocks, invalid_blob_is_reported)
+{
+  currency::pending_compact_blocks pcb(1000);
+  auto p1 = make_test_peer(1);
+  currency::transaction tx1 = make_test_tx(1);
+  std::list<crypto::hash> missed = { currency::get_transaction_hash(tx1) };
+  ASSERT_TRUE(pcb.add(get_test_block_id(1), currency::NOTIFY_NEW_COMPACT_BLOCK::request(), missed, p1, 0));
+
+  std::list<currency::blobdata> blobs = { "not a tx", currency::tx_to_blob(tx1) };
+  currency::NOTIFY_NEW_COMPACT_BLOCK::request res_arg = AUTO_VAL_INIT(res_arg);
+  std::list<currency::pending_compact_blocks::received_tx> txs;
+  bool has_invalid_blob = false;
+  ASSERT_TRUE(pcb.on_response(get_test_block_id(1), p1, blobs, res_arg, txs, has_invalid_blob));
+  ASSERT_TRUE(has_invalid_blob);
+  ASSERT_EQ(1, txs.size());
+}
+
+TEST(pending_compact_blocks, other_peers_are_asked_in_turn)
+{
+  currency::pending_compact_blocks pcb(1000);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2), p3 = make_test_peer(3);
+  std::list<crypto::hash> missed = { currency::get_transaction_hash(make_test_tx(1)) };
+  currency::NOTIFY_NEW_COMPACT_BLOCK::request arg = AUTO_VAL_INIT(arg);
+  ASSERT_TRUE(pcb.add(get_test_block_id(1), arg, missed, p1, 0));
+
+  // duplicate announcements don't make requests, the peers are remembered
+  ASSERT_FALSE(pcb.add(get_test_block_id(1), arg, missed, p2, 10));
+  ASSERT_TRUE(pcb.add_other_peer(get_test_block_id(1), p3));
+  ASSERT_TRUE(pcb.add_other_peer(get_test_block_id(1), p2));
+  ASSERT_FALSE(pcb.add_other_peer(get_test_block_id(2), p2));
+
+  std::set<boost::uuids::uuid> connections = { p1, p2, p3 };
+  std::list<currency::pending_compact_blocks::block_txs_request> requests;
+  pcb.on_idle(connections, 500, requests);
+  ASSERT_TRUE(requests.empty());
+
+  pcb.on_idle(connections, 1000, requests);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(p2, requests.front().peer);
+  ASSERT_EQ(get_test_block_id(1), requests.front().req.block_id);
+  ASSERT_EQ(missed, requests.front().req.txs);
+
+  // the first peer is late now
+  std::list<currency::pending_compact_blocks::received_tx> txs;
+  bool has_invalid_blob = false;
+  ASSERT_FALSE(pcb.on_response(get_test_block_id(1), p1, std::list<currency::blobdata>(), arg, txs, has_invalid_blob));
+
+  // a closed connection is not asked
+  connections.erase(p3);
+  requests.clear();
+  pcb.on_idle(connections, 2000, requests);
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(0, pcb.size());
+}
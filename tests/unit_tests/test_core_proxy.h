@@ -0,0 +1,246 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include "include_base_utils.h"
+#include "currency_core/currency_format_utils.h"
+#include "wallet/core_rpc_proxy.h"
+
+namespace unit_test
+{
+  // tx paying amount to the address, its input is made up: the stub doesn't check it
+  inline currency::transaction make_test_tx(const currency::account_public_address& to, uint64_t amount, const currency::payment_id_t& payment_id = currency::payment_id_t())
+  {
+    currency::transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    currency::keypair txkey = currency::keypair::generate();
+    currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+    if (!payment_id.empty())
+      currency::set_payment_id_and_swap_addr_to_tx_extra(tx.extra, payment_id);
+    currency::txin_to_key in = AUTO_VAL_INIT(in);
+    in.amount = amount;
+    in.key_offsets.push_back(0);
+    in.k_image = crypto::rand<crypto::key_image>();
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(1));
+    currency::construct_tx_out(to, txkey.sec, 0, amount, tx);
+    return tx;
+  }
+
+  /* Daemon stub for wallet tests: serves getblocks.bin (with global outputs indexes, compact txs if asked),
+   * gettransactions and, if enabled, getblocks_ids.bin from a chain built by the test. Other calls fail as if
+   * there was no connection.
+   */
+  class test_core_proxy : public tools::i_core_proxy
+  {
+  public:
+    explicit test_core_proxy(size_t blocks_per_response = 10) : m_blocks_per_response(blocks_per_response), m_ids_supported(false),
+      m_get_blocks_calls(0), m_get_blocks_ids_calls(0), m_get_transactions_calls(0), m_next_global_index(0)
+    {
+      currency::block genesis = currency::generate_genesis_block();
+      push_block(genesis);
+    }
+
+    // miner tx of the block pays to the address, txs go in the block as they are
+    currency::block add_block(const currency::account_public_address& miner_address, uint64_t timestamp,
+      const std::list<currency::transaction>& txs = std::list<currency::transaction>())
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      currency::block b = AUTO_VAL_INIT(b);
+      b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+      b.timestamp = timestamp;
+      b.prev_id = currency::get_block_hash(m_blocks.back().b);
+      currency::construct_miner_tx(m_blocks.size(), 0, 0, 0, 0, miner_address, b.miner_tx);
+      for (const auto& tx : txs)
+        b.tx_hashes.push_back(currency::get_transaction_hash(tx));
+      push_block(b, txs);
+      return b;
+    }
+
+    // chain is cut down to height blocks, so that another branch can be added on top
+    void pop_blocks(size_t height)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      if (height && height < m_blocks.size())
+        m_blocks.resize(height);
+    }
+
+    size_t get_height()
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_blocks.size();
+    }
+
+    crypto::hash get_block_id(size_t height)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_blocks[height].id;
+    }
+
+    void set_ids_supported(bool supported) { m_ids_supported = supported; }
+    // called on every getblocks.bin request, before it's answered
+    void set_get_blocks_hook(const std::function<void()>& hook) { m_get_blocks_hook = hook; }
+    size_t get_blocks_calls() const { return m_get_blocks_calls; }
+    size_t get_blocks_ids_calls() const { return m_get_blocks_ids_calls; }
+    size_t get_transactions_calls() const { return m_get_transactions_calls; }
+
+    virtual bool set_connection_addr(const std::string& url) { return true; }
+    virtual bool check_connection() { return true; }
+
+    virtual bool call_COMMAND_RPC_GET_BLOCKS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& rsp)
+    {
+      ++m_get_blocks_calls;
+      if (m_get_blocks_hook)
+        m_get_blocks_hook();
+      std::lock_guard<std::mutex> lk(m_lock);
+      size_t start_height = 0;
+      if (!find_start_height(rqt.block_ids, start_height))
+        return false;
+      for (size_t h = start_height; h != m_blocks.size() && h - start_height < m_blocks_per_response; ++h)
+      {
+        const test_block& tb = m_blocks[h];
+        rsp.blocks.push_back(currency::block_complete_entry());
+        rsp.blocks.back().block = currency::block_to_blob(tb.b);
+        for (const auto& tx : tb.txs)
+        {
+          if (!rqt.compact_txs)
+          {
+            rsp.blocks.back().txs.push_back(currency::tx_to_blob(tx));
+            continue;
+          }
+          currency::compact_tx_entry cte = AUTO_VAL_INIT(cte);
+          currency::get_compact_tx_entry(tx, cte);
+          rsp.blocks.back().txs.push_back(t_serializable_object_to_blob(cte));
+        }
+        if (rqt.need_global_outs_indexes)
+          rsp.global_outs_indexes.push_back(tb.indexes);
+      }
+      rsp.compact_txs = rqt.compact_txs;
+      rsp.start_height = start_height;
+      rsp.current_height = m_blocks.size();
+      rsp.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    virtual bool call_COMMAND_RPC_GET_BLOCKS_IDS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_IDS_FAST::response& rsp)
+    {
+      ++m_get_blocks_ids_calls;
+      if (!m_ids_supported)
+        return false;
+      std::lock_guard<std::mutex> lk(m_lock);
+      size_t start_height = 0;
+      if (!find_start_height(rqt.block_ids, start_height))
+        return false;
+      for (size_t h = start_height; h != m_blocks.size() && h - start_height < m_blocks_per_response; ++h)
+      {
+        rsp.ids.push_back(m_blocks[h].id);
+        rsp.timestamps.push_back(m_blocks[h].b.timestamp);
+      }
+      rsp.start_height = start_height;
+      rsp.current_height = m_blocks.size();
+      rsp.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    virtual bool call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(const currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& rqt, currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& rqt, currency::COMMAND_RPC_GET_INFO::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_TX_POOL(const currency::COMMAND_RPC_GET_TX_POOL::request& rqt, currency::COMMAND_RPC_GET_TX_POOL::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_ALIASES_BY_ADDRESS(const currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& rqt, currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS(const currency::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& rqt, currency::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_SEND_RAW_TX(const currency::COMMAND_RPC_SEND_RAW_TX::request& rqt, currency::COMMAND_RPC_SEND_RAW_TX::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_ALL_ALIASES(currency::COMMAND_RPC_GET_ALL_ALIASES::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_ALIAS_DETAILS(const currency::COMMAND_RPC_GET_ALIAS_DETAILS::request& req, currency::COMMAND_RPC_GET_ALIAS_DETAILS::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_GET_TRANSACTIONS(const currency::COMMAND_RPC_GET_TRANSACTIONS::request& req, currency::COMMAND_RPC_GET_TRANSACTIONS::response& rsp)
+    {
+      ++m_get_transactions_calls;
+      std::lock_guard<std::mutex> lk(m_lock);
+      for (const auto& id_hex : req.txs_hashes)
+      {
+        bool found = false;
+        for (size_t h = 0; h != m_blocks.size() && !found; ++h)
+        {
+          for (const auto& tx : m_blocks[h].txs)
+          {
+            if (epee::string_tools::pod_to_hex(currency::get_transaction_hash(tx)) == id_hex)
+            {
+              rsp.txs_as_hex.push_back(epee::string_tools::buff_to_hex_nodelimer(currency::tx_to_blob(tx)));
+              found = true;
+              break;
+            }
+          }
+        }
+        if (!found)
+          rsp.missed_tx.push_back(id_hex);
+      }
+      rsp.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+    virtual bool call_COMMAND_RPC_COMMAND_RPC_CHECK_KEYIMAGES(const currency::COMMAND_RPC_CHECK_KEYIMAGES::request& req, currency::COMMAND_RPC_CHECK_KEYIMAGES::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_VALIDATE_SIGNED_TEXT(const currency::COMMAND_RPC_VALIDATE_SIGNED_TEXT::request& req, currency::COMMAND_RPC_VALIDATE_SIGNED_TEXT::response& rsp) { return false; }
+    virtual bool call_COMMAND_RPC_RELAY_TXS(const currency::COMMAND_RPC_RELAY_TXS::request& req, currency::COMMAND_RPC_RELAY_TXS::response& rsp) { return false; }
+    virtual bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr, currency::payment_id_t& payment_id) { return false; }
+
+  private:
+    struct test_block
+    {
+      currency::block b;
+      crypto::hash id;
+      std::list<currency::transaction> txs;
+      currency::block_global_outs_indexes indexes;
+    };
+
+    void push_block(const currency::block& b, const std::list<currency::transaction>& txs = std::list<currency::transaction>())
+    {
+      test_block tb;
+      tb.b = b;
+      tb.id = currency::get_block_hash(b);
+      tb.txs = txs;
+      add_indexes(b.miner_tx, tb.indexes);
+      for (const auto& tx : txs)
+        add_indexes(tx, tb.indexes);
+      m_blocks.push_back(tb);
+    }
+
+    void add_indexes(const currency::transaction& tx, currency::block_global_outs_indexes& indexes)
+    {
+      indexes.txs.push_back(currency::tx_global_outs_indexes());
+      for (size_t i = 0; i != tx.vout.size(); ++i)
+        indexes.txs.back().indexes.push_back(m_next_global_index++);
+    }
+
+    // the first of the ids (they go from the top down) that is in the chain
+    bool find_start_height(const std::list<crypto::hash>& ids, size_t& start_height)
+    {
+      for (const auto& id : ids)
+      {
+        for (size_t h = 0; h != m_blocks.size(); ++h)
+        {
+          if (m_blocks[h].id == id)
+          {
+            start_height = h;
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    std::mutex m_lock;
+    std::vector<test_block> m_blocks;
+    size_t m_blocks_per_response;
+    bool m_ids_supported;
+    std::function<void()> m_get_blocks_hook;
+    std::atomic<size_t> m_get_blocks_calls;
+    std::atomic<size_t> m_get_blocks_ids_calls;
+    std::atomic<size_t> m_get_transactions_calls;
+    uint64_t m_next_global_index;
+  };
+}
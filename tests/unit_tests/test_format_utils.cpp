@@ -274,3 +274,119 @@ TEST(format_utils, print_money)
   cycle(increments_fib);
 
 }
+
+TEST(lookup_acc_outs, finds_only_own_outputs)
+{
+  currency::account_base alice, bob;
+  alice.generate();
+  bob.generate();
+
+  currency::transaction tx = AUTO_VAL_INIT(tx);
+  currency::keypair txkey = currency::keypair::generate();
+  currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+  for (size_t i = 0; i < 10; ++i)
+  {
+    const currency::account_base& dst = (i % 3 == 0) ? alice : bob;
+    ASSERT_TRUE(currency::construct_tx_out(dst.get_keys().m_account_address, txkey.sec, i, 100 + i, tx));
+  }
+
+  std::vector<size_t> outs;
+  uint64_t money = 0;
+  ASSERT_TRUE(currency::lookup_acc_outs(alice.get_keys(), tx, txkey.pub, outs, money));
+  ASSERT_EQ(std::vector<size_t>({ 0, 3, 6, 9 }), outs);
+  ASSERT_EQ(100 + 103 + 106 + 109, money);
+
+  // results must match the per-output check
+  for (size_t i = 0; i < tx.vout.size(); ++i)
+  {
+    bool is_alices = currency::is_out_to_acc(alice.get_keys(), boost::get<currency::txout_to_key>(tx.vout[i].target), txkey.pub, i);
+    ASSERT_EQ(i % 3 == 0, is_alices);
+  }
+}
+
+TEST(compact_tx_entry, same_lookup_and_key_images_as_full_tx)
+{
+  currency::account_base alice, bob;
+  alice.generate();
+  bob.generate();
+
+  currency::transaction tx = AUTO_VAL_INIT(tx);
+  currency::keypair txkey = currency::keypair::generate();
+  currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+  ASSERT_TRUE(currency::set_payment_id_and_swap_addr_to_tx_extra(tx.extra, currency::payment_id_t("payment id")));
+  for (size_t i = 0; i < 3; ++i)
+  {
+    currency::txin_to_key in = AUTO_VAL_INIT(in);
+    in.amount = 1000 + i;
+    in.key_offsets.assign(5, 10 + i);
+    force_random(in.k_image);
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(5));
+  }
+  for (size_t i = 0; i < 10; ++i)
+  {
+    const currency::account_base& dst = (i % 3 == 0) ? alice : bob;
+    ASSERT_TRUE(currency::construct_tx_out(dst.get_keys().m_account_address, txkey.sec, i, 100 + i, tx));
+  }
+
+  currency::compact_tx_entry cte = AUTO_VAL_INIT(cte);
+  currency::get_compact_tx_entry(tx, cte);
+  currency::blobdata cte_blob = t_serializable_object_to_blob(cte);
+  ASSERT_LT(cte_blob.size(), currency::tx_to_blob(tx).size());
+
+  currency::compact_tx_entry loaded_cte = AUTO_VAL_INIT(loaded_cte);
+  ASSERT_TRUE(t_unserializable_object_from_blob(loaded_cte, cte_blob));
+  ASSERT_EQ(1, loaded_cte.extra_parsed);
+  ASSERT_EQ(txkey.pub, loaded_cte.tx_pub_key);
+  ASSERT_EQ(std::string("payment id"), loaded_cte.payment_id);
+
+  currency::transaction compact_tx = AUTO_VAL_INIT(compact_tx);
+  currency::get_tx_from_compact_entry(loaded_cte, compact_tx);
+  std::vector<size_t> outs, compact_outs;
+  uint64_t money = 0, compact_money = 0;
+  ASSERT_TRUE(currency::lookup_acc_outs(alice.get_keys(), tx, txkey.pub, outs, money));
+  ASSERT_TRUE(currency::lookup_acc_outs(alice.get_keys(), compact_tx, loaded_cte.tx_pub_key, compact_outs, compact_money));
+  ASSERT_EQ(outs, compact_outs);
+  ASSERT_EQ(money, compact_money);
+
+  ASSERT_EQ(tx.vin.size(), compact_tx.vin.size());
+  for (size_t i = 0; i < tx.vin.size(); ++i)
+  {
+    ASSERT_EQ(boost::get<currency::txin_to_key>(tx.vin[i]).k_image, boost::get<currency::txin_to_key>(compact_tx.vin[i]).k_image);
+    ASSERT_EQ(boost::get<currency::txin_to_key>(tx.vin[i]).amount, boost::get<currency::txin_to_key>(compact_tx.vin[i]).amount);
+  }
+}
+
+TEST(compact_tx_entry, other_targets_are_marked)
+{
+  currency::account_base alice;
+  alice.generate();
+
+  currency::transaction tx = AUTO_VAL_INIT(tx);
+  currency::keypair txkey = currency::keypair::generate();
+  currency::add_tx_pub_key_to_extra(tx, txkey.pub);
+  ASSERT_TRUE(currency::construct_tx_out(alice.get_keys().m_account_address, txkey.sec, 0, 100, tx));
+  currency::tx_out script_out = AUTO_VAL_INIT(script_out);
+  script_out.amount = 200;
+  script_out.target = currency::txout_to_script();
+  tx.vout.push_back(script_out);
+
+  currency::compact_tx_entry cte = AUTO_VAL_INIT(cte);
+  currency::get_compact_tx_entry(tx, cte);
+  currency::compact_tx_entry loaded_cte = AUTO_VAL_INIT(loaded_cte);
+  ASSERT_TRUE(t_unserializable_object_from_blob(loaded_cte, t_serializable_object_to_blob(cte)));
+  ASSERT_EQ(2, loaded_cte.outs.size());
+  ASSERT_EQ(currency::compact_tx_out::type_to_key, loaded_cte.outs[0].type);
+  ASSERT_EQ(boost::get<currency::txout_to_key>(tx.vout[0].target).key, loaded_cte.outs[0].key);
+  ASSERT_EQ(currency::compact_tx_out::type_other, loaded_cte.outs[1].type);
+  ASSERT_EQ(200, loaded_cte.outs[1].amount);
+
+  // the rebuilt tx is looked up like the full one, not as an output with a null key
+  currency::transaction compact_tx = AUTO_VAL_INIT(compact_tx);
+  currency::get_tx_from_compact_entry(loaded_cte, compact_tx);
+  ASSERT_TRUE(compact_tx.vout[1].target.type() == typeid(currency::txout_to_script));
+  std::vector<size_t> outs, compact_outs;
+  uint64_t money = 0, compact_money = 0;
+  ASSERT_FALSE(currency::lookup_acc_outs(alice.get_keys(), tx, txkey.pub, outs, money));
+  ASSERT_FALSE(currency::lookup_acc_outs(alice.get_keys(), compact_tx, loaded_cte.tx_pub_key, compact_outs, compact_money));
+}
@@ -0,0 +1,340 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <ctime>
+#include <deque>
+#include <vector>
+#include <boost/filesystem.hpp>
+#include <boost/program_options.hpp>
+
+#include "include_base_utils.h"
+#include "common/boost_serialization_helper.h"
+#include "common/parallel_utils.h"
+#include "currency_core/blockchain_storage.h"
+#include "currency_core/currency_boost_serialization.h"
+#include "currency_core/currency_format_utils.h"
+#include "currency_core/miner.h"
+#include "currency_core/tx_pool.h"
+
+using namespace currency;
+
+namespace
+{
+  const size_t test_blocks_count = CURRENCY_MINED_MONEY_UNLOCK_WINDOW + 10;
+
+  /* Pool on top of a small chain mined to miner, txs spending its coinbase outputs pass the real
+   * input checks, so the admission and eviction rules are tested as they are in the daemon.
+   */
+  class tx_pool_test : public ::testing::Test
+  {
+  protected:
+    tx_pool_test() : m_pool(m_chain), m_chain(m_pool)
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("tx_pool_test_%%%%%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_miner.generate();
+      m_bob.generate();
+    }
+
+    ~tx_pool_test()
+    {
+      m_chain.deinit();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    // the options with their defaults
+    static boost::program_options::variables_map get_default_options()
+    {
+      boost::program_options::options_description desc;
+      blockchain_storage::init_options(desc);
+      tx_memory_pool::init_options(desc);
+      boost::program_options::variables_map vm;
+      boost::program_options::store(boost::program_options::basic_parsed_options<char>(&desc), vm);
+      boost::program_options::notify(vm);
+      return vm;
+    }
+
+    virtual void SetUp()
+    {
+      ASSERT_TRUE(m_chain.init(get_default_options(), m_dir.string()));
+      uint64_t timestamp = time(nullptr) - test_blocks_count * DIFFICULTY_TARGET;
+      for (size_t i = 0; i != test_blocks_count; ++i)
+      {
+        block b = AUTO_VAL_INIT(b);
+        wide_difficulty_type diff = 0;
+        uint64_t height = 0;
+        ASSERT_TRUE(m_chain.create_block_template(b, m_miner.get_keys().m_account_address, diff, height, blobdata(), false, alias_info()));
+        b.timestamp = timestamp + i * DIFFICULTY_TARGET;
+        std::vector<crypto::hash> scratchpad;
+        m_chain.copy_scratchpad(scratchpad);
+        ASSERT_TRUE(miner::find_nonce_for_given_block(b, diff, height, [&](uint64_t index) -> crypto::hash&
+        {
+          return scratchpad[index % scratchpad.size()];
+        }));
+        block_verification_context bvc = AUTO_VAL_INIT(bvc);
+        ASSERT_TRUE(m_chain.add_new_block(b, bvc));
+        ASSERT_TRUE(bvc.m_added_to_main_chain);
+        collect_outputs(b.miner_tx);
+      }
+      ASSERT_LE(8, m_outputs.size());
+    }
+
+    // one input, one output to bob, so all the test txs with the default inputs_count have the same size
+    transaction make_tx(uint64_t fee, size_t inputs_count = 1)
+    {
+      EXPECT_LE(inputs_count, m_outputs.size());
+      std::vector<tx_source_entry> sources(m_outputs.begin(), m_outputs.begin() + inputs_count);
+      m_outputs.erase(m_outputs.begin(), m_outputs.begin() + inputs_count);
+      uint64_t amount = 0;
+      for (const auto& se : sources)
+        amount += se.amount;
+      std::vector<tx_destination_entry> destinations(1, tx_destination_entry(amount - fee, m_bob.get_keys().m_account_address));
+      transaction tx = AUTO_VAL_INIT(tx);
+      keypair txkey = AUTO_VAL_INIT(txkey);
+      EXPECT_TRUE(construct_tx(m_miner.get_keys(), sources, destinations, tx, txkey, 0));
+      return tx;
+    }
+
+    bool add_tx(const transaction& tx, bool kept_by_block = false)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      return m_pool.add_tx(tx, tvc, kept_by_block) && tvc.m_added_to_pool;
+    }
+
+    uint64_t get_memory_usage()
+    {
+      tx_pool_memory_stat st = AUTO_VAL_INIT(st);
+      m_pool.get_memory_stat(st);
+      return st.memory_usage;
+    }
+
+    // room for count txs like the ones in the pool now
+    void set_pool_capacity(size_t count)
+    {
+      uint64_t tx_usage = get_memory_usage() / m_pool.get_transactions_count();
+      m_pool.set_max_memory_usage(tx_usage * count + tx_usage / 2);
+    }
+
+    std::vector<crypto::hash> fill_block_template()
+    {
+      block b = AUTO_VAL_INIT(b);
+      b.prev_id = m_chain.get_top_block_id();
+      size_t total_size = 0;
+      uint64_t fee = 0;
+      EXPECT_TRUE(m_pool.fill_block_template(b, CURRENCY_BLOCK_GRANTED_FULL_REWARD_ZONE, 0, 0, total_size, fee));
+      return b.tx_hashes;
+    }
+
+    // coinbase outputs big enough to pay any test fee, of the blocks unlocked by the end of SetUp()
+    void collect_outputs(const transaction& miner_tx)
+    {
+      if (m_chain.get_current_blockchain_height() > CURRENCY_MINED_MONEY_UNLOCK_WINDOW + 2)
+        return;
+      std::vector<uint64_t> indexes;
+      ASSERT_TRUE(m_chain.get_tx_outputs_gindexs(get_transaction_hash(miner_tx), indexes));
+      for (size_t i = 0; i != miner_tx.vout.size(); ++i)
+      {
+        if (miner_tx.vout[i].amount < TX_POOL_MINIMUM_FEE * 100)
+          continue;
+        tx_source_entry se = AUTO_VAL_INIT(se);
+        se.outputs.push_back(make_output_entry(indexes[i], boost::get<txout_to_key>(miner_tx.vout[i].target).key));
+        se.real_output = 0;
+        se.real_out_tx_key = get_tx_pub_key_from_extra(miner_tx);
+        se.real_output_in_tx_index = i;
+        se.amount = miner_tx.vout[i].amount;
+        m_outputs.push_back(se);
+      }
+    }
+
+    boost::filesystem::path m_dir;
+    tx_memory_pool m_pool;
+    blockchain_storage m_chain;
+    account_base m_miner;
+    account_base m_bob;
+    std::deque<tx_source_entry> m_outputs;
+  };
+}
+
+TEST_F(tx_pool_test, txs_below_minimum_fee_are_rejected)
+{
+  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+  ASSERT_FALSE(m_pool.add_tx(make_tx(TX_POOL_MINIMUM_FEE - 1), tvc, false));
+  ASSERT_TRUE(tvc.m_verifivation_failed);
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE)));
+
+  // txs from blocks are not subject to it
+  ASSERT_TRUE(add_tx(make_tx(1), true));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+}
+
+TEST_F(tx_pool_test, full_pool_admits_only_higher_fee_rate)
+{
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 3)));
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 2)));
+  set_pool_capacity(2);
+
+  // below the lowest fee rate in the pool: dropped, but not as an invalid tx
+  transaction tx = make_tx(TX_POOL_MINIMUM_FEE * 3 / 2);
+  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+  ASSERT_FALSE(m_pool.add_tx(tx, tvc, false));
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(tx)));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 4)));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+}
+
+TEST_F(tx_pool_test, lowest_fee_rate_txs_are_evicted_first)
+{
+  std::vector<transaction> txs;
+  for (uint64_t k : { 3, 1, 4, 2 })
+  {
+    txs.push_back(make_tx(TX_POOL_MINIMUM_FEE * k));
+    ASSERT_TRUE(add_tx(txs.back()));
+  }
+  set_pool_capacity(4);
+
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 5)));
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(txs[1])));
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 6)));
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(txs[3])));
+  ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(txs[0])));
+  ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(txs[2])));
+  ASSERT_EQ(4, m_pool.get_transactions_count());
+
+  tx_pool_memory_stat st = AUTO_VAL_INIT(st);
+  m_pool.get_memory_stat(st);
+  ASSERT_EQ(2, st.evicted_count);
+  ASSERT_GE(st.max_memory_usage, st.memory_usage);
+}
+
+TEST_F(tx_pool_test, large_tx_does_not_push_out_higher_fee_rates)
+{
+  std::vector<transaction> txs;
+  for (uint64_t k : { 2, 3, 4 })
+  {
+    txs.push_back(make_tx(TX_POOL_MINIMUM_FEE * k));
+    ASSERT_TRUE(add_tx(txs.back()));
+  }
+  size_t small_size = get_object_blobsize(txs[0]);
+  set_pool_capacity(3);
+
+  // pays a bit more per byte than the lowest one, but needs the room of all three
+  std::deque<tx_source_entry> outputs = m_outputs;
+  size_t large_size = get_object_blobsize(make_tx(0, 4));
+  m_outputs = outputs;
+  uint64_t fee = TX_POOL_MINIMUM_FEE * 2 * large_size / small_size + TX_POOL_MINIMUM_FEE / 10;
+  transaction large_tx = make_tx(fee, 4);
+  ASSERT_EQ(large_size, get_object_blobsize(large_tx));
+  ASSERT_LT(TX_POOL_MINIMUM_FEE * 2 * large_size, fee * small_size);
+  ASSERT_GT(TX_POOL_MINIMUM_FEE * 3 * large_size, fee * small_size);
+  tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+  ASSERT_FALSE(m_pool.add_tx(large_tx, tvc, false));
+  ASSERT_FALSE(tvc.m_verifivation_failed);
+  ASSERT_FALSE(tvc.m_added_to_pool);
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(large_tx)));
+  for (const auto& tx : txs)
+    ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(tx)));
+
+  tx_pool_memory_stat st = AUTO_VAL_INIT(st);
+  m_pool.get_memory_stat(st);
+  ASSERT_EQ(0, st.evicted_count);
+}
+
+TEST_F(tx_pool_test, txs_from_blocks_are_not_evicted)
+{
+  transaction kept_tx = make_tx(TX_POOL_MINIMUM_FEE);
+  ASSERT_TRUE(add_tx(kept_tx, true));
+  transaction low_tx = make_tx(TX_POOL_MINIMUM_FEE * 2);
+  ASSERT_TRUE(add_tx(low_tx));
+  set_pool_capacity(2);
+
+  // the one from a block has the lowest fee rate, the next one goes instead
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 3)));
+  ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(kept_tx)));
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(low_tx)));
+
+  // and it doesn't set the admission threshold
+  ASSERT_FALSE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 2)));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+
+  // txs from blocks are added over the limit, and only the others make room for them
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE), true));
+  ASSERT_TRUE(m_pool.have_tx(get_transaction_hash(kept_tx)));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+
+  // a pool full of them admits nothing
+  ASSERT_FALSE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 10)));
+  ASSERT_EQ(2, m_pool.get_transactions_count());
+}
+
+TEST_F(tx_pool_test, block_template_follows_pool_changes)
+{
+  transaction tx1 = make_tx(TX_POOL_MINIMUM_FEE);
+  transaction tx2 = make_tx(TX_POOL_MINIMUM_FEE * 2);
+  ASSERT_TRUE(add_tx(tx1));
+  ASSERT_TRUE(add_tx(tx2));
+  std::vector<crypto::hash> expected = { get_transaction_hash(tx2), get_transaction_hash(tx1) };
+  ASSERT_EQ(expected, fill_block_template());
+  // cached
+  ASSERT_EQ(expected, fill_block_template());
+
+  // added tx is in the next template, ordered by its fee rate
+  transaction tx3 = make_tx(TX_POOL_MINIMUM_FEE * 3);
+  ASSERT_TRUE(add_tx(tx3));
+  expected.insert(expected.begin(), get_transaction_hash(tx3));
+  ASSERT_EQ(expected, fill_block_template());
+
+  // and a taken one is not
+  transaction tx;
+  size_t blob_size = 0;
+  uint64_t fee = 0;
+  ASSERT_TRUE(m_pool.take_tx(get_transaction_hash(tx2), tx, blob_size, fee));
+  expected.erase(std::find(expected.begin(), expected.end(), get_transaction_hash(tx2)));
+  ASSERT_EQ(expected, fill_block_template());
+
+  // evicted ones too
+  set_pool_capacity(2);
+  transaction tx4 = make_tx(TX_POOL_MINIMUM_FEE * 4);
+  ASSERT_TRUE(add_tx(tx4));
+  ASSERT_FALSE(m_pool.have_tx(get_transaction_hash(tx1)));
+  expected = { get_transaction_hash(tx4), get_transaction_hash(tx3) };
+  ASSERT_EQ(expected, fill_block_template());
+}
+
+TEST_F(tx_pool_test, legacy_pool_file_goes_to_journal_and_txs_are_revalidated)
+{
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE)));
+  ASSERT_TRUE(add_tx(make_tx(TX_POOL_MINIMUM_FEE * 2)));
+  std::string pool_dir = (m_dir / "pool").string();
+  boost::filesystem::create_directories(pool_dir);
+  std::string state_file_path = pool_dir + "/" + CURRENCY_POOLDATA_FILENAME;
+  ASSERT_TRUE(tools::serialize_obj_to_file(m_pool, state_file_path));
+
+  // the old file is removed once its txs are synced to the journal
+  {
+    tx_memory_pool pool(m_chain);
+    ASSERT_TRUE(pool.init(pool_dir, get_default_options()));
+    ASSERT_EQ(2, pool.get_transactions_count());
+    ASSERT_FALSE(boost::filesystem::exists(state_file_path));
+    ASSERT_TRUE(pool.deinit());
+  }
+
+  // the journal txs are checked again on the verification pool threads
+  tools::worker_pool verification_pool(4);
+  verification_pool.start(2);
+  tx_memory_pool pool(m_chain);
+  pool.set_verification_pool(&verification_pool);
+  ASSERT_TRUE(pool.init(pool_dir, get_default_options()));
+  ASSERT_EQ(0, pool.get_transactions_count());
+  pool.on_idle();
+  ASSERT_EQ(2, pool.get_transactions_count());
+  ASSERT_TRUE(pool.deinit());
+}
@@ -0,0 +1,187 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <list>
+#include <unordered_set>
+#include <boost/uuid/nil_generator.hpp>
+
+#include "include_base_utils.h"
+#include "currency_protocol/tx_relay_tracker.h"
+
+namespace
+{
+  crypto::hash get_test_tx_id(uint64_t n)
+  {
+    return crypto::cn_fast_hash(&n, sizeof n);
+  }
+
+  std::list<crypto::hash> get_test_tx_ids(uint64_t from, uint64_t to)
+  {
+    std::list<crypto::hash> ids;
+    for (uint64_t n = from; n != to; ++n)
+      ids.push_back(get_test_tx_id(n));
+    return ids;
+  }
+
+  boost::uuids::uuid make_test_peer(uint8_t n)
+  {
+    boost::uuids::uuid id = boost::uuids::nil_uuid();
+    id.data[0] = n;
+    return id;
+  }
+}
+
+TEST(tx_relay_tracker, announced_tx_is_requested_from_one_peer_until_timeout)
+{
+  currency::tx_relay_tracker t(1000, 100, 100);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  std::list<crypto::hash> ids = get_test_tx_ids(0, 3);
+
+  std::list<crypto::hash> r1, r2, r3;
+  t.on_announce(p1, ids, ids, 0, r1);
+  ASSERT_EQ(ids, r1);
+  ASSERT_EQ(3, t.get_requested_count());
+
+  // the others announcing it are not asked while the request is fresh
+  t.on_announce(p2, ids, ids, 500, r2);
+  ASSERT_TRUE(r2.empty());
+
+  t.on_announce(p2, ids, ids, 1000, r3);
+  ASSERT_EQ(ids, r3);
+
+  // received tx is not awaited anymore
+  t.on_txs_received(p2, get_test_tx_ids(0, 1), 1100);
+  ASSERT_EQ(2, t.get_requested_count());
+
+  // timed out requests nobody else announced are forgotten on idle
+  std::set<boost::uuids::uuid> connections = { p1, p2 };
+  currency::tx_relay_tracker::peer_txs_list announces, requests;
+  t.on_idle(connections, 2000, announces, requests);
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(0, t.get_requested_count());
+}
+
+TEST(tx_relay_tracker, timed_out_tx_is_requested_from_next_announcer)
+{
+  currency::tx_relay_tracker t(1000, 100, 100, 2);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2), p3 = make_test_peer(3);
+  std::list<crypto::hash> ids = get_test_tx_ids(0, 3);
+
+  std::list<crypto::hash> to_request;
+  t.on_announce(p1, ids, ids, 0, to_request);
+  ASSERT_EQ(ids, to_request);
+  to_request.clear();
+  t.on_announce(p2, ids, ids, 100, to_request);
+  t.on_announce(p3, ids, ids, 200, to_request);
+  t.on_announce(p2, ids, ids, 300, to_request);
+  ASSERT_TRUE(to_request.empty());
+
+  // p1 doesn't answer, p2 is asked next, in messages of no more than 2 hashes
+  std::set<boost::uuids::uuid> connections = { p1, p2, p3 };
+  currency::tx_relay_tracker::peer_txs_list announces, requests;
+  t.on_idle(connections, 500, announces, requests);
+  ASSERT_TRUE(requests.empty());
+  t.on_idle(connections, 1000, announces, requests);
+  ASSERT_EQ(2, requests.size());
+  std::unordered_set<crypto::hash> requested;
+  for (const auto& r : requests)
+  {
+    ASSERT_EQ(p2, r.first);
+    ASSERT_GE(2, r.second.size());
+    requested.insert(r.second.begin(), r.second.end());
+  }
+  ASSERT_EQ(std::unordered_set<crypto::hash>(ids.begin(), ids.end()), requested);
+
+  // p2 sends one, p3 is gone, so the others are forgotten when p2 times out as well
+  t.on_txs_received(p2, get_test_tx_ids(0, 1), 1100);
+  connections.erase(p3);
+  requests.clear();
+  t.on_idle(connections, 2000, announces, requests);
+  ASSERT_TRUE(requests.empty());
+  ASSERT_EQ(0, t.get_requested_count());
+}
+
+TEST(tx_relay_tracker, closed_connection_request_goes_to_next_announcer)
+{
+  currency::tx_relay_tracker t(1000, 100, 100);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  std::list<crypto::hash> ids = get_test_tx_ids(0, 1);
+  std::list<crypto::hash> to_request;
+  t.on_announce(p1, ids, ids, 0, to_request);
+  t.on_announce(p2, ids, ids, 100, to_request);
+
+  // no need to wait for the timeout
+  currency::tx_relay_tracker::peer_txs_list announces, requests;
+  t.on_idle({ p2 }, 200, announces, requests);
+  ASSERT_EQ(1, requests.size());
+  ASSERT_EQ(p2, requests.front().first);
+  ASSERT_EQ(ids, requests.front().second);
+  ASSERT_EQ(1, t.get_requested_count());
+}
+
+TEST(tx_relay_tracker, known_txs_are_not_announced_back)
+{
+  currency::tx_relay_tracker t(1000, 100, 100);
+  auto p1 = make_test_peer(1), p2 = make_test_peer(2);
+  std::list<crypto::hash> to_request;
+  t.on_announce(p1, get_test_tx_ids(0, 2), std::list<crypto::hash>(), 0, to_request);
+  t.on_txs_received(p2, get_test_tx_ids(2, 3), 0);
+
+  std::list<boost::uuids::uuid> peers = { p1, p2 };
+  t.add_to_announce(peers, get_test_tx_ids(0, 4), 0);
+  // added twice, announced once
+  t.add_to_announce(peers, get_test_tx_ids(3, 4), 0);
+
+  std::set<boost::uuids::uuid> connections = { p1, p2 };
+  currency::tx_relay_tracker::peer_txs_list announces, requests;
+  t.on_idle(connections, 0, announces, requests);
+  ASSERT_TRUE(announces.empty());   // not due yet
+
+  t.on_idle(connections, 200, announces, requests);
+  ASSERT_EQ(2, announces.size());
+  for (const auto& a : announces)
+  {
+    if (a.first == p1)
+      ASSERT_EQ(get_test_tx_ids(2, 4), a.second);
+    else
+      ASSERT_EQ(std::list<crypto::hash>({ get_test_tx_id(0), get_test_tx_id(1), get_test_tx_id(3) }), a.second);
+  }
+}
+
+TEST(tx_relay_tracker, known_txs_and_announces_are_bounded)
+{
+  currency::tx_relay_tracker t(1000, 100, 100, 30);
+  auto p1 = make_test_peer(1);
+  std::list<boost::uuids::uuid> peers = { p1 };
+  t.add_to_announce(peers, get_test_tx_ids(0, 150), 0);
+
+  // only the latest ones are remembered
+  ASSERT_EQ(100, t.get_known_count(p1));
+  ASSERT_FALSE(t.is_known_by(p1, get_test_tx_id(49)));
+  ASSERT_TRUE(t.is_known_by(p1, get_test_tx_id(50)));
+  ASSERT_TRUE(t.is_known_by(p1, get_test_tx_id(149)));
+
+  // a big batch goes out in parts, one per idle call
+  std::set<boost::uuids::uuid> connections = { p1 };
+  currency::tx_relay_tracker::peer_txs_list announces, requests;
+  size_t announced = 0;
+  for (uint64_t now = 200; now != 210; ++now)
+  {
+    t.on_idle(connections, now, announces, requests);
+    for (const auto& a : announces)
+    {
+      ASSERT_GE(30, a.second.size());
+      announced += a.second.size();
+    }
+    announces.clear();
+  }
+  ASSERT_EQ(150, announced);
+
+  // closed connections are forgotten
+  t.on_idle(std::set<boost::uuids::uuid>(), 300, announces, requests);
+  ASSERT_EQ(0, t.get_peers_count());
+}
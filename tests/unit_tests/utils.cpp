@@ -6,6 +6,7 @@
 
 #include "include_base_utils.h"
 #include "common/pod_array_file_container.h"
+#include "common/journal_file.h"
 
 struct test_item_t
 {
@@ -139,3 +140,72 @@ TEST(utils, pod_array_file_container)
   container.close();
 
 }
+
+
+TEST(utils, journal_file)
+{
+  tools::journal_file journal;
+
+  std::wstring filename = L"test_journal_file.dat";
+
+  boost::filesystem::remove(filename);
+
+  std::vector<std::string> records;
+  bool corrupted = false;
+  std::string reason;
+  ASSERT_TRUE(journal.open(filename, records, &corrupted, &reason));
+  ASSERT_FALSE(corrupted);
+  ASSERT_TRUE(records.empty());
+  ASSERT_EQ(journal.get_snapshot_id(), 0);
+
+  ASSERT_TRUE(journal.reset(1234));
+  ASSERT_TRUE(journal.append("first"));
+  ASSERT_TRUE(journal.append(std::string()));
+  ASSERT_TRUE(journal.append(std::string(100000, 'x')));
+  ASSERT_EQ(journal.records_count(), 3);
+  uint64_t good_size = journal.size_bytes();
+  journal.close();
+
+  ////////////////////////////////
+
+  ASSERT_TRUE(journal.open(filename, records, &corrupted, &reason));
+  ASSERT_FALSE(corrupted);
+  ASSERT_EQ(journal.get_snapshot_id(), 1234);
+  ASSERT_EQ(records.size(), 3);
+  ASSERT_EQ(records[0], "first");
+  ASSERT_EQ(records[1], std::string());
+  ASSERT_EQ(records[2], std::string(100000, 'x'));
+  journal.close();
+
+  ////////////////////////////////
+  // simulate a record torn by a crash: it should be cut off, previous ones kept
+
+  {
+    boost::filesystem::ofstream out(filename, std::ios::binary | std::ios::app);
+    out << "\x10\x00\x00\x00garbage";
+  }
+
+  ASSERT_TRUE(journal.open(filename, records, &corrupted, &reason));
+  ASSERT_TRUE(corrupted);
+  ASSERT_EQ(records.size(), 3);
+  ASSERT_EQ(journal.size_bytes(), good_size);
+
+  ASSERT_TRUE(journal.append("fourth"));
+  journal.close();
+
+  ASSERT_TRUE(journal.open(filename, records, &corrupted, &reason));
+  ASSERT_FALSE(corrupted);
+  ASSERT_EQ(records.size(), 4);
+  ASSERT_EQ(records[3], "fourth");
+
+  ////////////////////////////////
+
+  ASSERT_TRUE(journal.reset(5678));
+  journal.close();
+
+  ASSERT_TRUE(journal.open(filename, records, &corrupted, &reason));
+  ASSERT_FALSE(corrupted);
+  ASSERT_EQ(journal.get_snapshot_id(), 5678);
+  ASSERT_TRUE(records.empty());
+  journal.close();
+}
@@ -0,0 +1,50 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "wallet/wallet2.h"
+#include "test_core_proxy.h"
+
+TEST(wallet_compact_sync, related_txs_are_fetched_once_per_response)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_compact_sync_test_%%%%%%%%");
+  boost::filesystem::create_directories(dir);
+  std::shared_ptr<unit_test::test_core_proxy> proxy(new unit_test::test_core_proxy(5));
+  {
+    tools::wallet2 w;
+    w.generate((dir / "wallet").wstring(), "");
+    std::shared_ptr<tools::i_core_proxy> p = proxy;
+    w.set_core_proxy(p);
+    w.set_scan_threads_count(1);
+    w.set_refresh_prefetch_depth(0);
+    ASSERT_TRUE(w.get_compact_sync());
+
+    currency::account_base other;
+    other.generate();
+    uint64_t expected_balance = 0;
+    for (size_t i = 0; i != 12; ++i)
+    {
+      std::list<currency::transaction> txs;
+      txs.push_back(unit_test::make_test_tx(other.get_keys().m_account_address, 1000 + i));
+      txs.push_back(unit_test::make_test_tx(w.get_account().get_keys().m_account_address, 2000 + i));
+      proxy->add_block(other.get_keys().m_account_address, time(nullptr), txs);
+      expected_balance += 2000 + i;
+    }
+
+    w.refresh();
+    ASSERT_EQ(proxy->get_height(), w.get_blockchain_current_height());
+    ASSERT_EQ(expected_balance, w.balance());
+    // responses start at the wallet's top block: 0-4, 4-8, 8-12 and 12, the last one has nothing new
+    ASSERT_EQ(4, proxy->get_blocks_calls());
+    ASSERT_EQ(3, proxy->get_transactions_calls());
+  }
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(dir, ec);
+}
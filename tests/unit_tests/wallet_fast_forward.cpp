@@ -0,0 +1,112 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "wallet/wallet2.h"
+#include "test_core_proxy.h"
+
+namespace
+{
+  const size_t old_blocks_count = 35;
+  const size_t new_blocks_count = 15;
+
+  /* Chain of old blocks, mined before the wallet was created, then of new ones. All the blocks pay to
+   * the wallet, so the balance tells which of them were scanned.
+   */
+  class wallet_fast_forward_test : public ::testing::Test
+  {
+  protected:
+    wallet_fast_forward_test() : m_proxy(new unit_test::test_core_proxy(10)), m_new_blocks_money(0)
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_fast_forward_test_%%%%%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_wallet.reset(new tools::wallet2());
+      m_wallet->generate((m_dir / "wallet").wstring(), "");
+      std::shared_ptr<tools::i_core_proxy> p = m_proxy;
+      m_wallet->set_core_proxy(p);
+      m_wallet->set_scan_threads_count(1);
+      m_wallet->set_refresh_prefetch_depth(0);
+
+      const currency::account_public_address& addr = m_wallet->get_account().get_keys().m_account_address;
+      uint64_t now = time(nullptr);
+      for (size_t i = 0; i != old_blocks_count; ++i)
+        m_proxy->add_block(addr, now - 60 * 60 * 24 * 3);
+      for (size_t i = 0; i != new_blocks_count; ++i)
+        m_new_blocks_money += currency::get_outs_money_amount(m_proxy->add_block(addr, now).miner_tx);
+    }
+
+    ~wallet_fast_forward_test()
+    {
+      m_wallet.reset();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    boost::filesystem::path m_dir;
+    std::shared_ptr<unit_test::test_core_proxy> m_proxy;
+    std::shared_ptr<tools::wallet2> m_wallet;
+    uint64_t m_new_blocks_money;
+  };
+}
+
+TEST_F(wallet_fast_forward_test, old_blocks_are_skipped_by_ids)
+{
+  m_proxy->set_ids_supported(true);
+  size_t blocks_fetched = 0;
+  bool received_money = false;
+  m_wallet->refresh(blocks_fetched, received_money);
+
+  // the skipped blocks are counted as fetched too
+  ASSERT_EQ(old_blocks_count + new_blocks_count, blocks_fetched);
+  ASSERT_EQ(m_proxy->get_height(), m_wallet->get_blockchain_current_height());
+  ASSERT_EQ(m_new_blocks_money, m_wallet->balance());
+  ASSERT_LT(0, m_proxy->get_blocks_ids_calls());
+  // only the new blocks are fetched in full: two batches and the last empty call
+  ASSERT_EQ(3, m_proxy->get_blocks_calls());
+
+  // ids are asked for only once, further refreshes go on with full blocks
+  size_t ids_calls = m_proxy->get_blocks_ids_calls();
+  currency::block b = m_proxy->add_block(m_wallet->get_account().get_keys().m_account_address, time(nullptr));
+  m_wallet->refresh(blocks_fetched, received_money);
+  ASSERT_EQ(1, blocks_fetched);
+  ASSERT_EQ(ids_calls, m_proxy->get_blocks_ids_calls());
+  ASSERT_EQ(m_new_blocks_money + currency::get_outs_money_amount(b.miner_tx), m_wallet->balance());
+}
+
+TEST_F(wallet_fast_forward_test, restore_height_skips_blocks_by_height)
+{
+  m_proxy->set_ids_supported(true);
+  // the account looks older than the chain, only the height keeps the first blocks out
+  m_wallet->get_account().set_createtime(0);
+  m_wallet->set_restore_height(old_blocks_count + 1);
+  size_t blocks_fetched = 0;
+  bool received_money = false;
+  m_wallet->refresh(blocks_fetched, received_money);
+
+  ASSERT_EQ(old_blocks_count + new_blocks_count, blocks_fetched);
+  ASSERT_EQ(m_proxy->get_height(), m_wallet->get_blockchain_current_height());
+  ASSERT_EQ(m_new_blocks_money, m_wallet->balance());
+}
+
+TEST_F(wallet_fast_forward_test, all_blocks_are_fetched_when_ids_unsupported)
+{
+  size_t blocks_fetched = 0;
+  bool received_money = false;
+  m_wallet->refresh(blocks_fetched, received_money);
+
+  // a single failed call, then the old way
+  ASSERT_EQ(1, m_proxy->get_blocks_ids_calls());
+  ASSERT_EQ(old_blocks_count + new_blocks_count, blocks_fetched);
+  ASSERT_EQ(m_proxy->get_height(), m_wallet->get_blockchain_current_height());
+  // old blocks are fetched but not scanned for outputs
+  ASSERT_EQ(m_new_blocks_money, m_wallet->balance());
+  // each response starts with the last known block, so 9 new ones a call
+  ASSERT_EQ(7, m_proxy->get_blocks_calls());
+}
@@ -0,0 +1,127 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "wallet/wallet2.h"
+#include "test_core_proxy.h"
+
+namespace
+{
+  class wallet_journal_test : public ::testing::Test
+  {
+  protected:
+    wallet_journal_test() : m_proxy(new unit_test::test_core_proxy(10))
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_journal_test_%%%%%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_wallet_file = (m_dir / "wallet").wstring();
+    }
+
+    ~wallet_journal_test()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    std::shared_ptr<tools::wallet2> make_wallet()
+    {
+      std::shared_ptr<tools::wallet2> w(new tools::wallet2());
+      std::shared_ptr<tools::i_core_proxy> p = m_proxy;
+      w->set_core_proxy(p);
+      w->set_scan_threads_count(1);
+      w->set_refresh_prefetch_depth(0);
+      return w;
+    }
+
+    std::shared_ptr<tools::wallet2> load_wallet()
+    {
+      std::shared_ptr<tools::wallet2> w = make_wallet();
+      w->load(m_wallet_file, "");
+      return w;
+    }
+
+    void mine_and_refresh(tools::wallet2& w, size_t count)
+    {
+      for (size_t i = 0; i != count; ++i)
+        m_proxy->add_block(w.get_account().get_keys().m_account_address, time(nullptr));
+      w.refresh();
+    }
+
+    uint64_t get_file_size(const std::wstring& filename)
+    {
+      return boost::filesystem::file_size(filename);
+    }
+
+    boost::filesystem::path m_dir;
+    std::wstring m_wallet_file;
+    std::shared_ptr<unit_test::test_core_proxy> m_proxy;
+  };
+}
+
+TEST_F(wallet_journal_test, stored_changes_are_replayed_on_load)
+{
+  std::shared_ptr<tools::wallet2> w = make_wallet();
+  w->generate(m_wallet_file, "");
+  uint64_t snapshot_size = get_file_size(m_wallet_file);
+  std::wstring journal_file = m_wallet_file + L".journal";
+
+  mine_and_refresh(*w, 5);
+  w->store();
+  uint64_t first_balance = w->balance();
+  uint64_t first_journal_size = get_file_size(journal_file);
+
+  mine_and_refresh(*w, 5);
+  w->store();
+  ASSERT_EQ(m_proxy->get_height(), w->get_blockchain_current_height());
+  // changes went to the journal, the snapshot stays as it was written on generate
+  ASSERT_EQ(snapshot_size, get_file_size(m_wallet_file));
+  ASSERT_LT(first_journal_size, get_file_size(journal_file));
+
+  std::shared_ptr<tools::wallet2> w2 = load_wallet();
+  ASSERT_EQ(w->get_blockchain_current_height(), w2->get_blockchain_current_height());
+  ASSERT_EQ(w->balance(), w2->balance());
+  ASSERT_LT(first_balance, w2->balance());
+  tools::wallet2::transfer_container tc, tc2;
+  w->get_transfers(tc);
+  w2->get_transfers(tc2);
+  ASSERT_EQ(tc.size(), tc2.size());
+}
+
+TEST_F(wallet_journal_test, torn_last_record_is_dropped)
+{
+  std::shared_ptr<tools::wallet2> w = make_wallet();
+  w->generate(m_wallet_file, "");
+  std::wstring journal_file = m_wallet_file + L".journal";
+
+  mine_and_refresh(*w, 5);
+  w->store();
+  uint64_t first_height = w->get_blockchain_current_height();
+  uint64_t first_balance = w->balance();
+
+  mine_and_refresh(*w, 5);
+  w->store();
+
+  // a crash in the middle of the last append
+  boost::filesystem::resize_file(journal_file, get_file_size(journal_file) - 3);
+
+  std::shared_ptr<tools::wallet2> w2 = load_wallet();
+  ASSERT_EQ(first_height, w2->get_blockchain_current_height());
+  ASSERT_EQ(first_balance, w2->balance());
+
+  // the lost blocks are synced again, and the journal takes records after the cut
+  w2->refresh();
+  ASSERT_EQ(m_proxy->get_height(), w2->get_blockchain_current_height());
+  w2->store();
+  w2.reset();
+
+  std::shared_ptr<tools::wallet2> w3 = load_wallet();
+  ASSERT_EQ(w->get_blockchain_current_height(), w3->get_blockchain_current_height());
+  ASSERT_EQ(w->balance(), w3->balance());
+}
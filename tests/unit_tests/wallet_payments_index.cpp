@@ -0,0 +1,185 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <unordered_set>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "wallet/wallet2.h"
+#include "test_core_proxy.h"
+
+namespace
+{
+  currency::payment_id_t get_test_payment_id(size_t i)
+  {
+    return currency::payment_id_t(1, static_cast<char>('a' + i % 5));
+  }
+
+  // payment #i is at height i / 3, with payment id i % 5
+  std::shared_ptr<tools::wallet2::read_view> make_test_view(size_t count)
+  {
+    std::shared_ptr<tools::wallet2::read_view> v(new tools::wallet2::read_view());
+    for (size_t i = 0; i != count; ++i)
+    {
+      tools::wallet2::payment_details pd = AUTO_VAL_INIT(pd);
+      pd.m_amount = i;
+      pd.m_block_height = i / 3;
+      std::pair<currency::payment_id_t, tools::wallet2::payment_details> p(get_test_payment_id(i), pd);
+      v->payments.append(&p, &p + 1);
+    }
+    return v;
+  }
+
+  // the height index has the same payments as the one by id
+  void check_payments_index(const tools::wallet2::read_view& v, const std::vector<currency::payment_id_t>& ids, size_t expected_count)
+  {
+    tools::wallet2::payments_list all;
+    v.get_payments_since(0, all);
+    ASSERT_EQ(expected_count, all.size());
+    size_t count_by_id = 0;
+    for (auto& id : ids)
+    {
+      std::list<tools::wallet2::payment_details> by_id;
+      v.get_payments(id, by_id);
+      count_by_id += by_id.size();
+      for (auto& pd : by_id)
+      {
+        auto it = std::find_if(all.begin(), all.end(), [&](const std::pair<currency::payment_id_t, tools::wallet2::payment_details>& p)
+        {
+          return p.first == id && p.second.m_tx_hash == pd.m_tx_hash;
+        });
+        ASSERT_TRUE(it != all.end());
+        ASSERT_EQ(pd.m_block_height, it->second.m_block_height);
+      }
+    }
+    ASSERT_EQ(expected_count, count_by_id);
+  }
+}
+
+TEST(wallet_payments_index, payments_since_height)
+{
+  std::shared_ptr<tools::wallet2::read_view> v = make_test_view(300);
+
+  tools::wallet2::payments_list all;
+  v->get_payments_since(0, all);
+  ASSERT_EQ(297, all.size()); // height 0 is not above min height
+
+  tools::wallet2::payments_list recent;
+  v->get_payments_since(89, recent);
+  ASSERT_EQ(30, recent.size());
+  uint64_t prev_height = 0;
+  for (auto& p : recent)
+  {
+    ASSERT_LT(89, p.second.m_block_height);
+    ASSERT_LE(prev_height, p.second.m_block_height);
+    ASSERT_EQ(get_test_payment_id(p.second.m_amount), p.first);
+    prev_height = p.second.m_block_height;
+  }
+
+  tools::wallet2::payments_list none;
+  v->get_payments_since(99, none);
+  ASSERT_TRUE(none.empty());
+}
+
+TEST(wallet_payments_index, same_payments_as_lookup_by_id)
+{
+  std::shared_ptr<tools::wallet2::read_view> v = make_test_view(300);
+
+  std::unordered_set<currency::payment_id_t> ids;
+  ids.insert(get_test_payment_id(1));
+  ids.insert(get_test_payment_id(3));
+  tools::wallet2::payments_list by_height;
+  v->get_payments_since(50, by_height, &ids);
+
+  size_t expected_count = 0;
+  uint64_t expected_amount_sum = 0;
+  for (auto& id : ids)
+  {
+    std::list<tools::wallet2::payment_details> by_id;
+    v->get_payments(id, by_id, 50);
+    expected_count += by_id.size();
+    for (auto& p : by_id)
+      expected_amount_sum += p.m_amount;
+  }
+
+  uint64_t amount_sum = 0;
+  for (auto& p : by_height)
+  {
+    ASSERT_EQ(1, ids.count(p.first));
+    amount_sum += p.second.m_amount;
+  }
+  ASSERT_EQ(expected_count, by_height.size());
+  ASSERT_EQ(expected_amount_sum, amount_sum);
+}
+
+TEST(wallet_payments_index, index_follows_refresh_detach_and_load)
+{
+  boost::filesystem::path dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_payments_index_%%%%%%%%");
+  boost::filesystem::create_directories(dir);
+  std::wstring wallet_file = (dir / "wallet").wstring();
+  std::shared_ptr<unit_test::test_core_proxy> proxy(new unit_test::test_core_proxy(10));
+  auto make_wallet = [&]()
+  {
+    std::shared_ptr<tools::wallet2> w(new tools::wallet2());
+    std::shared_ptr<tools::i_core_proxy> p = proxy;
+    w->set_core_proxy(p);
+    w->set_scan_threads_count(1);
+    w->set_refresh_prefetch_depth(0);
+    return w;
+  };
+
+  std::shared_ptr<tools::wallet2> w = make_wallet();
+  w->generate(wallet_file, "");
+  const currency::account_public_address& addr = w->get_account().get_keys().m_account_address;
+  std::vector<currency::payment_id_t> ids = { get_test_payment_id(0), get_test_payment_id(1), get_test_payment_id(2) };
+
+  // a payment per block at heights 1..12
+  for (size_t i = 0; i != 12; ++i)
+    proxy->add_block(addr, time(nullptr), { unit_test::make_test_tx(addr, 1000 + i, ids[i % 2]) });
+  w->refresh();
+  check_payments_index(*w->get_read_view(), ids, 12);
+
+  // the chain is switched at height 8: the payments of the detached blocks are gone from both indexes
+  proxy->pop_blocks(8);
+  for (size_t i = 0; i != 3; ++i)
+    proxy->add_block(addr, time(nullptr), { unit_test::make_test_tx(addr, 2000 + i, ids[2]) });
+  w->refresh();
+  ASSERT_EQ(proxy->get_height(), w->get_blockchain_current_height());
+  std::shared_ptr<const tools::wallet2::read_view> v = w->get_read_view();
+  check_payments_index(*v, ids, 10);
+  tools::wallet2::payments_list recent;
+  v->get_payments_since(7, recent);
+  ASSERT_EQ(3, recent.size());
+  for (auto& p : recent)
+  {
+    ASSERT_EQ(ids[2], p.first);
+    ASSERT_LE(2000, p.second.m_amount);
+  }
+
+  // the height index isn't stored, it's rebuilt on load
+  w->store();
+  std::shared_ptr<tools::wallet2> w2 = make_wallet();
+  w2->load(wallet_file, "");
+  check_payments_index(*w2->get_read_view(), ids, 10);
+  tools::wallet2::payments_list all, all2;
+  v->get_payments_since(0, all);
+  w2->get_read_view()->get_payments_since(0, all2);
+  ASSERT_EQ(all.size(), all2.size());
+  for (auto it = all.begin(), it2 = all2.begin(); it != all.end(); ++it, ++it2)
+  {
+    ASSERT_EQ(it->first, it2->first);
+    ASSERT_EQ(it->second.m_tx_hash, it2->second.m_tx_hash);
+  }
+
+  w.reset();
+  w2.reset();
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(dir, ec);
+}
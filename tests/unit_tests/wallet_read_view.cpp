@@ -0,0 +1,128 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+#include <memory>
+#include <set>
+#include <boost/filesystem.hpp>
+#include <boost/thread/thread.hpp>
+
+#include "include_base_utils.h"
+#include "wallet/wallet2.h"
+#include "test_core_proxy.h"
+
+namespace
+{
+  class wallet_read_view_test : public ::testing::Test
+  {
+  protected:
+    wallet_read_view_test() : m_proxy(new unit_test::test_core_proxy(10))
+    {
+      m_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallet_read_view_test_%%%%%%%%");
+      boost::filesystem::create_directories(m_dir);
+      m_wallet_file = (m_dir / "wallet").wstring();
+      m_miner.generate();
+    }
+
+    ~wallet_read_view_test()
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(m_dir, ec);
+    }
+
+    std::shared_ptr<tools::wallet2> make_wallet()
+    {
+      std::shared_ptr<tools::wallet2> w(new tools::wallet2());
+      std::shared_ptr<tools::i_core_proxy> p = m_proxy;
+      w->set_core_proxy(p);
+      w->set_scan_threads_count(1);
+      w->set_refresh_prefetch_depth(0);
+      return w;
+    }
+
+    // blocks are mined to another account, so only the given txs pay to the wallet
+    void add_blocks(size_t count, const std::list<currency::transaction>& txs = std::list<currency::transaction>())
+    {
+      m_proxy->add_block(m_miner.get_keys().m_account_address, time(nullptr), txs);
+      for (size_t i = 1; i < count; ++i)
+        m_proxy->add_block(m_miner.get_keys().m_account_address, time(nullptr));
+    }
+
+    static size_t get_history_size(const tools::wallet2::read_view& v, std::set<std::string>* tx_hashes = nullptr)
+    {
+      tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request req = AUTO_VAL_INIT(req);
+      req.in = req.out = true;
+      tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response res = AUTO_VAL_INIT(res);
+      v.get_transfers(req, res);
+      if (tx_hashes)
+      {
+        for (auto& wti : res.in)
+          tx_hashes->insert(wti.tx_hash);
+      }
+      return res.in.size() + res.out.size();
+    }
+
+    boost::filesystem::path m_dir;
+    std::wstring m_wallet_file;
+    std::shared_ptr<unit_test::test_core_proxy> m_proxy;
+    currency::account_base m_miner;
+  };
+}
+
+TEST_F(wallet_read_view_test, time_locked_transfer_unlocks_without_new_blocks)
+{
+  std::shared_ptr<tools::wallet2> w = make_wallet();
+  w->generate(m_wallet_file, "");
+  currency::transaction tx = unit_test::make_test_tx(w->get_account().get_keys().m_account_address, 1000);
+  tx.unlock_time = time(nullptr) + CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS + 2;
+  add_blocks(DEFAULT_TX_SPENDABLE_AGE + 1, { tx });
+
+  w->refresh();
+  std::shared_ptr<const tools::wallet2::read_view> v = w->get_read_view();
+  ASSERT_EQ(1000, v->balance);
+  ASSERT_EQ(0, v->unlocked_balance);
+  ASSERT_EQ(tx.unlock_time - CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS, v->next_unlock_time);
+  w->publish_read_view_if_stale();
+  ASSERT_EQ(v, w->get_read_view());
+
+  // there are no new blocks to publish it with
+  boost::this_thread::sleep_for(boost::chrono::seconds(3));
+  ASSERT_EQ(0, w->get_read_view()->unlocked_balance);
+  w->publish_read_view_if_stale();
+  ASSERT_EQ(1000, w->get_read_view()->unlocked_balance);
+  ASSERT_EQ(UINT64_MAX, w->get_read_view()->next_unlock_time);
+}
+
+TEST_F(wallet_read_view_test, detached_blocks_history_is_dropped)
+{
+  std::shared_ptr<tools::wallet2> w = make_wallet();
+  w->generate(m_wallet_file, "");
+  const currency::account_public_address& addr = w->get_account().get_keys().m_account_address;
+  currency::transaction tx1 = unit_test::make_test_tx(addr, 1000);
+  currency::transaction tx2 = unit_test::make_test_tx(addr, 2000);
+  add_blocks(3, { tx1 });
+  add_blocks(3, { tx2 });
+  w->refresh();
+  ASSERT_EQ(2, get_history_size(*w->get_read_view()));
+
+  // tx2 is mined again on another branch, with one more tx after it
+  m_proxy->pop_blocks(4);
+  add_blocks(2, { tx2 });
+  add_blocks(2, { unit_test::make_test_tx(addr, 3000) });
+  w->refresh();
+  std::shared_ptr<const tools::wallet2::read_view> v = w->get_read_view();
+  ASSERT_EQ(m_proxy->get_height(), v->blockchain_size);
+  ASSERT_EQ(6000, v->balance);
+  std::set<std::string> tx_hashes;
+  ASSERT_EQ(3, get_history_size(*v, &tx_hashes));
+  ASSERT_EQ(3, tx_hashes.size());
+
+  // the cut goes through the journal as well
+  w->store();
+  std::shared_ptr<tools::wallet2> w2 = make_wallet();
+  w2->load(m_wallet_file, "");
+  ASSERT_EQ(3, get_history_size(*w2->get_read_view()));
+}
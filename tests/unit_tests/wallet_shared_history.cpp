@@ -0,0 +1,76 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "wallet/shared_history.h"
+
+namespace
+{
+  typedef tools::shared_history<uint64_t> test_history;
+
+  void append_range(test_history& h, uint64_t from, uint64_t to)
+  {
+    std::vector<uint64_t> items;
+    for (uint64_t i = from; i != to; ++i)
+      items.push_back(i);
+    h.append(items.begin(), items.end());
+  }
+
+  void check_history(const test_history& h, uint64_t size)
+  {
+    ASSERT_EQ(size, h.size());
+    for (uint64_t i = 0; i != size; ++i)
+      ASSERT_EQ(i, h[i]);
+    uint64_t count = 0;
+    for (const auto& s : h.get_segments())
+    {
+      ASSERT_EQ(count, s->base);
+      count += s->items.size();
+    }
+    ASSERT_EQ(size, count);
+  }
+}
+
+TEST(wallet_shared_history, appends_keep_few_segments)
+{
+  test_history h;
+  for (uint64_t i = 0; i != 1000; ++i)
+  {
+    append_range(h, i * 3, i * 3 + 3);
+    ASSERT_GE(12, h.get_segments().size());
+  }
+  check_history(h, 3000);
+  ASSERT_EQ(1500, h.partition_point([](uint64_t item) { return item >= 1500; }));
+  ASSERT_EQ(0, h.partition_point([](uint64_t) { return true; }));
+  ASSERT_EQ(3000, h.partition_point([](uint64_t) { return false; }));
+}
+
+TEST(wallet_shared_history, copies_are_snapshots)
+{
+  test_history h;
+  append_range(h, 0, 100);
+  append_range(h, 100, 110);
+  test_history snapshot = h;
+
+  // the old segments are shared, not copied
+  append_range(h, 110, 115);
+  ASSERT_EQ(snapshot.get_segments().front(), h.get_segments().front());
+
+  h.truncate(105);
+  check_history(h, 105);
+  ASSERT_EQ(snapshot.get_segments().front(), h.get_segments().front());
+  append_range(h, 105, 120);
+  check_history(h, 120);
+  check_history(snapshot, 110);
+
+  h.truncate(50);
+  check_history(h, 50);
+  h.truncate(0);
+  ASSERT_TRUE(h.empty());
+  check_history(snapshot, 110);
+}
@@ -0,0 +1,130 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "include_base_utils.h"
+#include "common/boost_serialization_helper.h"
+#include "wallet/sparse_block_ids.h"
+
+namespace
+{
+  crypto::hash get_test_block_id(uint64_t height)
+  {
+    return crypto::cn_fast_hash(&height, sizeof height);
+  }
+
+  void fill_chain(tools::sparse_block_ids& chain, uint64_t from_height, uint64_t to_height)
+  {
+    for (uint64_t h = from_height; h != to_height; ++h)
+      chain.push_back(get_test_block_id(h));
+  }
+
+  // all ids that are kept must be the right ones, recent ids must be all kept
+  void check_chain(const tools::sparse_block_ids& chain, size_t recent_count)
+  {
+    crypto::hash id = currency::null_hash;
+    for (uint64_t h = 0; h != chain.size(); ++h)
+    {
+      bool r = chain.get(h, id);
+      if (h == 0 || h + recent_count >= chain.size())
+        ASSERT_TRUE(r);
+      if (r)
+        ASSERT_EQ(get_test_block_id(h), id);
+    }
+    ASSERT_EQ(get_test_block_id(chain.size() - 1), chain.back());
+  }
+}
+
+TEST(wallet_sparse_block_ids, keeps_recent_ids_and_few_checkpoints)
+{
+  tools::sparse_block_ids chain(100);
+  fill_chain(chain, 0, 200000);
+  ASSERT_EQ(200000, chain.size());
+  check_chain(chain, 100);
+  ASSERT_LT(chain.stored_ids_count(), 100 + SPARSE_BLOCK_IDS_CHECKPOINTS_PER_OCTAVE * 20);
+
+  ASSERT_TRUE(chain.has_ids_from(200000 - 100));
+  ASSERT_FALSE(chain.has_ids_from(200000 - 101));
+  std::vector<crypto::hash> ids;
+  ASSERT_TRUE(chain.get_ids_from(200000 - 3, ids));
+  ASSERT_EQ(std::vector<crypto::hash>({ get_test_block_id(199997), get_test_block_id(199998), get_test_block_id(199999) }), ids);
+}
+
+TEST(wallet_sparse_block_ids, short_chain_history)
+{
+  tools::sparse_block_ids chain(100);
+  fill_chain(chain, 0, 100000);
+
+  std::unordered_map<crypto::hash, uint64_t> heights;
+  for (uint64_t h = 0; h != chain.size(); ++h)
+    heights[get_test_block_id(h)] = h;
+
+  std::list<crypto::hash> ids;
+  chain.get_short_chain_history(ids);
+  ASSERT_LT(11, ids.size());
+  ASSERT_EQ(get_test_block_id(0), ids.back());
+
+  uint64_t expected_height = chain.size() - 1;
+  uint64_t prev_height = chain.size();
+  size_t i = 0;
+  for (const auto& id : ids)
+  {
+    ASSERT_EQ(1, heights.count(id));
+    uint64_t h = heights[id];
+    ASSERT_LT(h, prev_height);
+    if (i++ < 10)
+      ASSERT_EQ(expected_height--, h);
+    prev_height = h;
+  }
+}
+
+TEST(wallet_sparse_block_ids, truncate)
+{
+  tools::sparse_block_ids chain(100);
+  fill_chain(chain, 0, 10000);
+
+  // within recent ids
+  chain.truncate(9950);
+  ASSERT_EQ(9950, chain.size());
+  check_chain(chain, 50);
+  fill_chain(chain, 9950, 10000);
+  check_chain(chain, 100);
+
+  // below recent ids, the top id is a checkpoint then
+  crypto::hash id = currency::null_hash;
+  uint64_t checkpoint_height = 9000;
+  while (!chain.get(checkpoint_height, id))
+    --checkpoint_height;
+  chain.truncate(checkpoint_height + 1);
+  ASSERT_EQ(checkpoint_height + 1, chain.size());
+  ASSERT_EQ(get_test_block_id(checkpoint_height), chain.back());
+  fill_chain(chain, checkpoint_height + 1, 20000);
+  check_chain(chain, 100);
+}
+
+TEST(wallet_sparse_block_ids, serialization_and_migration)
+{
+  std::vector<crypto::hash> full_chain;
+  for (uint64_t h = 0; h != 5000; ++h)
+    full_chain.push_back(get_test_block_id(h));
+
+  tools::sparse_block_ids chain(100), migrated_chain(100);
+  fill_chain(chain, 0, 5000);
+  migrated_chain.assign(full_chain);
+  ASSERT_EQ(chain.size(), migrated_chain.size());
+  check_chain(migrated_chain, 100);
+
+  std::string buff;
+  ASSERT_TRUE(tools::serialize_obj_to_buff(chain, buff));
+  tools::sparse_block_ids loaded_chain(100);
+  ASSERT_TRUE(tools::unserialize_obj_from_buff(loaded_chain, buff));
+  ASSERT_EQ(chain.size(), loaded_chain.size());
+  ASSERT_EQ(chain.stored_ids_count(), loaded_chain.stored_ids_count());
+  check_chain(loaded_chain, 100);
+}
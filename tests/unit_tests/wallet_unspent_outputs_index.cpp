@@ -0,0 +1,129 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <cstdint>
+#include <vector>
+
+#include "profile_tools.h"
+#include "wallet/wallet2.h"
+#include "wallet/unspent_outputs_index.h"
+
+namespace
+{
+  const uint64_t test_amounts[] = { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 };
+
+  uint64_t get_test_amount(size_t i)
+  {
+    return test_amounts[(i * 7 + i / 3) % (sizeof test_amounts / sizeof test_amounts[0])];
+  }
+
+  void fill_free_amounts(size_t count, std::map<uint64_t, std::list<size_t> >& free_amounts)
+  {
+    free_amounts.clear();
+    for (size_t i = 0; i != count; ++i)
+      free_amounts[get_test_amount(i)].push_back(i);
+  }
+
+  void fill_index(size_t count, tools::unspent_outputs_index& index)
+  {
+    index.clear();
+    index.set_chain_size(1);
+    for (size_t i = 0; i != count; ++i)
+      index.add(i, get_test_amount(i), CURRENCY_TO_KEY_OUT_RELAXED, 0, 0);
+  }
+}
+
+TEST(wallet_unspent_outputs_index, same_selection_as_select_indices_for_transfer)
+{
+  tools::unspent_outputs_index index;
+  fill_index(100, index);
+  std::map<uint64_t, std::list<size_t> > free_amounts;
+
+  for (uint64_t needed_money = 0; needed_money < 20000; needed_money += 37)
+  {
+    fill_free_amounts(100, free_amounts);
+    std::list<size_t> expected_indexes;
+    uint64_t expected_money = tools::wallet2::select_indices_for_transfer(expected_indexes, free_amounts, needed_money);
+
+    std::list<size_t> selected_indexes;
+    ASSERT_EQ(expected_money, index.select(needed_money, 0, selected_indexes));
+    ASSERT_EQ(expected_indexes, selected_indexes);
+  }
+}
+
+TEST(wallet_unspent_outputs_index, locks_and_mix_attr)
+{
+  tools::unspent_outputs_index index;
+  index.set_chain_size(100);
+  index.set_time(1000);
+  index.add(0, 10, CURRENCY_TO_KEY_OUT_RELAXED, 50, 0);
+  index.add(1, 20, CURRENCY_TO_KEY_OUT_RELAXED, 110, 0);          // locked by height
+  index.add(2, 30, CURRENCY_TO_KEY_OUT_RELAXED, 50, 2000);        // locked by time
+  index.add(3, 40, CURRENCY_TO_KEY_OUT_RELAXED, 120, 1500);       // locked by both
+  index.add(4, 50, CURRENCY_TO_KEY_OUT_FORCED_NO_MIX, 50, 0);
+
+  std::list<size_t> selected;
+  ASSERT_EQ(10, index.select(100, 3, selected));
+  ASSERT_EQ(std::list<size_t>({ 0 }), selected);
+
+  selected.clear();
+  ASSERT_EQ(60, index.select(100, 0, selected));
+  ASSERT_EQ(std::list<size_t>({ 4, 0 }), selected);
+
+  index.set_chain_size(110);
+  selected.clear();
+  ASSERT_EQ(30, index.select(100, 3, selected));
+  ASSERT_EQ(std::list<size_t>({ 1, 0 }), selected);
+
+  index.set_chain_size(120);
+  index.set_time(1500);
+  selected.clear();
+  ASSERT_EQ(40, index.select(40, 3, selected));
+  ASSERT_EQ(std::list<size_t>({ 3 }), selected);
+
+  index.set_time(2000);
+  index.remove(3);
+  index.remove(4);
+  selected.clear();
+  ASSERT_EQ(60, index.select(1000, 0, selected));
+  ASSERT_EQ(std::list<size_t>({ 2, 1, 0 }), selected);
+  ASSERT_EQ(3, index.size());
+}
+
+// not a strict test, compares selection over the persistent index with the old way of
+// collecting all the wallet's unspent outputs into a map on every call
+TEST(wallet_unspent_outputs_index, benchmark)
+{
+  const size_t outputs_count = 200000;
+  const size_t selections_count = 20;
+
+  tools::unspent_outputs_index index;
+  fill_index(outputs_count, index);
+  std::map<uint64_t, std::list<size_t> > free_amounts;
+
+  uint64_t map_time = 0, index_time = 0;
+  for (size_t i = 0; i != selections_count; ++i)
+  {
+    uint64_t needed_money = 1000 + i * 977;
+    std::list<size_t> expected_indexes, selected_indexes;
+
+    TIME_MEASURE_START(map_select_time);
+    fill_free_amounts(outputs_count, free_amounts);
+    uint64_t expected_money = tools::wallet2::select_indices_for_transfer(expected_indexes, free_amounts, needed_money);
+    TIME_MEASURE_FINISH(map_select_time);
+    map_time += map_select_time;
+
+    TIME_MEASURE_START(index_select_time);
+    uint64_t found_money = index.select(needed_money, 0, selected_indexes);
+    TIME_MEASURE_FINISH(index_select_time);
+    index_time += index_select_time;
+
+    ASSERT_EQ(expected_money, found_money);
+    ASSERT_EQ(expected_indexes, selected_indexes);
+  }
+
+  std::cout << "select from " << outputs_count << " outputs, " << selections_count << " times: map " << map_time << " us, index " << index_time << " us" << std::endl;
+}
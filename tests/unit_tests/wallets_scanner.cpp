@@ -0,0 +1,111 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <ctime>
+#include <memory>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "include_base_utils.h"
+#include "wallet/wallets_scanner.h"
+#include "test_core_proxy.h"
+
+namespace
+{
+  struct test_wallets
+  {
+    test_wallets() : proxy(new unit_test::test_core_proxy(10))
+    {
+      dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("wallets_scanner_test_%%%%%%%%");
+      boost::filesystem::create_directories(dir);
+    }
+
+    ~test_wallets()
+    {
+      wallets.clear();
+      boost::system::error_code ec;
+      boost::filesystem::remove_all(dir, ec);
+    }
+
+    std::shared_ptr<tools::wallet2> add_wallet()
+    {
+      std::shared_ptr<tools::wallet2> w(new tools::wallet2());
+      w->generate((dir / ("wallet" + std::to_string(wallets.size()))).wstring(), "");
+      std::shared_ptr<tools::i_core_proxy> p = proxy;
+      w->set_core_proxy(p);
+      w->set_scan_threads_count(1);
+      w->set_refresh_prefetch_depth(0);
+      wallets.push_back(w);
+      return w;
+    }
+
+    boost::filesystem::path dir;
+    std::shared_ptr<unit_test::test_core_proxy> proxy;
+    std::vector<std::shared_ptr<tools::wallet2> > wallets;
+  };
+}
+
+TEST(wallets_scanner, wallets_are_refreshed_in_one_pass)
+{
+  test_wallets tw;
+  tools::wallets_scanner scanner;
+  scanner.set_core_proxy(tw.proxy);
+  scanner.set_threads_count(2);
+  scanner.add_wallet(tw.add_wallet());
+  scanner.add_wallet(tw.add_wallet());
+
+  // blocks are mined to the wallets in turn
+  std::vector<uint64_t> expected_balances(2, 0);
+  for (size_t i = 0; i != 25; ++i)
+  {
+    currency::block b = tw.proxy->add_block(tw.wallets[i % 2]->get_account().get_keys().m_account_address, time(nullptr));
+    expected_balances[i % 2] += currency::get_outs_money_amount(b.miner_tx);
+  }
+
+  size_t blocks_fetched = 0;
+  scanner.refresh(blocks_fetched);
+  ASSERT_EQ(25, blocks_fetched);
+  // each batch is fetched once for both wallets, the last call finds nothing new
+  ASSERT_EQ(4, tw.proxy->get_blocks_calls());
+  for (size_t i = 0; i != 2; ++i)
+  {
+    ASSERT_EQ(tw.proxy->get_height(), tw.wallets[i]->get_blockchain_current_height());
+    ASSERT_EQ(expected_balances[i], tw.wallets[i]->balance());
+  }
+}
+
+TEST(wallets_scanner, stop_interrupts_refresh)
+{
+  test_wallets tw;
+  tools::wallets_scanner scanner;
+  scanner.set_core_proxy(tw.proxy);
+  scanner.add_wallet(tw.add_wallet());
+  scanner.add_wallet(tw.add_wallet());
+  for (size_t i = 0; i != 45; ++i)
+    tw.proxy->add_block(tw.wallets[0]->get_account().get_keys().m_account_address, time(nullptr));
+
+  tw.proxy->set_get_blocks_hook([&]()
+  {
+    if (tw.proxy->get_blocks_calls() == 2)
+      scanner.stop();
+  });
+  size_t blocks_fetched = 0;
+  scanner.refresh(blocks_fetched);
+  ASSERT_EQ(2, tw.proxy->get_blocks_calls());
+  ASSERT_GT(tw.proxy->get_height(), tw.wallets[0]->get_blockchain_current_height());
+
+  // the wallets are stopped too, so they don't go on refreshing on their own
+  bool received_money = false, ok = false;
+  tw.wallets[1]->refresh(blocks_fetched, received_money, ok);
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(0, blocks_fetched);
+  ASSERT_EQ(2, tw.proxy->get_blocks_calls());
+
+  // a stopped scanner doesn't start again
+  scanner.refresh(blocks_fetched);
+  ASSERT_EQ(0, blocks_fetched);
+  ASSERT_EQ(2, tw.proxy->get_blocks_calls());
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2012-2014 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <vector>
+
+#include "include_base_utils.h"
+#include "common/parallel_utils.h"
+
+namespace
+{
+  // runs the batch and returns the ids of the threads that took part in it
+  std::set<boost::thread::id> run_test_batch(tools::worker_pool& pool, size_t count, size_t threads_count, std::vector<std::atomic<int> >& calls)
+  {
+    std::mutex lock;
+    std::set<boost::thread::id> thread_ids;
+    pool.run(count, threads_count, [&](size_t i)
+    {
+      ++calls[i];
+      std::lock_guard<std::mutex> lk(lock);
+      thread_ids.insert(boost::this_thread::get_id());
+    });
+    return thread_ids;
+  }
+}
+
+TEST(worker_pool, every_item_is_run_once_by_pool_threads)
+{
+  tools::worker_pool pool(16);
+  pool.start(3);
+  ASSERT_EQ(3, pool.get_threads_count());
+
+  std::set<boost::thread::id> all_thread_ids;
+  for (size_t n = 0; n != 20; ++n)
+  {
+    std::vector<std::atomic<int> > calls(1000);
+    std::set<boost::thread::id> thread_ids = run_test_batch(pool, calls.size(), 4, calls);
+    for (const auto& c : calls)
+      ASSERT_EQ(1, c);
+    all_thread_ids.insert(thread_ids.begin(), thread_ids.end());
+  }
+  // no threads are started per batch
+  ASSERT_GE(4, all_thread_ids.size());
+  ASSERT_EQ(0, pool.get_queue_size());
+}
+
+TEST(worker_pool, caller_runs_items_when_queue_is_full)
+{
+  tools::worker_pool pool(0);
+  pool.start(2);
+  std::vector<std::atomic<int> > calls(100);
+  std::set<boost::thread::id> thread_ids = run_test_batch(pool, calls.size(), 3, calls);
+  for (const auto& c : calls)
+    ASSERT_EQ(1, c);
+  ASSERT_EQ(1, thread_ids.size());
+  ASSERT_EQ(boost::this_thread::get_id(), *thread_ids.begin());
+}
+
+TEST(worker_pool, stopped_pool_runs_items_on_caller)
+{
+  tools::worker_pool pool(16);
+  pool.start(2);
+  pool.stop();
+  ASSERT_EQ(0, pool.get_threads_count());
+
+  std::vector<std::atomic<int> > calls(100);
+  std::set<boost::thread::id> thread_ids = run_test_batch(pool, calls.size(), 3, calls);
+  for (const auto& c : calls)
+    ASSERT_EQ(1, c);
+  ASSERT_EQ(1, thread_ids.size());
+}
+
+TEST(worker_pool, exception_is_rethrown_to_caller)
+{
+  tools::worker_pool pool(16);
+  pool.start(3);
+  ASSERT_THROW(pool.run(100, 4, [](size_t i)
+  {
+    if (i == 50)
+      throw std::runtime_error("test");
+  }), std::runtime_error);
+
+  // the pool is still usable after that
+  std::vector<std::atomic<int> > calls(100);
+  run_test_batch(pool, calls.size(), 4, calls);
+  for (const auto& c : calls)
+    ASSERT_EQ(1, c);
+}